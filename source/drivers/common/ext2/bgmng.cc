@@ -31,7 +31,7 @@
 #include "bgmng.h"
 #include "rw.h"
 
-Ext2BGMng::Ext2BGMng(Ext2FileSystem *fs) : _dirty(false), _groups(), _fs(fs) {
+Ext2BGMng::Ext2BGMng(Ext2FileSystem *fs) : _dirty(false), _groups(), _maxRuns(), _fs(fs) {
 	/* read block-group-descriptors */
 	int res;
 	size_t bcount = _fs->bytesToBlocks(_fs->getBlockGroupCount());
@@ -42,6 +42,16 @@ Ext2BGMng::Ext2BGMng(Ext2FileSystem *fs) : _dirty(false), _groups(), _fs(fs) {
 		free(_groups);
 		VTHROWE("Unable to read group-table",res);
 	}
+
+	/* we don't know the free runs yet, so assume that every group is completely free */
+	size_t count = _fs->getBlockGroupCount();
+	_maxRuns = (uint32_t*)malloc(count * sizeof(uint32_t));
+	if(_maxRuns == NULL) {
+		free(_groups);
+		VTHROWE("Unable to allocate memory for blockgroups",-ENOMEM);
+	}
+	for(size_t i = 0; i < count; ++i)
+		_maxRuns[i] = le32tocpu(_fs->sb.get()->blocksPerGroup);
 }
 
 void Ext2BGMng::update() {
@@ -39,6 +39,7 @@ public:
 	 * Destroys the blockgroups
 	 */
 	~Ext2BGMng() {
+		free(_maxRuns);
 		free(_groups);
 	}
 
@@ -50,6 +51,25 @@ public:
 		return _groups + i;
 	}
 
+	/**
+	 * @param i the block group number
+	 * @return an upper bound for the length of the longest run of free blocks in group <i>
+	 */
+	size_t getMaxRun(size_t i) const {
+		return _maxRuns[i];
+	}
+
+	/**
+	 * Sets the upper bound for the length of the longest run of free blocks in group <i>. This is
+	 * used to skip groups without loading their bitmap, when searching for contiguous blocks.
+	 *
+	 * @param i the block group number
+	 * @param run the length
+	 */
+	void setMaxRun(size_t i,size_t run) {
+		_maxRuns[i] = run;
+	}
+
 	/**
 	 * Marks the superblock as dirty
 	 */
@@ -77,5 +97,6 @@ private:
 private:
 	bool _dirty;
 	Ext2BlockGrp *_groups;
+	uint32_t *_maxRuns;
 	Ext2FileSystem *_fs;
 };
@@ -26,29 +26,23 @@
 
 #include "ext2.h"
 #include "bitmap.h"
+#include "bgmng.h"
 #include "sbmng.h"
 
 ino_t Ext2Bitmap::allocInode(Ext2FileSystem *e,Ext2CInode *dirInode,bool isDir) {
 	size_t gcount = e->getBlockGroupCount();
-	block_t block = e->getBlockOfInode(dirInode->inodeNo);
-	block_t i,group = e->getGroupOfBlock(block);
+	block_t group = e->getGroupOfInode(dirInode->inodeNo);
 	ino_t ino = 0;
-	uint32_t inodesPerGroup = le32tocpu(e->sb.get()->inodesPerGroup);
 
 	sassert(tpool_lock(EXT2_SUPERBLOCK_LOCK,LOCK_EXCLUSIVE | LOCK_KEEP) == 0);
 	if(le32tocpu(e->sb.get()->freeInodeCount) == 0)
 		goto done;
 
-	/* first try to find a block in the block-group of the inode */
-	ino = allocInodeIn(e,group * inodesPerGroup,e->bgs.get(group),isDir);
-	if(ino != 0)
-		goto done;
-
-	/* now try the other block-groups */
-	for(i = group + 1; i != group; i = (i + 1) % gcount) {
-		ino = allocInodeIn(e,i * inodesPerGroup,e->bgs.get(i),isDir);
+	/* first try the block-group of the directory, then the following ones */
+	for(size_t i = 0; i < gcount; ++i) {
+		ino = allocInodeIn(e,(group + i) % gcount,isDir);
 		if(ino != 0)
-			goto done;
+			break;
 	}
 
 done:
@@ -58,34 +52,25 @@ done:
 
 int Ext2Bitmap::freeInode(Ext2FileSystem *e,ino_t ino,bool isDir) {
 	block_t group = e->getGroupOfInode(ino);
-	uint8_t *bitmapbuf;
+	Ext2BlockGrp *bg = e->bgs.get(group);
 	CBlock *bitmap;
-	uint16_t freeInodeCount;
-	uint32_t sFreeInodeCount;
 
 	sassert(tpool_lock(EXT2_SUPERBLOCK_LOCK,LOCK_EXCLUSIVE | LOCK_KEEP) == 0);
-	bitmap = e->blockCache.request(le32tocpu(e->bgs.get(group)->inodeBitmap),BlockCache::WRITE);
+	bitmap = e->blockCache.request(le32tocpu(bg->inodeBitmap),BlockCache::WRITE);
 	if(bitmap == NULL) {
 		sassert(tpool_unlock(EXT2_SUPERBLOCK_LOCK) == 0);
 		return -1;
 	}
 
 	/* mark free in bitmap */
-	ino--;
-	ino %= le32tocpu(e->sb.get()->inodesPerGroup);
-	bitmapbuf = (uint8_t*)bitmap->buffer;
-	bitmapbuf[ino / 8] &= ~(1 << (ino % 8));
+	setBits((uint32_t*)bitmap->buffer,(ino - 1) % le32tocpu(e->sb.get()->inodesPerGroup),1,false);
 
-	freeInodeCount = le16tocpu(e->bgs.get(group)->freeInodeCount);
-	e->bgs.get(group)->freeInodeCount = cputole16(freeInodeCount + 1);
-	if(isDir) {
-		uint16_t usedDirCount = le16tocpu(e->bgs.get(group)->usedDirCount);
-		e->bgs.get(group)->usedDirCount = cputole16(usedDirCount - 1);
-	}
+	bg->freeInodeCount = cputole16(le16tocpu(bg->freeInodeCount) + 1);
+	if(isDir)
+		bg->usedDirCount = cputole16(le16tocpu(bg->usedDirCount) - 1);
 	e->bgs.markDirty();
 
-	sFreeInodeCount = le32tocpu(e->sb.get()->freeInodeCount);
-	e->sb.get()->freeInodeCount = cputole32(sFreeInodeCount + 1);
+	e->sb.get()->freeInodeCount = cputole32(le32tocpu(e->sb.get()->freeInodeCount) + 1);
 	e->sb.markDirty();
 
 	e->blockCache.markDirty(bitmap);
@@ -94,102 +79,146 @@ int Ext2Bitmap::freeInode(Ext2FileSystem *e,ino_t ino,bool isDir) {
 	return 0;
 }
 
-ino_t Ext2Bitmap::allocInodeIn(Ext2FileSystem *e,block_t groupStart,Ext2BlockGrp *group,bool isDir) {
-	size_t i,j;
-	ino_t ino;
-	CBlock *bitmap;
-	uint8_t *bitmapbuf;
-	uint32_t sFreeInodeCount;
-	if(le16tocpu(group->freeInodeCount) == 0)
+ino_t Ext2Bitmap::allocInodeIn(Ext2FileSystem *e,block_t group,bool isDir) {
+	Ext2BlockGrp *bg = e->bgs.get(group);
+	if(le16tocpu(bg->freeInodeCount) == 0)
 		return 0;
 
 	/* load bitmap */
-	bitmap = e->blockCache.request(le32tocpu(group->inodeBitmap),BlockCache::WRITE);
+	CBlock *bitmap = e->blockCache.request(le32tocpu(bg->inodeBitmap),BlockCache::WRITE);
 	if(bitmap == NULL)
 		return 0;
 
-	ino = 0;
-	bitmapbuf = (uint8_t*)bitmap->buffer;
-	for(i = 0; i < e->blockSize(); i++) {
-		for(j = 1; j < 256; ino++, j <<= 1) {
-			if(ino >= (ino_t)le32tocpu(e->sb.get()->inodeCount)) {
-				e->blockCache.release(bitmap);
-				return 0;
-			}
-			if(!(bitmapbuf[i] & j)) {
-				uint16_t freeInodeCount = le16tocpu(group->freeInodeCount);
-				group->freeInodeCount = cputole16(freeInodeCount - 1);
-				if(isDir) {
-					uint16_t usedDirCount = le16tocpu(group->usedDirCount);
-					group->usedDirCount = cputole16(usedDirCount + 1);
-				}
-				e->bgs.markDirty();
-				bitmapbuf[i] |= j;
-				sFreeInodeCount = le32tocpu(e->sb.get()->freeInodeCount);
-				e->sb.get()->freeInodeCount = cputole32(sFreeInodeCount - 1);
-				e->sb.markDirty();
-				e->blockCache.markDirty(bitmap);
-				e->blockCache.release(bitmap);
-				return ino + groupStart + 1;
-			}
-		}
+	/* the last group might be smaller */
+	uint32_t inodesPerGroup = le32tocpu(e->sb.get()->inodesPerGroup);
+	size_t bits = MIN(inodesPerGroup,le32tocpu(e->sb.get()->inodeCount) - group * inodesPerGroup);
+	uint32_t *words = (uint32_t*)bitmap->buffer;
+	size_t bit = findClear(words,0,bits);
+	if(bit == bits) {
+		e->blockCache.release(bitmap);
+		return 0;
 	}
+
+	setBits(words,bit,1,true);
+	bg->freeInodeCount = cputole16(le16tocpu(bg->freeInodeCount) - 1);
+	if(isDir)
+		bg->usedDirCount = cputole16(le16tocpu(bg->usedDirCount) + 1);
+	e->bgs.markDirty();
+	e->sb.get()->freeInodeCount = cputole32(le32tocpu(e->sb.get()->freeInodeCount) - 1);
+	e->sb.markDirty();
+	e->blockCache.markDirty(bitmap);
 	e->blockCache.release(bitmap);
-	return 0;
+	return group * inodesPerGroup + bit + 1;
 }
 
 block_t Ext2Bitmap::allocBlock(Ext2FileSystem *e,Ext2CInode *inode) {
+	block_t bno;
+	/* use the reserved blocks first */
+	if(inode->resCount > 0) {
+		bno = inode->resStart++;
+		inode->resCount--;
+	}
+	else {
+		size_t count = 1;
+		bno = allocBlocks(e,inode,inode->allocGoal,&count);
+	}
+	if(bno != 0)
+		inode->allocGoal = bno + 1;
+	return bno;
+}
+
+block_t Ext2Bitmap::allocBlocks(Ext2FileSystem *e,Ext2CInode *inode,block_t goal,size_t *count) {
 	size_t gcount = e->getBlockGroupCount();
-	block_t block = e->getBlockOfInode(inode->inodeNo);
-	block_t i,group = e->getGroupOfBlock(block);
-	block_t bno = 0;
 	uint32_t blocksPerGroup = le32tocpu(e->sb.get()->blocksPerGroup);
+	uint32_t firstBlock = le32tocpu(e->sb.get()->firstDataBlock);
+	block_t group,bno = 0;
 
 	sassert(tpool_lock(EXT2_SUPERBLOCK_LOCK,LOCK_EXCLUSIVE | LOCK_KEEP) == 0);
 	if(le32tocpu(e->sb.get()->freeBlockCount) == 0)
 		goto done;
 
-	/* first try to find a block in the block-group of the inode */
-	bno = allocBlockIn(e,group * blocksPerGroup,e->bgs.get(group));
-	if(bno != 0)
-		goto done;
+	if(goal < firstBlock || goal >= le32tocpu(e->sb.get()->blockCount))
+		goal = 0;
+
+	/* if there is a goal, try to continue there */
+	if(goal != 0) {
+		group = e->getGroupOfBlock(goal);
+		bno = allocRunIn(e,group,(goal - firstBlock) % blocksPerGroup,count,RUN_AT);
+		if(bno != 0)
+			goto done;
+	}
+	/* otherwise start in the group of the inode */
+	else
+		group = e->getGroupOfInode(inode->inodeNo);
+
+	/* search for a run that is long enough. the hints let us skip groups without such a run */
+	for(size_t i = 0; i < gcount; ++i) {
+		block_t g = (group + i) % gcount;
+		if(le16tocpu(e->bgs.get(g)->freeBlockCount) >= *count && e->bgs.getMaxRun(g) >= *count) {
+			bno = allocRunIn(e,g,0,count,RUN_FULL);
+			if(bno != 0)
+				goto done;
+		}
+	}
 
-	/* now try the other block-groups */
-	for(i = group + 1; i != group; i = (i + 1) % gcount) {
-		bno = allocBlockIn(e,i * blocksPerGroup,e->bgs.get(i));
+	/* take what we can get */
+	for(size_t i = 0; i < gcount; ++i) {
+		bno = allocRunIn(e,(group + i) % gcount,0,count,RUN_ANY);
 		if(bno != 0)
 			goto done;
 	}
 
 done:
+	if(bno == 0)
+		*count = 0;
 	sassert(tpool_unlock(EXT2_SUPERBLOCK_LOCK) == 0);
 	return bno;
 }
 
-int Ext2Bitmap::freeBlock(Ext2FileSystem *e,block_t blockNo) {
+void Ext2Bitmap::reserve(Ext2FileSystem *e,Ext2CInode *inode,size_t count) {
+	if(inode->resCount == 0 && count > 1) {
+		inode->resStart = allocBlocks(e,inode,inode->allocGoal,&count);
+		inode->resCount = count;
+	}
+}
+
+void Ext2Bitmap::discard(Ext2FileSystem *e,Ext2CInode *inode) {
+	if(inode->resCount > 0) {
+		freeBlocks(e,inode->resStart,inode->resCount);
+		inode->resCount = 0;
+	}
+}
+
+int Ext2Bitmap::freeBlocks(Ext2FileSystem *e,block_t blockNo,size_t count) {
 	block_t group = e->getGroupOfBlock(blockNo);
+	Ext2BlockGrp *bg = e->bgs.get(group);
+	uint32_t blocksPerGroup = le32tocpu(e->sb.get()->blocksPerGroup);
 	CBlock *bitmap;
-	uint8_t *bitmapbuf;
-	uint16_t freeBlockCount;
-	uint32_t sFreeBlockCount;
 
 	sassert(tpool_lock(EXT2_SUPERBLOCK_LOCK,LOCK_EXCLUSIVE | LOCK_KEEP) == 0);
-	bitmap = e->blockCache.request(le32tocpu(e->bgs.get(group)->blockBitmap),BlockCache::WRITE);
+	bitmap = e->blockCache.request(le32tocpu(bg->blockBitmap),BlockCache::WRITE);
 	if(bitmap == NULL) {
 		sassert(tpool_unlock(EXT2_SUPERBLOCK_LOCK) == 0);
 		return -1;
 	}
 
 	/* mark free in bitmap */
-	blockNo--;
-	blockNo %= le32tocpu(e->sb.get()->blocksPerGroup);
-	bitmapbuf = (uint8_t*)bitmap->buffer;
-	bitmapbuf[blockNo / 8] &= ~(1 << (blockNo % 8));
-	freeBlockCount = le16tocpu(e->bgs.get(group)->freeBlockCount);
-	e->bgs.get(group)->freeBlockCount = cputole16(freeBlockCount + 1);
+	uint32_t *words = (uint32_t*)bitmap->buffer;
+	size_t bits = MIN(blocksPerGroup,
+		le32tocpu(e->sb.get()->blockCount) - le32tocpu(e->sb.get()->firstDataBlock) - group * blocksPerGroup);
+	size_t bit = (blockNo - le32tocpu(e->sb.get()->firstDataBlock)) % blocksPerGroup;
+	assert(bit + count <= bits);
+	setBits(words,bit,count,false);
+
+	/* the freed blocks might have been merged with other free blocks to a longer run */
+	size_t runStart = findLastSet(words,bit);
+	size_t runEnd = findSet(words,bit + count,bits);
+	if(runEnd - runStart > e->bgs.getMaxRun(group))
+		e->bgs.setMaxRun(group,runEnd - runStart);
+
+	bg->freeBlockCount = cputole16(le16tocpu(bg->freeBlockCount) + count);
 	e->bgs.markDirty();
-	sFreeBlockCount = le32tocpu(e->sb.get()->freeBlockCount);
-	e->sb.get()->freeBlockCount = cputole32(sFreeBlockCount + 1);
+	e->sb.get()->freeBlockCount = cputole32(le32tocpu(e->sb.get()->freeBlockCount) + count);
 	e->sb.markDirty();
 	e->blockCache.markDirty(bitmap);
 	e->blockCache.release(bitmap);
@@ -197,43 +226,120 @@ int Ext2Bitmap::freeBlock(Ext2FileSystem *e,block_t blockNo) {
 	return 0;
 }
 
-block_t Ext2Bitmap::allocBlockIn(Ext2FileSystem *e,block_t groupStart,Ext2BlockGrp *group) {
-	size_t i,j;
-	block_t bno;
-	CBlock *bitmap;
-	uint8_t *bitmapbuf;
-	uint32_t sFreeBlockCount;
-	uint32_t blockCount = le32tocpu(e->sb.get()->blockCount);
-	if(le16tocpu(group->freeBlockCount) == 0)
+block_t Ext2Bitmap::allocRunIn(Ext2FileSystem *e,block_t group,size_t start,size_t *count,int mode) {
+	Ext2BlockGrp *bg = e->bgs.get(group);
+	if(le16tocpu(bg->freeBlockCount) == 0)
 		return 0;
 
 	/* load bitmap */
-	bitmap = e->blockCache.request(le32tocpu(group->blockBitmap),BlockCache::WRITE);
+	CBlock *bitmap = e->blockCache.request(le32tocpu(bg->blockBitmap),BlockCache::WRITE);
 	if(bitmap == NULL)
 		return 0;
 
-	bno = 0;
-	bitmapbuf = (uint8_t*)bitmap->buffer;
-	for(i = 0; i < e->blockSize(); i++) {
-		for(j = 1; j < 256; bno++, j <<= 1) {
-			if(bno >= blockCount) {
-				e->blockCache.release(bitmap);
-				return 0;
-			}
-			if(!(bitmapbuf[i] & j)) {
-				uint16_t freeBlockCount = le16tocpu(group->freeBlockCount);
-				group->freeBlockCount = cputole16(freeBlockCount - 1);
-				e->bgs.markDirty();
-				bitmapbuf[i] |= j;
-				sFreeBlockCount = le32tocpu(e->sb.get()->freeBlockCount);
-				e->sb.get()->freeBlockCount = cputole32(sFreeBlockCount - 1);
-				e->sb.markDirty();
-				e->blockCache.markDirty(bitmap);
-				e->blockCache.release(bitmap);
-				return bno + groupStart + 1;
+	/* the last group might be smaller */
+	uint32_t blocksPerGroup = le32tocpu(e->sb.get()->blocksPerGroup);
+	uint32_t firstBlock = le32tocpu(e->sb.get()->firstDataBlock);
+	size_t bits = MIN(blocksPerGroup,le32tocpu(e->sb.get()->blockCount) - firstBlock - group * blocksPerGroup);
+	uint32_t *words = (uint32_t*)bitmap->buffer;
+
+	size_t runStart = bits,runLen = 0;
+	if(mode == RUN_AT) {
+		if(start < bits && findClear(words,start,start + 1) == start) {
+			runStart = start;
+			runLen = findSet(words,start,MIN(bits,start + *count)) - start;
+		}
+	}
+	else {
+		size_t maxRun = 0;
+		for(size_t pos = start; pos < bits; ) {
+			size_t free = findClear(words,pos,bits);
+			if(free == bits)
+				break;
+			size_t used = findSet(words,free,mode == RUN_FULL ? bits : MIN(bits,free + *count));
+			if(used - free >= *count || mode == RUN_ANY) {
+				runStart = free;
+				runLen = MIN(*count,used - free);
+				break;
 			}
+			maxRun = MAX(maxRun,used - free);
+			pos = used;
 		}
+		/* we've seen all runs, so we know the longest one now */
+		if(runLen == 0 && mode == RUN_FULL)
+			e->bgs.setMaxRun(group,maxRun);
 	}
+
+	if(runLen == 0) {
+		e->blockCache.release(bitmap);
+		return 0;
+	}
+
+	setBits(words,runStart,runLen,true);
+	bg->freeBlockCount = cputole16(le16tocpu(bg->freeBlockCount) - runLen);
+	e->bgs.markDirty();
+	e->sb.get()->freeBlockCount = cputole32(le32tocpu(e->sb.get()->freeBlockCount) - runLen);
+	e->sb.markDirty();
+	e->blockCache.markDirty(bitmap);
 	e->blockCache.release(bitmap);
-	return 0;
+	*count = runLen;
+	return firstBlock + group * blocksPerGroup + runStart;
+}
+
+size_t Ext2Bitmap::findClear(const uint32_t *bitmap,size_t start,size_t end) {
+	if(start >= end)
+		return end;
+
+	/* ignore the bits in front of start in the first word */
+	size_t w = start / 32;
+	uint32_t word = ~le32tocpu(bitmap[w]) & (~0U << (start % 32));
+	while(word == 0) {
+		if(++w * 32 >= end)
+			return end;
+		word = ~le32tocpu(bitmap[w]);
+	}
+	return MIN(end,w * 32 + __builtin_ctz(word));
+}
+
+size_t Ext2Bitmap::findSet(const uint32_t *bitmap,size_t start,size_t end) {
+	if(start >= end)
+		return end;
+
+	size_t w = start / 32;
+	uint32_t word = le32tocpu(bitmap[w]) & (~0U << (start % 32));
+	while(word == 0) {
+		if(++w * 32 >= end)
+			return end;
+		word = le32tocpu(bitmap[w]);
+	}
+	return MIN(end,w * 32 + __builtin_ctz(word));
+}
+
+size_t Ext2Bitmap::findLastSet(const uint32_t *bitmap,size_t end) {
+	if(end == 0)
+		return 0;
+
+	/* ignore the bits behind end in the last word. the result is the bit behind the set one */
+	size_t w = (end - 1) / 32;
+	uint32_t word = le32tocpu(bitmap[w]) & (~0U >> (31 - ((end - 1) % 32)));
+	while(word == 0) {
+		if(w-- == 0)
+			return 0;
+		word = le32tocpu(bitmap[w]);
+	}
+	return w * 32 + 32 - __builtin_clz(word);
+}
+
+void Ext2Bitmap::setBits(uint32_t *bitmap,size_t start,size_t count,bool set) {
+	while(count > 0) {
+		size_t w = start / 32;
+		size_t off = start % 32;
+		size_t n = MIN(count,32 - off);
+		uint32_t mask = (n == 32 ? ~0U : ((1U << n) - 1)) << off;
+		if(set)
+			bitmap[w] = cputole32(le32tocpu(bitmap[w]) | mask);
+		else
+			bitmap[w] = cputole32(le32tocpu(bitmap[w]) & ~mask);
+		start += n;
+		count -= n;
+	}
 }
@@ -25,6 +25,15 @@
 class Ext2Bitmap {
 	Ext2Bitmap() = delete;
 
+	enum {
+		/* the run has to start at the given bit */
+		RUN_AT,
+		/* the run has to have the requested length */
+		RUN_FULL,
+		/* take the first free run, regardless of the length */
+		RUN_ANY,
+	};
+
 public:
 	/**
 	 * Allocates a new inode for the given directory-inode. It will be tried to allocate an inode in
@@ -48,8 +57,9 @@ public:
 	static int freeInode(Ext2FileSystem *e,ino_t ino,bool isDir);
 
 	/**
-	 * Allocates a new block for the given inode. It will be tried to allocate a block in the same
-	 * block-group.
+	 * Allocates a new block for the given inode. If blocks have been reserved for the inode, the
+	 * next one of them is used. Otherwise, it will be tried to allocate the block behind the one
+	 * that has been allocated last for this inode or at least one in the same block-group.
 	 *
 	 * @param e the ext2-fs
 	 * @param inode the inode
@@ -57,6 +67,37 @@ public:
 	 */
 	static block_t allocBlock(Ext2FileSystem *e,Ext2CInode *inode);
 
+	/**
+	 * Allocates up to <*count> contiguous blocks, preferably starting at <goal>. If there is no
+	 * run of free blocks that is long enough, a shorter one is allocated.
+	 *
+	 * @param e the ext2-fs
+	 * @param inode the inode
+	 * @param goal the preferred block-number (0 = none)
+	 * @param count the number of blocks; will be set to the number of allocated blocks
+	 * @return the first block-number or 0 if failed
+	 */
+	static block_t allocBlocks(Ext2FileSystem *e,Ext2CInode *inode,block_t goal,size_t *count);
+
+	/**
+	 * Allocates up to <count> contiguous blocks in advance for the following allocBlock() calls
+	 * of <inode>. This is used to lay out large writes contiguously on disk. Note that you have to
+	 * call discard() afterwards.
+	 *
+	 * @param e the ext2-fs
+	 * @param inode the inode
+	 * @param count the number of blocks
+	 */
+	static void reserve(Ext2FileSystem *e,Ext2CInode *inode,size_t count);
+
+	/**
+	 * Frees the blocks that have been reserved for <inode> but have not been used.
+	 *
+	 * @param e the ext2-fs
+	 * @param inode the inode
+	 */
+	static void discard(Ext2FileSystem *e,Ext2CInode *inode);
+
 	/**
 	 * Free's the given block-number
 	 *
@@ -64,9 +105,25 @@ public:
 	 * @param blockNo the block-number
 	 * @return 0 on success
 	 */
-	static int freeBlock(Ext2FileSystem *e,block_t blockNo);
+	static int freeBlock(Ext2FileSystem *e,block_t blockNo) {
+		return freeBlocks(e,blockNo,1);
+	}
+
+	/**
+	 * Free's the <count> blocks starting at <blockNo>. They have to be in the same block-group.
+	 *
+	 * @param e the ext2-fs
+	 * @param blockNo the first block-number
+	 * @param count the number of blocks
+	 * @return 0 on success
+	 */
+	static int freeBlocks(Ext2FileSystem *e,block_t blockNo,size_t count);
 
 private:
-	static ino_t allocInodeIn(Ext2FileSystem *e,block_t groupStart,Ext2BlockGrp *group,bool isDir);
-	static block_t allocBlockIn(Ext2FileSystem *e,block_t groupStart,Ext2BlockGrp *group);
+	static ino_t allocInodeIn(Ext2FileSystem *e,block_t group,bool isDir);
+	static block_t allocRunIn(Ext2FileSystem *e,block_t group,size_t start,size_t *count,int mode);
+	static size_t findClear(const uint32_t *bitmap,size_t start,size_t end);
+	static size_t findSet(const uint32_t *bitmap,size_t start,size_t end);
+	static size_t findLastSet(const uint32_t *bitmap,size_t end);
+	static void setBits(uint32_t *bitmap,size_t start,size_t count,bool set);
 };
@@ -24,11 +24,14 @@
 #include <errno.h>
 #include <string.h>
 #include <assert.h>
+#include <time.h>
 
 #include "ext2.h"
 #include "dir.h"
 #include "file.h"
 #include "link.h"
+#include "inode.h"
+#include "htree.h"
 #include "inodecache.h"
 
 int Ext2Dir::create(Ext2FileSystem *e,FSUser *u,Ext2CInode *dir,const char *name,mode_t mode) {
@@ -44,6 +47,9 @@ int Ext2Dir::create(Ext2FileSystem *e,FSUser *u,Ext2CInode *dir,const char *name
 	cnode = e->inodeCache.request(ino,IMODE_WRITE);
 	vassert(cnode != NULL,"Unable to load inode %d\n",ino);
 
+	/* the inode might have been a directory before */
+	e->dirCache.removeDir(ino);
+
 	/* create '.' and '..' */
 	if((res = Ext2Link::create(e,u,cnode,cnode,".")) < 0) {
 		Ext2File::remove(e,cnode);
@@ -65,48 +71,70 @@ int Ext2Dir::create(Ext2FileSystem *e,FSUser *u,Ext2CInode *dir,const char *name
 
 ino_t Ext2Dir::find(Ext2FileSystem *e,Ext2CInode *dir,const char *name,size_t nameLen) {
 	ino_t ino;
-	size_t size = le32tocpu(dir->inode.size);
-	int res;
-	Ext2DirEntry *buffer = (Ext2DirEntry*)malloc(size);
-	if(buffer == NULL)
-		return -ENOMEM;
+	if(e->dirCache.find(dir->inodeNo,name,nameLen,&ino))
+		return ino;
 
-	/* read the directory */
-	if((res = Ext2File::readIno(e,dir,buffer,0,size)) < 0) {
-		free(buffer);
-		return res;
-	}
+	/* use the index, if there is one and it's usable */
+	ino = -EINVAL;
+	if(Ext2HTree::isIndexed(e,dir))
+		ino = Ext2HTree::find(e,dir,name,nameLen);
+	if(ino == -EINVAL)
+		ino = findLinear(e,dir,name,nameLen);
 
-	ino = findIn(buffer,size,name,nameLen);
-	free(buffer);
+	if(ino >= 0 || ino == -ENOENT)
+		e->dirCache.insert(dir->inodeNo,name,nameLen,ino);
 	return ino;
 }
 
-ino_t Ext2Dir::findIn(Ext2DirEntry *buffer,size_t bufSize,const char *name,size_t nameLen) {
-	ssize_t rem = bufSize;
-	Ext2DirEntry *entry = buffer;
-
-	/* search the directory-entries */
-	while(rem > 0 && le32tocpu(entry->inode) != 0) {
-		/* found a match? */
-		if(nameLen == le16tocpu(entry->nameLen) && strncmp(entry->name,name,nameLen) == 0) {
-			ino_t ino = le32tocpu(entry->inode);
-			return ino;
-		}
+int Ext2Dir::add(Ext2FileSystem *e,Ext2CInode *dir,ino_t ino,const char *name,size_t nameLen) {
+	/* check if the entry exists */
+	ino_t exist = find(e,dir,name,nameLen);
+	if(exist >= 0)
+		return -EEXIST;
+	if(exist != -ENOENT)
+		return exist;
 
-		/* to next dir-entry */
-		rem -= le16tocpu(entry->recLen);
-		entry = (Ext2DirEntry*)((uintptr_t)entry + le16tocpu(entry->recLen));
+	int res = -EINVAL;
+	if(Ext2HTree::isIndexed(e,dir)) {
+		res = Ext2HTree::add(e,dir,ino,name,nameLen);
+		/* if the index is broken, continue without it */
+		if(res == -EINVAL)
+			Ext2HTree::drop(e,dir);
 	}
-	return -ENOENT;
+	if(res == -EINVAL)
+		res = addLinear(e,dir,ino,name,nameLen);
+	if(res < 0)
+		return res;
+
+	e->dirCache.insert(dir->inodeNo,name,nameLen,ino);
+	time_t now = cputole32(time(NULL));
+	dir->inode.accesstime = now;
+	dir->inode.modifytime = now;
+	e->inodeCache.markDirty(dir);
+	return 0;
+}
+
+ino_t Ext2Dir::removeEntry(Ext2FileSystem *e,Ext2CInode *dir,const char *name,size_t nameLen) {
+	ino_t ino = -EINVAL;
+	if(Ext2HTree::isIndexed(e,dir))
+		ino = Ext2HTree::remove(e,dir,name,nameLen);
+	if(ino == -EINVAL)
+		ino = removeLinear(e,dir,name,nameLen);
+	if(ino < 0)
+		return ino;
+
+	e->dirCache.insert(dir->inodeNo,name,nameLen,-ENOENT);
+	time_t now = cputole32(time(NULL));
+	dir->inode.accesstime = now;
+	dir->inode.modifytime = now;
+	e->inodeCache.markDirty(dir);
+	return ino;
 }
 
 int Ext2Dir::remove(Ext2FileSystem *e,FSUser *u,Ext2CInode *dir,const char *name) {
 	ino_t ino;
-	size_t size = le32tocpu(dir->inode.size);
 	int res;
 	Ext2CInode *delIno;
-	Ext2DirEntry *entry,*buffer;
 
 	/* we need write-permission to delete */
 	if((res = e->hasPermission(dir,u,MODE_WRITE)) < 0)
@@ -121,33 +149,12 @@ int Ext2Dir::remove(Ext2FileSystem *e,FSUser *u,Ext2CInode *dir,const char *name
 	if(delIno == NULL)
 		return -ENOBUFS;
 
-	/* read the directory */
-	buffer = (Ext2DirEntry*)malloc(size);
-	if(buffer == NULL) {
-		res = -ENOMEM;
-		goto error;
-	}
-	if((res = Ext2File::readIno(e,delIno,buffer,0,size)) < 0)
-		goto error;
-
-	/* search for other entries than '.' and '..' */
-	entry = buffer;
-	while(size > 0 && entry->inode != 0) {
-		uint16_t namelen = le16tocpu(entry->nameLen);
-		/* found a match? */
-		if(namelen != 1 && namelen != 2 &&
-				strncmp(entry->name,".",namelen) != 0 &&
-				strncmp(entry->name,"..",namelen) != 0) {
+	/* check whether there are other entries than '.' and '..' */
+	if((res = isEmpty(e,delIno)) <= 0) {
+		if(res == 0)
 			res = -ENOTEMPTY;
-			goto error;
-		}
-
-		/* to next dir-entry */
-		size -= le16tocpu(entry->recLen);
-		entry = (Ext2DirEntry*)((uintptr_t)entry + le16tocpu(entry->recLen));
+		goto error;
 	}
-	free(buffer);
-	buffer = NULL;
 
 	/* ok, directory is empty, so remove '.' and '..' */
 	if((res = Ext2Link::remove(e,u,dir,delIno,".",true)) < 0 ||
@@ -157,11 +164,203 @@ int Ext2Dir::remove(Ext2FileSystem *e,FSUser *u,Ext2CInode *dir,const char *name
 	e->inodeCache.release(delIno);
 	/* now remove directory from parent, which will delete it because of no more references */
 	res = Ext2Link::remove(e,u,NULL,dir,name,true);
-	free(buffer);
+	if(res == 0)
+		e->dirCache.removeDir(ino);
 	return res;
 
 error:
-	free(buffer);
 	e->inodeCache.release(delIno);
 	return res;
 }
+
+CBlock *Ext2Dir::requestBlock(Ext2FileSystem *e,const Ext2CInode *dir,block_t lblock,uint mode) {
+	if(lblock >= e->bytesToBlocks(le32tocpu(dir->inode.size)))
+		return NULL;
+	block_t block = Ext2INode::getDataBlock(e,dir,lblock);
+	if(block == 0)
+		return NULL;
+	return e->blockCache.request(block,mode);
+}
+
+CBlock *Ext2Dir::appendBlock(Ext2FileSystem *e,Ext2CInode *dir,block_t *lblock) {
+	size_t size = le32tocpu(dir->inode.size);
+	*lblock = e->bytesToBlocks(size);
+	block_t block = Ext2INode::reqDataBlock(e,dir,*lblock);
+	if(block == 0)
+		return NULL;
+	CBlock *blk = e->blockCache.create(block);
+	if(blk == NULL)
+		return NULL;
+
+	/* an empty directory-block consists of one unused entry */
+	Ext2DirEntry *de = (Ext2DirEntry*)blk->buffer;
+	de->inode = cputole32(0);
+	de->recLen = cputole16(e->blockSize());
+	de->nameLen = cputole16(0);
+	e->blockCache.markDirty(blk);
+
+	dir->inode.size = cputole32((*lblock + 1) * e->blockSize());
+	e->inodeCache.markDirty(dir);
+	return blk;
+}
+
+ino_t Ext2Dir::findInBlock(Ext2FileSystem *e,const void *buffer,const char *name,size_t nameLen) {
+	size_t bs = e->blockSize();
+	for(size_t off = 0; off + sizeof(Ext2DirEntry) <= bs; ) {
+		const Ext2DirEntry *de = (const Ext2DirEntry*)((uintptr_t)buffer + off);
+		uint16_t recLen = le16tocpu(de->recLen);
+		if(recLen < sizeof(Ext2DirEntry) || off + recLen > bs)
+			break;
+
+		/* found a match? */
+		if(le32tocpu(de->inode) != 0 && nameLen == le16tocpu(de->nameLen) &&
+				strncmp(de->name,name,nameLen) == 0)
+			return le32tocpu(de->inode);
+		off += recLen;
+	}
+	return -ENOENT;
+}
+
+bool Ext2Dir::addToBlock(Ext2FileSystem *e,void *buffer,ino_t ino,const char *name,size_t nameLen) {
+	size_t bs = e->blockSize();
+	size_t tlen = Ext2Link::getDirESize(nameLen);
+	for(size_t off = 0; off + sizeof(Ext2DirEntry) <= bs; ) {
+		Ext2DirEntry *de = (Ext2DirEntry*)((uintptr_t)buffer + off);
+		uint16_t recLen = le16tocpu(de->recLen);
+		if(recLen < sizeof(Ext2DirEntry) || off + recLen > bs)
+			break;
+
+		/* does our entry fit into the unused space of this one? */
+		size_t used = le32tocpu(de->inode) != 0 ? Ext2Link::getDirESize(le16tocpu(de->nameLen)) : 0;
+		if(recLen >= used + tlen) {
+			if(used > 0) {
+				de->recLen = cputole16(used);
+				de = (Ext2DirEntry*)((uintptr_t)de + used);
+				de->recLen = cputole16(recLen - used);
+			}
+			de->inode = cputole32(ino);
+			de->nameLen = cputole16(nameLen);
+			memcpy(de->name,name,nameLen);
+			return true;
+		}
+		off += recLen;
+	}
+	return false;
+}
+
+ino_t Ext2Dir::removeFromBlock(Ext2FileSystem *e,void *buffer,const char *name,size_t nameLen) {
+	size_t bs = e->blockSize();
+	Ext2DirEntry *prev = NULL;
+	for(size_t off = 0; off + sizeof(Ext2DirEntry) <= bs; ) {
+		Ext2DirEntry *de = (Ext2DirEntry*)((uintptr_t)buffer + off);
+		uint16_t recLen = le16tocpu(de->recLen);
+		if(recLen < sizeof(Ext2DirEntry) || off + recLen > bs)
+			break;
+
+		if(le32tocpu(de->inode) != 0 && nameLen == le16tocpu(de->nameLen) &&
+				strncmp(de->name,name,nameLen) == 0) {
+			ino_t ino = le32tocpu(de->inode);
+			/* if we have a previous one, simply increase its length */
+			if(prev != NULL)
+				prev->recLen = cputole16(le16tocpu(prev->recLen) + recLen);
+			/* otherwise make an empty entry */
+			else
+				de->inode = cputole32(0);
+			return ino;
+		}
+
+		prev = de;
+		off += recLen;
+	}
+	return -ENOENT;
+}
+
+ino_t Ext2Dir::findLinear(Ext2FileSystem *e,const Ext2CInode *dir,const char *name,size_t nameLen) {
+	size_t blocks = e->bytesToBlocks(le32tocpu(dir->inode.size));
+	for(block_t i = 0; i < blocks; ++i) {
+		CBlock *blk = requestBlock(e,dir,i,BlockCache::READ);
+		if(blk == NULL)
+			return -ENOBUFS;
+		ino_t ino = findInBlock(e,blk->buffer,name,nameLen);
+		e->blockCache.release(blk);
+		if(ino != -ENOENT)
+			return ino;
+	}
+	return -ENOENT;
+}
+
+int Ext2Dir::addLinear(Ext2FileSystem *e,Ext2CInode *dir,ino_t ino,const char *name,size_t nameLen) {
+	size_t blocks = e->bytesToBlocks(le32tocpu(dir->inode.size));
+	for(block_t i = 0; i < blocks; ++i) {
+		CBlock *blk = requestBlock(e,dir,i,BlockCache::WRITE);
+		if(blk == NULL)
+			return -ENOBUFS;
+		bool added = addToBlock(e,blk->buffer,ino,name,nameLen);
+		if(added)
+			e->blockCache.markDirty(blk);
+		e->blockCache.release(blk);
+		if(added)
+			return 0;
+	}
+
+	/* if the first block is full, index the directory, so that it can grow without getting slow */
+	if(blocks == 1 && Ext2HTree::canIndex(e) && !Ext2HTree::isIndexed(e,dir)) {
+		int res = Ext2HTree::build(e,dir);
+		if(res == 0)
+			return Ext2HTree::add(e,dir,ino,name,nameLen);
+	}
+
+	/* otherwise store it on a new block */
+	block_t lblock;
+	CBlock *blk = appendBlock(e,dir,&lblock);
+	if(blk == NULL)
+		return -ENOSPC;
+	addToBlock(e,blk->buffer,ino,name,nameLen);
+	e->blockCache.release(blk);
+	return 0;
+}
+
+ino_t Ext2Dir::removeLinear(Ext2FileSystem *e,Ext2CInode *dir,const char *name,size_t nameLen) {
+	size_t blocks = e->bytesToBlocks(le32tocpu(dir->inode.size));
+	for(block_t i = 0; i < blocks; ++i) {
+		CBlock *blk = requestBlock(e,dir,i,BlockCache::WRITE);
+		if(blk == NULL)
+			return -ENOBUFS;
+		ino_t ino = removeFromBlock(e,blk->buffer,name,nameLen);
+		if(ino >= 0)
+			e->blockCache.markDirty(blk);
+		e->blockCache.release(blk);
+		if(ino != -ENOENT)
+			return ino;
+	}
+	return -ENOENT;
+}
+
+int Ext2Dir::isEmpty(Ext2FileSystem *e,const Ext2CInode *dir) {
+	size_t bs = e->blockSize();
+	size_t blocks = e->bytesToBlocks(le32tocpu(dir->inode.size));
+	for(block_t i = 0; i < blocks; ++i) {
+		CBlock *blk = requestBlock(e,dir,i,BlockCache::READ);
+		if(blk == NULL)
+			return -ENOBUFS;
+
+		for(size_t off = 0; off + sizeof(Ext2DirEntry) <= bs; ) {
+			const Ext2DirEntry *de = (const Ext2DirEntry*)((uintptr_t)blk->buffer + off);
+			uint16_t recLen = le16tocpu(de->recLen);
+			if(recLen < sizeof(Ext2DirEntry) || off + recLen > bs)
+				break;
+
+			/* found something else than '.' and '..'? */
+			uint16_t namelen = le16tocpu(de->nameLen);
+			if(le32tocpu(de->inode) != 0 &&
+					!(namelen == 1 && de->name[0] == '.') &&
+					!(namelen == 2 && de->name[0] == '.' && de->name[1] == '.')) {
+				e->blockCache.release(blk);
+				return 0;
+			}
+			off += recLen;
+		}
+		e->blockCache.release(blk);
+	}
+	return 1;
+}
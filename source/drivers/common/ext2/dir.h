@@ -21,6 +21,7 @@
 
 #include <sys/common.h>
 #include <fs/ext2/ext2.h>
+#include <fs/blockcache.h>
 
 struct Ext2CInode;
 class Ext2FileSystem;
@@ -54,15 +55,28 @@ public:
 	static ino_t find(Ext2FileSystem *e,Ext2CInode *dir,const char *name,size_t nameLen);
 
 	/**
-	 * Finds the inode-number to the entry <name> in the given buffer
+	 * Adds the entry <name> -> <ino> to the directory <dir>. If the directory gets too large, it
+	 * will be indexed, if the filesystem supports that.
 	 *
-	 * @param buffer the buffer with all directory-entries
-	 * @param bufSize the size of the buffer
-	 * @param name the name of the entry to find
+	 * @param e the ext2-fs
+	 * @param dir the directory (requested for writing!)
+	 * @param ino the inode-number
+	 * @param name the name
 	 * @param nameLen the length of the name
-	 * @return the inode-number or < 0
+	 * @return 0 on success
 	 */
-	static ino_t findIn(Ext2DirEntry *buffer,size_t bufSize,const char *name,size_t nameLen);
+	static int add(Ext2FileSystem *e,Ext2CInode *dir,ino_t ino,const char *name,size_t nameLen);
+
+	/**
+	 * Removes the entry <name> from the directory <dir>.
+	 *
+	 * @param e the ext2-fs
+	 * @param dir the directory (requested for writing!)
+	 * @param name the name
+	 * @param nameLen the length of the name
+	 * @return the inode-number of the removed entry or < 0
+	 */
+	static ino_t removeEntry(Ext2FileSystem *e,Ext2CInode *dir,const char *name,size_t nameLen);
 
 	/**
 	 * Removes the directory with given name from the given directory. It is required that
@@ -75,4 +89,65 @@ public:
 	 * @return 0 on success
 	 */
 	static int remove(Ext2FileSystem *e,FSUser *u,Ext2CInode *dir,const char *name);
+
+	/**
+	 * Requests the block <lblock> of directory <dir> from the block cache.
+	 *
+	 * @param e the ext2-fs
+	 * @param dir the directory
+	 * @param lblock the linear block-number
+	 * @param mode the mode (BlockCache::READ or BlockCache::WRITE)
+	 * @return the block or NULL if it does not exist
+	 */
+	static CBlock *requestBlock(Ext2FileSystem *e,const Ext2CInode *dir,block_t lblock,uint mode);
+
+	/**
+	 * Appends an empty block to the directory <dir>.
+	 *
+	 * @param e the ext2-fs
+	 * @param dir the directory
+	 * @param lblock will be set to the linear block-number
+	 * @return the block (requested for writing) or NULL if there is no free block
+	 */
+	static CBlock *appendBlock(Ext2FileSystem *e,Ext2CInode *dir,block_t *lblock);
+
+	/**
+	 * Searches for <name> in the given directory-block.
+	 *
+	 * @param e the ext2-fs
+	 * @param buffer the block
+	 * @param name the name
+	 * @param nameLen the length of the name
+	 * @return the inode-number or -ENOENT
+	 */
+	static ino_t findInBlock(Ext2FileSystem *e,const void *buffer,const char *name,size_t nameLen);
+
+	/**
+	 * Adds the entry <name> -> <ino> to the given directory-block, if there is enough space.
+	 *
+	 * @param e the ext2-fs
+	 * @param buffer the block
+	 * @param ino the inode-number
+	 * @param name the name
+	 * @param nameLen the length of the name
+	 * @return true if it has been added
+	 */
+	static bool addToBlock(Ext2FileSystem *e,void *buffer,ino_t ino,const char *name,size_t nameLen);
+
+	/**
+	 * Removes the entry <name> from the given directory-block.
+	 *
+	 * @param e the ext2-fs
+	 * @param buffer the block
+	 * @param name the name
+	 * @param nameLen the length of the name
+	 * @return the inode-number of the removed entry or -ENOENT
+	 */
+	static ino_t removeFromBlock(Ext2FileSystem *e,void *buffer,const char *name,size_t nameLen);
+
+private:
+	static ino_t findLinear(Ext2FileSystem *e,const Ext2CInode *dir,const char *name,size_t nameLen);
+	static int addLinear(Ext2FileSystem *e,Ext2CInode *dir,ino_t ino,const char *name,size_t nameLen);
+	static ino_t removeLinear(Ext2FileSystem *e,Ext2CInode *dir,const char *name,size_t nameLen);
+	static int isEmpty(Ext2FileSystem *e,const Ext2CInode *dir);
 };
@@ -0,0 +1,100 @@
+/**
+ * $Id$
+ * Copyright (C) 2008 - 2014 Nils Asmussen
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <sys/common.h>
+#include <string.h>
+#include <errno.h>
+
+#include "dircache.h"
+
+Ext2DirCache::Ext2DirCache(size_t size)
+		: _size(size), _stamp(), _hits(), _negHits(), _misses(), _entries(new Entry[size]) {
+	for(size_t i = 0; i < _size; i++)
+		_entries[i].dir = 0;
+}
+
+Ext2DirCache::Entry *Ext2DirCache::getSet(ino_t dir,const char *name,size_t nameLen) const {
+	/* FNV-1a */
+	uint32_t hash = 2166136261U ^ (uint32_t)dir;
+	for(size_t i = 0; i < nameLen; i++)
+		hash = (hash ^ (uchar)name[i]) * 16777619U;
+	return _entries + (hash % (_size / WAYS)) * WAYS;
+}
+
+bool Ext2DirCache::find(ino_t dir,const char *name,size_t nameLen,ino_t *ino) {
+	if(nameLen <= NAME_LEN) {
+		Entry *e = getSet(dir,name,nameLen);
+		for(size_t i = 0; i < WAYS; i++, e++) {
+			if(e->dir == dir && e->nameLen == nameLen && memcmp(e->name,name,nameLen) == 0) {
+				e->stamp = ++_stamp;
+				*ino = e->ino;
+				if(e->ino < 0)
+					_negHits++;
+				else
+					_hits++;
+				return true;
+			}
+		}
+	}
+	_misses++;
+	return false;
+}
+
+void Ext2DirCache::insert(ino_t dir,const char *name,size_t nameLen,ino_t ino) {
+	if(nameLen > NAME_LEN)
+		return;
+
+	/* use the existing entry, a free one or the least recently used one */
+	Entry *set = getSet(dir,name,nameLen);
+	Entry *e = set;
+	for(size_t i = 0; i < WAYS; i++) {
+		if(set[i].dir == dir && set[i].nameLen == nameLen && memcmp(set[i].name,name,nameLen) == 0) {
+			e = set + i;
+			break;
+		}
+		if(set[i].dir == 0 || (e->dir != 0 && set[i].stamp < e->stamp))
+			e = set + i;
+	}
+
+	e->dir = dir;
+	e->ino = ino;
+	e->stamp = ++_stamp;
+	e->nameLen = nameLen;
+	memcpy(e->name,name,nameLen);
+}
+
+void Ext2DirCache::removeDir(ino_t dir) {
+	for(size_t i = 0; i < _size; i++) {
+		if(_entries[i].dir == dir)
+			_entries[i].dir = 0;
+	}
+}
+
+void Ext2DirCache::print(FILE *f) {
+	size_t used = 0;
+	for(size_t i = 0; i < _size; i++) {
+		if(_entries[i].dir != 0)
+			used++;
+	}
+	fprintf(f,"\t\tTotal entries: %zu\n",_size);
+	fprintf(f,"\t\tUsed entries: %zu\n",used);
+	fprintf(f,"\t\tHits: %zu\n",_hits);
+	fprintf(f,"\t\tNegative hits: %zu\n",_negHits);
+	fprintf(f,"\t\tMisses: %zu\n",_misses);
+}
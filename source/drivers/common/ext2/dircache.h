@@ -0,0 +1,102 @@
+/**
+ * $Id$
+ * Copyright (C) 2008 - 2014 Nils Asmussen
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#pragma once
+
+#include <sys/common.h>
+#include <stdio.h>
+
+/**
+ * Caches the results of directory-lookups, i.e. maps (directory, name) to inode-numbers. Names
+ * that do not exist are cached as well. The cache is updated whenever an entry is added or
+ * removed, so that it never needs to be flushed.
+ */
+class Ext2DirCache {
+	/* the associativity */
+	static const size_t WAYS		= 4;
+	/* longer names are not cached */
+	static const size_t NAME_LEN	= 48;
+
+	struct Entry {
+		/* the directory-inode; 0 = unused */
+		ino_t dir;
+		/* the inode or -ENOENT */
+		ino_t ino;
+		uint32_t stamp;
+		uint16_t nameLen;
+		char name[NAME_LEN];
+	};
+
+public:
+	/**
+	 * Creates a cache with <size> entries
+	 *
+	 * @param size the number of entries (a multiple of 4)
+	 */
+	explicit Ext2DirCache(size_t size);
+	~Ext2DirCache() {
+		delete[] _entries;
+	}
+
+	/**
+	 * Searches for <name> in the directory <dir>.
+	 *
+	 * @param dir the inode-number of the directory
+	 * @param name the name
+	 * @param nameLen the length of the name
+	 * @param ino will be set to the inode-number or -ENOENT, if found
+	 * @return true if found
+	 */
+	bool find(ino_t dir,const char *name,size_t nameLen,ino_t *ino);
+
+	/**
+	 * Stores that <name> in directory <dir> refers to <ino>.
+	 *
+	 * @param dir the inode-number of the directory
+	 * @param name the name
+	 * @param nameLen the length of the name
+	 * @param ino the inode-number or -ENOENT if it does not exist
+	 */
+	void insert(ino_t dir,const char *name,size_t nameLen,ino_t ino);
+
+	/**
+	 * Removes all entries of directory <dir>. This has to be done if the directory is deleted,
+	 * because the inode might be reused.
+	 *
+	 * @param dir the inode-number of the directory
+	 */
+	void removeDir(ino_t dir);
+
+	/**
+	 * Prints statistics about the cache into the given file
+	 *
+	 * @param f the file
+	 */
+	void print(FILE *f);
+
+private:
+	Entry *getSet(ino_t dir,const char *name,size_t nameLen) const;
+
+	size_t _size;
+	uint32_t _stamp;
+	size_t _hits;
+	size_t _negHits;
+	size_t _misses;
+	Entry *_entries;
+};
@@ -42,22 +42,46 @@
 #include "dir.h"
 #include "rw.h"
 
+static void parseOptions(char *opts,int *atime,size_t *icacheSize) {
+	for(char *opt = strtok(opts,","); opt != NULL; opt = strtok(NULL,",")) {
+		if(strcmp(opt,"strictatime") == 0 || strcmp(opt,"atime") == 0)
+			*atime = Ext2FileSystem::ATIME_STRICT;
+		else if(strcmp(opt,"relatime") == 0)
+			*atime = Ext2FileSystem::ATIME_RELAXED;
+		else if(strcmp(opt,"noatime") == 0)
+			*atime = Ext2FileSystem::ATIME_NONE;
+		else if(strncmp(opt,"icache=",7) == 0) {
+			*icacheSize = strtoul(opt + 7,NULL,0);
+			if(*icacheSize < EXT2_ICACHE_MIN)
+				error("The inode cache needs at least %d entries",EXT2_ICACHE_MIN);
+		}
+		else
+			error("Unknown option '%s'",opt);
+	}
+}
+
 int main(int argc,char *argv[]) {
 	char fspath[MAX_PATH_LEN];
-	if(argc != 3)
-		error("Usage: %s <wait> <devicePath>",argv[0]);
+	if(argc != 3 && argc != 4)
+		error("Usage: %s <wait> <devicePath> [<opt1>,<opt2>,...]",argv[0]);
 
 	/* the backend has to be a block device */
 	if(!isblock(argv[2]))
 		error("'%s' is neither a block-device nor a regular file",argv[2]);
 
+	/* options like "noatime,icache=1024" */
+	int atime = Ext2FileSystem::ATIME_STRICT;
+	size_t icacheSize = EXT2_ICACHE_SIZE;
+	if(argc == 4)
+		parseOptions(argv[3],&atime,&icacheSize);
+
 	/* build fs device name */
 	char *dev = strrchr(argv[2],'/');
 	if(!dev)
 		dev = argv[2] - 1;
 	snprintf(fspath,sizeof(fspath),"/dev/ext2-%s",dev + 1);
 
-	FSDevice fsdev(new Ext2FileSystem(argv[2]),fspath);
+	FSDevice fsdev(new Ext2FileSystem(argv[2],atime,icacheSize),fspath);
 	fsdev.loop();
 	return 0;
 }
@@ -70,9 +94,9 @@ bool Ext2FileSystem::Ext2BlockCache::writeBlocks(const void *buffer,size_t start
 	return Ext2RW::writeBlocks(_fs,buffer,start,blockCount);
 }
 
-Ext2FileSystem::Ext2FileSystem(const char *device)
-		: fd(::open(device,O_RDWR)), sb(this), bgs(this),
-		  inodeCache(this), blockCache(this) {
+Ext2FileSystem::Ext2FileSystem(const char *device,int _atime,size_t icacheSize)
+		: fd(::open(device,O_RDWR)), atime(_atime), sb(this), bgs(this),
+		  inodeCache(this,icacheSize), blockCache(this), dirCache(EXT2_DCACHE_SIZE) {
 	if(fd < 0)
 		VTHROWE("Unable to open device '" << device << "'",fd);
 }
@@ -103,8 +127,8 @@ ino_t Ext2FileSystem::open(FSUser *u,ino_t ino,uint flags) {
 	}
 	/* increase references so that the inode stays in cache until we close it. this is necessary
 	 * to prevent that somebody else deletes the file while another one uses it. of course, this
-	 * means that we can never have more open files that inode-cache-slots. so, we might have to
-	 * increase that at sometime. */
+	 * means that we can never have more open files that inode-cache-slots. so, increase the
+	 * cache with the option "icache=<n>", if necessary. */
 	cnode->refs++;
 	inodeCache.release(cnode);
 
@@ -236,10 +260,14 @@ void Ext2FileSystem::print(FILE *f) {
 	fprintf(f,"Free: %zu bytes\n",le32tocpu(sb.get()->freeBlockCount) * blockSize());
 	fprintf(f,"Mount count: %u\n",le16tocpu(sb.get()->mountCount));
 	fprintf(f,"Max mount count: %u\n",le16tocpu(sb.get()->maxMountCount));
+	static const char *atimes[] = {"strict","relaxed","none"};
+	fprintf(f,"Access-time updates: %s\n",atimes[atime]);
 	fprintf(f,"Block cache:\n");
 	blockCache.printStats(f);
 	fprintf(f,"Inode cache:\n");
 	inodeCache.print(f);
+	fprintf(f,"Directory cache:\n");
+	dirCache.print(f);
 }
 
 int Ext2FileSystem::hasPermission(Ext2CInode *cnode,FSUser *u,uint perms) {
@@ -29,12 +29,21 @@
 #include "sbmng.h"
 #include "inodecache.h"
 #include "dir.h"
+#include "dircache.h"
 
 #define DISK_SECTOR_SIZE					512
 #define EXT2_SUPERBLOCK_LOCK				0xF7180002
 
-#define EXT2_ICACHE_SIZE					64
+/* the default number of cached inodes; can be changed with the option "icache=<n>" */
+#define EXT2_ICACHE_SIZE					256
+/* the min. number of cached inodes (note that open files keep their inode in the cache) */
+#define EXT2_ICACHE_MIN						16
 #define EXT2_BCACHE_SIZE					512
+#define EXT2_DCACHE_SIZE					1024
+/* runs of at least this many blocks are transferred without the block-cache */
+#define EXT2_DIRECT_MIN						8
+/* the max. number of blocks that we determine at once for a block-run of an inode */
+#define EXT2_EXTENT_MAX						1024
 
 class Ext2FileSystem : public FileSystem {
 public:
@@ -51,7 +60,18 @@ public:
 		Ext2FileSystem *_fs;
 	};
 
-	explicit Ext2FileSystem(const char *device);
+	/* how the access-time of files is updated on reads */
+	enum {
+		/* on every read */
+		ATIME_STRICT,
+		/* only if it is not newer than the modification- or change-time or older than a day */
+		ATIME_RELAXED,
+		/* never */
+		ATIME_NONE,
+	};
+
+	explicit Ext2FileSystem(const char *device,int atime = ATIME_STRICT,
+		size_t icacheSize = EXT2_ICACHE_SIZE);
 	virtual ~Ext2FileSystem();
 
 	virtual ino_t open(FSUser *u,ino_t ino,uint flags);
@@ -135,7 +155,7 @@ public:
 	 * @return the block-group-number
 	 */
 	block_t getGroupOfBlock(block_t block) {
-		return block / le32tocpu(sb.get()->blocksPerGroup);
+		return (block - le32tocpu(sb.get()->firstDataBlock)) / le32tocpu(sb.get()->blocksPerGroup);
 	}
 
 	/**
@@ -146,7 +166,7 @@ public:
 	 * @return the block-group-number
 	 */
 	block_t getGroupOfInode(ino_t inodeNo) {
-		return inodeNo / le32tocpu(sb.get()->inodesPerGroup);
+		return (inodeNo - 1) / le32tocpu(sb.get()->inodesPerGroup);
 	}
 
 	/**
@@ -191,6 +211,8 @@ public:
 
 	/* the fd for the device */
 	int fd;
+	/* the access-time mode (ATIME_*) */
+	int atime;
 
 	/* superblock and blockgroups of that ext2-fs */
 	Ext2SBMng sb;
@@ -199,4 +221,5 @@ public:
 	/* caches */
 	Ext2INodeCache inodeCache;
 	Ext2BlockCache blockCache;
+	Ext2DirCache dirCache;
 };
@@ -72,27 +72,28 @@ int Ext2File::remove(Ext2FileSystem *e,Ext2CInode *cnode) {
 }
 
 int Ext2File::truncate(Ext2FileSystem *e,Ext2CInode *cnode,bool del) {
+	FreeRun run = {0,0};
 	int res;
 	size_t i;
 	/* free direct blocks */
 	for(i = 0; i < EXT2_DIRBLOCK_COUNT; i++) {
 		if(le32tocpu(cnode->inode.dBlocks[i]) == 0)
 			break;
-		if((res = Ext2Bitmap::freeBlock(e,le32tocpu(cnode->inode.dBlocks[i]))) < 0)
+		if((res = freeLater(e,&run,le32tocpu(cnode->inode.dBlocks[i]))) < 0)
 			return res;
 		if(!del)
 			cnode->inode.dBlocks[i] = cputole32(0);
 	}
 	/* indirect */
 	if(le32tocpu(cnode->inode.singlyIBlock)) {
-		if((res = freeIndirBlock(e,le32tocpu(cnode->inode.singlyIBlock))) < 0)
+		if((res = freeIndirBlock(e,&run,le32tocpu(cnode->inode.singlyIBlock))) < 0)
 			return res;
 		if(!del)
 			cnode->inode.singlyIBlock = cputole32(0);
 	}
 	/* double indirect */
 	if(le32tocpu(cnode->inode.doublyIBlock)) {
-		if((res = freeDIndirBlock(e,le32tocpu(cnode->inode.doublyIBlock))) < 0)
+		if((res = freeDIndirBlock(e,&run,le32tocpu(cnode->inode.doublyIBlock))) < 0)
 			return res;
 		if(!del)
 			cnode->inode.doublyIBlock = cputole32(0);
@@ -105,28 +106,34 @@ int Ext2File::truncate(Ext2FileSystem *e,Ext2CInode *cnode,bool del) {
 		vassert(blocks != NULL,"Block %d set, but unable to load it\n",
 				le32tocpu(cnode->inode.triplyIBlock));
 
+		if((res = freeLater(e,&run,le32tocpu(cnode->inode.triplyIBlock))) < 0) {
+			e->blockCache.release(blocks);
+			return res;
+		}
 		e->blockCache.markDirty(blocks);
 		count = e->blockSize() / sizeof(block_t);
 		for(i = 0; i < count; i++) {
 			if(le32tocpu(((block_t*)blocks->buffer)[i]) == 0)
 				break;
-			if((res = freeDIndirBlock(e,le32tocpu(((block_t*)blocks->buffer)[i]))) < 0) {
+			if((res = freeDIndirBlock(e,&run,le32tocpu(((block_t*)blocks->buffer)[i]))) < 0) {
 				e->blockCache.release(blocks);
 				return res;
 			}
 		}
 		e->blockCache.release(blocks);
-		if((res = Ext2Bitmap::freeBlock(e,le32tocpu(cnode->inode.triplyIBlock))) < 0)
-			return res;
 		if(!del)
 			cnode->inode.triplyIBlock = cputole32(0);
 	}
+	if((res = freeRun(e,&run)) < 0)
+		return res;
 
 	if(!del) {
 		/* reset size */
 		cnode->inode.size = cputole32(0);
 		cnode->inode.blocks = cputole32(0);
 	}
+	cnode->allocGoal = 0;
+	Ext2INode::clearRuns(cnode);
 	e->inodeCache.markDirty(cnode);
 	return 0;
 }
@@ -135,24 +142,46 @@ ssize_t Ext2File::read(Ext2FileSystem *e,ino_t inodeNo,void *buffer,off_t offset
 	Ext2CInode *cnode;
 	ssize_t res;
 
-	/* at first we need the inode */
-	cnode = e->inodeCache.request(inodeNo,IMODE_WRITE);
+	/* at first we need the inode. reading requires just a shared lock. note that this does not
+	 * let reads run in parallel yet, because the driver handles one request at a time */
+	cnode = e->inodeCache.request(inodeNo,IMODE_READ);
 	if(cnode == NULL)
 		return -ENOBUFS;
 
 	/* read */
 	res = readIno(e,cnode,buffer,offset,count);
-	if(res <= 0) {
-		e->inodeCache.release(cnode);
+	time_t now = time(NULL);
+	bool update = res > 0 && needsAccessTime(e,cnode,now);
+	e->inodeCache.release(cnode);
+	if(!update)
 		return res;
+
+	/* mark accessed. the file is open, so that the inode can't have been deleted meanwhile */
+	cnode = e->inodeCache.request(inodeNo,IMODE_WRITE);
+	if(cnode != NULL) {
+		cnode->inode.accesstime = cputole32(now);
+		e->inodeCache.markDirty(cnode);
+		e->inodeCache.release(cnode);
 	}
+	return res;
+}
 
-	/* mark accessed */
-	cnode->inode.accesstime = cputole32(time(NULL));
-	e->inodeCache.markDirty(cnode);
-	e->inodeCache.release(cnode);
+bool Ext2File::needsAccessTime(Ext2FileSystem *e,const Ext2CInode *cnode,time_t now) {
+	switch(e->atime) {
+		case Ext2FileSystem::ATIME_NONE:
+			return false;
+
+		case Ext2FileSystem::ATIME_RELAXED: {
+			/* like Linux: only if the last access was before the last change or a day ago */
+			time_t atime = le32tocpu(cnode->inode.accesstime);
+			return atime <= (time_t)le32tocpu(cnode->inode.modifytime) ||
+				atime <= (time_t)le32tocpu(cnode->inode.createtime) ||
+				now - atime >= 24 * 60 * 60;
+		}
 
-	return res;
+		default:
+			return true;
+	}
 }
 
 ssize_t Ext2File::readIno(Ext2FileSystem *e,const Ext2CInode *cnode,void *buffer,off_t offset,size_t count) {
@@ -177,25 +206,44 @@ ssize_t Ext2File::readIno(Ext2FileSystem *e,const Ext2CInode *cnode,void *buffer
 		/* use the offset in the first block; after the first one the offset is 0 anyway */
 		leftBytes = count;
 		bufWork = (uint8_t*)buffer;
-		for(i = 0; i < blockCount; i++) {
-			/* request block */
-			block_t block = Ext2INode::getDataBlock(e,cnode,startBlock + i);
-			CBlock *tmpBuffer = e->blockCache.request(block,BlockCache::READ);
-			if(tmpBuffer == NULL)
-				return -ENOBUFS;
+		for(i = 0; i < blockCount; ) {
+			size_t run = blockCount - i;
+			block_t block = Ext2INode::getDataRun(e,cnode,startBlock + i,&run);
+
+			/* read complete blocks of long runs directly into the buffer */
+			run = MIN(run,offset == 0 ? leftBytes / blockSize : 0);
+			if(block != 0 && run >= EXT2_DIRECT_MIN) {
+				/* the cache might have newer versions of these blocks */
+				e->blockCache.sync(block,run);
+				if(Ext2RW::readBlocks(e,bufWork,block,run) != 0)
+					return -ENOBUFS;
+				bufWork += run * blockSize;
+				leftBytes -= run * blockSize;
+				i += run;
+				continue;
+			}
 
 			/* copy the requested part */
 			c = MIN(leftBytes,blockSize - offset);
-			memcpy(bufWork,(uint8_t*)tmpBuffer->buffer + offset,c);
+			if(block == 0) {
+				/* holes are read as zeros */
+				memclear(bufWork,c);
+			}
+			else {
+				CBlock *tmpBuffer = e->blockCache.request(block,BlockCache::READ);
+				if(tmpBuffer == NULL)
+					return -ENOBUFS;
+				memcpy(bufWork,(uint8_t*)tmpBuffer->buffer + offset,c);
+				e->blockCache.release(tmpBuffer);
+			}
 			bufWork += c;
 
-			e->blockCache.release(tmpBuffer);
-
 			/* we substract to much, but it matters only if we read an additional block. In this
 			 * case it is correct */
 			leftBytes -= blockSize - offset;
 			/* offset is always 0 for additional blocks */
 			offset = 0;
+			i++;
 		}
 	}
 	return count;
@@ -217,9 +265,10 @@ ssize_t Ext2File::writeIno(Ext2FileSystem *e,Ext2CInode *cnode,const void *buffe
 	CBlock *tmpBuffer;
 	const uint8_t *bufWork;
 	time_t now;
-	size_t c,i,blockSize,blockCount,leftBytes;
+	size_t c,i,blockSize,blockCount,leftBytes,inoBlocks;
 	block_t startBlock;
 	off_t orgOff = offset;
+	ssize_t res = count;
 	int32_t inoSize = le32tocpu(cnode->inode.size);
 
 	/* gap-filling not supported yet */
@@ -231,13 +280,35 @@ ssize_t Ext2File::writeIno(Ext2FileSystem *e,Ext2CInode *cnode,const void *buffe
 	offset %= blockSize;
 	blockCount = (offset + count + blockSize - 1) / blockSize;
 
+	/* continue behind the last block of the file, if we don't know where we stopped last time */
+	if(cnode->allocGoal == 0 && startBlock > 0)
+		cnode->allocGoal = Ext2INode::getDataBlock(e,cnode,startBlock - 1) + 1;
+	/* allocate the new blocks in one run, if possible */
+	inoBlocks = (inoSize + blockSize - 1) / blockSize;
+	if(startBlock + blockCount > inoBlocks + 1)
+		Ext2Bitmap::reserve(e,cnode,startBlock + blockCount - inoBlocks);
+
 	leftBytes = count;
 	bufWork = (const uint8_t*)buffer;
-	for(i = 0; i < blockCount; i++) {
+	for(i = 0; i < blockCount; ) {
+		/* write complete blocks directly to disk, if there are enough of them */
+		size_t full = offset == 0 ? leftBytes / blockSize : 0;
+		if(full >= EXT2_DIRECT_MIN) {
+			res = writeDirect(e,cnode,bufWork,startBlock + i,full);
+			if(res < 0)
+				break;
+			bufWork += full * blockSize;
+			leftBytes -= full * blockSize;
+			i += full;
+			continue;
+		}
+
 		block_t block = Ext2INode::reqDataBlock(e,cnode,startBlock + i);
 		/* error (e.g. no free block) ? */
-		if(block == 0)
-			return -ENOSPC;
+		if(block == 0) {
+			res = -ENOSPC;
+			break;
+		}
 
 		c = MIN(leftBytes,blockSize - offset);
 
@@ -246,8 +317,10 @@ ssize_t Ext2File::writeIno(Ext2FileSystem *e,Ext2CInode *cnode,const void *buffe
 			tmpBuffer = e->blockCache.request(block,BlockCache::WRITE);
 		else
 			tmpBuffer = e->blockCache.create(block);
-		if(tmpBuffer == NULL)
-			return -ENOBUFS;
+		if(tmpBuffer == NULL) {
+			res = -ENOBUFS;
+			break;
+		}
 		/* we can write it to disk later :) */
 		memcpy((uint8_t*)tmpBuffer->buffer + offset,bufWork,c);
 		e->blockCache.markDirty(tmpBuffer);
@@ -259,8 +332,14 @@ ssize_t Ext2File::writeIno(Ext2FileSystem *e,Ext2CInode *cnode,const void *buffe
 		leftBytes -= blockSize - offset;
 		/* offset is always 0 for additional blocks */
 		offset = 0;
+		i++;
 	}
 
+	/* give the reserved blocks back that we haven't used */
+	Ext2Bitmap::discard(e,cnode);
+	if(res < 0)
+		return res;
+
 	/* finally, update the inode */
 	now = cputole32(time(NULL));
 	cnode->inode.accesstime = now;
@@ -270,38 +349,84 @@ ssize_t Ext2File::writeIno(Ext2FileSystem *e,Ext2CInode *cnode,const void *buffe
 	return count;
 }
 
-int Ext2File::freeDIndirBlock(Ext2FileSystem *e,block_t blockNo) {
+ssize_t Ext2File::writeDirect(Ext2FileSystem *e,Ext2CInode *cnode,const uint8_t *buffer,
+		block_t start,size_t count) {
+	size_t blockSize = e->blockSize();
+	/* allocate all blocks first to get runs that are as long as possible */
+	for(size_t i = 0; i < count; ++i) {
+		if(Ext2INode::reqDataBlock(e,cnode,start + i) == 0)
+			return -ENOSPC;
+	}
+
+	for(size_t i = 0; i < count; ) {
+		size_t run = count - i;
+		block_t block = Ext2INode::getDataRun(e,cnode,start + i,&run);
+		if(Ext2RW::writeBlocks(e,buffer,block,run) != 0)
+			return -ENOBUFS;
+		/* the cache might contain these blocks, e.g., if they belonged to a deleted file */
+		e->blockCache.update(buffer,block,run);
+		buffer += run * blockSize;
+		i += run;
+	}
+	return 0;
+}
+
+int Ext2File::freeLater(Ext2FileSystem *e,FreeRun *run,block_t block) {
+	/* runs may not cross block-group-boundaries */
+	if(run->count > 0 && block == run->start + run->count &&
+			e->getGroupOfBlock(block) == e->getGroupOfBlock(run->start)) {
+		run->count++;
+		return 0;
+	}
+
+	int res = freeRun(e,run);
+	run->start = block;
+	run->count = 1;
+	return res;
+}
+
+int Ext2File::freeRun(Ext2FileSystem *e,FreeRun *run) {
+	int res = 0;
+	if(run->count > 0)
+		res = Ext2Bitmap::freeBlocks(e,run->start,run->count);
+	run->count = 0;
+	return res;
+}
+
+int Ext2File::freeDIndirBlock(Ext2FileSystem *e,FreeRun *run,block_t blockNo) {
 	size_t i,count;
 	/* note that we don't need to set the block-numbers to 0 here (-> write), since the whole
 	 * block is free'd afterwards anyway */
 	CBlock *blocks = e->blockCache.request(blockNo,BlockCache::READ);
 	vassert(blocks != NULL,"Block %d set, but unable to load it\n",blockNo);
 
+	/* the indirect blocks are allocated before the blocks they refer to. thus, free them in the
+	 * same order to get long runs */
+	freeLater(e,run,blockNo);
 	count = e->blockSize() / sizeof(block_t);
 	for(i = 0; i < count; i++) {
 		if(le32tocpu(((block_t*)blocks->buffer)[i]) == 0)
 			break;
-		freeIndirBlock(e,le32tocpu(((block_t*)blocks->buffer)[i]));
+		freeIndirBlock(e,run,le32tocpu(((block_t*)blocks->buffer)[i]));
 	}
 	e->blockCache.release(blocks);
-	Ext2Bitmap::freeBlock(e,blockNo);
 	return 0;
 }
 
-int Ext2File::freeIndirBlock(Ext2FileSystem *e,block_t blockNo) {
+int Ext2File::freeIndirBlock(Ext2FileSystem *e,FreeRun *run,block_t blockNo) {
 	size_t i,count;
 	CBlock *blocks = e->blockCache.request(blockNo,BlockCache::WRITE);
 	vassert(blocks != NULL,"Block %d set, but unable to load it\n",blockNo);
 
+	freeLater(e,run,blockNo);
 	count = e->blockSize() / sizeof(block_t);
 	for(i = 0; i < count; i++) {
 		if(le32tocpu(((block_t*)blocks->buffer)[i]) == 0)
 			break;
-		Ext2Bitmap::freeBlock(e,le32tocpu(((block_t*)blocks->buffer)[i]));
+		freeLater(e,run,le32tocpu(((block_t*)blocks->buffer)[i]));
 		((block_t*)blocks->buffer)[i] = cputole32(0);
 	}
 	e->blockCache.markDirty(blocks);
 	e->blockCache.release(blocks);
-	Ext2Bitmap::freeBlock(e,blockNo);
 	return 0;
 }
@@ -112,12 +112,39 @@ public:
 	static ssize_t writeIno(Ext2FileSystem *e,Ext2CInode *cnode,const void *buffer,off_t offset,size_t count);
 
 private:
+	/**
+	 * Determines whether the access-time of <cnode> should be set to <now> for a read, depending
+	 * on the atime-mode of the filesystem.
+	 */
+	static bool needsAccessTime(Ext2FileSystem *e,const Ext2CInode *cnode,time_t now);
+	/**
+	 * Writes the <count> complete blocks, starting with the linear block <start>, from <buffer>
+	 * directly to disk, bypassing the block-cache.
+	 */
+	static ssize_t writeDirect(Ext2FileSystem *e,Ext2CInode *cnode,const uint8_t *buffer,
+		block_t start,size_t count);
+	/**
+	 * Collects consecutive blocks to free them with one bitmap-update
+	 */
+	struct FreeRun {
+		block_t start;
+		size_t count;
+	};
+
+	/**
+	 * Adds <block> to <run>. If it doesn't continue the run, the run is free'd first.
+	 */
+	static int freeLater(Ext2FileSystem *e,FreeRun *run,block_t block);
+	/**
+	 * Free's the blocks in <run>
+	 */
+	static int freeRun(Ext2FileSystem *e,FreeRun *run);
 	/**
 	 * Free's the given doubly-indirect-block
 	 */
-	static int freeDIndirBlock(Ext2FileSystem *e,block_t blockNo);
+	static int freeDIndirBlock(Ext2FileSystem *e,FreeRun *run,block_t blockNo);
 	/**
 	 * Free's the given singly-indirect-block
 	 */
-	static int freeIndirBlock(Ext2FileSystem *e,block_t blockNo);
+	static int freeIndirBlock(Ext2FileSystem *e,FreeRun *run,block_t blockNo);
 };
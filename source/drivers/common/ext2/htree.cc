@@ -0,0 +1,640 @@
+/**
+ * $Id$
+ * Copyright (C) 2008 - 2014 Nils Asmussen
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <sys/common.h>
+#include <sys/endian.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "ext2.h"
+#include "dir.h"
+#include "link.h"
+#include "htree.h"
+#include "inodecache.h"
+
+/* the hash that marks the end of the index */
+#define HTREE_EOF					0x7FFFFFFFU
+
+/* TEA and half-MD4, as used by Linux for ext3/ext4 (fs/ext4/hash.c) */
+#define TEA_DELTA					0x9E3779B9
+#define MD4_F(x,y,z)				((z) ^ ((x) & ((y) ^ (z))))
+#define MD4_G(x,y,z)				(((x) & (y)) + (((x) ^ (y)) & (z)))
+#define MD4_H(x,y,z)				((x) ^ (y) ^ (z))
+#define MD4_ROUND(f,a,b,c,d,x,s)	(a += f(b,c,d) + (x), a = (a << (s)) | (a >> (32 - (s))))
+#define MD4_K2						013240474631U
+#define MD4_K3						015666365641U
+
+static void teaTransform(uint32_t buf[4],const uint32_t in[4]) {
+	uint32_t sum = 0;
+	uint32_t b0 = buf[0], b1 = buf[1];
+	uint32_t a = in[0], b = in[1], c = in[2], d = in[3];
+	for(int n = 0; n < 16; n++) {
+		sum += TEA_DELTA;
+		b0 += ((b1 << 4) + a) ^ (b1 + sum) ^ ((b1 >> 5) + b);
+		b1 += ((b0 << 4) + c) ^ (b0 + sum) ^ ((b0 >> 5) + d);
+	}
+	buf[0] += b0;
+	buf[1] += b1;
+}
+
+static void halfMD4Transform(uint32_t buf[4],const uint32_t in[8]) {
+	uint32_t a = buf[0], b = buf[1], c = buf[2], d = buf[3];
+
+	MD4_ROUND(MD4_F,a,b,c,d,in[0],3);
+	MD4_ROUND(MD4_F,d,a,b,c,in[1],7);
+	MD4_ROUND(MD4_F,c,d,a,b,in[2],11);
+	MD4_ROUND(MD4_F,b,c,d,a,in[3],19);
+	MD4_ROUND(MD4_F,a,b,c,d,in[4],3);
+	MD4_ROUND(MD4_F,d,a,b,c,in[5],7);
+	MD4_ROUND(MD4_F,c,d,a,b,in[6],11);
+	MD4_ROUND(MD4_F,b,c,d,a,in[7],19);
+
+	MD4_ROUND(MD4_G,a,b,c,d,in[1] + MD4_K2,3);
+	MD4_ROUND(MD4_G,d,a,b,c,in[3] + MD4_K2,5);
+	MD4_ROUND(MD4_G,c,d,a,b,in[5] + MD4_K2,9);
+	MD4_ROUND(MD4_G,b,c,d,a,in[7] + MD4_K2,13);
+	MD4_ROUND(MD4_G,a,b,c,d,in[0] + MD4_K2,3);
+	MD4_ROUND(MD4_G,d,a,b,c,in[2] + MD4_K2,5);
+	MD4_ROUND(MD4_G,c,d,a,b,in[4] + MD4_K2,9);
+	MD4_ROUND(MD4_G,b,c,d,a,in[6] + MD4_K2,13);
+
+	MD4_ROUND(MD4_H,a,b,c,d,in[3] + MD4_K3,3);
+	MD4_ROUND(MD4_H,d,a,b,c,in[7] + MD4_K3,9);
+	MD4_ROUND(MD4_H,c,d,a,b,in[2] + MD4_K3,11);
+	MD4_ROUND(MD4_H,b,c,d,a,in[6] + MD4_K3,15);
+	MD4_ROUND(MD4_H,a,b,c,d,in[1] + MD4_K3,3);
+	MD4_ROUND(MD4_H,d,a,b,c,in[5] + MD4_K3,9);
+	MD4_ROUND(MD4_H,c,d,a,b,in[0] + MD4_K3,11);
+	MD4_ROUND(MD4_H,b,c,d,a,in[4] + MD4_K3,15);
+
+	buf[0] += a;
+	buf[1] += b;
+	buf[2] += c;
+	buf[3] += d;
+}
+
+static uint32_t legacyHash(const char *name,size_t len,bool unsignedChars) {
+	uint32_t hash,hash0 = 0x12A3FE2D,hash1 = 0x37ABE8F9;
+	for(size_t i = 0; i < len; i++) {
+		int c = unsignedChars ? (int)(uchar)name[i] : (int)(signed char)name[i];
+		hash = hash1 + (hash0 ^ (uint32_t)(c * 7152373));
+		if(hash & 0x80000000)
+			hash -= 0x7FFFFFFF;
+		hash1 = hash0;
+		hash0 = hash;
+	}
+	return hash0 << 1;
+}
+
+static void strToHashBuf(const char *msg,size_t len,uint32_t *buf,int num,bool unsignedChars) {
+	uint32_t pad = (uint32_t)len | ((uint32_t)len << 8);
+	pad |= pad << 16;
+
+	uint32_t val = pad;
+	if(len > (size_t)num * 4)
+		len = num * 4;
+	for(size_t i = 0; i < len; i++) {
+		int c = unsignedChars ? (int)(uchar)msg[i] : (int)(signed char)msg[i];
+		val = c + (val << 8);
+		if((i % 4) == 3) {
+			*buf++ = val;
+			val = pad;
+			num--;
+		}
+	}
+	if(--num >= 0)
+		*buf++ = val;
+	while(--num >= 0)
+		*buf++ = pad;
+}
+
+bool Ext2HTree::canIndex(Ext2FileSystem *e) {
+	return le32tocpu(e->sb.get()->featureCompat) & EXT2_FEATURE_COMPAT_DIR_INDEX;
+}
+
+bool Ext2HTree::isIndexed(Ext2FileSystem *e,const Ext2CInode *dir) {
+	return (le32tocpu(dir->inode.flags) & EXT2_INDEX_FL) && canIndex(e);
+}
+
+uint32_t Ext2HTree::hash(Ext2FileSystem *e,uint version,const char *name,size_t nameLen) {
+	uint32_t in[8],hash;
+	uint32_t buf[4] = {0x67452301,0xEFCDAB89,0x98BADCFE,0x10325476};
+	bool unsignedChars = version >= EXT2_HASH_LEGACY_UNSIGNED;
+
+	/* use the seed from the super-block, if there is any */
+	const Ext2SuperBlock *sb = e->sb.get();
+	if(sb->hashSeed[0] || sb->hashSeed[1] || sb->hashSeed[2] || sb->hashSeed[3]) {
+		for(size_t i = 0; i < 4; i++)
+			buf[i] = le32tocpu(sb->hashSeed[i]);
+	}
+
+	switch(version) {
+		case EXT2_HASH_LEGACY:
+		case EXT2_HASH_LEGACY_UNSIGNED:
+			hash = legacyHash(name,nameLen,unsignedChars);
+			break;
+
+		case EXT2_HASH_HALF_MD4:
+		case EXT2_HASH_HALF_MD4_UNSIGNED:
+			for(ssize_t len = nameLen; len > 0; len -= 32, name += 32) {
+				strToHashBuf(name,len,in,8,unsignedChars);
+				halfMD4Transform(buf,in);
+			}
+			hash = buf[1];
+			break;
+
+		default:
+			for(ssize_t len = nameLen; len > 0; len -= 16, name += 16) {
+				strToHashBuf(name,len,in,4,unsignedChars);
+				teaTransform(buf,in);
+			}
+			hash = buf[0];
+			break;
+	}
+
+	hash &= ~1;
+	if(hash == (HTREE_EOF << 1))
+		hash = (HTREE_EOF - 1) << 1;
+	return hash;
+}
+
+int Ext2HTree::probe(Ext2FileSystem *e,const Ext2CInode *dir,const char *name,size_t nameLen,
+		uint mode,Path *path) {
+	size_t dirBlocks = le32tocpu(dir->inode.size) / e->blockSize();
+	CBlock *blk = Ext2Dir::requestBlock(e,dir,0,mode);
+	if(blk == NULL)
+		return -ENOBUFS;
+
+	/* check the root */
+	Ext2DxRootInfo *info = (Ext2DxRootInfo*)((uintptr_t)blk->buffer + ROOT_INFO_OFF);
+	if(info->reservedZero != 0 || info->hashVersion > EXT2_HASH_TEA ||
+			info->infoLength != sizeof(Ext2DxRootInfo) || info->indirectLevels >= MAX_LEVELS ||
+			(info->unusedFlags & 1)) {
+		e->blockCache.release(blk);
+		return -EINVAL;
+	}
+
+	path->version = info->hashVersion;
+	if(le32tocpu(e->sb.get()->flags) & EXT2_FLAGS_UNSIGNED_HASH)
+		path->version += EXT2_HASH_LEGACY_UNSIGNED;
+	path->hash = hash(e,path->version,name,nameLen);
+	path->levels = info->indirectLevels;
+
+	Ext2DxEntry *entries = (Ext2DxEntry*)((uintptr_t)info + info->infoLength);
+	size_t limit = (e->blockSize() - ROOT_INFO_OFF - sizeof(Ext2DxRootInfo)) / sizeof(Ext2DxEntry);
+	for(size_t i = 0; ; ++i) {
+		path->frames[i].block = blk;
+		path->frames[i].entries = entries;
+
+		size_t count = getCount(entries);
+		if(getLimit(entries) != limit || count == 0 || count > limit) {
+			path->levels = i;
+			release(e,path);
+			return -EINVAL;
+		}
+
+		/* binary search for the last entry with a hash <= ours. the first one has none */
+		Ext2DxEntry *p = entries + 1;
+		Ext2DxEntry *q = entries + count - 1;
+		while(p <= q) {
+			Ext2DxEntry *m = p + (q - p) / 2;
+			if(le32tocpu(m->hash) > path->hash)
+				q = m - 1;
+			else
+				p = m + 1;
+		}
+
+		path->frames[i].at = p - 1;
+		if(le32tocpu(path->frames[i].at->block) >= dirBlocks) {
+			path->levels = i;
+			release(e,path);
+			return -EINVAL;
+		}
+		if(i == path->levels)
+			break;
+
+		blk = Ext2Dir::requestBlock(e,dir,le32tocpu(path->frames[i].at->block),mode);
+		if(blk == NULL) {
+			path->levels = i;
+			release(e,path);
+			return -ENOBUFS;
+		}
+		entries = (Ext2DxEntry*)((uintptr_t)blk->buffer + NODE_OFF);
+		limit = (e->blockSize() - NODE_OFF) / sizeof(Ext2DxEntry);
+	}
+	return 0;
+}
+
+int Ext2HTree::nextBlock(Ext2FileSystem *e,const Ext2CInode *dir,Path *path,uint mode) {
+	Frame *p = path->frames + path->levels;
+	size_t num = 0;
+
+	/* find the next entry, going up if we're at the end of an index-block */
+	while(true) {
+		if(++p->at < p->entries + getCount(p->entries))
+			break;
+		if(p == path->frames)
+			return 0;
+		num++;
+		p--;
+	}
+
+	/* if the next block doesn't continue with our hash, we're done */
+	if((le32tocpu(p->at->hash) & ~1) != path->hash)
+		return 0;
+
+	/* go down again */
+	while(num-- > 0) {
+		CBlock *blk = Ext2Dir::requestBlock(e,dir,le32tocpu(p->at->block),mode);
+		if(blk == NULL)
+			return -ENOBUFS;
+		p++;
+		e->blockCache.release(p->block);
+		p->block = blk;
+		p->entries = p->at = (Ext2DxEntry*)((uintptr_t)blk->buffer + NODE_OFF);
+	}
+	return 1;
+}
+
+void Ext2HTree::release(Ext2FileSystem *e,Path *path) {
+	for(size_t i = 0; i <= path->levels; ++i)
+		e->blockCache.release(path->frames[i].block);
+}
+
+ino_t Ext2HTree::find(Ext2FileSystem *e,const Ext2CInode *dir,const char *name,size_t nameLen) {
+	/* "." and ".." are not indexed */
+	if(isDots(name,nameLen))
+		return -EINVAL;
+
+	Path path;
+	int res = probe(e,dir,name,nameLen,BlockCache::READ,&path);
+	if(res < 0)
+		return res;
+
+	ino_t ino;
+	while(true) {
+		Frame *f = path.frames + path.levels;
+		CBlock *leaf = Ext2Dir::requestBlock(e,dir,le32tocpu(f->at->block),BlockCache::READ);
+		if(leaf == NULL) {
+			ino = -ENOBUFS;
+			break;
+		}
+		ino = Ext2Dir::findInBlock(e,leaf->buffer,name,nameLen);
+		e->blockCache.release(leaf);
+		if(ino != -ENOENT)
+			break;
+
+		/* with hash-collisions, the entry might be in the next block */
+		if((res = nextBlock(e,dir,&path,BlockCache::READ)) <= 0) {
+			ino = res < 0 ? res : -ENOENT;
+			break;
+		}
+	}
+	release(e,&path);
+	return ino;
+}
+
+ino_t Ext2HTree::remove(Ext2FileSystem *e,Ext2CInode *dir,const char *name,size_t nameLen) {
+	if(isDots(name,nameLen))
+		return -EINVAL;
+
+	Path path;
+	int res = probe(e,dir,name,nameLen,BlockCache::WRITE,&path);
+	if(res < 0)
+		return res;
+
+	ino_t ino;
+	while(true) {
+		Frame *f = path.frames + path.levels;
+		CBlock *leaf = Ext2Dir::requestBlock(e,dir,le32tocpu(f->at->block),BlockCache::WRITE);
+		if(leaf == NULL) {
+			ino = -ENOBUFS;
+			break;
+		}
+		ino = Ext2Dir::removeFromBlock(e,leaf->buffer,name,nameLen);
+		if(ino >= 0)
+			e->blockCache.markDirty(leaf);
+		e->blockCache.release(leaf);
+		if(ino != -ENOENT)
+			break;
+
+		if((res = nextBlock(e,dir,&path,BlockCache::WRITE)) <= 0) {
+			ino = res < 0 ? res : -ENOENT;
+			break;
+		}
+	}
+	release(e,&path);
+	return ino;
+}
+
+int Ext2HTree::add(Ext2FileSystem *e,Ext2CInode *dir,ino_t ino,const char *name,size_t nameLen) {
+	Path path;
+	int res = probe(e,dir,name,nameLen,BlockCache::WRITE,&path);
+	if(res < 0)
+		return res;
+
+	Frame *f = path.frames + path.levels;
+	CBlock *leaf = Ext2Dir::requestBlock(e,dir,le32tocpu(f->at->block),BlockCache::WRITE);
+	if(leaf == NULL) {
+		res = -ENOBUFS;
+		goto done;
+	}
+
+	/* is there enough room in the leaf? */
+	if(!Ext2Dir::addToBlock(e,leaf->buffer,ino,name,nameLen)) {
+		/* no, so we have to split it. first make sure that the index has room for it */
+		if(getCount(f->entries) == getLimit(f->entries)) {
+			if((res = growIndex(e,dir,&path)) < 0)
+				goto done;
+		}
+
+		leaf = splitLeaf(e,dir,&path,leaf);
+		if(leaf == NULL) {
+			res = -ENOSPC;
+			goto done;
+		}
+		if(!Ext2Dir::addToBlock(e,leaf->buffer,ino,name,nameLen)) {
+			res = -ENOSPC;
+			goto done;
+		}
+	}
+	e->blockCache.markDirty(leaf);
+	res = 0;
+
+done:
+	if(leaf)
+		e->blockCache.release(leaf);
+	release(e,&path);
+	return res;
+}
+
+int Ext2HTree::growIndex(Ext2FileSystem *e,Ext2CInode *dir,Path *path) {
+	size_t nodeLimit = (e->blockSize() - NODE_OFF) / sizeof(Ext2DxEntry);
+	Frame *f = path->frames + path->levels;
+	block_t nblock;
+
+	/* if the parent is full as well, we can't do anything */
+	if(path->levels > 0 && getCount(f[-1].entries) == getLimit(f[-1].entries))
+		return -ENOSPC;
+
+	CBlock *blk = Ext2Dir::appendBlock(e,dir,&nblock);
+	if(blk == NULL)
+		return -ENOSPC;
+
+	/* the index-blocks look like empty directory-blocks */
+	Ext2DirEntry *fake = (Ext2DirEntry*)blk->buffer;
+	fake->inode = cputole32(0);
+	fake->recLen = cputole16(e->blockSize());
+	fake->nameLen = cputole16(0);
+	Ext2DxEntry *nentries = (Ext2DxEntry*)((uintptr_t)blk->buffer + NODE_OFF);
+
+	size_t count = getCount(f->entries);
+	if(path->levels == 0) {
+		/* move the entries from the root into the new block and let the root point to it */
+		memcpy(nentries,f->entries,count * sizeof(Ext2DxEntry));
+		setCountLimit(nentries,count,nodeLimit);
+
+		Ext2DxRootInfo *info = (Ext2DxRootInfo*)((uintptr_t)f->block->buffer + ROOT_INFO_OFF);
+		info->indirectLevels = 1;
+		setCountLimit(f->entries,1,getLimit(f->entries));
+		f->entries[0].block = cputole32(nblock);
+
+		path->frames[1].block = blk;
+		path->frames[1].entries = nentries;
+		path->frames[1].at = nentries + (f->at - f->entries);
+		f->at = f->entries;
+		path->levels = 1;
+		e->blockCache.markDirty(f->block);
+		e->blockCache.markDirty(blk);
+		return 0;
+	}
+
+	/* move the upper half of the entries into the new block */
+	size_t count1 = count / 2;
+	size_t count2 = count - count1;
+	uint32_t hash2 = le32tocpu(f->entries[count1].hash);
+	memcpy(nentries,f->entries + count1,count2 * sizeof(Ext2DxEntry));
+	setCountLimit(nentries,count2,nodeLimit);
+	setCountLimit(f->entries,count1,nodeLimit);
+	e->blockCache.markDirty(f->block);
+	e->blockCache.markDirty(blk);
+
+	/* continue with the half that contains our position */
+	if(f->at >= f->entries + count1) {
+		f->at = nentries + (f->at - (f->entries + count1));
+		f->entries = nentries;
+		e->blockCache.release(f->block);
+		f->block = blk;
+	}
+	else
+		e->blockCache.release(blk);
+
+	insertIndex(f - 1,hash2,nblock);
+	e->blockCache.markDirty(f[-1].block);
+	return 0;
+}
+
+struct LeafEntry {
+	uint32_t hash;
+	uint16_t offset;
+	uint16_t size;
+};
+
+static int compareLeafEntries(const void *a,const void *b) {
+	uint32_t ha = static_cast<const LeafEntry*>(a)->hash;
+	uint32_t hb = static_cast<const LeafEntry*>(b)->hash;
+	return ha < hb ? -1 : (ha > hb ? 1 : 0);
+}
+
+static void moveEntries(uint8_t *dst,const uint8_t *src,const LeafEntry *entries,size_t count,
+		size_t blockSize) {
+	Ext2DirEntry *de = NULL;
+	size_t off = 0;
+	for(size_t i = 0; i < count; ++i) {
+		de = (Ext2DirEntry*)(dst + off);
+		memcpy(de,src + entries[i].offset,entries[i].size);
+		de->recLen = cputole16(entries[i].size);
+		off += entries[i].size;
+	}
+	/* the last one takes the rest of the block */
+	de->recLen = cputole16(le16tocpu(de->recLen) + blockSize - off);
+}
+
+CBlock *Ext2HTree::splitLeaf(Ext2FileSystem *e,Ext2CInode *dir,Path *path,CBlock *leaf) {
+	size_t bs = e->blockSize();
+	Frame *f = path->frames + path->levels;
+	LeafEntry *map = (LeafEntry*)malloc((bs / Ext2Link::getDirESize(1)) * sizeof(LeafEntry));
+	uint8_t *copy = (uint8_t*)malloc(bs);
+	if(map == NULL || copy == NULL) {
+		free(map);
+		free(copy);
+		e->blockCache.release(leaf);
+		return NULL;
+	}
+
+	/* collect the entries and sort them by hash */
+	size_t count = 0;
+	uint8_t *buf = (uint8_t*)leaf->buffer;
+	for(size_t off = 0; off + sizeof(Ext2DirEntry) <= bs; ) {
+		Ext2DirEntry *de = (Ext2DirEntry*)(buf + off);
+		uint16_t recLen = le16tocpu(de->recLen);
+		if(recLen < sizeof(Ext2DirEntry) || off + recLen > bs)
+			break;
+		if(de->inode != 0) {
+			map[count].hash = hash(e,path->version,de->name,le16tocpu(de->nameLen));
+			map[count].offset = off;
+			map[count].size = Ext2Link::getDirESize(le16tocpu(de->nameLen));
+			count++;
+		}
+		off += recLen;
+	}
+	if(count < 2) {
+		free(map);
+		free(copy);
+		e->blockCache.release(leaf);
+		return NULL;
+	}
+	qsort(map,count,sizeof(LeafEntry),compareLeafEntries);
+
+	/* move the upper half (size-wise) into the new block */
+	size_t moved = 0,split;
+	for(split = count; split > 1; --split) {
+		if(moved + map[split - 1].size / 2 > bs / 2)
+			break;
+		moved += map[split - 1].size;
+	}
+	uint32_t hash2 = map[split].hash;
+	bool continued = hash2 == map[split - 1].hash;
+
+	block_t nblock;
+	CBlock *nleaf = Ext2Dir::appendBlock(e,dir,&nblock);
+	if(nleaf == NULL) {
+		free(map);
+		free(copy);
+		e->blockCache.release(leaf);
+		return NULL;
+	}
+
+	memcpy(copy,buf,bs);
+	moveEntries(buf,copy,map,split,bs);
+	moveEntries((uint8_t*)nleaf->buffer,copy,map + split,count - split,bs);
+	free(map);
+	free(copy);
+
+	insertIndex(f,hash2 + continued,nblock);
+	e->blockCache.markDirty(f->block);
+	e->blockCache.markDirty(leaf);
+	e->blockCache.markDirty(nleaf);
+
+	/* continue with the block where our entry belongs to */
+	if(path->hash >= hash2) {
+		e->blockCache.release(leaf);
+		return nleaf;
+	}
+	e->blockCache.release(nleaf);
+	return leaf;
+}
+
+void Ext2HTree::insertIndex(Frame *f,uint32_t hash,block_t block) {
+	size_t count = getCount(f->entries);
+	Ext2DxEntry *n = f->at + 1;
+	memmove(n + 1,n,(f->entries + count - n) * sizeof(Ext2DxEntry));
+	n->hash = cputole32(hash);
+	n->block = cputole32(block);
+	setCountLimit(f->entries,count + 1,getLimit(f->entries));
+}
+
+int Ext2HTree::build(Ext2FileSystem *e,Ext2CInode *dir) {
+	size_t bs = e->blockSize();
+	CBlock *root = Ext2Dir::requestBlock(e,dir,0,BlockCache::WRITE);
+	if(root == NULL)
+		return -ENOBUFS;
+
+	/* the block has to start with "." and ".." */
+	uint8_t *buf = (uint8_t*)root->buffer;
+	Ext2DirEntry *dot = (Ext2DirEntry*)buf;
+	Ext2DirEntry *dotdot = (Ext2DirEntry*)(buf + ROOT_INFO_OFF / 2);
+	if(le16tocpu(dot->recLen) != ROOT_INFO_OFF / 2 || le16tocpu(dot->nameLen) != 1 ||
+			dot->name[0] != '.' || le16tocpu(dotdot->nameLen) != 2 ||
+			dotdot->name[0] != '.' || dotdot->name[1] != '.') {
+		e->blockCache.release(root);
+		return -EINVAL;
+	}
+
+	block_t lblock;
+	CBlock *leaf = Ext2Dir::appendBlock(e,dir,&lblock);
+	if(leaf == NULL) {
+		e->blockCache.release(root);
+		return -ENOSPC;
+	}
+
+	/* move all other entries into the new block */
+	size_t noff = 0;
+	Ext2DirEntry *last = NULL;
+	uint8_t *nbuf = (uint8_t*)leaf->buffer;
+	for(size_t off = ROOT_INFO_OFF / 2 + le16tocpu(dotdot->recLen); off + sizeof(Ext2DirEntry) <= bs; ) {
+		Ext2DirEntry *de = (Ext2DirEntry*)(buf + off);
+		uint16_t recLen = le16tocpu(de->recLen);
+		if(recLen < sizeof(Ext2DirEntry) || off + recLen > bs)
+			break;
+		if(de->inode != 0) {
+			size_t size = Ext2Link::getDirESize(le16tocpu(de->nameLen));
+			last = (Ext2DirEntry*)(nbuf + noff);
+			memcpy(last,de,size);
+			last->recLen = cputole16(size);
+			noff += size;
+		}
+		off += recLen;
+	}
+	if(last)
+		last->recLen = cputole16(le16tocpu(last->recLen) + bs - noff);
+	else {
+		last = (Ext2DirEntry*)nbuf;
+		last->inode = cputole32(0);
+		last->recLen = cputole16(bs);
+		last->nameLen = cputole16(0);
+	}
+
+	/* turn the first block into the root */
+	dotdot->recLen = cputole16(bs - ROOT_INFO_OFF / 2);
+	memset(buf + ROOT_INFO_OFF,0,bs - ROOT_INFO_OFF);
+	Ext2DxRootInfo *info = (Ext2DxRootInfo*)(buf + ROOT_INFO_OFF);
+	info->hashVersion = e->sb.get()->defHashVersion;
+	if(info->hashVersion > EXT2_HASH_TEA)
+		info->hashVersion = EXT2_HASH_HALF_MD4;
+	info->infoLength = sizeof(Ext2DxRootInfo);
+	Ext2DxEntry *entries = (Ext2DxEntry*)(info + 1);
+	setCountLimit(entries,1,(bs - ROOT_INFO_OFF - sizeof(Ext2DxRootInfo)) / sizeof(Ext2DxEntry));
+	entries[0].block = cputole32(lblock);
+
+	e->blockCache.markDirty(root);
+	e->blockCache.markDirty(leaf);
+	e->blockCache.release(root);
+	e->blockCache.release(leaf);
+
+	dir->inode.flags = cputole32(le32tocpu(dir->inode.flags) | EXT2_INDEX_FL);
+	e->inodeCache.markDirty(dir);
+	return 0;
+}
+
+void Ext2HTree::drop(Ext2FileSystem *e,Ext2CInode *dir) {
+	dir->inode.flags = cputole32(le32tocpu(dir->inode.flags) & ~EXT2_INDEX_FL);
+	e->inodeCache.markDirty(dir);
+}
@@ -0,0 +1,159 @@
+/**
+ * $Id$
+ * Copyright (C) 2008 - 2014 Nils Asmussen
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#pragma once
+
+#include <sys/common.h>
+#include <sys/endian.h>
+#include <fs/ext2/ext2.h>
+#include <fs/blockcache.h>
+
+struct Ext2CInode;
+class Ext2FileSystem;
+
+/**
+ * Hash-indexed directories (dir_index). The first block of an indexed directory contains "." and
+ * "..", followed by the root of a b-tree that maps the hashes of the names to the directory-blocks
+ * that hold the entries. The index-blocks look like empty blocks for implementations that don't
+ * know about the index, so that the directory stays readable without it.
+ */
+class Ext2HTree {
+	Ext2HTree() = delete;
+
+	/* the max. number of index-levels (the root and one level below) */
+	static const size_t MAX_LEVELS		= 2;
+	/* the offset of Ext2DxRootInfo in the first block (behind "." and "..") */
+	static const size_t ROOT_INFO_OFF	= 24;
+	/* the offset of the entries in index-blocks other than the root */
+	static const size_t NODE_OFF		= 8;
+
+	struct Frame {
+		CBlock *block;
+		Ext2DxEntry *entries;
+		Ext2DxEntry *at;
+	};
+
+	struct Path {
+		uint version;
+		uint32_t hash;
+		size_t levels;
+		Frame frames[MAX_LEVELS];
+	};
+
+public:
+	/**
+	 * @param e the ext2-fs
+	 * @return true if the filesystem supports indexed directories
+	 */
+	static bool canIndex(Ext2FileSystem *e);
+
+	/**
+	 * @param e the ext2-fs
+	 * @param dir the directory
+	 * @return true if the given directory is indexed
+	 */
+	static bool isIndexed(Ext2FileSystem *e,const Ext2CInode *dir);
+
+	/**
+	 * Searches for <name> in the indexed directory <dir>.
+	 *
+	 * @param e the ext2-fs
+	 * @param dir the directory
+	 * @param name the name
+	 * @param nameLen the length of the name
+	 * @return the inode-number, -ENOENT if not found or -EINVAL if the index can't be used
+	 */
+	static ino_t find(Ext2FileSystem *e,const Ext2CInode *dir,const char *name,size_t nameLen);
+
+	/**
+	 * Adds the entry <name> -> <ino> to the indexed directory <dir>. Assumes that it does not
+	 * exist yet.
+	 *
+	 * @param e the ext2-fs
+	 * @param dir the directory
+	 * @param ino the inode-number
+	 * @param name the name
+	 * @param nameLen the length of the name
+	 * @return 0 on success or -EINVAL if the index can't be used
+	 */
+	static int add(Ext2FileSystem *e,Ext2CInode *dir,ino_t ino,const char *name,size_t nameLen);
+
+	/**
+	 * Removes the entry <name> from the indexed directory <dir>.
+	 *
+	 * @param e the ext2-fs
+	 * @param dir the directory
+	 * @param name the name
+	 * @param nameLen the length of the name
+	 * @return the inode-number of the removed entry, -ENOENT if not found or -EINVAL if the
+	 *  index can't be used
+	 */
+	static ino_t remove(Ext2FileSystem *e,Ext2CInode *dir,const char *name,size_t nameLen);
+
+	/**
+	 * Turns the directory <dir>, that consists of one block, into an indexed directory.
+	 *
+	 * @param e the ext2-fs
+	 * @param dir the directory
+	 * @return 0 on success
+	 */
+	static int build(Ext2FileSystem *e,Ext2CInode *dir);
+
+	/**
+	 * Marks the directory as not indexed. This is done if the index is broken, so that the
+	 * directory is treated as a linear one from now on.
+	 *
+	 * @param e the ext2-fs
+	 * @param dir the directory
+	 */
+	static void drop(Ext2FileSystem *e,Ext2CInode *dir);
+
+	/**
+	 * Calculates the hash of the given name
+	 *
+	 * @param e the ext2-fs
+	 * @param version the hash-version (EXT2_HASH_*)
+	 * @param name the name
+	 * @param nameLen the length of the name
+	 * @return the hash
+	 */
+	static uint32_t hash(Ext2FileSystem *e,uint version,const char *name,size_t nameLen);
+
+private:
+	static int probe(Ext2FileSystem *e,const Ext2CInode *dir,const char *name,size_t nameLen,
+		uint mode,Path *path);
+	static int nextBlock(Ext2FileSystem *e,const Ext2CInode *dir,Path *path,uint mode);
+	static void release(Ext2FileSystem *e,Path *path);
+	static int growIndex(Ext2FileSystem *e,Ext2CInode *dir,Path *path);
+	static CBlock *splitLeaf(Ext2FileSystem *e,Ext2CInode *dir,Path *path,CBlock *leaf);
+	static void insertIndex(Frame *f,uint32_t hash,block_t block);
+	static bool isDots(const char *name,size_t nameLen) {
+		return (nameLen == 1 && name[0] == '.') || (nameLen == 2 && name[0] == '.' && name[1] == '.');
+	}
+	static size_t getCount(const Ext2DxEntry *entries) {
+		return le16tocpu(reinterpret_cast<const Ext2DxCountLimit*>(entries)->count);
+	}
+	static size_t getLimit(const Ext2DxEntry *entries) {
+		return le16tocpu(reinterpret_cast<const Ext2DxCountLimit*>(entries)->limit);
+	}
+	static void setCountLimit(Ext2DxEntry *entries,size_t count,size_t limit) {
+		reinterpret_cast<Ext2DxCountLimit*>(entries)->count = cputole16(count);
+		reinterpret_cast<Ext2DxCountLimit*>(entries)->limit = cputole16(limit);
+	}
+};
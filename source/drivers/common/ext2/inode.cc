@@ -63,6 +63,7 @@ int Ext2INode::create(Ext2FileSystem *e,FSUser *u,Ext2CInode *dirNode,Ext2CInode
 	for(i = 0; i < EXT2_DIRBLOCK_COUNT; i++)
 		cnode->inode.dBlocks[i] = cputole32(0);
 	cnode->inode.blocks = cputole32(0);
+	cnode->inode.flags = cputole32(0);
 	now = cputole32(time(NULL));
 	cnode->inode.accesstime = now;
 	cnode->inode.createtime = now;
@@ -154,6 +155,7 @@ block_t Ext2INode::accessIndirBlock(Ext2FileSystem *e,Ext2CInode *cnode,block_t
 		*indir = cputole32(Ext2Bitmap::allocBlock(e,cnode));
 		if(!*indir)
 			return 0;
+		cnode->inode.blocks = cputole32(le32tocpu(cnode->inode.blocks) + e->blocksToSecs(1));
 		added = true;
 	}
 
@@ -232,6 +234,43 @@ block_t Ext2INode::doGetDataBlock(Ext2FileSystem *e,Ext2CInode *cnode,block_t bl
 	return 0;
 }
 
+block_t Ext2INode::getDataRun(Ext2FileSystem *e,const Ext2CInode *cnode,block_t block,size_t *count) {
+	/* do we know the run already? */
+	for(size_t i = 0; i < EXT2_EXTCACHE_SIZE; ++i) {
+		const Ext2Extent *ext = cnode->extents + i;
+		if(block >= ext->start && block < ext->start + ext->count) {
+			*count = MIN(*count,ext->start + ext->count - block);
+			return ext->phys + (block - ext->start);
+		}
+	}
+
+	block_t phys = getDataBlock(e,cnode,block);
+	if(phys == 0) {
+		*count = 1;
+		return 0;
+	}
+
+	/* walk to the end of the run, even beyond <count>, because the next request will probably
+	 * continue there */
+	size_t len = 1;
+	while(len < EXT2_EXTENT_MAX && getDataBlock(e,cnode,block + len) == phys + len)
+		len++;
+
+	Ext2Extent *ext = cnode->extents + cnode->nextExtent;
+	ext->start = block;
+	ext->phys = phys;
+	ext->count = len;
+	cnode->nextExtent = (cnode->nextExtent + 1) % EXT2_EXTCACHE_SIZE;
+	*count = MIN(*count,len);
+	return phys;
+}
+
+void Ext2INode::clearRuns(const Ext2CInode *cnode) {
+	for(size_t i = 0; i < EXT2_EXTCACHE_SIZE; ++i)
+		cnode->extents[i].count = 0;
+	cnode->nextExtent = 0;
+}
+
 #if DEBUGGING
 
 void Ext2INode::print(Ext2Inode *inode) {
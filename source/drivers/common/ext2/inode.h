@@ -116,6 +116,27 @@ public:
 		return doGetDataBlock(e,(Ext2CInode*)cnode,block,false);
 	}
 
+	/**
+	 * Determines the run of blocks on disk that holds the linear blocks <block> .. <block>+<count>-1
+	 * of the given inode. That is, if these blocks are not contiguous on disk, <count> is reduced
+	 * accordingly. The runs are cached in the inode, so that the indirect blocks have to be walked
+	 * only once for each run.
+	 *
+	 * @param e the ext2-handle
+	 * @param cnode the cached inode
+	 * @param block the linear-block-number
+	 * @param count the max. number of blocks; will be set to the length of the run
+	 * @return the first block on disk or 0 if there is no block yet (*count = 1 in this case)
+	 */
+	static block_t getDataRun(Ext2FileSystem *e,const Ext2CInode *cnode,block_t block,size_t *count);
+
+	/**
+	 * Forgets all cached block-runs of the given inode. This is required if blocks are free'd.
+	 *
+	 * @param cnode the cached inode
+	 */
+	static void clearRuns(const Ext2CInode *cnode);
+
 #if DEBUGGING
 
 	/**
@@ -33,20 +33,33 @@
 #include "rw.h"
 #include "inodecache.h"
 
-Ext2INodeCache::Ext2INodeCache(Ext2FileSystem *fs)
-		: _hits(), _misses(), _cache(new Ext2CInode[EXT2_ICACHE_SIZE]), _fs(fs) {
-	size_t i;
-	Ext2CInode *inode = _cache;
-	for(i = 0; i < EXT2_ICACHE_SIZE; i++) {
+Ext2INodeCache::Ext2INodeCache(Ext2FileSystem *fs,size_t size)
+		: _size(size), _hashSize(1), _hashmap(), _newest(), _oldest(), _hits(), _misses(),
+		  _writes(), _writtenInodes(), _cache(new Ext2CInode[size]), _fs(fs) {
+	/* use at least one bucket per inode */
+	while(_hashSize < _size)
+		_hashSize *= 2;
+	_hashmap = new Ext2CInode*[_hashSize]();
+
+	/* all inodes are unused at the beginning */
+	for(size_t i = 0; i < _size; i++) {
+		Ext2CInode *inode = _cache + i;
+		inode->prev = i > 0 ? inode - 1 : NULL;
+		inode->next = i < _size - 1 ? inode + 1 : NULL;
+		inode->hnext = NULL;
 		inode->inodeNo = EXT2_BAD_INO;
 		inode->refs = 0;
 		inode->dirty = false;
-		inode++;
+		inode->allocGoal = 0;
+		inode->resCount = 0;
+		Ext2INode::clearRuns(inode);
 	}
+	_newest = _cache;
+	_oldest = _cache + _size - 1;
 }
 
 void Ext2INodeCache::flush() {
-	Ext2CInode *inode,*end = _cache + EXT2_ICACHE_SIZE;
+	Ext2CInode *inode,*end = _cache + _size;
 	for(inode = _cache; inode < end; inode++) {
 		if(inode->dirty) {
 			sassert(tpool_lock(ALLOC_LOCK,LOCK_EXCLUSIVE | LOCK_KEEP) == 0);
@@ -58,9 +71,6 @@ void Ext2INodeCache::flush() {
 }
 
 Ext2CInode *Ext2INodeCache::request(ino_t no,uint mode) {
-	/* search for the inode. perhaps it's already in cache */
-	Ext2CInode *startNode = _cache + (no & (EXT2_ICACHE_SIZE - 1));
-	Ext2CInode *iend = _cache + EXT2_ICACHE_SIZE;
 	Ext2CInode *inode;
 	if(no <= EXT2_BAD_INO)
 		return NULL;
@@ -68,54 +78,44 @@ Ext2CInode *Ext2INodeCache::request(ino_t no,uint mode) {
 	/* tpool_lock the request of an inode */
 	sassert(tpool_lock(ALLOC_LOCK,LOCK_EXCLUSIVE | LOCK_KEEP) == 0);
 
-	for(inode = startNode; inode < iend; inode++) {
-		if(inode->inodeNo == no) {
-			acquire(inode,mode);
-			_hits++;
-			return inode;
-		}
-	}
-	/* look in 0 .. startNode; separate it to make the average-case fast */
-	if(inode == iend) {
-		for(inode = _cache; inode < startNode; inode++) {
-			if(inode->inodeNo == no) {
-				acquire(inode,mode);
-				_hits++;
-				return inode;
-			}
-		}
+	/* search for the inode. perhaps it's already in cache */
+	inode = lookup(no);
+	if(inode != NULL) {
+		touch(inode);
+		acquire(inode,mode);
+		_hits++;
+		return inode;
 	}
 
-	/* ok, not in cache. so we start again at the position to find a usable node */
-	/* if we have to load it from disk anyway I think we can waste a few cycles more
-	 * to reduce the number of cycles in the cache-lookup. therefore
-	 * we don't collect the information in the loops above. */
-	for(inode = startNode; inode < iend; inode++) {
-		if(inode->inodeNo == EXT2_BAD_INO || inode->refs == 0)
+	/* ok, not in cache. take the least recently used one, that is not in use */
+	for(inode = _oldest; inode != NULL; inode = inode->prev) {
+		if(inode->refs == 0)
 			break;
 	}
-	if(inode == iend) {
-		for(inode = _cache; inode < startNode; inode++) {
-			if(inode->inodeNo == EXT2_BAD_INO || inode->refs == 0)
-				break;
-		}
-
-		if(inode == startNode) {
-			printf("NO FREE INODE-CACHE-SLOT! What to to??");
-			return NULL;
-		}
+	if(inode == NULL) {
+		sassert(tpool_unlock(ALLOC_LOCK) == 0);
+		printe("No free inode-cache-slot");
+		return NULL;
 	}
 
 	/* write the old inode back, if necessary */
-	if(inode->dirty && inode->inodeNo != EXT2_BAD_INO) {
-		acquire(inode,IMODE_READ);
-		write(inode);
-		doRelease(inode,false);
+	if(inode->inodeNo != EXT2_BAD_INO) {
+		if(inode->dirty) {
+			acquire(inode,IMODE_READ);
+			write(inode);
+			doRelease(inode,false);
+		}
+		hashRemove(inode);
 	}
 
 	/* build node */
 	inode->inodeNo = no;
 	inode->dirty = false;
+	inode->allocGoal = 0;
+	inode->resCount = 0;
+	Ext2INode::clearRuns(inode);
+	hashInsert(inode);
+	touch(inode);
 	/* first for writing because we have to load it */
 	acquire(inode,IMODE_WRITE);
 
@@ -134,18 +134,20 @@ Ext2CInode *Ext2INodeCache::request(ino_t no,uint mode) {
 void Ext2INodeCache::print(FILE *f) {
 	float hitrate;
 	size_t used = 0,dirty = 0;
-	Ext2CInode *inode,*end = _cache + EXT2_ICACHE_SIZE;
+	Ext2CInode *inode,*end = _cache + _size;
 	for(inode = _cache; inode < end; inode++) {
 		if(inode->inodeNo != EXT2_BAD_INO)
 			used++;
 		if(inode->dirty)
 			dirty++;
 	}
-	fprintf(f,"\t\tTotal entries: %u\n",EXT2_ICACHE_SIZE);
+	fprintf(f,"\t\tTotal entries: %zu\n",_size);
 	fprintf(f,"\t\tUsed entries: %zu\n",used);
 	fprintf(f,"\t\tDirty entries: %zu\n",dirty);
+	fprintf(f,"\t\tHash buckets: %zu\n",_hashSize);
 	fprintf(f,"\t\tHits: %zu\n",_hits);
 	fprintf(f,"\t\tMisses: %zu\n",_misses);
+	fprintf(f,"\t\tWrites: %zu (%zu inodes)\n",_writes,_writtenInodes);
 	if(_hits == 0)
 		hitrate = 0;
 	else
@@ -170,9 +172,11 @@ void Ext2INodeCache::doRelease(Ext2CInode *ino,bool unlockAlloc) {
 	if(--ino->refs == 0) {
 		if(ino->inode.linkCount == 0) {
 			Ext2File::remove(_fs,ino);
+			/* the inode has been free'd in the bitmap; write the deletion to disk as well, because
+			 * the cache-entry is invalidated now and would never be written back */
+			write(ino);
 			/* ensure that we don't use the cached inode again */
-			ino->inodeNo = EXT2_BAD_INO;
-			ino->dirty = false;
+			invalidate(ino);
 		}
 	}
 	if(unlockAlloc)
@@ -203,8 +207,72 @@ void Ext2INodeCache::write(Ext2CInode *inode) {
 	size_t inodeInBlock = (inode->inodeNo - 1) % inodesPerBlock;
 	CBlock *block = _fs->blockCache.request(blockNo,BlockCache::WRITE);
 	vassert(block != NULL,"Fetching block %d failed",blockNo);
-	memcpy((uint8_t*)block->buffer + inodeInBlock * sizeof(Ext2Inode),&(inode->inode),
-			sizeof(Ext2Inode));
+
+	/* write the other dirty inodes in this block as well, so that we don't have to request the
+	 * block again for them. but skip the ones that are in use, because they might be changed
+	 * at the moment */
+	ino_t first = inode->inodeNo - inodeInBlock;
+	for(size_t i = 0; i < inodesPerBlock; ++i) {
+		Ext2CInode *other = first + (ino_t)i == inode->inodeNo ? inode : lookup(first + i);
+		if(other == inode || (other != NULL && other->dirty && other->refs == 0)) {
+			memcpy((uint8_t*)block->buffer + i * sizeof(Ext2Inode),&(other->inode),
+					sizeof(Ext2Inode));
+			other->dirty = false;
+			_writtenInodes++;
+		}
+	}
+	_writes++;
+
 	_fs->blockCache.markDirty(block);
 	_fs->blockCache.release(block);
 }
+
+void Ext2INodeCache::invalidate(Ext2CInode *inode) {
+	hashRemove(inode);
+	inode->inodeNo = EXT2_BAD_INO;
+	inode->dirty = false;
+
+	/* move it to the end of the LRU-list */
+	if(inode != _oldest) {
+		if(inode->prev)
+			inode->prev->next = inode->next;
+		else
+			_newest = inode->next;
+		inode->next->prev = inode->prev;
+		inode->prev = _oldest;
+		inode->next = NULL;
+		_oldest->next = inode;
+		_oldest = inode;
+	}
+}
+
+void Ext2INodeCache::touch(Ext2CInode *inode) {
+	if(inode != _newest) {
+		if(inode == _oldest)
+			_oldest = inode->prev;
+		inode->prev->next = inode->next;
+		if(inode->next)
+			inode->next->prev = inode->prev;
+		inode->prev = NULL;
+		inode->next = _newest;
+		_newest->prev = inode;
+		_newest = inode;
+	}
+}
+
+void Ext2INodeCache::hashInsert(Ext2CInode *inode) {
+	Ext2CInode **list = &_hashmap[inode->inodeNo & (_hashSize - 1)];
+	inode->hnext = *list;
+	*list = inode;
+}
+
+void Ext2INodeCache::hashRemove(Ext2CInode *inode) {
+	Ext2CInode **list = &_hashmap[inode->inodeNo & (_hashSize - 1)];
+	while(*list != NULL) {
+		if(*list == inode) {
+			*list = inode->hnext;
+			break;
+		}
+		list = &(*list)->hnext;
+	}
+}
@@ -24,12 +24,38 @@
 
 #include "inode.h"
 
+/* the number of block-runs we remember per inode */
+#define EXT2_EXTCACHE_SIZE		4
+
 class Ext2FileSystem;
 
+/* a run of blocks of an inode that are contiguous on disk */
+struct Ext2Extent {
+	/* the first linear block-number */
+	block_t start;
+	/* the corresponding block on disk */
+	block_t phys;
+	/* the number of blocks (0 = unused) */
+	size_t count;
+};
+
 struct Ext2CInode {
+	/* the LRU-list and the chain in the hashmap */
+	Ext2CInode *prev;
+	Ext2CInode *next;
+	Ext2CInode *hnext;
 	ino_t inodeNo;
 	ushort dirty;
 	ushort refs;
+	/* the block that should be allocated next for this inode (0 = none) */
+	block_t allocGoal;
+	/* the blocks that have been reserved for a write (see Ext2Bitmap::reserve) */
+	block_t resStart;
+	size_t resCount;
+	/* the recently used block-runs (see Ext2INode::getDataRun). readers update them as well, while
+	 * holding just a shared lock. this is fine, because the requests are handled one by one */
+	mutable Ext2Extent extents[EXT2_EXTCACHE_SIZE];
+	mutable size_t nextExtent;
 	Ext2Inode inode;
 };
 
@@ -42,9 +68,13 @@ class Ext2INodeCache {
 public:
 	/**
 	 * Inits the inode-cache
+	 *
+	 * @param fs the filesystem
+	 * @param size the number of inodes to cache
 	 */
-	explicit Ext2INodeCache(Ext2FileSystem *fs);
+	explicit Ext2INodeCache(Ext2FileSystem *fs,size_t size);
 	~Ext2INodeCache() {
+		delete[] _hashmap;
 		delete[] _cache;
 	}
 
@@ -105,12 +135,39 @@ private:
 	 */
 	void read(Ext2CInode *inode);
 	/**
-	 * Writes the inode back to the cached block, which can be written to disk later
+	 * Writes the inode back to the cached block, which can be written to disk later. The other
+	 * dirty and unused inodes in the same block are written as well.
 	 */
 	void write(Ext2CInode *inode);
+	/**
+	 * Removes the inode from the hashmap and puts it at the end of the LRU-list to reuse it first
+	 */
+	void invalidate(Ext2CInode *inode);
+	/**
+	 * Puts the given inode at the beginning of the LRU-list
+	 */
+	void touch(Ext2CInode *inode);
+	/**
+	 * Searches for the given inode in the hashmap
+	 */
+	Ext2CInode *lookup(ino_t no) const {
+		Ext2CInode *inode = _hashmap[no & (_hashSize - 1)];
+		while(inode != NULL && inode->inodeNo != no)
+			inode = inode->hnext;
+		return inode;
+	}
+	void hashInsert(Ext2CInode *inode);
+	void hashRemove(Ext2CInode *inode);
 
+	size_t _size;
+	size_t _hashSize;
+	Ext2CInode **_hashmap;
+	Ext2CInode *_newest;
+	Ext2CInode *_oldest;
 	size_t _hits;
 	size_t _misses;
+	size_t _writes;
+	size_t _writtenInodes;
 	Ext2CInode *_cache;
 	Ext2FileSystem *_fs;
 };
@@ -53,7 +53,6 @@ public:
 	static int remove(Ext2FileSystem *e,FSUser *u,Ext2CInode *pdir,Ext2CInode *dir,const char *name,
 		bool delDir);
 
-private:
 	/**
 	 * Calculates the total size of a dir-entry, including padding
 	 */
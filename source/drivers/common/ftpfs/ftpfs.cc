@@ -18,6 +18,7 @@
  */
 
 #include <sys/common.h>
+#include <sys/driver.h>
 #include <dirent.h>
 #include <esc/proto/socket.h>
 #include <esc/proto/net.h>
@@ -104,22 +105,14 @@ public:
   	}
 
 	void loop() {
-		ulong buf[IPC_DEF_SIZE / sizeof(ulong)];
 		while(1) {
-			msgid_t mid;
-			int fd = getwork(id(),&mid,buf,sizeof(buf),isStopped() ? GW_NOBLOCK : 0);
-			if(EXPECT_FALSE(fd < 0)) {
-				if(fd != -EINTR) {
-					// no requests anymore and we should shutdown?
-					if(isStopped())
-						break;
-					printe("getwork failed");
-				}
-				continue;
+			ssize_t res = handleWork(isStopped() ? GW_NOBLOCK : 0);
+			if(EXPECT_FALSE(res < 0 && res != -EINTR)) {
+				// no requests anymore and we should shutdown?
+				if(isStopped())
+					break;
+				printe("getwork failed");
 			}
-
-			IPCStream is(fd,buf,sizeof(buf),mid);
-			handleMsg(mid,is);
 		}
 	}
 
@@ -198,7 +191,11 @@ public:
 			if(DirCache::getList(file->ctrlRef,file->path.c_str(),false) == NULL)
 				DirCache::removeDirOf(file->path.c_str());
 		}
+		bool written = file->flags & O_WRITE;
 		ClientDevice::close(is);
+		/* the file is uploaded on close, so that the kernel can't know the new attributes */
+		if(written)
+			fsinvalidate(id(),-1);
 	}
 
 	void stat(IPCStream &is) {
@@ -102,22 +102,14 @@ public:
   	}
 
 	void loop() {
-		ulong buf[IPC_DEF_SIZE / sizeof(ulong)];
 		while(1) {
-			msgid_t mid;
-			int fd = getwork(id(),&mid,buf,sizeof(buf),isStopped() ? GW_NOBLOCK : 0);
-			if(EXPECT_FALSE(fd < 0)) {
-				if(fd != -EINTR) {
-					// no requests anymore and we should shutdown?
-					if(isStopped())
-						break;
-					printe("getwork failed");
-				}
-				continue;
+			ssize_t res = handleWork(isStopped() ? GW_NOBLOCK : 0);
+			if(EXPECT_FALSE(res < 0 && res != -EINTR)) {
+				// no requests anymore and we should shutdown?
+				if(isStopped())
+					break;
+				printe("getwork failed");
 			}
-
-			IPCStream is(fd,buf,sizeof(buf),mid);
-			handleMsg(mid,is);
 		}
 	}
 
@@ -18,6 +18,7 @@
  */
 
 #include <sys/common.h>
+#include <sys/conf.h>
 #include <sys/thread.h>
 #include <sys/driver.h>
 #include <sys/sync.h>
@@ -49,6 +50,14 @@ std::mutex mutex;
 
 static int receiveThread(void *arg);
 
+static void pinThread(tid_t tid) {
+	/* distribute the threads over the CPUs (expects that <mutex> is held) */
+	static size_t nextCPU = 0;
+	long cpus = sysconf(CONF_CPU_COUNT);
+	if(cpus > 1 && setaffinity(tid,1UL << (nextCPU++ % cpus)) < 0)
+		printe("Unable to set affinity of thread %d",tid);
+}
+
 class SocketDevice : public esc::ClientDevice<Socket> {
 public:
 	explicit SocketDevice(const char *path,mode_t mode)
@@ -279,6 +288,9 @@ public:
 				LinkMng::rem(name.str());
 				delete linkcpy;
 			}
+			/* keep the caches of the receive-thread warm */
+			else
+				pinThread(res);
 		}
 		is << res << esc::Reply();
 	}
@@ -549,6 +561,7 @@ int main() {
 		printe("Unable to create /sys/net");
 	createResolvConf();
 
+	Timeouts::init();
 	if(startthread(socketThread,NULL) < 0)
 		error("Unable to start socket thread");
 	if(startthread(linksFileThread,NULL) < 0)
@@ -19,26 +19,39 @@
 
 #include <sys/common.h>
 #include <sys/thread.h>
+#include <stdlib.h>
 
 #include "timeouts.h"
 
-uint Timeouts::_now;
+bool Timeouts::_waiting;
+tUserSem Timeouts::_sem;
 int Timeouts::_nextId;
 std::list<Timeouts::Entry> Timeouts::_list;
 extern std::mutex mutex;
 
+void Timeouts::init() {
+	if(usemcrt(&_sem,0) < 0)
+		error("Unable to create timeout semaphore");
+}
+
 void Timeouts::program(int id,callback_type *cb,uint msecs) {
 	// first cancel the old one
 	cancel(id);
 
 	// insert new timeout, sorted in ascending order
-	uint ts = _now + msecs;
+	uint64_t ts = now() + (uint64_t)msecs * 1000;
 	auto it = _list.begin();
 	for(; it != _list.end(); ++it) {
 		if(it->timestamp > ts)
 			break;
 	}
 	_list.insert(it,Entry(id,cb,ts));
+
+	// wakeup the thread, if it waits for the first timeout
+	if(_waiting) {
+		_waiting = false;
+		usemup(&_sem);
+	}
 }
 
 void Timeouts::cancel(int id) {
@@ -53,21 +66,33 @@ void Timeouts::cancel(int id) {
 
 int Timeouts::thread(void*) {
 	while(1) {
-		// TODO we shouldn't wake up all the time when there is no timeout to trigger
-		sleep(100);
-		_now += 100;
+		uint64_t delay = 0;
+		{
+			std::lock_guard<std::mutex> guard(mutex);
+			// it's sorted
+			while(_list.size() > 0) {
+				uint64_t cur = now();
+				if(_list.front().timestamp > cur) {
+					delay = MIN(_list.front().timestamp - cur,MAX_SLEEP);
+					break;
+				}
 
-		// it's sorted
-		std::lock_guard<std::mutex> guard(mutex);
-		while(_list.size() > 0 && _list.front().timestamp <= _now) {
-			auto it = _list.begin();
-			callback_type *cb = it->cb;
-			_list.erase(it);
+				auto it = _list.begin();
+				callback_type *cb = it->cb;
+				_list.erase(it);
 
-			(*cb)();
+				(*cb)();
 
-			delete cb;
+				delete cb;
+			}
+			_waiting = delay == 0;
 		}
+
+		// sleep until the next timeout expires or wait until there is one
+		if(delay == 0)
+			usemdown(&_sem);
+		else
+			usleep(delay);
 	}
 	return 0;
 }
@@ -20,6 +20,8 @@
 #pragma once
 
 #include <sys/common.h>
+#include <sys/sync.h>
+#include <sys/time.h>
 #include <functor.h>
 #include <mutex>
 #include <list>
@@ -27,19 +29,25 @@
 class Timeouts {
 	Timeouts() = delete;
 
+	/* the maximum number of microseconds to sleep at once. this bounds the delay of timeouts that are
+	 * programmed while we're sleeping and expire before the one we're waiting for */
+	static const uint64_t MAX_SLEEP		= 100 * 1000;
+
 public:
 	typedef std::Functor<void> callback_type;
 
 	struct Entry {
-		explicit Entry(int _id,callback_type *_cb,uint _timestamp)
+		explicit Entry(int _id,callback_type *_cb,uint64_t _timestamp)
 			: id(_id), cb(_cb), timestamp(_timestamp) {
 		}
 
 		int id;
 		callback_type *cb;
-		uint timestamp;
+		/* the expiration time in microseconds */
+		uint64_t timestamp;
 	};
 
+	static void init();
 	static int thread(void*);
 
 	static int allocateId() {
@@ -50,7 +58,12 @@ public:
 	static void cancel(int id);
 
 private:
-	static uint _now;
+	static uint64_t now() {
+		return tsctotime(rdtsc());
+	}
+
+	static bool _waiting;
+	static tUserSem _sem;
 	static int _nextId;
 	static std::list<Entry> _list;
 };
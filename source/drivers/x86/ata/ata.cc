@@ -18,6 +18,7 @@
  */
 
 #include <sys/common.h>
+#include <sys/arch.h>
 #include <sys/arch/x86/ports.h>
 #include <sys/debug.h>
 #include <sys/proc.h>
@@ -30,27 +31,51 @@
 
 static bool ata_setupCommand(sATADevice *device,uint64_t lba,size_t secCount,uint cmd);
 static uint ata_getCommand(sATADevice *device,uint op);
+static bool ata_isDirect(const void *buffer,const uintptr_t *phys,size_t size);
+static void ata_setupPRDT(sATAController *ctrl,const void *buffer,const uintptr_t *phys,size_t size);
 
-bool ata_readWrite(sATADevice *device,uint op,void *buffer,uint64_t lba,size_t secSize,
-		size_t secCount) {
+bool ata_readWrite(sATADevice *device,uint op,void *buffer,const uintptr_t *phys,uint64_t lba,
+		size_t secSize,size_t secCount) {
 	uint cmd = ata_getCommand(device,op);
-	if(!ata_setupCommand(device,lba,secCount,cmd))
-		return false;
+	if(cmd == COMMAND_PACKET) {
+		if(!ata_setupCommand(device,lba,secCount,cmd))
+			return false;
+		return ata_transferPIO(device,op,buffer,secSize,secCount,true);
+	}
+
+	/* split the request, if it doesn't fit into one command */
+	size_t max = device->info.features.lba48 ? 0xFFFF : 0xFF;
+	bool dma = device->ctrl->useDma && device->info.capabilities.DMA;
+	if(dma) {
+		if(ata_isDirect(buffer,phys,secCount * secSize))
+			max = MIN(max,((PRDT_ENTRIES - 1) * PAGE_SIZE) / secSize);
+		else
+			max = MIN(max,DMA_BUF_SIZE / secSize);
+	}
+
+	size_t pageOff = (uintptr_t)buffer & (PAGE_SIZE - 1);
+	size_t done = 0;
+	while(secCount > 0) {
+		size_t count = MIN(secCount,max);
+		char *buf = (char*)buffer + done;
+		/* phys[0] belongs to the page that contains <buffer> */
+		const uintptr_t *bufPhys = phys ? phys + (pageOff + done) / PAGE_SIZE : NULL;
+		if(!ata_setupCommand(device,lba,count,cmd))
+			return false;
+
+		bool res;
+		if(dma)
+			res = ata_transferDMA(device,op,buf,bufPhys,secSize,count);
+		else
+			res = ata_transferPIO(device,op,buf,secSize,count,true);
+		if(!res)
+			return false;
 
-	switch(cmd) {
-		case COMMAND_PACKET:
-		case COMMAND_READ_SEC:
-		case COMMAND_READ_SEC_EXT:
-		case COMMAND_WRITE_SEC:
-		case COMMAND_WRITE_SEC_EXT:
-			return ata_transferPIO(device,op,buffer,secSize,secCount,true);
-		case COMMAND_READ_DMA:
-		case COMMAND_READ_DMA_EXT:
-		case COMMAND_WRITE_DMA:
-		case COMMAND_WRITE_DMA_EXT:
-			return ata_transferDMA(device,op,buffer,secSize,secCount);
-	}
-	return false;
+		done += count * secSize;
+		lba += count;
+		secCount -= count;
+	}
+	return true;
 }
 
 bool ata_transferPIO(sATADevice *device,uint op,void *buffer,size_t secSize,
@@ -89,16 +114,31 @@ bool ata_transferPIO(sATADevice *device,uint op,void *buffer,size_t secSize,
 	return true;
 }
 
-bool ata_transferDMA(sATADevice *device,uint op,void *buffer,size_t secSize,size_t secCount) {
+bool ata_transferDMA(sATADevice *device,uint op,void *buffer,const uintptr_t *phys,size_t secSize,
+		size_t secCount) {
 	sATAController* ctrl = device->ctrl;
 	uint8_t status;
 	size_t size = secCount * secSize;
+	bool direct = ata_isDirect(buffer,phys,size);
 	int res;
 
 	/* setup PRDT */
-	ctrl->dma_prdt_virt->buffer = (uint32_t)(uintptr_t)ctrl->dma_buf_phys;
-	ctrl->dma_prdt_virt->byteCount = size;
-	ctrl->dma_prdt_virt->last = 1;
+	if(direct) {
+		if(size > (PRDT_ENTRIES - 1) * PAGE_SIZE) {
+			ATA_LOG("Device %d: DMA-transfer of %zu bytes does not fit into the PRDT",device->id,size);
+			return false;
+		}
+		ata_setupPRDT(ctrl,buffer,phys,size);
+	}
+	else {
+		if(size > DMA_BUF_SIZE) {
+			ATA_LOG("Device %d: DMA-transfer of %zu bytes does not fit into the buffer",device->id,size);
+			return false;
+		}
+		ctrl->dma_prdt_virt->buffer = (uint32_t)(uintptr_t)ctrl->dma_buf_phys;
+		ctrl->dma_prdt_virt->byteCount = size;
+		ctrl->dma_prdt_virt->last = 1;
+	}
 
 	/* stop running transfers */
 	ATA_PR2("Stopping running transfers");
@@ -110,9 +150,8 @@ bool ata_transferDMA(sATADevice *device,uint op,void *buffer,size_t secSize,size
 	ATA_PR2("Setting PRDT");
 	ctrl_outbmrl(ctrl,BMR_REG_PRDT,reinterpret_cast<uintptr_t>(ctrl->dma_prdt_phys));
 
-	/* write data to buffer, if we should write */
-	/* TODO we should use the buffer directly when reading from the client */
-	if(op == OP_WRITE || op == OP_PACKET)
+	/* write data to buffer, if we should write and can't let the controller access it directly */
+	if(!direct && (op == OP_WRITE || op == OP_PACKET))
 		memcpy(ctrl->dma_buf_virt,buffer,size);
 
 	/* it seems to be necessary to read those ports here */
@@ -127,11 +166,25 @@ bool ata_transferDMA(sATADevice *device,uint op,void *buffer,size_t secSize,size
 	ctrl_inbmrb(ctrl,BMR_REG_COMMAND);
 	ctrl_inbmrb(ctrl,BMR_REG_STATUS);
 
-	/* now wait for an interrupt */
+	/* now wait for an interrupt. the irq-semaphore might have been raised by an earlier interrupt
+	 * as well, so check whether the controller really finished the transfer */
 	ATA_PR2("Waiting for an interrupt");
-	ctrl_waitIntrpt(ctrl);
+	do {
+		ctrl_waitIntrpt(ctrl);
+		status = ctrl_inbmrb(ctrl,BMR_REG_STATUS);
+	}
+	while(!(status & (BMR_STATUS_IRQ | BMR_STATUS_ERROR)));
+
+	/* stop bus-mastering and acknowledge the interrupt */
+	ctrl_outbmrb(ctrl,BMR_REG_COMMAND,0);
+	ctrl_outbmrb(ctrl,BMR_REG_STATUS,status | BMR_STATUS_ERROR | BMR_STATUS_IRQ);
+	if(status & BMR_STATUS_ERROR) {
+		ATA_LOG("Device %d: DMA-Transfer failed: bus-master-status %#x",device->id,status);
+		return false;
+	}
 
-	res = ctrl_waitUntil(ctrl,DMA_TRANSFER_TIMEOUT,DMA_TRANSFER_SLEEPTIME,0,CMD_ST_BUSY | CMD_ST_DRQ);
+	/* the device should be ready now; thus, don't sleep, if it's not */
+	res = ctrl_waitUntil(ctrl,DMA_TRANSFER_TIMEOUT,0,0,CMD_ST_BUSY | CMD_ST_DRQ);
 	if(res == -1) {
 		ATA_LOG("Device %d: Timeout after DMA-transfer",device->id);
 		return false;
@@ -141,14 +194,57 @@ bool ata_transferDMA(sATADevice *device,uint op,void *buffer,size_t secSize,size
 		return false;
 	}
 
-	ctrl_inbmrb(ctrl,BMR_REG_STATUS);
-	ctrl_outbmrb(ctrl,BMR_REG_COMMAND,0);
 	/* copy data when reading */
-	if(op == OP_READ)
+	if(!direct && op == OP_READ)
 		memcpy(buffer,ctrl->dma_buf_virt,size);
 	return true;
 }
 
+static bool ata_isDirect(const void *buffer,const uintptr_t *phys,size_t size) {
+	/* the controller requires word-aligned buffers */
+	if(phys == NULL || ((uintptr_t)buffer & 1))
+		return false;
+
+	/* and is only able to access the first 4 GiB */
+	size_t pages = (((uintptr_t)buffer & (PAGE_SIZE - 1)) + size + PAGE_SIZE - 1) / PAGE_SIZE;
+	for(size_t i = 0; i < pages; ++i) {
+		if((uint64_t)phys[i] + PAGE_SIZE > 0x100000000ULL)
+			return false;
+	}
+	return true;
+}
+
+static void ata_setupPRDT(sATAController *ctrl,const void *buffer,const uintptr_t *phys,size_t size) {
+	sPRD *prd = ctrl->dma_prdt_virt;
+	size_t off = (uintptr_t)buffer & (PAGE_SIZE - 1);
+	uintptr_t start = 0;
+	size_t len = 0;
+	for(size_t i = 0; size > 0; ++i) {
+		uintptr_t addr = phys[i] + off;
+		size_t amount = MIN(PAGE_SIZE - off,size);
+
+		/* put physically contiguous pages into one entry, as long as it doesn't cross a 64 KiB
+		 * boundary */
+		if(len > 0 && (addr != start + len || (start & ~0xFFFFUL) != ((addr + amount - 1) & ~0xFFFFUL))) {
+			prd->buffer = start;
+			prd->byteCount = len;	/* 0 means 64 KiB */
+			prd->last = 0;
+			prd++;
+			len = 0;
+		}
+		if(len == 0)
+			start = addr;
+		len += amount;
+
+		size -= amount;
+		off = 0;
+	}
+
+	prd->buffer = start;
+	prd->byteCount = len;
+	prd->last = 1;
+}
+
 static bool ata_setupCommand(sATADevice *device,uint64_t lba,size_t secCount,uint cmd) {
 	sATAController *ctrl = device->ctrl;
 	uint8_t devValue;
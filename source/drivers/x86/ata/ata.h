@@ -35,13 +35,15 @@
  * @param device the device
  * @param op the operation: OP_READ, OP_WRITE or OP_PACKET
  * @param buffer the buffer to write to
+ * @param phys the physical addresses of the pages of <buffer>, beginning with the page that
+ *  contains <buffer> (optional). if given, DMA-transfers go directly from/to the buffer.
  * @param lba the block-address to start at
  * @param secSize the size of a sector
  * @param secCount number of sectors
  * @return true on success
  */
-bool ata_readWrite(sATADevice *device,uint op,void *buffer,uint64_t lba,size_t secSize,
-		size_t secCount);
+bool ata_readWrite(sATADevice *device,uint op,void *buffer,const uintptr_t *phys,uint64_t lba,
+		size_t secSize,size_t secCount);
 
 /**
  * Performs a PIO-transfer
@@ -63,8 +65,10 @@ bool ata_transferPIO(sATADevice *device,uint op,void *buffer,size_t secSize,size
  * @param device the device
  * @param op the operation: OP_READ, OP_WRITE or OP_PACKET
  * @param buffer the buffer to write to
+ * @param phys the physical addresses of the pages of <buffer> (optional; see ata_readWrite)
  * @param secSize the size of a sector
  * @param secCount number of sectors
  * @return true if successfull
  */
-bool ata_transferDMA(sATADevice *device,uint op,void *buffer,size_t secSize,size_t secCount);
+bool ata_transferDMA(sATADevice *device,uint op,void *buffer,const uintptr_t *phys,size_t secSize,
+		size_t secCount);
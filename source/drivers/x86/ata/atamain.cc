@@ -19,6 +19,7 @@
 
 #include <sys/common.h>
 #include <usergroup/group.h>
+#include <sys/arch.h>
 #include <sys/arch/x86/ports.h>
 #include <sys/driver.h>
 #include <sys/io.h>
@@ -49,8 +50,10 @@ using namespace esc;
 
 class ATAPartitionDevice;
 
-static ulong handleRead(sATADevice *device,sPartition *part,uint16_t *buf,uint offset,uint count);
-static ulong handleWrite(sATADevice *device,sPartition *part,uint16_t *buf,uint offset,uint count);
+static ulong handleRead(sATADevice *device,sPartition *part,uint16_t *buf,const uintptr_t *phys,
+	uint offset,uint count);
+static ulong handleWrite(sATADevice *device,sPartition *part,uint16_t *buf,const uintptr_t *phys,
+	uint offset,uint count);
 static void initDrives(void);
 static void createVFSEntry(sATADevice *device,sPartition *part,const char *name);
 
@@ -61,7 +64,38 @@ static ATAPartitionDevice *devs[DEVICE_COUNT * PARTITION_COUNT];
  * may not have more memory and can't do anything about it */
 static uint16_t buffer[MAX_RW_SIZE / sizeof(uint16_t)];
 
-class ATAPartitionDevice : public ClientDevice<> {
+class ATAClient : public Client {
+public:
+	explicit ATAClient(int f) : Client(f), phys() {
+	}
+	virtual ~ATAClient() {
+		if(phys)
+			munmap(phys);
+	}
+
+	/**
+	 * Determines the physical addresses of the shared memory, so that the controller can transfer
+	 * the data directly from/to it. If that fails, we use the bounce-buffer of the controller.
+	 *
+	 * @param size the size of the shared memory
+	 */
+	void translate(size_t size) {
+		size_t pages = (size + PAGE_SIZE - 1) / PAGE_SIZE;
+		/* as for the shared memory, we can't cause pagefaults when accessing the table */
+		phys = static_cast<uintptr_t*>(mmap(NULL,pages * sizeof(uintptr_t),0,PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_POPULATE | MAP_NOSWAP | MAP_LOCKED,-1,0));
+		if(phys && virt2phys(shm(),phys,pages) < 0) {
+			ATA_LOG("Unable to determine physical addresses of shared memory");
+			munmap(phys);
+			phys = NULL;
+		}
+	}
+
+	/* the physical addresses of the pages in shm() */
+	uintptr_t *phys;
+};
+
+class ATAPartitionDevice : public ClientDevice<ATAClient> {
 public:
 	explicit ATAPartitionDevice(uint dev,uint part,const char *name,mode_t mode)
 		: ClientDevice(name,mode,DEV_TYPE_BLOCK,
@@ -79,7 +113,7 @@ public:
 
 	void shfile(IPCStream &is) {
 		char path[MAX_PATH_LEN];
-		Client *c = (*this)[is.fd()];
+		ATAClient *c = (*this)[is.fd()];
 		FileShFile::Request r(path,sizeof(path));
 		is >> r;
 		assert(c->shm() == NULL && !is.error());
@@ -89,6 +123,8 @@ public:
 		 * MAP_NOSWAP to let it fail if there is not enough memory instead of starting
 		 * to swap (which would cause a deadlock, because we're doing that). */
 		int res = joinshm(c,path,r.size,MAP_POPULATE | MAP_NOSWAP | MAP_LOCKED);
+		if(res == 0)
+			c->translate(r.size);
 		is << FileShFile::Response(res) << Reply();
 	}
 
@@ -97,8 +133,9 @@ public:
 		is >> r;
 		assert(!is.error());
 
-		uint16_t *buf = r.shmemoff == -1 ? buffer : (uint16_t*)(*this)[is.fd()]->shm() + (r.shmemoff >> 1);
-		size_t res = handleRead(_ataDev,_part,buf,r.offset,r.count);
+		const uintptr_t *phys;
+		uint16_t *buf = getBuffer(is.fd(),r.shmemoff,&phys);
+		size_t res = handleRead(_ataDev,_part,buf,phys,r.offset,r.count);
 
 		is << FileRead::Response(res) << Reply();
 		if(r.shmemoff == -1 && res > 0)
@@ -112,8 +149,9 @@ public:
 			is >> ReceiveData(buffer,sizeof(buffer));
 		assert(!is.error());
 
-		uint16_t *buf = r.shmemoff == -1 ? buffer : (uint16_t*)(*this)[is.fd()]->shm() + (r.shmemoff >> 1);
-		size_t res = handleWrite(_ataDev,_part,buf,r.offset,r.count);
+		const uintptr_t *phys;
+		uint16_t *buf = getBuffer(is.fd(),r.shmemoff,&phys);
+		size_t res = handleWrite(_ataDev,_part,buf,phys,r.offset,r.count);
 
 		is << FileWrite::Response(res) << Reply();
 	}
@@ -123,6 +161,18 @@ public:
 	}
 
 private:
+	uint16_t *getBuffer(int fd,ssize_t shmemoff,const uintptr_t **phys) {
+		*phys = NULL;
+		if(shmemoff == -1)
+			return buffer;
+
+		ATAClient *c = (*this)[fd];
+		/* if the kernel has lent us the pages of the client, we don't know where they are */
+		if(c->shm() && c->phys)
+			*phys = c->phys + shmemoff / PAGE_SIZE;
+		return (uint16_t*)c->shm() + (shmemoff >> 1);
+	}
+
 	sATADevice *_ataDev;
 	sPartition *_part;
 };
@@ -184,7 +234,8 @@ int main(int argc,char **argv) {
 	return EXIT_SUCCESS;
 }
 
-static ulong handleRead(sATADevice *ataDev,sPartition *part,uint16_t *buf,uint offset,uint count) {
+static ulong handleRead(sATADevice *ataDev,sPartition *part,uint16_t *buf,const uintptr_t *phys,
+		uint offset,uint count) {
 	/* we have to check whether it is at least one sector. otherwise ATA can't
 	 * handle the request */
 	if(offset + count <= part->size * ataDev->secSize && offset + count > offset) {
@@ -196,11 +247,14 @@ static ulong handleRead(sATADevice *ataDev,sPartition *part,uint16_t *buf,uint o
 			for(i = 0; i < RETRY_COUNT; i++) {
 				if(i > 0)
 					ATA_LOG("Read failed; retry %zu",i);
-				if(ataDev->rwHandler(ataDev,OP_READ,buf,
+				/* the requests to all devices of a controller are served one after another */
+				usemdown(&ataDev->ctrl->lock);
+				bool res = ataDev->rwHandler(ataDev,OP_READ,buf,phys,
 						offset / ataDev->secSize + part->start,
-						ataDev->secSize,rcount / ataDev->secSize)) {
+						ataDev->secSize,rcount / ataDev->secSize);
+				usemup(&ataDev->ctrl->lock);
+				if(res)
 					return count;
-				}
 			}
 			ATA_LOG("Giving up after %zu retries",i);
 			return 0;
@@ -211,7 +265,8 @@ static ulong handleRead(sATADevice *ataDev,sPartition *part,uint16_t *buf,uint o
 	return 0;
 }
 
-static ulong handleWrite(sATADevice *ataDev,sPartition *part,uint16_t *buf,uint offset,uint count) {
+static ulong handleWrite(sATADevice *ataDev,sPartition *part,uint16_t *buf,const uintptr_t *phys,
+		uint offset,uint count) {
 	if(offset + count <= part->size * ataDev->secSize && offset + count > offset) {
 		if(buf != buffer || count <= MAX_RW_SIZE) {
 			size_t i;
@@ -219,11 +274,14 @@ static ulong handleWrite(sATADevice *ataDev,sPartition *part,uint16_t *buf,uint
 			for(i = 0; i < RETRY_COUNT; i++) {
 				if(i > 0)
 					ATA_LOG("Write failed; retry %zu",i);
-				if(ataDev->rwHandler(ataDev,OP_WRITE,buf,
+				/* the requests to all devices of a controller are served one after another */
+				usemdown(&ataDev->ctrl->lock);
+				bool res = ataDev->rwHandler(ataDev,OP_WRITE,buf,phys,
 						offset / ataDev->secSize + part->start,
-						ataDev->secSize,count / ataDev->secSize)) {
+						ataDev->secSize,count / ataDev->secSize);
+				usemup(&ataDev->ctrl->lock);
+				if(res)
 					return count;
-				}
 			}
 			ATA_LOG("Giving up after %zu retries",i);
 			return 0;
@@ -25,7 +25,8 @@
 #include "ata.h"
 #include "atapi.h"
 
-static bool atapi_request(sATADevice *device,uint8_t *cmd,void *buffer,size_t bufSize);
+static bool atapi_request(sATADevice *device,uint8_t *cmd,void *buffer,const uintptr_t *phys,
+		size_t bufSize);
 
 void atapi_softReset(sATADevice *device) {
 	int i = 1000000;
@@ -41,8 +42,8 @@ void atapi_softReset(sATADevice *device) {
 	ctrl_wait(device->ctrl);
 }
 
-bool atapi_read(sATADevice *device,uint op,void *buffer,uint64_t lba,A_UNUSED size_t secSize,
-		size_t secCount) {
+bool atapi_read(sATADevice *device,uint op,void *buffer,const uintptr_t *phys,uint64_t lba,
+		A_UNUSED size_t secSize,size_t secCount) {
 	uint8_t cmd[] = {SCSI_CMD_READ_SECTORS_EXT,0,0,0,0,0,0,0,0,0,0,0};
 	if(!device->info.features.lba48)
 		cmd[0] = SCSI_CMD_READ_SECTORS;
@@ -65,30 +66,31 @@ bool atapi_read(sATADevice *device,uint op,void *buffer,uint64_t lba,A_UNUSED si
 	cmd[3] = (lba >> 16) & 0xFF;
 	cmd[4] = (lba >> 8) & 0xFF;
 	cmd[5] = (lba >> 0) & 0xFF;
-	return atapi_request(device,cmd,buffer,secCount * device->secSize);
+	return atapi_request(device,cmd,buffer,phys,secCount * device->secSize);
 }
 
 size_t atapi_getCapacity(sATADevice *device) {
 	uint8_t resp[8];
 	uint8_t cmd[] = {SCSI_CMD_READ_CAPACITY,0,0,0,0,0,0,0,0,0,0,0};
-	bool res = atapi_request(device,cmd,resp,8);
+	bool res = atapi_request(device,cmd,resp,NULL,8);
 	if(!res)
 		return 0;
 	return (resp[0] << 24) | (resp[1] << 16) | (resp[2] << 8) | (resp[3] << 0);
 }
 
-static bool atapi_request(sATADevice *device,uint8_t *cmd,void *buffer,size_t bufSize) {
+static bool atapi_request(sATADevice *device,uint8_t *cmd,void *buffer,const uintptr_t *phys,
+		size_t bufSize) {
 	int res;
 	size_t size;
 	sATAController *ctrl = device->ctrl;
 
 	/* send PACKET command to drive */
-	if(!ata_readWrite(device,OP_PACKET,cmd,0xFFFF00,12,1))
+	if(!ata_readWrite(device,OP_PACKET,cmd,NULL,0xFFFF00,12,1))
 		return false;
 
 	/* now transfer the data */
 	if(ctrl->useDma && device->info.capabilities.DMA)
-		return ata_transferDMA(device,OP_READ,buffer,device->secSize,bufSize / device->secSize);
+		return ata_transferDMA(device,OP_READ,buffer,phys,device->secSize,bufSize / device->secSize);
 
 	/* ok, no DMA, so wait first until the drive is ready */
 	res = ctrl_waitUntil(ctrl,ATAPI_TRANSFER_TIMEOUT,ATAPI_TRANSFER_SLEEPTIME,
@@ -30,12 +30,14 @@ void atapi_softReset(sATADevice *device);
  * @param device the device
  * @param op the operation: just OP_READ here ;)
  * @param buffer the buffer to write to
+ * @param phys the physical addresses of the pages of <buffer> (optional; see ata_readWrite)
  * @param lba the block-address to start at
  * @param secSize the size of a sector
  * @param secCount number of sectors
  * @return true on success
  */
-bool atapi_read(sATADevice *device,uint op,void *buffer,uint64_t lba,size_t secSize,size_t secCount);
+bool atapi_read(sATADevice *device,uint op,void *buffer,const uintptr_t *phys,uint64_t lba,
+		size_t secSize,size_t secCount);
 
 /**
  * Determines the capacity for the given device
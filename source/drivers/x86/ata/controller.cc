@@ -43,8 +43,6 @@
 
 #define BMR_SEC_OFFSET				0x8
 
-#define DMA_BUF_SIZE				(64 * 1024)
-
 using namespace esc;
 
 static bool ctrl_isBusResponding(sATAController* ctrl);
@@ -99,6 +97,9 @@ void ctrl_init(bool useDma) {
 			continue;
 		}
 
+		if(usemcrt(&ctrls[i].lock,1) < 0)
+			error("Unable to create lock for controller %d",ctrls[i].id);
+
 		/* set interrupt-handler */
 		char irqname[32];
 		snprintf(irqname,sizeof(irqname),"ATA%zd",i);
@@ -112,7 +113,7 @@ void ctrl_init(bool useDma) {
 			ctrls[i].bmrBase += i * BMR_SEC_OFFSET;
 			/* allocate memory for PRDT and buffer */
 			ctrls[i].dma_prdt_virt = static_cast<sPRD*>(
-				mmapphys((uintptr_t*)&ctrls[i].dma_prdt_phys,8,4096,MAP_PHYS_ALLOC));
+				mmapphys((uintptr_t*)&ctrls[i].dma_prdt_phys,PRDT_SIZE,PRDT_SIZE,MAP_PHYS_ALLOC));
 			if(!ctrls[i].dma_prdt_virt)
 				error("Unable to allocate PRDT for controller %d",ctrls[i].id);
 			ctrls[i].dma_buf_virt = mmapphys((uintptr_t*)&ctrls[i].dma_buf_phys,
@@ -46,6 +46,12 @@
 
 #define CTRL_IRQ_BASE				14
 
+/* the bounce-buffer for transfers from/to memory we don't know the physical address of */
+#define DMA_BUF_SIZE				(64 * 1024)
+/* the PRDT for transfers from/to the client's memory; one entry per page at most */
+#define PRDT_SIZE					4096
+#define PRDT_ENTRIES				(PRDT_SIZE / sizeof(sPRD))
+
 /**
  * Inits the controllers
  *
@@ -59,7 +59,7 @@ void device_init(sATADevice *device) {
 		device->rwHandler = ata_readWrite;
 		ATA_LOG("Device %d is an ATA-device",device->id);
 		/* read the partition-table */
-		if(!ata_readWrite(device,OP_READ,buffer,0,device->secSize,1)) {
+		if(!ata_readWrite(device,OP_READ,buffer,NULL,0,device->secSize,1)) {
 			if(device->ctrl->useDma && device->info.capabilities.DMA) {
 				ATA_LOG("Device %d: Reading the partition table with DMA failed. Disabling DMA.",
 						device->id);
@@ -69,7 +69,7 @@ void device_init(sATADevice *device) {
 				ATA_LOG("Device %d: Reading the partition table with PIO failed. Retrying.",
 						device->id);
 			}
-			if(!ata_readWrite(device,OP_READ,buffer,0,device->secSize,1)) {
+			if(!ata_readWrite(device,OP_READ,buffer,NULL,0,device->secSize,1)) {
 				device->present = 0;
 				ATA_LOG("Device %d: Unable to read partition-table! Disabling device",device->id);
 				return;
@@ -21,14 +21,15 @@
 
 #include <sys/common.h>
 #include <sys/irq.h>
+#include <sys/sync.h>
 #include "partition.h"
 
 #define OP_READ						0
 #define OP_WRITE					1
 #define OP_PACKET					2
 
+/* we wait for the interrupt; afterwards, the device should be ready immediately */
 #define DMA_TRANSFER_TIMEOUT		3000
-#define DMA_TRANSFER_SLEEPTIME		20
 
 /* sleep for 20ms (just for writes; when reading we wait for an interrupt; the status should be ok
  * afterwards) */
@@ -274,8 +275,8 @@ typedef struct {
 
 typedef struct sATAController sATAController;
 typedef struct sATADevice sATADevice;
-typedef bool (*fReadWrite)(sATADevice *device,uint op,void *buffer,uint64_t lba,size_t secSize,
-		size_t secCount);
+typedef bool (*fReadWrite)(sATADevice *device,uint op,void *buffer,const uintptr_t *phys,
+		uint64_t lba,size_t secSize,size_t secCount);
 
 struct sATADevice {
 	/* the identifier; 0-3; bit0 set means slave */
@@ -316,6 +317,8 @@ struct sATAController {
 	uint16_t bmrBase;
 	int irq;
 	int irqsem;
+	/* the requests of all devices at this controller are served one after another */
+	tUserSem lock;
 	sPRD *dma_prdt_phys;
 	sPRD *dma_prdt_virt;
 	void *dma_buf_phys;
@@ -21,7 +21,9 @@
 #include <esc/proto/pci.h>
 #include <esc/proto/nic.h>
 #include <esc/ipc/nicdevice.h>
+#include <esc/cmdargs.h>
 #include <stdlib.h>
+#include <stdio.h>
 
 #include "e1000dev.h"
 
@@ -154,9 +156,34 @@ static IntelNIC nics[] = {
 	{0x8086,0x2e6e,"cemedia","CE Media Processor"},
 };
 
+static void usage(const char *name) {
+	fprintf(stderr,"Usage: %s [--rx <count>] [--tx <count>] [--itr <irqs/s>] <device>\n",name);
+	fprintf(stderr,"    --rx <count>:   use <count> receive descriptors (default %zu)\n",
+		E1000::DEF_RX_COUNT);
+	fprintf(stderr,"    --tx <count>:   use <count> transmit descriptors (default %zu)\n",
+		E1000::DEF_TX_COUNT);
+	fprintf(stderr,"    --itr <irqs/s>: limit the interrupts per second to %u..%u; 0 = no limit"
+		" (default %u)\n",E1000::MIN_ITR,E1000::MAX_ITR,E1000::DEF_ITR);
+	exit(EXIT_FAILURE);
+}
+
 int main(int argc,char **argv) {
-	if(argc != 2)
-		error("Usage: %s <device>\n",argv[0]);
+	uint rxCount = E1000::DEF_RX_COUNT;
+	uint txCount = E1000::DEF_TX_COUNT;
+	uint itr = E1000::DEF_ITR;
+	const char *path = NULL;
+
+	esc::cmdargs args(argc,argv,esc::cmdargs::MAX1_FREE);
+	try {
+		args.parse("rx=u tx=u itr=u",&rxCount,&txCount,&itr);
+		if(args.is_help() || args.get_free().size() != 1)
+			usage(argv[0]);
+		path = args.get_free().at(0)->c_str();
+	}
+	catch(const esc::cmdargs_error& e) {
+		fprintf(stderr,"Invalid arguments: %s\n",e.what());
+		usage(argv[0]);
+	}
 
 	esc::PCI pci("/dev/pci");
 
@@ -180,8 +207,8 @@ int main(int argc,char **argv) {
 		error("Unable to find an e1000");
 	}
 
-	E1000 *e1000 = new E1000(pci,nic);
-	esc::NICDevice dev(argv[1],0770,e1000);
+	E1000 *e1000 = new E1000(pci,nic,rxCount,txCount,itr);
+	esc::NICDevice dev(path,0770,e1000);
 	e1000->setHandler(std::make_memfun(&dev,&esc::NICDevice::checkPending));
 
 	esc::NIC::MAC mac = dev.mac();
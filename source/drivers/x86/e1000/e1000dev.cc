@@ -28,9 +28,22 @@
 #include "e1000dev.h"
 #include "eeprom.h"
 
-E1000::E1000(esc::PCI &pci,const esc::PCI::Device &nic)
-		: NICDriver(), _irq(nic.irq), _irqsem(), _curRxBuf(), _curTxBuf(), _bufs(),
-		  _bufsPhys(), _mmio(), _handler() {
+static void *allocContiguous(size_t size,uintptr_t *phys,const char *name) {
+	*phys = 0;
+	void *virt = mmapphys(phys,size,PAGE_SIZE,MAP_PHYS_ALLOC);
+	if(virt == NULL)
+		error("Unable to map %s of %zu bytes",name,size);
+	print("Mapped %s @ virt=%p phys=%p",name,virt,*phys);
+	return virt;
+}
+
+E1000::E1000(esc::PCI &pci,const esc::PCI::Device &nic,size_t rxCount,size_t txCount,uint itr)
+		: NICDriver(), _irq(nic.irq), _irqsem(),
+		  _rxCount(MIN(MAX_DESC_COUNT,MAX(8,ROUND_UP(rxCount,8)))),
+		  _txCount(MIN(MAX_DESC_COUNT,MAX(8,ROUND_UP(txCount,8)))),
+		  _itr(itr ? MIN(MAX_ITR,MAX(MIN_ITR,itr)) : 0),
+		  _curRxBuf(), _curTxBuf(), _cleanTxBuf(), _rxDescs(), _txDescs(), _rxBufs(), _txBufs(),
+		  _descsPhys(), _rxBufsPhys(), _txBufsPhys(), _mmio(), _handler() {
 	if(_irqsem < 0)
 		error("Unable to create irq-semaphore");
 
@@ -46,17 +59,16 @@ E1000::E1000(esc::PCI &pci,const esc::PCI::Device &nic)
 		}
 	}
 
-	// create buffers in contiguous physical memory
-	uintptr_t phys = 0;
-	_bufs = reinterpret_cast<Buffers*>(mmapphys(&phys,sizeof(Buffers),PAGE_SIZE,MAP_PHYS_ALLOC));
-	if(_bufs == NULL)
-		error("Unable to map buffer space of %zu bytes",sizeof(Buffers));
-	print("Mapped buffer space @ virt=%p phys=%p",_bufs,phys);
-	_bufsPhys = reinterpret_cast<Buffers*>(phys);
+	// create rings and buffers in contiguous physical memory
+	size_t descSize = _rxCount * sizeof(RxDesc) + _txCount * sizeof(TxDesc);
+	_rxDescs = reinterpret_cast<RxDesc*>(allocContiguous(descSize,&_descsPhys,"descriptors"));
+	_txDescs = reinterpret_cast<TxDesc*>(_rxDescs + _rxCount);
+	_rxBufs = reinterpret_cast<uint8_t*>(allocContiguous(_rxCount * RX_BUF_SIZE,&_rxBufsPhys,"RX buffers"));
+	_txBufs = reinterpret_cast<uint8_t*>(allocContiguous(_txCount * TX_BUF_SIZE,&_txBufsPhys,"TX buffers"));
+	DBG1("Using %zu RX and %zu TX descriptors, at most %u interrupts/s",_rxCount,_txCount,_itr);
 
 	// clear descriptors
-	memset(_bufs->rxDescs,0,sizeof(_bufs->rxDescs));
-	memset(_bufs->txDescs,0,sizeof(_bufs->txDescs));
+	memset(_rxDescs,0,descSize);
 
 	// reset card
 	reset();
@@ -168,26 +180,29 @@ void E1000::reset() {
 
 	// init receive ring
 	writeReg(REG_RDBAH,0);
-	writeReg(REG_RDBAL,reinterpret_cast<uintptr_t>(_bufsPhys->rxDescs + 0));
-	writeReg(REG_RDLEN,RX_BUF_COUNT * sizeof(RxDesc));
+	writeReg(REG_RDBAL,_descsPhys);
+	writeReg(REG_RDLEN,_rxCount * sizeof(RxDesc));
 	writeReg(REG_RDH,0);
-	writeReg(REG_RDT,RX_BUF_COUNT - 1);
+	writeReg(REG_RDT,_rxCount - 1);
 	writeReg(REG_RDTR,0);
 	writeReg(REG_RADV,0);
 
 	// init transmit ring
 	writeReg(REG_TDBAH,0);
-	writeReg(REG_TDBAL,reinterpret_cast<uintptr_t>(_bufsPhys->txDescs + 0));
-	writeReg(REG_TDLEN,TX_BUF_COUNT * sizeof(TxDesc));
+	writeReg(REG_TDBAL,_descsPhys + _rxCount * sizeof(RxDesc));
+	writeReg(REG_TDLEN,_txCount * sizeof(TxDesc));
 	writeReg(REG_TDH,0);
 	writeReg(REG_TDT,0);
 	writeReg(REG_TIDV,0);
 	writeReg(REG_TADV,0);
 
+	// moderate interrupts; the interval is specified in units of 256ns
+	writeReg(REG_ITR,_itr ? 1000000000 / (_itr * 256) : 0);
+
 	// setup rx descriptors
-	for(size_t i = 0; i < RX_BUF_COUNT; i++) {
-		_bufs->rxDescs[i].length = RX_BUF_SIZE;
-		_bufs->rxDescs[i].buffer = reinterpret_cast<uint64_t>(_bufsPhys->rxBuf + i * RX_BUF_SIZE);
+	for(size_t i = 0; i < _rxCount; i++) {
+		_rxDescs[i].length = RX_BUF_SIZE;
+		_rxDescs[i].buffer = _rxBufsPhys + i * RX_BUF_SIZE;
 	}
 
 	// enable rings
@@ -217,38 +232,51 @@ ssize_t E1000::send(const void *packet,size_t size) {
 	assert(size <= mtu());
 	// to next tx descriptor
 	uint32_t cur = _curTxBuf;
-	_curTxBuf = (_curTxBuf + 1) % TX_BUF_COUNT;
-
-	// is there enough space?
-	uint32_t head = readReg(REG_TDH);
-	if(_curTxBuf == head) {
-		// TODO handle that case
-		DBG1("No free buffers");
-		return -EBUSY;
+	uint32_t next = (_curTxBuf + 1) % _txCount;
+
+	// is there enough space? if not, reclaim all descriptors the HW is done with
+	if(next == _cleanTxBuf) {
+		reclaim();
+		if(next == _cleanTxBuf) {
+			DBG1("No free buffers");
+			return -EBUSY;
+		}
 	}
+	_curTxBuf = next;
 
 	// copy to buffer
-	memcpy(_bufs->txBuf + cur * TX_BUF_SIZE,packet,size);
+	memcpy(_txBufs + cur * TX_BUF_SIZE,packet,size);
 
-	uint8_t *phys = _bufsPhys->txBuf + cur * TX_BUF_SIZE;
+	uintptr_t phys = _txBufsPhys + cur * TX_BUF_SIZE;
 	DBG2("TX %u: %p..%p",cur,phys,phys + size);
 
 	// setup descriptor
-	_bufs->txDescs[cur].cmd = TX_CMD_EOP | TX_CMD_IFCS;
-	_bufs->txDescs[cur].length = size;
-	_bufs->txDescs[cur].buffer = reinterpret_cast<uint64_t>(phys);
-	_bufs->txDescs[cur].status = 0;
+	_txDescs[cur].cmd = TX_CMD_EOP | TX_CMD_IFCS | TX_CMD_RS;
+	_txDescs[cur].length = size;
+	_txDescs[cur].buffer = phys;
+	_txDescs[cur].status = 0;
 	asm volatile ("" : : : "memory");
 
 	writeReg(REG_TDT,_curTxBuf);
 	return size;
 }
 
-void E1000::receive() {
-	uint32_t head = readReg(REG_RDH);
-	while(_curRxBuf != head) {
-		RxDesc *desc = _bufs->rxDescs + _curRxBuf;
+void E1000::reclaim() {
+	// the HW processes the descriptors in order and reports their status in memory, so that we
+	// don't need to read TDH
+	while(_cleanTxBuf != _curTxBuf) {
+		volatile TxDesc *desc = _txDescs + _cleanTxBuf;
+		if(~desc->status & TDS_DONE)
+			break;
+		_cleanTxBuf = (_cleanTxBuf + 1) % _txCount;
+	}
+}
 
+void E1000::receive() {
+	// harvest all packets the HW has finished, without asking it for the head
+	size_t count;
+	for(count = 0; count < _rxCount; ++count) {
+		volatile RxDesc *desc = _rxDescs + _curRxBuf;
 		if(~desc->status & RDS_DONE)
 			break;
 
@@ -263,21 +291,24 @@ void E1000::receive() {
 			break;
 		}
 		pkt->length = size;
-		memcpy(pkt->data,_bufs->rxBuf + _curRxBuf * RX_BUF_SIZE,size);
+		memcpy(pkt->data,_rxBufs + _curRxBuf * RX_BUF_SIZE,size);
 
 		// insert into list
 		insert(pkt);
-		(*_handler)();
 
-		// to next packet
-		_curRxBuf = (_curRxBuf + 1) % RX_BUF_COUNT;
+		// to next packet; the descriptor can be used again
+		desc->status = 0;
+		_curRxBuf = (_curRxBuf + 1) % _rxCount;
 	}
 
-	// set new tail
-	if(_curRxBuf == head)
-		writeReg(REG_RDT,(head + RX_BUF_COUNT - 1) % RX_BUF_COUNT);
-	else
-		writeReg(REG_RDT,_curRxBuf);
+	if(count > 0) {
+		// give all descriptors we're done with back to the HW at once
+		asm volatile ("" : : : "memory");
+		writeReg(REG_RDT,(_curRxBuf + _rxCount - 1) % _rxCount);
+
+		// and notify the clients once for the whole batch
+		(*_handler)();
+	}
 }
 
 int E1000::irqThread(void *ptr) {
@@ -288,6 +319,10 @@ int E1000::irqThread(void *ptr) {
 		// bits 31:17 are reserved
 		uint32_t icr = e1000->readReg(REG_ICR) & 0x1FFFF;
 
+		// nothing to do if the last batch has already handled it
+		if(icr == 0)
+			continue;
+
 		// packet received
 		if(icr & (ICR_RXT0 | ICR_RXO))
 			e1000->receive();
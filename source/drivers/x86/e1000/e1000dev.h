@@ -53,6 +53,7 @@ class E1000 : public esc::NICDriver {
 		REG_VET				= 0x38,			/* VLAN ether type */
 
 		REG_ICR				= 0xc0,			/* interrupt cause read register */
+		REG_ITR				= 0xc4,			/* interrupt throttling register */
 		REG_IMS				= 0xd0,			/* interrupt mask set/read register */
 		REG_IMC				= 0xd8,			/* interrupt mask clear register */
 
@@ -152,6 +153,12 @@ class E1000 : public esc::NICDriver {
 	enum {
 		TX_CMD_EOP			= 0x01,			/* end of packet */
 		TX_CMD_IFCS			= 0x02,			/* insert FCS/CRC */
+		TX_CMD_RS			= 0x08,			/* report status */
+	};
+
+	enum {
+		TDS_DONE			= 1 << 0,		/* transmit descriptor status; indicates that the HW has
+											 * finished the descriptor (if TX_CMD_RS was set) */
 	};
 
 	enum {
@@ -159,8 +166,6 @@ class E1000 : public esc::NICDriver {
 											 * finished the descriptor */
 	};
 
-	static const size_t RX_BUF_COUNT	= 8;
-	static const size_t TX_BUF_COUNT	= 8;
 	static const size_t RX_BUF_SIZE		= 2048;
 	static const size_t TX_BUF_SIZE		= 2048;
 
@@ -183,15 +188,19 @@ class E1000 : public esc::NICDriver {
 		uint16_t : 16;
 	} A_PACKED A_ALIGNED(4);
 
-	struct Buffers {
-		RxDesc rxDescs[RX_BUF_COUNT] A_ALIGNED(16);
-		TxDesc txDescs[TX_BUF_COUNT] A_ALIGNED(16);
-		uint8_t rxBuf[RX_BUF_COUNT * RX_BUF_SIZE];
-		uint8_t txBuf[TX_BUF_COUNT * TX_BUF_SIZE];
-	};
-
 public:
-	explicit E1000(esc::PCI &pci,const esc::PCI::Device &nic);
+	/* the ring sizes have to be a multiple of 8 (the length needs to be 128-byte aligned) */
+	static const size_t DEF_RX_COUNT	= 256;
+	static const size_t DEF_TX_COUNT	= 256;
+	static const size_t MAX_DESC_COUNT	= 4096;
+	/* the maximum number of interrupts per second (0 = unlimited) */
+	static const uint DEF_ITR			= 8000;
+	/* the limits that the 16-bit interval (in units of 256ns) can express */
+	static const uint MIN_ITR			= 1000000000 / (256 * 0xFFFF) + 1;
+	static const uint MAX_ITR			= 1000000000 / 256;
+
+	explicit E1000(esc::PCI &pci,const esc::PCI::Device &nic,size_t rxCount = DEF_RX_COUNT,
+		size_t txCount = DEF_TX_COUNT,uint itr = DEF_ITR);
 
 	void setHandler(std::Functor<void> *handler) {
 		_handler = handler;
@@ -211,6 +220,7 @@ private:
 	void readEEPROM(uint8_t *dest,size_t len);
 	esc::NIC::MAC readMAC();
 	void receive();
+	void reclaim();
 
 	void writeReg(uint16_t reg,uint32_t value) {
 		DBG2("REG[%#04x] <- %#08x",reg,value);
@@ -226,10 +236,19 @@ private:
 
 	int _irq;
 	int _irqsem;
+	size_t _rxCount;
+	size_t _txCount;
+	uint _itr;
 	uint32_t _curRxBuf;
 	uint32_t _curTxBuf;
-	Buffers *_bufs;
-	Buffers *_bufsPhys;
+	uint32_t _cleanTxBuf;
+	RxDesc *_rxDescs;
+	TxDesc *_txDescs;
+	uint8_t *_rxBufs;
+	uint8_t *_txBufs;
+	uintptr_t _descsPhys;
+	uintptr_t _rxBufsPhys;
+	uintptr_t _txBufsPhys;
 	volatile uint32_t *_mmio;
 	esc::NIC::MAC _mac;
 	std::Functor<void> *_handler;
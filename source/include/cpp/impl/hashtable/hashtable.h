@@ -0,0 +1,479 @@
+/**
+ * $Id$
+ * Copyright (C) 2008 - 2014 Nils Asmussen
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#pragma once
+
+#include <bits/c++config.h>
+#include <stddef.h>
+#include <iterator>
+#include <algorithm>
+#include <functional>
+#include <utility>
+#include <limits>
+
+#include <impl/hashtable/hashtablenode.h>
+#include <impl/hashtable/hashtableiterator.h>
+
+namespace std {
+	/**
+	 * Extracts the key from the values of unordered_map
+	 */
+	template<class Key,class Val>
+	struct hashtable_key_of_pair {
+		const Key& operator()(const Val& v) const {
+			return v.first;
+		}
+	};
+	/**
+	 * Extracts the key from the values of unordered_set
+	 */
+	template<class Key>
+	struct hashtable_key_identity {
+		const Key& operator()(const Key& v) const {
+			return v;
+		}
+	};
+
+	/**
+	 * A hash table with separate chaining, which is used for the implementation of unordered_map
+	 * and unordered_set. Each value has to have a unique key, which is determined by KeyOf.
+	 * The number of buckets is always a power of 2 and the table grows as soon as the load
+	 * factor would exceed max_load_factor(). Since hash<T> returns integers unchanged, the bucket
+	 * is chosen by multiplicative (Fibonacci) hashing instead of just masking the lower bits.
+	 * Otherwise, keys with a common stride, e.g. pointers, would end up in a few buckets.
+	 */
+	template<class Key,class Val,class KeyOf,class Hash = hash<Key>,class Eq = equal_to<Key> >
+	class hashtable {
+		friend class hashtable_iterator<Val,hashtable>;
+		friend class const_hashtable_iterator<Val,hashtable>;
+
+		static const size_t MIN_BUCKET_BITS = 3;
+
+	public:
+		typedef Key key_type;
+		typedef Val value_type;
+		typedef Hash hasher;
+		typedef Eq key_equal;
+		typedef Val& reference;
+		typedef const Val& const_reference;
+		typedef Val* pointer;
+		typedef const Val* const_pointer;
+		typedef hashtable_iterator<Val,hashtable> iterator;
+		typedef const_hashtable_iterator<Val,hashtable> const_iterator;
+		typedef size_t size_type;
+		typedef long difference_type;
+
+		/**
+		 * Creates an empty hash table with at least <n> buckets
+		 *
+		 * @param n the minimum number of buckets
+		 * @param hf the hash-function
+		 * @param eql the key-equality-predicate
+		 */
+		explicit hashtable(size_type n = 0,const Hash& hf = Hash(),const Eq& eql = Eq())
+			: _hash(hf), _eq(eql), _keyOf(), _elCount(0), _bucketBits(0), _buckets(nullptr),
+			  _maxLoad(1.0f) {
+			alloc_buckets(bits_for(n));
+		}
+		/**
+		 * Copy-constructor
+		 */
+		hashtable(const hashtable& c)
+			: _hash(c._hash), _eq(c._eq), _keyOf(), _elCount(0), _bucketBits(0), _buckets(nullptr),
+			  _maxLoad(c._maxLoad) {
+			alloc_buckets(c._bucketBits);
+			copy_from(c);
+		}
+		/**
+		 * Assignment-operator
+		 */
+		hashtable& operator =(const hashtable& c) {
+			if(this != &c) {
+				clear();
+				_hash = c._hash;
+				_eq = c._eq;
+				_maxLoad = c._maxLoad;
+				if(_bucketBits < c._bucketBits) {
+					delete[] _buckets;
+					alloc_buckets(c._bucketBits);
+				}
+				copy_from(c);
+			}
+			return *this;
+		}
+		/**
+		 * Destructor
+		 */
+		~hashtable() {
+			clear();
+			delete[] _buckets;
+		}
+
+		/**
+		 * @return the beginning of the table
+		 */
+		iterator begin() {
+			return iterator(first_node(0),this);
+		}
+		/**
+		 * @return the beginning of the table, as const-iterator
+		 */
+		const_iterator begin() const {
+			return const_iterator(first_node(0),this);
+		}
+		/**
+		 * @return the end of the table
+		 */
+		iterator end() {
+			return iterator(nullptr,this);
+		}
+		/**
+		 * @return the end of the table, as const-iterator
+		 */
+		const_iterator end() const {
+			return const_iterator(nullptr,this);
+		}
+
+		/**
+		 * @return true if the table is empty
+		 */
+		bool empty() const {
+			return _elCount == 0;
+		}
+		/**
+		 * @return the number of elements in the table
+		 */
+		size_type size() const {
+			return _elCount;
+		}
+		/**
+		 * @return the max number of elements supported
+		 */
+		size_type max_size() const {
+			return numeric_limits<size_type>::max() / sizeof(hashtable_node<Val>);
+		}
+
+		/**
+		 * @return the number of buckets
+		 */
+		size_type bucket_count() const {
+			return static_cast<size_type>(1) << _bucketBits;
+		}
+		/**
+		 * @param n the bucket number
+		 * @return the number of elements in bucket <n>
+		 */
+		size_type bucket_size(size_type n) const {
+			size_type count = 0;
+			for(hashtable_node<Val>* node = _buckets[n]; node; node = node->next())
+				count++;
+			return count;
+		}
+		/**
+		 * @param k the key
+		 * @return the bucket number in which the key <k> is (or would be) stored
+		 */
+		size_type bucket(const Key& k) const {
+			return index(_hash(k));
+		}
+		/**
+		 * @return the average number of elements per bucket
+		 */
+		float load_factor() const {
+			return static_cast<float>(_elCount) / bucket_count();
+		}
+		/**
+		 * @return the load factor at which the table grows
+		 */
+		float max_load_factor() const {
+			return _maxLoad;
+		}
+		/**
+		 * Sets the load factor at which the table grows. Rehashes the table if necessary.
+		 *
+		 * @param z the new max load factor
+		 */
+		void max_load_factor(float z) {
+			if(z > 0) {
+				_maxLoad = z;
+				reserve(_elCount);
+			}
+		}
+		/**
+		 * Changes the number of buckets to at least <n> and rehashes the elements. The table
+		 * never shrinks below what is required for the current size and max_load_factor().
+		 *
+		 * @param n the minimum number of buckets
+		 */
+		void rehash(size_type n) {
+			size_type min = static_cast<size_type>(_elCount / _maxLoad);
+			size_t bits = bits_for(n > min ? n : min);
+			if(bits != _bucketBits)
+				do_rehash(bits);
+		}
+		/**
+		 * Makes room for <n> elements without growing the table again
+		 *
+		 * @param n the number of elements
+		 */
+		void reserve(size_type n) {
+			rehash(static_cast<size_type>(n / _maxLoad + 1));
+		}
+
+		/**
+		 * @return the hash-function
+		 */
+		hasher hash_function() const {
+			return _hash;
+		}
+		/**
+		 * @return the key-equality-predicate
+		 */
+		key_equal key_eq() const {
+			return _eq;
+		}
+
+		/**
+		 * Inserts <v>, if there is no element with the same key yet
+		 *
+		 * @param v the value
+		 * @return the position of the element with that key and whether <v> has been inserted
+		 */
+		pair<iterator,bool> insert(const Val& v) {
+			const Key& k = _keyOf(v);
+			size_t h = _hash(k);
+			hashtable_node<Val>* node = find_node(k,h);
+			if(node)
+				return make_pair(iterator(node,this),false);
+
+			if(_elCount + 1 > _maxLoad * bucket_count())
+				do_rehash(_bucketBits + 1);
+			size_type i = index(h);
+			node = new hashtable_node<Val>(v,h,_buckets[i]);
+			_buckets[i] = node;
+			_elCount++;
+			return make_pair(iterator(node,this),true);
+		}
+
+		/**
+		 * Searches for the given key
+		 *
+		 * @param k the key to find
+		 * @return the iterator at the position of the found key; end() if not found
+		 */
+		iterator find(const Key& k) {
+			return iterator(find_node(k,_hash(k)),this);
+		}
+		const_iterator find(const Key& k) const {
+			return const_iterator(find_node(k,_hash(k)),this);
+		}
+		/**
+		 * @param k the key
+		 * @return 1 if the key exists, 0 otherwise
+		 */
+		size_type count(const Key& k) const {
+			return find_node(k,_hash(k)) ? 1 : 0;
+		}
+
+		/**
+		 * Removes the element at given position
+		 *
+		 * @param it the position
+		 * @return the position of the element behind it
+		 */
+		iterator erase(const_iterator it) {
+			hashtable_node<Val>* node = const_cast<hashtable_node<Val>*>(it.node());
+			hashtable_node<Val>* next = next_node(node);
+			unlink(node);
+			return iterator(next,this);
+		}
+		/**
+		 * Removes the element with key <k>
+		 *
+		 * @param k the key
+		 * @return the number of removed elements (0 or 1)
+		 */
+		size_type erase(const Key& k) {
+			hashtable_node<Val>* node = find_node(k,_hash(k));
+			if(node) {
+				unlink(node);
+				return 1;
+			}
+			return 0;
+		}
+		/**
+		 * Removes the range [<first> .. <last>)
+		 *
+		 * @param first the beginning of the range (inclusive)
+		 * @param last the end of the range (exclusive)
+		 * @return <last>
+		 */
+		iterator erase(const_iterator first,const_iterator last) {
+			while(first != last)
+				first = erase(first);
+			return iterator(const_cast<hashtable_node<Val>*>(last.node()),this);
+		}
+		/**
+		 * Removes all elements. The number of buckets stays the same.
+		 */
+		void clear() {
+			for(size_type i = 0; i < bucket_count(); ++i) {
+				hashtable_node<Val>* node = _buckets[i];
+				while(node) {
+					hashtable_node<Val>* next = node->next();
+					delete node;
+					node = next;
+				}
+				_buckets[i] = nullptr;
+			}
+			_elCount = 0;
+		}
+		/**
+		 * Swaps *this with <t>
+		 *
+		 * @param t the other table
+		 */
+		void swap(hashtable& t) {
+			std::swap(_hash,t._hash);
+			std::swap(_eq,t._eq);
+			std::swap(_elCount,t._elCount);
+			std::swap(_bucketBits,t._bucketBits);
+			std::swap(_buckets,t._buckets);
+			std::swap(_maxLoad,t._maxLoad);
+		}
+
+	private:
+		/**
+		 * @param h the hash value
+		 * @return the bucket for <h>
+		 */
+		size_type index(size_t h) const {
+			const size_t mul = sizeof(size_t) == 8 ? static_cast<size_t>(0x9E3779B97F4A7C15ULL)
+			                                       : static_cast<size_t>(0x9E3779B9UL);
+			return (h * mul) >> (sizeof(size_t) * 8 - _bucketBits);
+		}
+		/**
+		 * @param n the number of buckets
+		 * @return the number of bits for at least <n> buckets
+		 */
+		static size_t bits_for(size_type n) {
+			size_t bits = MIN_BUCKET_BITS;
+			while((static_cast<size_type>(1) << bits) < n && bits < sizeof(size_t) * 8 - 1)
+				bits++;
+			return bits;
+		}
+		/**
+		 * Allocates an empty bucket-array with 2^<bits> buckets
+		 */
+		void alloc_buckets(size_t bits) {
+			_bucketBits = bits;
+			_buckets = new hashtable_node<Val>*[bucket_count()]();
+		}
+		/**
+		 * Moves all nodes into a new bucket-array with 2^<bits> buckets. Since the nodes store
+		 * their hash, no element has to be hashed again.
+		 */
+		void do_rehash(size_t bits) {
+			hashtable_node<Val>** old = _buckets;
+			size_type oldCount = bucket_count();
+			alloc_buckets(bits);
+			for(size_type i = 0; i < oldCount; ++i) {
+				hashtable_node<Val>* node = old[i];
+				while(node) {
+					hashtable_node<Val>* next = node->next();
+					size_type j = index(node->hash());
+					node->next(_buckets[j]);
+					_buckets[j] = node;
+					node = next;
+				}
+			}
+			delete[] old;
+		}
+		/**
+		 * Inserts all elements of <c> into this table, which has to be empty and large enough
+		 */
+		void copy_from(const hashtable& c) {
+			for(size_type i = 0; i < c.bucket_count(); ++i) {
+				for(hashtable_node<Val>* node = c._buckets[i]; node; node = node->next()) {
+					size_type j = index(node->hash());
+					_buckets[j] = new hashtable_node<Val>(node->data(),node->hash(),_buckets[j]);
+				}
+			}
+			_elCount = c._elCount;
+		}
+		/**
+		 * @param k the key
+		 * @param h the hash of <k>
+		 * @return the node with key <k> or nullptr
+		 */
+		hashtable_node<Val>* find_node(const Key& k,size_t h) const {
+			for(hashtable_node<Val>* node = _buckets[index(h)]; node; node = node->next()) {
+				if(node->hash() == h && _eq(_keyOf(node->data()),k))
+					return node;
+			}
+			return nullptr;
+		}
+		/**
+		 * @param i the bucket to start at
+		 * @return the first node in the buckets i, i+1, ... or nullptr
+		 */
+		hashtable_node<Val>* first_node(size_type i) const {
+			for(; i < bucket_count(); ++i) {
+				if(_buckets[i])
+					return _buckets[i];
+			}
+			return nullptr;
+		}
+		/**
+		 * @param node the node
+		 * @return the node behind <node> in iteration order or nullptr
+		 */
+		hashtable_node<Val>* next_node(hashtable_node<Val>* node) const {
+			if(node->next())
+				return node->next();
+			return first_node(index(node->hash()) + 1);
+		}
+		/**
+		 * Removes <node> from its bucket and deletes it
+		 */
+		void unlink(hashtable_node<Val>* node) {
+			size_type i = index(node->hash());
+			if(_buckets[i] == node)
+				_buckets[i] = node->next();
+			else {
+				hashtable_node<Val>* prev = _buckets[i];
+				while(prev->next() != node)
+					prev = prev->next();
+				prev->next(node->next());
+			}
+			delete node;
+			_elCount--;
+		}
+
+	private:
+		Hash _hash;
+		Eq _eq;
+		KeyOf _keyOf;
+		size_type _elCount;
+		size_t _bucketBits;
+		hashtable_node<Val>** _buckets;
+		float _maxLoad;
+	};
+}
@@ -0,0 +1,124 @@
+/**
+ * $Id$
+ * Copyright (C) 2008 - 2014 Nils Asmussen
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#pragma once
+
+#include <impl/hashtable/hashtablenode.h>
+#include <iterator>
+
+namespace std {
+	template<class Val,class Table>
+	class const_hashtable_iterator;
+
+	template<class Val,class Table>
+	class hashtable_iterator : public iterator<forward_iterator_tag,Val> {
+		friend class const_hashtable_iterator<Val,Table>;
+		friend Table;
+	public:
+		hashtable_iterator()
+			: _node(nullptr), _table(nullptr) {
+		}
+		hashtable_iterator(hashtable_node<Val> *n,const Table *t)
+			: _node(n), _table(t) {
+		}
+		~hashtable_iterator() {
+		}
+
+		Val& operator *() const {
+			return _node->data();
+		}
+		Val* operator ->() const {
+			return &(operator*());
+		}
+		hashtable_iterator& operator ++() {
+			_node = _table->next_node(_node);
+			return *this;
+		}
+		hashtable_iterator operator ++(int) {
+			hashtable_iterator<Val,Table> tmp(*this);
+			operator++();
+			return tmp;
+		}
+		bool operator ==(const hashtable_iterator<Val,Table>& rhs) const {
+			return _node == rhs._node;
+		}
+		bool operator !=(const hashtable_iterator<Val,Table>& rhs) const {
+			return _node != rhs._node;
+		}
+
+	private:
+		hashtable_node<Val>* node() const {
+			return _node;
+		}
+
+	private:
+		hashtable_node<Val>* _node;
+		const Table* _table;
+	};
+
+	// === const-iterator ===
+	template<class Val,class Table>
+	class const_hashtable_iterator : public iterator<forward_iterator_tag,Val> {
+		friend Table;
+	public:
+		const_hashtable_iterator()
+			: _node(nullptr), _table(nullptr) {
+		}
+		const_hashtable_iterator(const hashtable_node<Val> *n,const Table *t)
+			: _node(n), _table(t) {
+		}
+		const_hashtable_iterator(const hashtable_iterator<Val,Table>& it)
+			: _node(it._node), _table(it._table) {
+		}
+		~const_hashtable_iterator() {
+		}
+
+		const Val& operator *() const {
+			return _node->data();
+		}
+		const Val* operator ->() const {
+			return &(operator*());
+		}
+		const_hashtable_iterator& operator ++() {
+			_node = _table->next_node(const_cast<hashtable_node<Val>*>(_node));
+			return *this;
+		}
+		const_hashtable_iterator operator ++(int) {
+			const_hashtable_iterator<Val,Table> tmp(*this);
+			operator++();
+			return tmp;
+		}
+		bool operator ==(const const_hashtable_iterator<Val,Table>& rhs) const {
+			return _node == rhs._node;
+		}
+		bool operator !=(const const_hashtable_iterator<Val,Table>& rhs) const {
+			return _node != rhs._node;
+		}
+
+	private:
+		const hashtable_node<Val>* node() const {
+			return _node;
+		}
+
+	private:
+		const hashtable_node<Val>* _node;
+		const Table* _table;
+	};
+}
@@ -0,0 +1,62 @@
+/**
+ * $Id$
+ * Copyright (C) 2008 - 2014 Nils Asmussen
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#pragma once
+
+#include <stddef.h>
+
+namespace std {
+	template<class Val>
+	class hashtable_node {
+	public:
+		hashtable_node(const Val& v,size_t h,hashtable_node* n)
+			: _next(n), _hash(h), _data(v) {
+		}
+		~hashtable_node() {
+		}
+
+		hashtable_node* next() const {
+			return _next;
+		}
+		void next(hashtable_node* n) {
+			_next = n;
+		}
+
+		size_t hash() const {
+			return _hash;
+		}
+
+		Val& data() {
+			return _data;
+		}
+		const Val& data() const {
+			return _data;
+		}
+
+	private:
+		// not copyable
+		hashtable_node(const hashtable_node&);
+		hashtable_node& operator =(const hashtable_node&);
+
+		hashtable_node* _next;
+		size_t _hash;
+		Val _data;
+	};
+}
@@ -30,7 +30,8 @@
 #include <impl/map/bintreenode.h>
 #include <impl/map/bintreeiterator.h>
 
-// Note: algorithms are based on http://en.wikipedia.org/wiki/Binary_search_tree
+// Note: algorithms are based on http://en.wikipedia.org/wiki/Red%E2%80%93black_tree and
+// "Introduction to Algorithms" (Cormen et al.), chapter 13
 
 namespace std {
 	template<class Key,class T,class Cmp>
@@ -41,8 +42,14 @@ namespace std {
 	class const_bintree_iterator;
 
 	/**
-	 * A binary search tree with sorted keys (defined by the compare-object). This is used for
-	 * the map-implementation.
+	 * A red-black tree with sorted keys (defined by the compare-object). This is used for
+	 * the map-implementation. The tree is kept balanced, so that insert, find and erase take
+	 * O(log n), regardless of the order in which the keys are inserted. Additionally, all nodes
+	 * are linked in ascending order, which makes iteration cheap. Erasing a node does not
+	 * invalidate iterators to other nodes.
+	 *
+	 * _head and _foot are sentinels of that list. The root is the right child of _head, which is
+	 * always black.
 	 */
 	template<class Key,class T,class Cmp = less<Key> >
 	class bintree {
@@ -98,7 +105,7 @@ namespace std {
 			_head.next(&_foot);
 			_foot.prev(&_head);
 			for(const_iterator it = c.begin(); it != c.end(); ++it)
-				insert(it->first,it->second);
+				insert(end(),it->first,it->second);
 		}
 		/**
 		 * Assignment-operator
@@ -107,7 +114,7 @@ namespace std {
 			clear();
 			_cmp = c._cmp;
 			for(const_iterator it = c.begin(); it != c.end(); ++it)
-				insert(it->first,it->second);
+				insert(end(),it->first,it->second);
 			return *this;
 		}
 		/**
@@ -210,15 +217,16 @@ namespace std {
 		 * @return a iterator, pointing to the inserted element
 		 */
 		iterator insert(const Key& k,const T& v,bool replace = true) {
-			return do_insert(_head.right(),k,v,replace);
+			return do_insert(k,v,replace);
 		}
 		iterator insert(const pair<Key,T>& p,bool replace = true) {
 			return insert(p.first,p.second,replace);
 		}
 		/**
 		 * Inserts the key <k> with value <v> into the tree and gives the insert-algorithm a hint
-		 * with <pos>. I.e. it tries to start at this node, if possible, which can speed up
-		 * the insert a lot.
+		 * with <pos>. If <k> belongs directly before <pos>, the node is attached there without
+		 * searching the tree. Thus, inserting sorted keys with end() as hint takes amortized
+		 * constant time (plus the rebalancing). Otherwise, the hint is ignored.
 		 *
 		 * @param pos the position where to start
 		 * @param k the key
@@ -228,15 +236,17 @@ namespace std {
 		 */
 		iterator insert(iterator pos,const Key& k,const T& v,bool replace = true) {
 			bintree_node<Key,T,Cmp>* node = pos.node();
-			// head and foot are not allowed
-			if(node == &_head || node == &_foot)
-				node = _head.right();
-			else {
-				// while the parent is less than k, move upwards
-				while(node->parent() && _cmp(k,node->parent()->key()))
-					node = node->parent();
+			bintree_node<Key,T,Cmp>* before = node->prev();
+			// does k belong between the predecessor of pos and pos?
+			if(node != &_head && (before == &_head || _cmp(before->key(),k)) &&
+					(node == &_foot || _cmp(k,node->key()))) {
+				// in this case, either node has no left child or its predecessor has no right child
+				if(node != &_foot && !node->left())
+					return attach(node,true,k,v);
+				if(before != &_head)
+					return attach(before,false,k,v);
 			}
-			return do_insert(node,k,v,replace);
+			return do_insert(k,v,replace);
 		}
 
 		/**
@@ -272,18 +282,16 @@ namespace std {
 		 */
 		iterator lower_bound(const key_type &x) {
 			bintree_node<Key,T,Cmp>* node = _head.right();
+			bintree_node<Key,T,Cmp>* res = &_foot;
 			while(node != nullptr) {
-				if(_cmp(x,node->key())) {
-					if(!node->left() || !_cmp(x,node->left()->key()))
-						return iterator(node);
+				if(!_cmp(node->key(),x)) {
+					res = node;
 					node = node->left();
 				}
-				else if(x == node->key())
-					return iterator(node);
 				else
 					node = node->right();
 			}
-			return end();
+			return iterator(res);
 		}
 		const_iterator lower_bound(const key_type &x) const {
 			iterator it = lower_bound(x);
@@ -297,18 +305,16 @@ namespace std {
 		 */
 		iterator upper_bound(const key_type &x) {
 			bintree_node<Key,T,Cmp>* node = _head.right();
+			bintree_node<Key,T,Cmp>* res = &_foot;
 			while(node != nullptr) {
 				if(_cmp(x,node->key())) {
-					if(!node->left() || !_cmp(x,node->left()->key()))
-						return iterator(node);
+					res = node;
 					node = node->left();
 				}
-				else if(x == node->key())
-					return iterator(node->next());
 				else
 					node = node->right();
 			}
-			return end();
+			return iterator(res);
 		}
 		const_iterator upper_bound(const key_type &x) const {
 			iterator it = upper_bound(x);
@@ -343,15 +349,10 @@ namespace std {
 		 * @param last the end of the range (exclusive)
 		 */
 		void erase(iterator first,iterator last) {
-			/* note that we have to run to the node each time because deleted nodes might be reused for
-			 * other nodes. that is, we can't simply iterator through the sequence and delete every
-			 * node. doing so might free nodes twice. */
-			difference_type i = distance(begin(),first);
-			difference_type num = distance(first,last);
-			while(num-- > 0) {
-				iterator it = begin();
-				advance(it,i);
-				do_erase(it.node());
+			while(first != last) {
+				bintree_node<Key,T,Cmp>* node = first.node();
+				++first;
+				do_erase(node);
 			}
 		}
 		/**
@@ -372,17 +373,17 @@ namespace std {
 
 	private:
 		/**
-		 * Does the actual inserting, starting at <node>
+		 * Searches for the insert-position of <k>, starting at the root, and inserts it there
 		 *
-		 * @param node the start-node
 		 * @param k the key
 		 * @param v the value
 		 * @param replace whether to replace existing elements
 		 * @return the insert-position
 		 */
-		iterator do_insert(bintree_node<Key,T,Cmp>* node,const Key& k,const T& v,bool replace) {
+		iterator do_insert(const Key& k,const T& v,bool replace) {
 			bool left = false;
-			bintree_node<Key,T,Cmp>* prev = node ? node->parent() : nullptr;
+			bintree_node<Key,T,Cmp>* node = _head.right();
+			bintree_node<Key,T,Cmp>* prev = &_head;
 			while(node != nullptr) {
 				prev = node;
 				// less?
@@ -401,12 +402,21 @@ namespace std {
 					node = node->right();
 				}
 			}
-
-			// node is null, so create a new node
-			node = new bintree_node<Key,T,Cmp>(k,nullptr,nullptr);
+			return attach(prev,left,k,v);
+		}
+		/**
+		 * Creates a new node for <k> and <v>, makes it the left or right child of <prev>, which
+		 * has to be free, and rebalances the tree afterwards.
+		 *
+		 * @param prev the parent node
+		 * @param left whether to insert it as the left child
+		 * @param k the key
+		 * @param v the value
+		 * @return the insert-position
+		 */
+		iterator attach(bintree_node<Key,T,Cmp>* prev,bool left,const Key& k,const T& v) {
+			bintree_node<Key,T,Cmp>* node = new bintree_node<Key,T,Cmp>(k,nullptr,nullptr);
 			node->value(v);
-			if(!prev)
-				prev = &_head;
 			node->parent(prev);
 
 			// insert into tree
@@ -416,7 +426,7 @@ namespace std {
 				prev->right(node);
 
 			// insert into sequence
-			// note that its always directly behind or before the found node when we want to keep
+			// note that its always directly behind or before the parent when we want to keep
 			// the keys in ascending order!
 			if(left) {
 				// insert before prev
@@ -433,9 +443,191 @@ namespace std {
 				prev->next(node);
 			}
 
+			insert_fixup(node);
 			_elCount++;
 			return iterator(node);
 		}
+		/**
+		 * Restores the red-black properties after <n> has been inserted.
+		 *
+		 * @param n the new node
+		 */
+		void insert_fixup(bintree_node<Key,T,Cmp>* n) {
+			n->red(true);
+			// since the root is black, a red parent always has a parent of its own
+			while(n->parent()->red()) {
+				bintree_node<Key,T,Cmp>* p = n->parent();
+				bintree_node<Key,T,Cmp>* g = p->parent();
+				if(p == g->left()) {
+					bintree_node<Key,T,Cmp>* u = g->right();
+					if(is_red(u)) {
+						p->red(false);
+						u->red(false);
+						g->red(true);
+						n = g;
+					}
+					else {
+						if(n == p->right()) {
+							n = p;
+							rotate_left(n);
+							p = n->parent();
+						}
+						p->red(false);
+						g->red(true);
+						rotate_right(g);
+					}
+				}
+				else {
+					bintree_node<Key,T,Cmp>* u = g->left();
+					if(is_red(u)) {
+						p->red(false);
+						u->red(false);
+						g->red(true);
+						n = g;
+					}
+					else {
+						if(n == p->left()) {
+							n = p;
+							rotate_right(n);
+							p = n->parent();
+						}
+						p->red(false);
+						g->red(true);
+						rotate_left(g);
+					}
+				}
+			}
+			_head.right()->red(false);
+		}
+		/**
+		 * Restores the red-black properties after a black node has been removed. <x> is the node
+		 * that took its place (might be null) and <xp> the parent of <x>.
+		 *
+		 * @param x the node
+		 * @param xp the parent of x
+		 */
+		void erase_fixup(bintree_node<Key,T,Cmp>* x,bintree_node<Key,T,Cmp>* xp) {
+			while(x != _head.right() && !is_red(x)) {
+				if(x == xp->left()) {
+					bintree_node<Key,T,Cmp>* w = xp->right();
+					if(w->red()) {
+						w->red(false);
+						xp->red(true);
+						rotate_left(xp);
+						w = xp->right();
+					}
+					if(!is_red(w->left()) && !is_red(w->right())) {
+						w->red(true);
+						x = xp;
+						xp = x->parent();
+					}
+					else {
+						if(!is_red(w->right())) {
+							w->left()->red(false);
+							w->red(true);
+							rotate_right(w);
+							w = xp->right();
+						}
+						w->red(xp->red());
+						xp->red(false);
+						w->right()->red(false);
+						rotate_left(xp);
+						x = _head.right();
+					}
+				}
+				else {
+					bintree_node<Key,T,Cmp>* w = xp->left();
+					if(w->red()) {
+						w->red(false);
+						xp->red(true);
+						rotate_right(xp);
+						w = xp->left();
+					}
+					if(!is_red(w->left()) && !is_red(w->right())) {
+						w->red(true);
+						x = xp;
+						xp = x->parent();
+					}
+					else {
+						if(!is_red(w->left())) {
+							w->right()->red(false);
+							w->red(true);
+							rotate_left(w);
+							w = xp->left();
+						}
+						w->red(xp->red());
+						xp->red(false);
+						w->left()->red(false);
+						rotate_right(xp);
+						x = _head.right();
+					}
+				}
+			}
+			if(x)
+				x->red(false);
+		}
+		/**
+		 * Rotates the subtree of <x> to the left, i.e. the right child of <x> takes its place.
+		 *
+		 * @param x the node
+		 */
+		void rotate_left(bintree_node<Key,T,Cmp>* x) {
+			bintree_node<Key,T,Cmp>* y = x->right();
+			x->right(y->left());
+			if(y->left())
+				y->left()->parent(x);
+			y->parent(x->parent());
+			replace_child(x->parent(),x,y);
+			y->left(x);
+			x->parent(y);
+		}
+		/**
+		 * Rotates the subtree of <x> to the right, i.e. the left child of <x> takes its place.
+		 *
+		 * @param x the node
+		 */
+		void rotate_right(bintree_node<Key,T,Cmp>* x) {
+			bintree_node<Key,T,Cmp>* y = x->left();
+			x->left(y->right());
+			if(y->right())
+				y->right()->parent(x);
+			y->parent(x->parent());
+			replace_child(x->parent(),x,y);
+			y->right(x);
+			x->parent(y);
+		}
+		/**
+		 * Replaces the child <old> of <parent> with <n>
+		 *
+		 * @param parent the parent (might be _head)
+		 * @param old the old child
+		 * @param n the new child
+		 */
+		static void replace_child(bintree_node<Key,T,Cmp>* parent,bintree_node<Key,T,Cmp>* old,
+				bintree_node<Key,T,Cmp>* n) {
+			if(old == parent->left())
+				parent->left(n);
+			else
+				parent->right(n);
+		}
+		/**
+		 * Puts <n> at the place of <old> in the tree. Does not touch the children of <old>.
+		 *
+		 * @param old the node to replace
+		 * @param n the new node (might be null)
+		 */
+		static void transplant(bintree_node<Key,T,Cmp>* old,bintree_node<Key,T,Cmp>* n) {
+			replace_child(old->parent(),old,n);
+			if(n)
+				n->parent(old->parent());
+		}
+		/**
+		 * @param n the node (might be null)
+		 * @return true if <n> is red; null-nodes are black
+		 */
+		static bool is_red(bintree_node<Key,T,Cmp>* n) {
+			return n && n->red();
+		}
 		/**
 		 * Finds the node with the minimum key in the subtree of <n>.
 		 *
@@ -448,28 +640,6 @@ namespace std {
 				current = current->left();
 			return current;
 		}
-		/**
-		 * Replaces <n> with <newnode>. Deletes <n> when done
-		 *
-		 * @param n the node
-		 * @param newnode the new node
-		 */
-		void replace_in_parent(bintree_node<Key,T,Cmp>* n,bintree_node<Key,T,Cmp>* newnode) {
-			bintree_node<Key,T,Cmp>* parent = n->parent();
-			// erase out of the sequence
-			n->prev()->next(n->next());
-			n->next()->prev(n->prev());
-			// replace in parent
-			if(parent) {
-				if(n == parent->left())
-					parent->left(newnode);
-				else
-					parent->right(newnode);
-			}
-			if(newnode)
-				newnode->parent(parent);
-			delete n;
-		}
 		/**
 		 * The recursive erase-method
 		 *
@@ -490,25 +660,51 @@ namespace std {
 			return false;
 		}
 		/**
-		 * Removes the given node
+		 * Removes the given node. Instead of copying the successor into <n>, the successor is moved
+		 * to the place of <n>, so that iterators to it stay valid.
 		 *
 		 * @param n the node
 		 */
 		void do_erase(bintree_node<Key,T,Cmp>* n) {
-			if(n->left() && n->right()) {
-				bintree_node<Key,T,Cmp>* successor = find_min(n->right());
-				n->key(successor->key());
-				n->value(successor->value());
-				replace_in_parent(successor,successor->right());
+			bintree_node<Key,T,Cmp>* x;
+			bintree_node<Key,T,Cmp>* xp;
+			bool wasRed = n->red();
+
+			// erase out of the sequence
+			n->prev()->next(n->next());
+			n->next()->prev(n->prev());
+
+			if(!n->left()) {
+				x = n->right();
+				xp = n->parent();
+				transplant(n,x);
 			}
-			else if(n->left() || n->right()) {
-				if(n->left())
-					replace_in_parent(n,n->left());
-				else
-					replace_in_parent(n,n->right());
+			else if(!n->right()) {
+				x = n->left();
+				xp = n->parent();
+				transplant(n,x);
 			}
-			else
-				replace_in_parent(n,nullptr);
+			else {
+				bintree_node<Key,T,Cmp>* successor = find_min(n->right());
+				wasRed = successor->red();
+				x = successor->right();
+				if(successor->parent() == n)
+					xp = successor;
+				else {
+					xp = successor->parent();
+					transplant(successor,x);
+					successor->right(n->right());
+					successor->right()->parent(successor);
+				}
+				transplant(n,successor);
+				successor->left(n->left());
+				successor->left()->parent(successor);
+				successor->red(n->red());
+			}
+
+			if(!wasRed)
+				erase_fixup(x,xp);
+			delete n;
 			_elCount--;
 		}
 
@@ -45,6 +45,9 @@ public:
 	};
 	typedef std::map<msgid_t,Handler> oplist_type;
 
+	/* the max. number of messages that are fetched and handled at once */
+	static const size_t BATCH_SIZE		= 8;
+
 	/**
 	 * Creates the device at given path
 	 *
@@ -110,11 +113,20 @@ public:
 	void unset(msgid_t op);
 
 	/**
-	 * Executes the device-loop, i.e. uses getwork() to get a messages and handles it with the
+	 * Executes the device-loop, i.e. uses handleWork() to get messages and handles them with the
 	 * appropriate handler.
 	 */
 	void loop();
 
+	/**
+	 * Uses getworkv() to fetch up to BATCH_SIZE messages, handles them with the appropriate
+	 * handler and sends all replies with one sendv() call afterwards.
+	 *
+	 * @param flags the flags for getworkv()
+	 * @return the number of handled messages or the error code of getworkv()
+	 */
+	ssize_t handleWork(uint flags);
+
 	/**
 	 * Calls the handler for the given message
 	 *
@@ -125,6 +137,7 @@ public:
 
 protected:
 	void reply(IPCStream &is,int errcode);
+	void sendReplies(const sMsgVec *replies,size_t count);
 	void close(IPCStream &is) {
 		::close(is.fd());
 	}
@@ -68,6 +68,8 @@ class IPCStream {
 		FL_ALLOC	= 1 << 0,
 		FL_READING	= 1 << 1,
 		FL_OPEN		= 1 << 2,
+		FL_DEFER	= 1 << 3,
+		FL_PENDING	= 1 << 4,
 	};
 
 public:
@@ -156,6 +158,45 @@ public:
 		_buf.reset();
 	}
 
+	/**
+	 * Lets Reply defer the reply instead of sending it immediately. The reply stays in the buffer
+	 * of the stream until it is fetched via takeReply() or the stream is used again, in which case
+	 * it is sent first. This allows to send the replies for multiple messages at once.
+	 */
+	void deferReply() {
+		_flags |= FL_DEFER;
+	}
+	/**
+	 * Takes the deferred reply, if there is any. The reply id is msgid().
+	 *
+	 * @param data will be set to the reply data
+	 * @param size will be set to the size of the reply
+	 * @return true if there was a deferred reply
+	 */
+	bool takeReply(void **data,size_t *size) {
+		if(~_flags & FL_PENDING)
+			return false;
+		_flags &= ~FL_PENDING;
+		*data = _buf.buffer();
+		*size = _buf.pos();
+		_buf.reset();
+		return true;
+	}
+	/**
+	 * Sends the deferred reply, if there is any.
+	 */
+	void flushReply() {
+		if(EXPECT_FALSE(_flags & FL_PENDING)) {
+			_flags &= ~FL_PENDING;
+			A_UNUSED ssize_t res = ::send(_fd,_mid,_buf.buffer(),_buf.pos());
+#ifndef IN_KERNEL
+			if(EXPECT_FALSE(res < 0))
+				VTHROWE("send",res);
+#endif
+			_buf.reset();
+		}
+	}
+
 	/**
 	 * Puts the given item into the stream. Note that this automatically puts the stream into
 	 * writing mode, if it is not already in it.
@@ -188,13 +229,15 @@ public:
 
 private:
 	void startWriting() {
-		if(EXPECT_FALSE(_flags & FL_READING)) {
+		if(EXPECT_FALSE(_flags & (FL_READING | FL_PENDING))) {
+			flushReply();
 			_flags &= ~FL_READING;
 			_buf.reset();
 		}
 	}
 	void startReading() {
-		if(EXPECT_FALSE(~_flags & FL_READING)) {
+		if(EXPECT_FALSE((~_flags & FL_READING) || (_flags & FL_PENDING))) {
+			flushReply();
 			_flags |= FL_READING;
 			_buf.reset();
 		}
@@ -282,6 +325,12 @@ struct Reply : public Send {
 
 	IPCStream &operator()(IPCStream &is) {
 		_mid = is._mid;
+		if(EXPECT_FALSE(is._flags & IPCStream::FL_DEFER)) {
+			// send a still pending reply first and keep the new one in the buffer
+			is.startWriting();
+			is._flags |= IPCStream::FL_PENDING;
+			return is;
+		}
 		return Send::operator()(is);
 	}
 };
@@ -295,6 +344,7 @@ struct Receive {
 
 	IPCStream &operator()(IPCStream &is) {
 		ssize_t res;
+		is.flushReply();
 		do {
 			res = ::receive(is.fd(),&is._mid,is._buf.buffer(),is._buf.max());
 		}
@@ -333,6 +383,7 @@ struct SendData {
 	}
 
 	IPCStream &operator()(IPCStream &is) {
+		is.flushReply();
 		ssize_t res = ::send(is.fd(),_mid,_data,_size);
 #ifndef IN_KERNEL
 		if(EXPECT_FALSE(res < 0))
@@ -372,6 +423,7 @@ struct ReceiveData {
 
 	IPCStream &operator()(IPCStream &is) {
 		ssize_t res;
+		is.flushReply();
 		do {
 			res = ::receive(is.fd(),&is._mid,_data,_size);
 		}
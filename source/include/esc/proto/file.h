@@ -131,6 +131,9 @@ struct FileRead {
 
 		size_t offset;
 		size_t count;
+		/* the offset in the shared memory or -1. if no memory has been shared with this client, the
+		 * kernel might have lent the client's pages to the driver. in this case, it's the address
+		 * of them, so that shm() + shmemoff works in both cases */
 		ssize_t shmemoff;
 	};
 
@@ -152,6 +155,9 @@ struct FileWrite {
 
 		size_t offset;
 		size_t count;
+		/* the offset in the shared memory or -1. if no memory has been shared with this client, the
+		 * kernel might have lent the client's pages to the driver. in this case, it's the address
+		 * of them, so that shm() + shmemoff works in both cases */
 		ssize_t shmemoff;
 	};
 
@@ -30,12 +30,20 @@ struct CBlock {
 	size_t blockNo;
 	ushort dirty;
 	ushort refs;
+	/* whether it has been read ahead and not been requested yet */
+	bool prefetched;
 	/* NULL indicates an unused entry */
 	void *buffer;
 };
 
 class BlockCache {
-	static const size_t HASH_SIZE	= 256;
+	/* the initial number of hash buckets; doubled whenever the average chain gets too long */
+	static const size_t HASH_INIT	= 256;
+	static const size_t HASH_LOAD	= 2;
+	/* the maximum number of blocks that are read or written at once */
+	static const size_t MAX_BATCH	= 32;
+	/* the number of blocks we read ahead, initially, when detecting sequential accesses */
+	static const size_t RA_MIN		= 4;
 
 public:
 	enum {
@@ -78,10 +86,30 @@ public:
 	virtual bool writeBlocks(const void *buffer,size_t start,size_t blockCount) = 0;
 
 	/**
-	 * Writes all dirty blocks to disk
+	 * Writes all dirty blocks to disk. Adjacent dirty blocks are written at once.
 	 */
 	void flush();
 
+	/**
+	 * Writes the dirty blocks in the range <start> .. <start>+<count>-1 to disk. This is required
+	 * before these blocks are read from disk while bypassing the cache.
+	 *
+	 * @param start the first block number
+	 * @param count the number of blocks
+	 */
+	void sync(block_t start,size_t count);
+
+	/**
+	 * Updates the cached copies of the blocks <start> .. <start>+<count>-1, if any, with the
+	 * content of <buffer>. This is required after these blocks have been written to disk while
+	 * bypassing the cache. The updated blocks are clean afterwards.
+	 *
+	 * @param buffer the new content of the blocks
+	 * @param start the first block number
+	 * @param count the number of blocks
+	 */
+	void update(const void *buffer,block_t start,size_t count);
+
 	/**
 	 * Marks the given block as dirty
 	 *
@@ -157,9 +185,35 @@ private:
 	 * Fetches a block-cache-entry
 	 */
 	CBlock *getBlock(block_t blockNo);
+	/**
+	 * Reads the given block from disk and, for sequential accesses, the following blocks as well
+	 */
+	bool fetch(CBlock *block);
+	/**
+	 * Writes the given block and the adjacent dirty blocks to disk
+	 */
+	void writeBack(CBlock *block);
+	/**
+	 * Removes the given block from the cache and puts it into the freelist
+	 */
+	void invalidate(CBlock *block);
+	/**
+	 * Searches for the given block in the hashmap
+	 */
+	CBlock *lookup(block_t blockNo) const {
+		CBlock *b = _hashmap[blockNo & (_hashSize - 1)];
+		while(b != NULL && b->blockNo != blockNo)
+			b = b->hnext;
+		return b;
+	}
+	void hashInsert(CBlock *block);
+	void hashRemove(CBlock *block);
+	void hashResize(size_t size);
 
 	size_t _blockCacheSize;
 	size_t _blockSize;
+	size_t _hashSize;
+	size_t _hashUsed;
 	CBlock **_hashmap;
 	CBlock *_oldestBlock;
 	CBlock *_newestBlock;
@@ -167,6 +221,17 @@ private:
 	CBlock *_blockCache;
 	void *_blockmem;
 	ulong _blockshm;
+	/* a buffer for MAX_BATCH blocks behind the cache, that is shared with the disk as well */
+	void *_stage;
+	/* read-ahead state: the block we expect next and the current window */
+	block_t _raNext;
+	size_t _raWindow;
+	size_t _raMax;
 	ulong _hits;
 	ulong _misses;
+	ulong _raBlocks;
+	ulong _raHits;
+	ulong _diskReads;
+	ulong _diskWrites;
+	ulong _writtenBlocks;
 };
@@ -35,6 +35,10 @@
 /* magic number */
 #define EXT2_SUPER_MAGIC					0xEF53
 
+/* super-block flags */
+#define EXT2_FLAGS_SIGNED_HASH				0x0001
+#define EXT2_FLAGS_UNSIGNED_HASH			0x0002
+
 /* states */
 #define EXT2_VALID_FS						1
 #define EXT2_ERROR_FS						2
@@ -140,10 +144,10 @@
 #define EXT2_NOCOMPR_FL						0x00000400	/* access raw compressed data */
 #define EXT2_ECOMPR_FL						0x00000800	/* compression error */
 /* compression end */
-#define EXT2_BTREE_FL						0x00010000	/* b-tree format directory */
-#define EXT2_INDEX_FL						0x00010000  /* hash indexed directory */
-#define EXT2_IMAGIC_FL						0x00020000	/* AFS directory */
-#define EXT3_JOURNAL_DATA_FL				0x00040000	/* journal file data */
+#define EXT2_BTREE_FL						0x00001000	/* b-tree format directory */
+#define EXT2_INDEX_FL						0x00001000	/* hash indexed directory */
+#define EXT2_IMAGIC_FL						0x00002000	/* AFS directory */
+#define EXT3_JOURNAL_DATA_FL				0x00004000	/* journal file data */
 #define EXT2_RESERVED_FL					0x80000000	/* reserved for ext2 library */
 
 struct Ext2SuperBlock {
@@ -241,7 +245,11 @@ struct Ext2SuperBlock {
 	/* A 32bit value indicating the block group ID of the first meta block group. */
 	uint32_t firstMetaBg;
 	/* UNUSED */
-	uint8_t unused[760];
+	uint8_t unused1[88];
+	/* A 32bit value with miscellaneous flags (EXT2_FLAGS_*) */
+	uint32_t flags;
+	/* UNUSED */
+	uint8_t unused2[668];
 } A_PACKED;
 
 struct Ext2BlockGrp {
@@ -271,6 +279,42 @@ struct Ext2DirEntry {
 	char name[];
 } A_PACKED;
 
+/* hash versions for indexed directories */
+#define EXT2_HASH_LEGACY					0
+#define EXT2_HASH_HALF_MD4					1
+#define EXT2_HASH_TEA						2
+/* the same with unsigned chars; not stored on disk, but determined by EXT2_FLAGS_UNSIGNED_HASH */
+#define EXT2_HASH_LEGACY_UNSIGNED			3
+#define EXT2_HASH_HALF_MD4_UNSIGNED			4
+#define EXT2_HASH_TEA_UNSIGNED				5
+
+/* the information in the first block of an indexed directory, behind the entries "." and ".." */
+struct Ext2DxRootInfo {
+	uint32_t reservedZero;
+	/* one of EXT2_HASH_* */
+	uint8_t hashVersion;
+	/* the size of this struct (8) */
+	uint8_t infoLength;
+	/* the number of index-levels below the root */
+	uint8_t indirectLevels;
+	uint8_t unusedFlags;
+} A_PACKED;
+
+/* an entry in an index-block. in the first entry, the hash is replaced by Ext2DxCountLimit */
+struct Ext2DxEntry {
+	/* the lowest hash in the block; the lowest bit is set if the previous block continues with
+	 * the same hash */
+	uint32_t hash;
+	/* the linear block-number in the directory */
+	uint32_t block;
+} A_PACKED;
+
+struct Ext2DxCountLimit {
+	/* the max. and the current number of entries in the index-block */
+	uint16_t limit;
+	uint16_t count;
+} A_PACKED;
+
 struct Ext2Inode {
 	uint16_t mode;
 	uint16_t uid;
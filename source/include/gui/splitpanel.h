@@ -73,6 +73,10 @@ namespace gui {
 			_controls.reserve(3);
 			Panel::add(make_control<Splitter>(_orientation),0);
 		}
+		// the splitter is always at index 0; the controls at 1 and 2 might not exist yet
+		Control *getChild(size_t idx) const {
+			return idx < _controls.size() ? _controls[idx].get() : nullptr;
+		}
 		void refresh();
 		Size combine(Size a,Size b,Size splitter) const;
 		virtual Size getPrefSize() const;
@@ -30,6 +30,7 @@
 #define CONF_LOG_TO_VGA			6
 #define CONF_CPU_COUNT			8
 #define CONF_TICKS_PER_SEC		10
+#define CONF_LEND_PAGES			13
 
 #if defined(__cplusplus)
 extern "C" {
@@ -21,6 +21,7 @@
 
 #include <sys/common.h>
 #include <sys/syscalls.h>
+#include <sys/messages.h>
 
 #define DEV_OPEN					1
 #define DEV_READ					2		/* cancelable, if DEV_CANCEL is supported */
@@ -45,6 +46,21 @@
 
 #define GW_NOBLOCK					1
 
+/* the max. number of messages for getworkv() and sendv() */
+#define MSGVEC_MAX					32
+
+/* one message for getworkv() and sendv() */
+typedef struct {
+	/* the file-descriptor of the client */
+	int fd;
+	/* the message-id */
+	msgid_t mid;
+	/* the message buffer */
+	void *data;
+	/* the (max) size of the message */
+	size_t size;
+} sMsgVec;
+
 #if defined(__cplusplus)
 extern "C" {
 #endif
@@ -77,6 +93,40 @@ A_CHECKRET static inline int getwork(int fd,msgid_t *mid,void *msg,size_t size,u
 	return syscall4(SYSCALL_GETWORK,(fd << 2) | flags,(ulong)mid,(ulong)msg,size);
 }
 
+/**
+ * For drivers: Like getwork(), but receives up to <count> messages at once. It waits (unless
+ * GW_NOBLOCK is given) until at least one client wants to be served and afterwards fetches all
+ * further messages that are already available, until <count> is reached. At most one message is
+ * taken from each client, because a request might be followed by messages that belong to it (e.g.
+ * the data of a write), which are received by the handler of the request. For each received message,
+ * vec[i].fd is set to the client fd, vec[i].mid to the msg-id and vec[i].size to the message size.
+ * vec[i].data and vec[i].size have to be set to the buffer to receive the message into before.
+ * Note that you may be interrupted by a signal!
+ *
+ * @param fd the device fd
+ * @param vec the message array
+ * @param count the number of entries in <vec> (at most MSGVEC_MAX)
+ * @param flags the flags
+ * @return the number of received messages or < 0 if an error occurred
+ */
+A_CHECKRET static inline ssize_t getworkv(int fd,sMsgVec *vec,size_t count,uint flags) {
+	return syscall3(SYSCALL_GETWORKV,(fd << 2) | flags,(ulong)vec,count);
+}
+
+/**
+ * Sends the <count> given messages, i.e. vec[i].data with vec[i].size bytes and msg-id vec[i].mid
+ * to client vec[i].fd. This is intended for drivers to send the replies for multiple messages
+ * received by getworkv() at once. Messages that cannot be sent (e.g. because the client is gone)
+ * are skipped.
+ *
+ * @param vec the message array
+ * @param count the number of entries in <vec> (at most MSGVEC_MAX)
+ * @return the number of sent messages or < 0 if none could be sent
+ */
+static inline ssize_t sendv(const sMsgVec *vec,size_t count) {
+	return syscall2(SYSCALL_SENDV,(ulong)vec,count);
+}
+
 /**
  * Binds the device or channel, referenced by <fd>, to the thread with given id.
  * For devices it means that all channels are bound to thread <tid>, i.e. thread <tid> will receive
@@ -92,6 +142,22 @@ static inline int bindto(int fd,tid_t tid) {
 	return syscall2(SYSCALL_BINDTO,fd,tid);
 }
 
+/**
+ * Tells the kernel that the inode <ino> of the filesystem, whose device is referenced by <fd>, has
+ * been changed without the kernel noticing it. This removes all cached attributes and lookups of
+ * it. A filesystem needs to call that only for changes that have not been requested through the
+ * kernel, e.g., if the files have been changed on a remote host.
+ *
+ * @param fd the fd for the device
+ * @param ino the inode-number or -1 for all inodes
+ * @return 0 on success
+ */
+static inline int fsinvalidate(int fd,ino_t ino) {
+	if(ino == (ino_t)-1)
+		return syscall4(SYSCALL_SEND,fd,MSG_FS_INVALIDATE,0,0);
+	return syscall4(SYSCALL_SEND,fd,MSG_FS_INVALIDATE,(ulong)&ino,sizeof(ino));
+}
+
 #if defined(__cplusplus)
 }
 #endif
@@ -51,6 +51,9 @@
 #define MSG_FS_CHOWN				113
 #define MSG_FS_UTIME				114
 
+/* fs to kernel: the given inode (ino_t) or, without data, everything has changed */
+#define MSG_FS_INVALIDATE			115
+
 /* Other messages */
 #define MSG_SPEAKER_BEEP			200		/* performs a beep */
 
@@ -41,6 +41,12 @@
 #define MAP_PHYS_ALLOC		0		/* allocate physical memory */
 #define MAP_PHYS_MAP		1		/* map the specified physical memory */
 
+/* access-pattern advices */
+#define MADV_NORMAL			0		/* load neighbouring pages and read ahead on sequential faults */
+#define MADV_RANDOM			1		/* load only the faulting page */
+#define MADV_SEQUENTIAL		2		/* read ahead aggressively */
+#define MADV_WILLNEED		3		/* load the region now, as far as memory permits */
+
 #if defined(__cplusplus)
 extern "C" {
 #endif
@@ -82,6 +88,20 @@ void *mmap(void *addr,size_t length,size_t loadLength,int prot,int flags,int fd,
  */
 void *mmapphys(uintptr_t *phys,size_t count,size_t align,int flags) A_CHECKRET;
 
+/**
+ * Determines the physical addresses of the <count> pages starting at <addr>. The region has to
+ * be locked into memory (see mlock()), so that the addresses stay valid until it is unmapped.
+ * This is intended for drivers that let devices access the memory of their clients via DMA.
+ *
+ * @param addr the virtual address (page aligned)
+ * @param phys the array to write the physical addresses to
+ * @param count the number of pages
+ * @return 0 on success
+ */
+static inline int virt2phys(void *addr,uintptr_t *phys,size_t count) {
+	return syscall3(SYSCALL_VIRT2PHYS,(ulong)addr,(ulong)phys,count);
+}
+
 /**
  * Changes the protection of the region denoted by the given address.
  *
@@ -93,6 +113,18 @@ static inline int mprotect(void *addr,uint prot) {
 	return syscall2(SYSCALL_MPROTECT,(ulong)addr,prot);
 }
 
+/**
+ * Tells the kernel how the region denoted by the given address will be accessed, so that it can
+ * adjust the demand-loading of file-mappings accordingly.
+ *
+ * @param addr the virtual address
+ * @param advice the access pattern (MADV_*)
+ * @return 0 on success
+ */
+static inline int madvise(void *addr,int advice) {
+	return syscall2(SYSCALL_MADVISE,(ulong)addr,advice);
+}
+
 /**
  * Unmaps the region denoted by <addr>
  *
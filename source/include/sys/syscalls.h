@@ -115,6 +115,11 @@ enum {
 	SYSCALL_RENAME,
 	SYSCALL_GETTOD,
 	SYSCALL_UTIME,
+	SYSCALL_SETAFFINITY,
+	SYSCALL_GETWORKV,
+	SYSCALL_SENDV,
+	SYSCALL_MADVISE,
+	SYSCALL_VIRT2PHYS,
 #	ifdef __x86__
 	SYSCALL_REQIOPORTS,
 	SYSCALL_RELIOPORTS,
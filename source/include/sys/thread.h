@@ -91,7 +91,18 @@ static inline int alarm(time_t msecs) {
  * @return 0 on success
  */
 static inline int sleep(time_t msecs) {
-	return syscall1(SYSCALL_SLEEP,msecs);
+	return syscall2(SYSCALL_SLEEP,msecs,0);
+}
+
+/**
+ * Puts the current thread to sleep for <usecs> microseconds. If interrupted, -EINTR
+ * is returned. Note that the precision depends on the timer device of the machine.
+ *
+ * @param usecs the number of microseconds to wait
+ * @return 0 on success
+ */
+static inline int usleep(uint64_t usecs) {
+	return syscall2(SYSCALL_SLEEP,usecs / 1000,usecs % 1000);
 }
 
 /**
@@ -105,6 +116,18 @@ static inline int join(tid_t tid) {
 	return syscall1(SYSCALL_JOIN,tid);
 }
 
+/**
+ * Restricts the thread with given id (from the own process) to the given set of CPUs. Newly
+ * started threads inherit the set of their creator.
+ *
+ * @param tid the thread-id
+ * @param mask the CPU-mask (bit n = CPU n)
+ * @return 0 on success
+ */
+static inline int setaffinity(tid_t tid,ulong mask) {
+	return syscall2(SYSCALL_SETAFFINITY,tid,mask);
+}
+
 #if defined(__cplusplus)
 }
 #endif
@@ -24,13 +24,15 @@
 namespace z {
 
 /**
- * Computes the Cyclic Redundancy Check.
+ * Computes the Cyclic Redundancy Check. It uses the slice-by-8 algorithm with precomputed tables
+ * and, on x86_64, the carry-less multiplication (PCLMULQDQ), if the CPU supports it.
  */
 class CRC32 {
 public:
 	typedef uint32_t type;
 
-	explicit CRC32();
+	explicit CRC32() {
+	}
 
 	/**
 	 * Computes the CRC32 of <buf>[0] .. <buf>[<len>-1].
@@ -57,8 +59,16 @@ public:
 	 */
 	type update(type crc,const void *buf,size_t len);
 
-private:
-	type _table[256];
+	/**
+	 * @return true if update() uses a hardware-accelerated implementation
+	 */
+	static bool accelerated();
+
+	/**
+	 * The implementations behind update(); only intended for tests and benchmarks.
+	 */
+	static type update_bytewise(type crc,const void *buf,size_t len);
+	static type update_sliced(type crc,const void *buf,size_t len);
 };
 
 }
@@ -24,6 +24,7 @@
 #include <z/deflatebase.h>
 #include <stdio.h>
 #include <assert.h>
+#include <string.h>
 #include <algorithm>
 
 namespace z {
@@ -49,25 +50,14 @@ public:
 	virtual size_t count() const = 0;
 
 	/**
-	 * @return true if there is more data than the current block
-	 */
-	virtual bool more() = 0;
-
-	/**
-	 * @return the remaining data from the currently cached block
-	 */
-	virtual size_t cached() = 0;
-
-	/**
-	 * @param off the offset (might be negative). has to be within the current block
-	 * @return the byte at current position plus <off>
-	 */
-	virtual uint8_t peek(ssize_t off) = 0;
-
-	/**
-	 * @return the next byte
+	 * Reads up to <count> bytes into <buf>. Less than <count> bytes are only returned at the end
+	 * of the data.
+	 *
+	 * @param buf the buffer to write to
+	 * @param count the maximum number of bytes
+	 * @return the number of read bytes (0 = end of data)
 	 */
-	virtual uint8_t get() = 0;
+	virtual size_t read(uint8_t *buf,size_t count) = 0;
 };
 
 /**
@@ -79,81 +69,43 @@ public:
 	}
 
 	/**
-	 * Writes <c> to drain
+	 * Writes <count> bytes from <buf> to drain
 	 *
-	 * @param c the character to write
+	 * @param buf the data
+	 * @param count the number of bytes
 	 */
-	virtual void put(uint8_t c) = 0;
+	virtual void write(const uint8_t *buf,size_t count) = 0;
 };
 
 /**
  * A source implementation that reads from a FILE.
  */
 class FileDeflateSource : public DeflateSource {
-	static const size_t CACHE_SIZE	= 4096;
-
 public:
 	explicit FileDeflateSource(FILE *file)
-		: DeflateSource(), _cache(new uint8_t[CACHE_SIZE / 2]), _next(new uint8_t[CACHE_SIZE / 2]),
-		  _pos(0), _cached(0), _nextcount(0), _total(0), _checksum(0), _crc(), _file(file) {
-	}
-	virtual ~FileDeflateSource() {
-		delete[] _cache;
-		delete[] _next;
+		: DeflateSource(), _total(0), _checksum(0), _crc(), _file(file) {
 	}
 
 	virtual CRC32::type crc32() {
-		if(_pos != _cached) {
-			_checksum = _crc.update(_checksum,_cache,_pos);
-			_pos = _cached;
-		}
 		return _checksum;
 	}
 	virtual size_t count() const {
 		return _total;
 	}
-	virtual bool more() {
-		load();
-		return _nextcount > 0;
-	}
-	virtual size_t cached() {
-		load();
-		return _cached - _pos;
-	}
-	virtual uint8_t peek(ssize_t off) {
-		load();
-		assert(_pos + off >= 0 && _pos + off < _cached);
-		return _cache[_pos + off];
-	}
-	virtual uint8_t get() {
-		load();
-		assert(_pos < _cached);
-		_total++;
-		return _cache[_pos++];
-	}
-
-private:
-	void load() {
-		if(_cached - _pos == 0) {
-			bool first = _cached == 0 && _pos == 0;
-			if(!first)
-				_checksum = _crc.update(_checksum,_cache,_pos);
-			_cached = fread(_cache,1,CACHE_SIZE / 2,_file);
-			_pos = 0;
-			if(first)
-				_nextcount = fread(_next,1,CACHE_SIZE / 2,_file);
-			else {
-				std::swap(_cache,_next);
-				std::swap(_cached,_nextcount);
-			}
+	virtual size_t read(uint8_t *buf,size_t count) {
+		size_t res = 0;
+		while(res < count) {
+			size_t n = fread(buf + res,1,count - res,_file);
+			if(n == 0)
+				break;
+			res += n;
 		}
+		_checksum = _crc.update(_checksum,buf,res);
+		_total += res;
+		return res;
 	}
 
-	uint8_t *_cache;
-	uint8_t *_next;
-	size_t _pos;
-	size_t _cached;
-	size_t _nextcount;
+private:
 	size_t _total;
 	CRC32::type _checksum;
 	CRC32 _crc;
@@ -169,22 +121,113 @@ public:
 		: DeflateDrain(), _file(file) {
 	}
 
-	virtual void put(uint8_t c) {
-		fputc(c,_file);
+	virtual void write(const uint8_t *buf,size_t count) {
+		fwrite(buf,1,count,_file);
 	}
 
 private:
 	FILE *_file;
 };
 
+class MemDeflateSource : public DeflateSource {
+public:
+	explicit MemDeflateSource(const void *buffer,size_t size)
+		: _buffer(reinterpret_cast<const uint8_t*>(buffer)), _size(size), _pos() {
+	}
+
+	virtual CRC32::type crc32() {
+		CRC32 crc;
+		return crc.get(_buffer,_pos);
+	}
+	virtual size_t count() const {
+		return _pos;
+	}
+	virtual size_t read(uint8_t *buf,size_t count) {
+		size_t amount = std::min(count,_size - _pos);
+		memcpy(buf,_buffer + _pos,amount);
+		_pos += amount;
+		return amount;
+	}
+
+private:
+	const uint8_t *_buffer;
+	size_t _size;
+	size_t _pos;
+};
+
+class MemDeflateDrain : public DeflateDrain {
+public:
+	explicit MemDeflateDrain(void *buffer,size_t size)
+		: _buffer(reinterpret_cast<uint8_t*>(buffer)), _size(size), _pos() {
+	}
+
+	/**
+	 * @return the number of bytes written so far (might exceed the buffer size)
+	 */
+	size_t count() const {
+		return _pos;
+	}
+
+	virtual void write(const uint8_t *buf,size_t count) {
+		if(_pos < _size)
+			memcpy(_buffer + _pos,buf,std::min(count,_size - _pos));
+		_pos += count;
+	}
+
+private:
+	uint8_t *_buffer;
+	size_t _size;
+	size_t _pos;
+};
+
 /**
- * The encoder part of the deflate compression algorithm.
+ * The encoder part of the deflate compression algorithm. It uses a 32 KiB sliding window with
+ * hash chains to find matches and chooses per block between stored, fixed and dynamic Huffman
+ * coding, whatever is the smallest.
  */
 class Deflate : public DeflateBase {
-	struct Tree {
-		unsigned int litbase[4];
-		unsigned int length[4];
-		unsigned int codebase[4];
+	static const size_t WSIZE			= 32 * 1024;
+	static const size_t WMASK			= WSIZE - 1;
+	static const size_t HASH_BITS		= 15;
+	static const size_t HASH_SIZE		= 1 << HASH_BITS;
+	static const size_t HASH_MASK		= HASH_SIZE - 1;
+	static const size_t HASH_SHIFT		= (HASH_BITS + 2) / 3;
+	static const size_t MIN_MATCH		= 3;
+	static const size_t MAX_MATCH		= 258;
+	/* we need MAX_MATCH bytes for the next match plus MIN_MATCH for the hash of the next string */
+	static const size_t MIN_LOOKAHEAD	= MAX_MATCH + MIN_MATCH + 1;
+	static const size_t MAX_DIST		= WSIZE - MIN_LOOKAHEAD;
+	/* matches of length 3 are discarded if their distance exceeds this */
+	static const size_t TOO_FAR			= 4096;
+	/* the max. number of symbols per block */
+	static const size_t SYM_COUNT		= 16 * 1024;
+	static const size_t MAX_STORED		= 0xFFFF;
+	static const size_t OUT_SIZE		= 4096;
+
+	static const size_t LITERALS		= 256;
+	static const size_t END_BLOCK		= 256;
+	static const size_t L_CODES			= 286;
+	static const size_t D_CODES			= 30;
+	static const size_t BL_CODES		= 19;
+	static const size_t MAX_BITS		= 15;
+	static const size_t MAX_BL_BITS		= 7;
+
+	/* the parameters for one compression level */
+	struct Config {
+		/* reduce the lazy search above this match length */
+		unsigned short good_length;
+		/* greedy: only insert new strings up to this length; lazy: don't search further above it */
+		unsigned short max_lazy;
+		/* stop searching when a match of this length is found */
+		unsigned short nice_length;
+		/* the max. number of hash chain entries to follow */
+		unsigned short max_chain;
+		bool lazy;
+	};
+
+	struct Code {
+		unsigned short code;
+		unsigned short len;
 	};
 
 	struct Data {
@@ -193,6 +236,27 @@ class Deflate : public DeflateBase {
 		unsigned int bitcount;
 
 		DeflateDrain *drain;
+		uint8_t out[OUT_SIZE];
+		size_t outpos;
+
+		const Config *cfg;
+		/* the hash of the string at strstart */
+		unsigned int ins_h;
+		/* the start of the current block in the window; negative if it slid out */
+		long block_start;
+		size_t strstart;
+		size_t lookahead;
+		size_t match_start;
+		size_t match_length;
+		size_t prev_length;
+		size_t prev_match;
+		bool match_available;
+		bool eof;
+
+		/* the collected symbols of the current block */
+		size_t sym_count;
+		unsigned short lit_freq[L_CODES + 2];
+		unsigned short dist_freq[D_CODES];
 	};
 
 	enum {
@@ -200,42 +264,111 @@ class Deflate : public DeflateBase {
 		FAILED	= -1
 	};
 
+	/* block types */
+	enum {
+		STORED	= 0,
+		FIXED	= 1,
+		DYN		= 2
+	};
+
 public:
 	enum Level {
 		NONE	= 0,
-		FIXED	= 1,
-		DYN		= 2
+		FAST	= 1,
+		DEFAULT	= 6,
+		BEST	= 9
 	};
 
 	/**
 	 * Constructor
 	 */
 	explicit Deflate();
+	/**
+	 * Destructor
+	 */
+	~Deflate();
+
+	/**
+	 * No copying
+	 */
+	Deflate(const Deflate&) = delete;
+	Deflate &operator=(const Deflate&) = delete;
 
 	/**
 	 * Compresses the data in <source> into <drain>.
 	 *
 	 * @param drain the destination
 	 * @param source the source
-	 * @param compr the compression level
+	 * @param level the compression level (NONE .. BEST)
 	 * @return 0 on success or -1 on error
 	 */
-	int compress(DeflateDrain *drain,DeflateSource *source,int compr);
+	int compress(DeflateDrain *drain,DeflateSource *source,int level);
 
 private:
+	void put(Data *d,uint8_t c) {
+		d->out[d->outpos++] = c;
+		if(EXPECT_FALSE(d->outpos == OUT_SIZE))
+			flush_output(d);
+	}
+	void flush_output(Data *d);
 	void flush(Data *d);
-	void writebit(Data *d,int bit);
 	void write_bits(Data *d,unsigned int bits,int num);
-	void write_bits_reverse(Data *d,unsigned int bits,unsigned int num);
-	void write_symbol(Data *d,Tree *t,unsigned int sym);
-	void write_int(Data *d,Tree *t,unsigned short *base,unsigned char *bits,unsigned int value,int add);
-	void write_symbol_chain(Data *d,Tree *lt,Tree *dt,unsigned int len,unsigned int dist);
+	void write_code(Data *d,const Code *c) {
+		write_bits(d,c->code,c->len);
+	}
+
+	static void build_lengths(const unsigned short *freq,unsigned short *lens,size_t num,size_t maxbits);
+	static void build_codes(Code *codes,const unsigned short *lens,size_t num);
+	size_t build_bl_tree(const Code *ltree,size_t lcodes,const Code *dtree,size_t dcodes);
+
+	void fill_window(Data *d);
+	unsigned int insert_string(Data *d,size_t pos);
+	size_t longest_match(Data *d,size_t cur_match);
+	bool tally(Data *d,size_t dist,size_t lc);
+	unsigned int dist_code(size_t dist) const {
+		return dist < 256 ? dist_codes[dist] : dist_codes[256 + (dist >> 7)];
+	}
+
+	void deflate_stored(Data *d);
+	void deflate_greedy(Data *d);
+	void deflate_lazy(Data *d);
 
+	void flush_block(Data *d,bool last);
+	void compress_block(Data *d,const Code *ltree,const Code *dtree);
 	void deflate_fixed_block(Data *d);
-	void deflate_uncompressed_block(Data *d);
+	void deflate_dynamic_block(Data *d);
+	void deflate_uncompressed_block(Data *d,const uint8_t *buf,size_t len,bool last);
+
+	/* the sliding window (2 * WSIZE), the heads of the hash chains and the chains themself */
+	uint8_t *window;
+	unsigned short *head;
+	unsigned short *prev;
+	/* the symbols of the current block: literal/length and distance (0 = literal) */
+	uint8_t *sym_lc;
+	unsigned short *sym_dist;
+
+	/* the dynamic trees for the current block */
+	Code dltree[L_CODES + 2];
+	Code ddtree[D_CODES];
+	Code bltree[BL_CODES];
+	/* the code lengths of the literal/length and distance trees, run-length encoded */
+	uint8_t bl_syms[L_CODES + D_CODES];
+	uint8_t bl_extra[L_CODES + D_CODES];
+	size_t bl_count;
+	/* the number of literal/length, distance and code length codes to send */
+	size_t dyn_lcodes;
+	size_t dyn_dcodes;
+	size_t bl_codes;
+
+	/* fixed trees */
+	Code sltree[L_CODES + 2];
+	Code sdtree[D_CODES];
+
+	/* length - MIN_MATCH -> length code and distance - 1 -> distance code (see dist_code()) */
+	uint8_t length_code[MAX_MATCH - MIN_MATCH + 1];
+	uint8_t dist_codes[512];
 
-	Tree sltree;
-	Tree sdtree;
+	static const Config configs[];
 };
 
 }
@@ -23,6 +23,7 @@
 #include <z/crc32.h>
 #include <z/deflatebase.h>
 #include <stdio.h>
+#include <string.h>
 #include <assert.h>
 #include <algorithm>
 
@@ -37,9 +38,31 @@ public:
 	}
 
 	/**
-	 * @return the next byte
+	 * @return the next byte (0 if there is none)
 	 */
-	virtual uint8_t get() = 0;
+	uint8_t get() {
+		uint8_t c = 0;
+		read(&c,1);
+		return c;
+	}
+
+	/**
+	 * Reads at most <count> bytes into <buf>.
+	 *
+	 * @param buf the buffer to write to
+	 * @param count the maximum number of bytes
+	 * @return the number of read bytes (0 = end of data)
+	 */
+	virtual size_t read(uint8_t *buf,size_t count) = 0;
+
+	/**
+	 * Gives the bytes back that have been read beyond the end of the compressed stream. That is,
+	 * the next reads should return <buf> first. Inflate calls it at most once, at the end.
+	 *
+	 * @param buf the bytes
+	 * @param count the number of bytes
+	 */
+	virtual void unread(const uint8_t *buf,size_t count) = 0;
 };
 
 /**
@@ -58,19 +81,12 @@ public:
 	virtual CRC32::type crc32() = 0;
 
 	/**
-	 * Should return the previously written character, written <off> bytes ago.
+	 * Writes <count> bytes from <buf> to the drain.
 	 *
-	 * @param off the offset (at most 32*1024)
-	 * @return the character written <off> bytes ago
+	 * @param buf the data
+	 * @param count the number of bytes
 	 */
-	virtual uint8_t get(size_t off) = 0;
-
-	/**
-	 * Writes <c> to drain
-	 *
-	 * @param c the character to write
-	 */
-	virtual void put(uint8_t c) = 0;
+	virtual void write(const uint8_t *buf,size_t count) = 0;
 };
 
 /**
@@ -79,15 +95,34 @@ public:
 class FileInflateSource : public InflateSource {
 public:
 	explicit FileInflateSource(FILE *file)
-		: InflateSource(), _file(file) {
+		: InflateSource(), _file(file), _back(), _backpos(), _backsize() {
+	}
+	virtual ~FileInflateSource() {
+		delete[] _back;
 	}
 
-	virtual uint8_t get() {
-		return fgetc(_file);
+	virtual size_t read(uint8_t *buf,size_t count) {
+		if(_backpos < _backsize) {
+			size_t amount = std::min(count,_backsize - _backpos);
+			memcpy(buf,_back + _backpos,amount);
+			_backpos += amount;
+			return amount;
+		}
+		return fread(buf,1,count,_file);
+	}
+	virtual void unread(const uint8_t *buf,size_t count) {
+		delete[] _back;
+		_back = new uint8_t[count];
+		memcpy(_back,buf,count);
+		_backpos = 0;
+		_backsize = count;
 	}
 
 private:
 	FILE *_file;
+	uint8_t *_back;
+	size_t _backpos;
+	size_t _backsize;
 };
 
 /**
@@ -95,41 +130,23 @@ private:
  */
 class FileInflateDrain : public InflateDrain {
 public:
-	static const size_t BUF_SIZE	= 32 * 1024;	// has to be at least 32K
-
 	explicit FileInflateDrain(FILE *file)
-		: InflateDrain(), _crc(), _checksum(0), _file(file), _buf(new uint8_t[BUF_SIZE]), _wpos() {
-	}
-	virtual ~FileInflateDrain() {
-		delete[] _buf;
+		: InflateDrain(), _crc(), _checksum(0), _file(file) {
 	}
 
 	virtual CRC32::type crc32() {
-		if(_wpos > 0) {
-			_checksum = _crc.update(_checksum,_buf,_wpos);
-			_wpos = 0;
-		}
 		return _checksum;
 	}
 
-	virtual uint8_t get(size_t off) {
-		assert(off < BUF_SIZE);
-		return _buf[(_wpos - off) % BUF_SIZE];
-	}
-	virtual void put(uint8_t c) {
-		fputc(c,_file);
-		_buf[_wpos] = c;
-		_wpos = (_wpos + 1) % BUF_SIZE;
-		if(_wpos == 0)
-			_checksum = _crc.update(_checksum,_buf,BUF_SIZE);
+	virtual void write(const uint8_t *buf,size_t count) {
+		fwrite(buf,1,count,_file);
+		_checksum = _crc.update(_checksum,buf,count);
 	}
 
 private:
 	CRC32 _crc;
 	CRC32::type _checksum;
 	FILE *_file;
-	uint8_t *_buf;
-	size_t _wpos;
 };
 
 class MemInflateSource : public InflateSource {
@@ -138,10 +155,15 @@ public:
 		: _buffer(reinterpret_cast<uint8_t*>(buffer)), _size(size), _pos() {
 	}
 
-	virtual uint8_t get() {
-		if(_pos >= _size)
-			return 0;
-		return _buffer[_pos++];
+	virtual size_t read(uint8_t *buf,size_t count) {
+		size_t amount = std::min(count,_size - _pos);
+		memcpy(buf,_buffer + _pos,amount);
+		_pos += amount;
+		return amount;
+	}
+	virtual void unread(const uint8_t *,size_t count) {
+		assert(count <= _pos);
+		_pos -= count;
 	}
 
 private:
@@ -156,19 +178,22 @@ public:
 		: _buffer(reinterpret_cast<uint8_t*>(buffer)), _size(size), _pos() {
 	}
 
+	/**
+	 * @return the number of bytes written so far
+	 */
+	size_t count() const {
+		return _pos;
+	}
+
 	virtual CRC32::type crc32() {
 		CRC32 crc;
 		return crc.get(_buffer,_pos);
 	}
 
-	virtual uint8_t get(size_t off) {
-		assert(off <= _pos);
-		return _buffer[_pos - off];
-	}
-
-	virtual void put(uint8_t c) {
-		if(_pos < _size)
-			_buffer[_pos++] = c;
+	virtual void write(const uint8_t *buf,size_t count) {
+		size_t amount = std::min(count,_size - _pos);
+		memcpy(_buffer + _pos,buf,amount);
+		_pos += amount;
 	}
 
 private:
@@ -177,26 +202,75 @@ private:
 	size_t _pos;
 };
 
+/**
+ * Decompresses a raw deflate stream (RFC 1951). The huffman codes are decoded with lookup tables
+ * that are indexed by the next bits of the input. Codes that are longer than the primary table
+ * allows continue in a sub table. The bits are kept in a 64-bit buffer, which is refilled a word
+ * at a time while enough input is available.
+ */
 class Inflate : public DeflateBase {
-	struct Tree {
-		unsigned short table[16];  /* table of code length counts */
-		unsigned short trans[288]; /* code -> symbol translation table */
-	};
+	/* the number of bits used to index the primary tables */
+	static const uint LITLEN_BITS		= 10;
+	static const uint DIST_BITS			= 8;
+	static const uint PRECODE_BITS		= 7;
+
+	/* the maximum size of the tables, including all sub tables. the worst case is a chain of
+	 * codes with the lengths <bits>+1, ..., 15, 15 below as many primary entries as possible,
+	 * each requiring a sub table with 2^(15-<bits>) entries */
+	static const size_t LITLEN_ENOUGH	= (1 << LITLEN_BITS) + (288 / 6) * (1 << (15 - LITLEN_BITS));
+	static const size_t DIST_ENOUGH		= (1 << DIST_BITS) + (32 / 8) * (1 << (15 - DIST_BITS));
+
+	/* layout of a table entry. bits 0..4 contain the length of the code (relative to the primary
+	 * table for sub table entries), bits 8..12 the number of extra bits or, for a pointer to a
+	 * sub table, its number of bits. the upper 16 bits hold the literal, the base of the length
+	 * or distance or the offset of the sub table */
+	static const uint32_t E_LEN_MASK	= 0x1F;
+	static const uint32_t E_EXTRA_SHIFT	= 8;
+	static const uint32_t E_EXTRA_MASK	= 0x1F;
+	static const uint32_t E_LITERAL		= 1 << 13;
+	static const uint32_t E_EOB			= 1 << 14;
+	static const uint32_t E_SUBTABLE	= 1 << 15;
+	static const uint32_t E_VALUE_SHIFT	= 16;
+
+	static const size_t WSIZE			= 32 * 1024;
+	/* the amount of output that is collected before it is passed to the drain */
+	static const size_t OUT_SIZE		= 64 * 1024;
+	/* matches are copied word-wise and might therefore write a few bytes beyond their end */
+	static const size_t OUT_SLACK		= 16;
+	static const size_t IN_SIZE			= 16 * 1024;
+	static const size_t MAX_MATCH		= 258;
 
 	struct Data {
 		InflateSource *source;
-		unsigned int tag;
-		unsigned int bitcount;
-
 		InflateDrain *drain;
 
-		Tree ltree; /* dynamic length/symbol tree */
-		Tree dtree; /* dynamic distance tree */
+		uint64_t bitbuf;
+		uint bitcnt;
+		/* the number of zero-bytes that have been put into the bit buffer after the input ended */
+		uint overrun;
+
+		/* the input buffer. the bytes in front of <in> are kept when it is refilled, because they
+		 * might still be in the bit buffer */
+		const uint8_t *in;
+		const uint8_t *in_end;
+		uint8_t inbuf[sizeof(uint64_t) + IN_SIZE];
+
+		/* the output, which serves as the sliding window as well */
+		uint8_t *out;
+		uint8_t *flushed;
+		uint8_t *wend;
+		uint8_t window[WSIZE + OUT_SIZE + OUT_SLACK];
+
+		/* whether the tables contain the fixed codes at the moment */
+		bool fixed;
+		uint32_t littable[LITLEN_ENOUGH];
+		uint32_t disttable[DIST_ENOUGH];
 	};
 
 	enum {
 		OK		= 0,
-		FAILED	= -1
+		FAILED	= -1,
+		AGAIN	= 1,
 	};
 
 public:
@@ -215,30 +289,26 @@ public:
 	int uncompress(InflateDrain *drain,InflateSource *source);
 
 private:
-	void build_fixed_trees(Tree *lt,Tree *dt);
-	void build_tree(Tree *t,const unsigned char *lengths,unsigned int num);
-
-	void flush(Data *d);
-	void writebit(Data *d,int bit);
-	void write_bits(Data *d,unsigned int bits,int num);
-
-	int getbit(Data *d);
-	unsigned int read_bits(Data *d,int num,int base);
-	int decode_symbol(Data *d,Tree *t);
-	void decode_trees(Data *d,Tree *lt,Tree *dt);
-
-	int deflate_uncompressed_block(Data *d);
-
-	int inflate_block_data(Data *d,Tree *lt,Tree *dt);
+	bool build_table(uint32_t *table,size_t size,uint bits,const uint32_t *syms,
+		const uint8_t *lengths,uint num);
+	bool build_fixed_tables(Data *d);
+
+	void refill_input(Data *d);
+	void need(Data *d,uint num);
+	uint read_bits(Data *d,uint num,uint base);
+	uint32_t decode_symbol(Data *d,const uint32_t *table,uint bits);
+	bool decode_trees(Data *d);
+	void flush_window(Data *d);
+	void align(Data *d);
+
+	int inflate_fast(Data *d);
+	int inflate_block_data(Data *d);
 	int inflate_uncompressed_block(Data *d);
-	int inflate_fixed_block(Data *d);
-	int inflate_dynamic_block(Data *d);
-
-	Tree sltree; /* fixed length/symbol tree */
-	Tree sdtree; /* fixed distance tree */
 
-	/* special ordering of code length codes */
-	static const unsigned char clcidx[];
+	/* the table entries (without code length) for all symbols of the alphabets */
+	uint32_t litsyms[288];
+	uint32_t distsyms[32];
+	uint32_t precodesyms[19];
 };
 
 }
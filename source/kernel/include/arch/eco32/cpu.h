@@ -43,6 +43,12 @@ public:
 		return res;
 	}
 
+	/**
+	 * Hint for spin-wait loops. There is no such instruction, so it does nothing
+	 */
+	static void pause() {
+	}
+
 private:
 	static uint64_t cpuHz;
 };
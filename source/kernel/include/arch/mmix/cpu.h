@@ -151,6 +151,12 @@ public:
 	 */
 	static uint64_t getSpecial(int rno) asm("cpu_getSpecial");
 
+	/**
+	 * Hint for spin-wait loops. There is no such instruction, so it does nothing
+	 */
+	static void pause() {
+	}
+
 private:
 	static const char *specialRegs[33];
 	static uint64_t cpuHz;
@@ -43,10 +43,19 @@ public:
 	static void ackIntrpt();
 };
 
+inline uint64_t TimerBase::getMicros() {
+	/* the timer is periodic, so that we simply count the interrupts */
+	return (uint64_t)getIntrptCount() * (1000000 / FREQUENCY_DIV);
+}
+
 inline void TimerBase::getTimeval(struct timeval *tv) {
-	time_t time = Timer::getRuntime();
-	tv->tv_sec = time / 1000;
-	tv->tv_usec = time % 1000;
+	uint64_t usecs = getMicros();
+	tv->tv_sec = usecs / 1000000;
+	tv->tv_usec = usecs % 1000000;
+}
+
+inline void TimerBase::program(uint64_t,uint64_t) {
+	/* nothing to do; the timer is periodic */
 }
 
 inline void TimerBase::archInit() {
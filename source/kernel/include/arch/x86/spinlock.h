@@ -23,17 +23,23 @@
 #include <atomic.h>
 #include <cpu.h>
 
-#if !DEBUG_LOCKS
+#if !DEBUG_LOCKS && !LOCK_STATS
 inline void SpinLock::down() {
-	while(!Atomic::cmpnswap(&lock, 0, 1))
+	uint16_t ticket = Atomic::fetch_and_add(&next,1);
+	while(owner != ticket)
 		CPU::pause();
 }
 
 inline bool SpinLock::tryDown() {
-	return Atomic::cmpnswap(&lock, 0, 1);
+	/* we can only get it, if nobody holds it and nobody waits for it */
+	uint16_t cur = owner;
+	return Atomic::cmpnswap(&next,cur,(uint16_t)(cur + 1));
 }
 #endif
 
+#if !DEBUG_LOCKS
 inline void SpinLock::up() {
-	asm volatile ("movl	$0,%0" : : "m"(lock) : "memory");
+	/* only the holder writes <owner>, so that we don't need an atomic operation */
+	asm volatile ("incw	%0" : "+m"(owner) : : "memory");
 }
+#endif
@@ -30,6 +30,8 @@ class Timer : public TimerBase {
 	static const uint64_t TOLERANCE			= 1000000;
 	static const int MEASURE_COUNT			= 5;
 	static const int REQUIRED_MATCHES		= 3;
+	/* the maximum delay in microseconds to program the LAPIC with, to prevent overflows */
+	static const uint64_t MAX_DELAY			= 1000000;
 
 public:
 	/**
@@ -58,11 +60,16 @@ private:
 	static uint64_t bootTSC;
 	static time_t bootTime;
 	static uint64_t cpuMhz;
+	/* whether the LAPIC is used in one-shot mode (otherwise, the PIT is used periodically) */
+	static bool oneshot;
 };
 
+inline uint64_t TimerBase::getMicros() {
+	return cyclesToTime(CPU::rdtsc() - Timer::bootTSC);
+}
+
 inline void TimerBase::getTimeval(struct timeval *tv) {
-	uint64_t tsc = CPU::rdtsc();
-	uint64_t usecs = cyclesToTime(tsc - Timer::bootTSC);
+	uint64_t usecs = getMicros();
 	tv->tv_sec = Timer::bootTime + usecs / 1000000;
 	tv->tv_usec = usecs % 1000000;
 }
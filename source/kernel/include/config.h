@@ -40,6 +40,7 @@ public:
 		TICKS_PER_SEC,
 		FORCE_PIT,
 		FORCE_PIC,
+		LEND_PAGES,
 	};
 
 	/**
@@ -75,6 +76,7 @@ private:
 	static bool smp;
 	static bool forcePIT;
 	static bool forcePIC;
+	static bool lendPages;
 	static char rootDev[];
 	static char swapDev[];
 };
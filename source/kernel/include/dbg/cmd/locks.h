@@ -24,7 +24,7 @@
 class OStream;
 
 /**
- * Lets the user enable/disable locks
+ * Lets the user enable/disable locks and, with LOCK_STATS, view or reset the lock statistics
  *
  * @param os the output-stream
  * @param argc the number of args
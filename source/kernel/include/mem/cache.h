@@ -27,6 +27,11 @@ class OStream;
 class Cache {
 	Cache() = delete;
 
+	static const size_t CACHE_COUNT		= 11;
+	/* the max. number of objects per magazine and the max. number of bytes in a magazine */
+	static const size_t MAG_SIZE		= 16;
+	static const size_t MAG_BYTES		= 16 * 1024;
+
 	struct Entry {
 		const size_t objSize;
 		size_t totalObjs;
@@ -34,7 +39,27 @@ class Cache {
 		void *freeList;
 	};
 
+	/* a small stack of free objects of one size, owned by one CPU */
+	struct Magazine {
+		size_t count;
+		size_t allocs;
+		size_t allocHits;
+		size_t frees;
+		size_t freeHits;
+		void *objs[MAG_SIZE];
+	};
+
+	struct CPUCache {
+		Magazine mags[CACHE_COUNT];
+	};
+
 public:
+	/**
+	 * Enables the per-CPU magazines. Before that, all objects are taken from the global freelists.
+	 * Should be called as soon as all CPUs are running and know their id.
+	 */
+	static void initMagazines();
+
 	/**
 	 * Allocates <size> bytes from the cache
 	 *
@@ -99,12 +124,17 @@ public:
 
 private:
 	static size_t totalObjSize(size_t sz);
+	static size_t magCapacity(size_t i);
+	static size_t magObjs(size_t i);
 	static void printBar(OStream &os,size_t mem,size_t maxMem,size_t total,size_t free);
 	static void *get(Entry *c,size_t i);
+	static ulong *take(Entry *c,size_t i);
+	static void put(Entry *c,ulong *area);
 
 #if DEBUGGING
 	static bool aafEnabled;
 #endif
 	static SpinLock lock;
-	static Entry caches[];
+	static Entry caches[CACHE_COUNT];
+	static CPUCache *cpuCaches;
 };
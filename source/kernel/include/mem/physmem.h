@@ -165,6 +165,15 @@ public:
 	 */
 	static bool reserve(size_t frameCount,bool swap);
 
+	/**
+	 * Reserves <frameCount> frames, if they are available without swapping. In contrast to
+	 * reserve(), nothing is reserved if that's not the case.
+	 *
+	 * @param frameCount the number of frames you need
+	 * @return true on success
+	 */
+	static bool tryReserve(size_t frameCount);
+
 	/**
 	 * Allocates one frame. Assumes that it is available. You should announce it with reserve()
 	 * first!
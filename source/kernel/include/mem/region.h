@@ -149,6 +149,33 @@ public:
 		timestamp = ts;
 	}
 
+	/**
+	 * @return the expected access pattern (MADV_*)
+	 */
+	int getAdvice() const {
+		return advice;
+	}
+	void setAdvice(int adv) {
+		advice = adv;
+		raNext = 0;
+		raPages = 0;
+	}
+
+	/**
+	 * The read-ahead state: the page that is expected to fault next, if the region is accessed
+	 * sequentially, and the number of pages that have been loaded ahead the last time.
+	 */
+	size_t getReadAheadNext() const {
+		return raNext;
+	}
+	size_t getReadAheadPages() const {
+		return raPages;
+	}
+	void setReadAhead(size_t next,size_t pages) {
+		raNext = next;
+		raPages = pages;
+	}
+
 	/**
 	 * @return the flags of the given page
 	 */
@@ -255,6 +282,9 @@ private:
 	ISList<VirtMem*> vms;
 	Mutex lock;				/* lock for the procs-field (all others can't change or belong to
 	 	 	 	 	 	 	   exactly 1 process, which is locked anyway) */
+	int advice;				/* the expected access pattern (MADV_*) */
+	size_t raNext;			/* the read-ahead state for demand-loading */
+	size_t raPages;
 };
 
 inline ulong Region::getSwapBlock(size_t pageIndex) const {
@@ -53,6 +53,11 @@
 #define MAP_PHYS_ALLOC		0
 #define MAP_PHYS_MAP		1
 
+#define MADV_NORMAL			0
+#define MADV_RANDOM			1
+#define MADV_SEQUENTIAL		2
+#define MADV_WILLNEED		3
+
 class Proc;
 class Thread;
 class OStream;
@@ -62,6 +67,11 @@ class OpenFile;
 class VirtMem : public SListItem {
 	friend class ProcBase;
 
+	/* the aligned window of pages that is loaded around a demand-load fault */
+	static const size_t FAULT_AROUND_PAGES	= 16;
+	/* the maximum number of pages to read ahead for sequential faults */
+	static const size_t READ_AHEAD_MAX		= 32;
+
 public:
 	/**
 	 * Tries to handle a page-fault for the given address. That means, loads a page on demand, zeros
@@ -203,6 +213,16 @@ public:
 	 */
 	int lockall();
 
+	/**
+	 * Sets the expected access pattern for the region @ <addr>. MADV_WILLNEED loads the pages that
+	 * are not present yet immediately, as far as that's possible without swapping.
+	 *
+	 * @param addr the virtual address
+	 * @param advice the advice (MADV_*)
+	 * @return 0 on success
+	 */
+	int advise(uintptr_t addr,int advice);
+
 	/**
 	 * This is a helper-function for determining the real memory-usage of all processes. It counts
 	 * the number of present frames in all regions of the given process and divides them for each
@@ -226,6 +246,17 @@ public:
 	 */
 	ssize_t getShareInfo(uintptr_t addr,char *path,size_t size);
 
+	/**
+	 * Determines the frames of the <count> pages starting at <addr>. The region has to be locked
+	 * into memory, so that the frames don't change until it is unmapped.
+	 *
+	 * @param addr the virtual address (page aligned)
+	 * @param frames the array to write the frame numbers to
+	 * @param count the number of pages
+	 * @return 0 on success
+	 */
+	int getFrames(uintptr_t addr,frameno_t *frames,size_t count);
+
 	/**
 	 * Gets the region at given address
 	 *
@@ -293,6 +324,30 @@ public:
 	 */
 	int join(uintptr_t srcAddr,VirtMem *dst,VMRegion **nvm,uintptr_t *dstVirt,ulong flags);
 
+	/**
+	 * Lends the pages that contain <srcAddr>..<srcAddr>+<bytes> of this virtmem (current) to <dst>.
+	 * That is, the same frames are mapped into a new region of <dst>, until unlend() is called.
+	 * Before that, all pages are faulted in (and copied, if they are copy-on-write and <write> is
+	 * true). This is only supported for private regions and without swapping, because the frames
+	 * have to stay where they are.
+	 *
+	 * @param srcAddr the virtual address in this virtmem
+	 * @param bytes the number of bytes
+	 * @param dst the destination-virtmem
+	 * @param write whether <dst> should be able to write to the pages
+	 * @param nvm will be set to the created region
+	 * @return the address in <dst> that corresponds to <srcAddr> or 0 if it failed
+	 */
+	uintptr_t lend(uintptr_t srcAddr,size_t bytes,VirtMem *dst,bool write,VMRegion **nvm);
+
+	/**
+	 * Removes the region <vm> at <virt> that has been created by lend(), if it still exists.
+	 *
+	 * @param virt the virtual address of the region
+	 * @param vm the region
+	 */
+	void unlend(uintptr_t virt,VMRegion *vm);
+
 	/**
 	 * Clones all regions of this virtmem (current) into the destination-virtmem
 	 *
@@ -404,7 +459,9 @@ private:
 	void doUnmap(VMRegion *vm);
 	size_t doGrow(VMRegion *vm,ssize_t amount);
 	int demandLoad(VMRegion *vm,uintptr_t addr);
-	int loadFromFile(VMRegion *vm,uintptr_t addr,size_t loadCount);
+	void getLoadWindow(VMRegion *vm,size_t page,size_t *first,size_t *count);
+	int loadFromFile(VMRegion *vm,size_t first,size_t count);
+	void mapLoaded(VMRegion *vm,uintptr_t addr,frameno_t frame);
 	uintptr_t findFreeStack(size_t byteCount,ulong rflags);
 	bool isOccupied(uintptr_t start,uintptr_t end) const;
 	uintptr_t getFirstUsableAddr() const;
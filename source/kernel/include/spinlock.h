@@ -22,18 +22,46 @@
 #include <common.h>
 
 #define DEBUG_LOCKS		0
+/* whether to count acquisitions, contended acquisitions and spin-cycles per call-site of down()
+ * (x86 only; the other architectures are uniprocessor) */
+#define LOCK_STATS		0
 
+class OStream;
+
+/**
+ * A ticket-lock: a CPU that wants to acquire the lock draws a ticket and spins until its ticket is
+ * served. Thus, the lock is granted in FIFO order and waiters only read the lock while spinning,
+ * instead of hammering it with atomic operations.
+ */
 class SpinLock {
 public:
-	explicit SpinLock() : lock(0) {
+	explicit SpinLock() : owner(0), next(0) {
 	}
 
 	void down();
 	bool tryDown();
 	void up();
 
+#if LOCK_STATS
+	/**
+	 * Prints the statistics of all call-sites of SpinLock::down()
+	 *
+	 * @param os the output-stream
+	 */
+	static void printStats(OStream &os);
+
+	/**
+	 * Resets the statistics
+	 */
+	static void resetStats();
+#endif
+
 private:
-	uint lock;
+	/* the ticket that is currently served. this has to be the first field, because the thread-switch
+	 * code releases a lock by incrementing it */
+	volatile uint16_t owner;
+	/* the next ticket to hand out */
+	volatile uint16_t next;
 };
 
 #if defined(__x86__)
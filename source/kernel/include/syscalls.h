@@ -74,6 +74,8 @@ private:
 	// driver
 	static int createdev(Thread *t,IntrptStackFrame *stack);
 	static int getwork(Thread *t,IntrptStackFrame *stack);
+	static int getworkv(Thread *t,IntrptStackFrame *stack);
+	static int sendv(Thread *t,IntrptStackFrame *stack);
 	static int bindto(Thread *t,IntrptStackFrame *stack);
 
 	// io
@@ -117,6 +119,8 @@ private:
 	static int mmapphys(Thread *t,IntrptStackFrame *stack);
 	static int mlock(Thread *t,IntrptStackFrame *stack);
 	static int mlockall(Thread *t,IntrptStackFrame *stack);
+	static int madvise(Thread *t,IntrptStackFrame *stack);
+	static int virt2phys(Thread *t,IntrptStackFrame *stack);
 
 	// proc
 	static int getpid(Thread *t,IntrptStackFrame *stack);
@@ -153,6 +157,7 @@ private:
 	static int sleep(Thread *t,IntrptStackFrame *stack);
 	static int yield(Thread *t,IntrptStackFrame *stack);
 	static int join(Thread *t,IntrptStackFrame *stack);
+	static int setaffinity(Thread *t,IntrptStackFrame *stack);
 	static int semcrt(Thread *t,IntrptStackFrame *stack);
 	static int semcrtirq(Thread *t,IntrptStackFrame *stack);
 	static int semop(Thread *t,IntrptStackFrame *stack);
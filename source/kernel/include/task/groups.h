@@ -65,6 +65,16 @@ public:
 	 */
 	static size_t get(pid_t pid,gid_t *list,size_t count);
 
+	/**
+	 * Copies the group-ids from the given process into the given kernel buffer.
+	 *
+	 * @param pid the process-id
+	 * @param list the destination list
+	 * @param count the number of items in the list
+	 * @return the number of groups or -1 if the process has more than <count> groups
+	 */
+	static ssize_t copy(pid_t pid,gid_t *list,size_t count);
+
 	/**
 	 * Checks whether the groups of process <p> contain <gid>.
 	 *
@@ -24,6 +24,8 @@
 #include <col/dlist.h>
 #include <spinlock.h>
 
+#define MAX_PRIO				4
+
 /* the events we can wait for */
 enum {
 	EV_NOEVENT,
@@ -73,10 +75,11 @@ public:
 	static void wakeup(uint event,evobj_t object,bool all = true);
 
 	/**
-	 * @return the current ready-mask. 1 bit per priority.
+	 * @param cpu the CPU
+	 * @return the current ready-mask of the given CPU. 1 bit per priority.
 	 */
-	static ulong getReadyMask() {
-		return readyMask;
+	static ulong getReadyMask(cpuid_t cpu) {
+		return rqs[cpu].readyMask;
 	}
 
 	/**
@@ -100,6 +103,16 @@ public:
 	 */
 	static void unblockQuick(Thread *t);
 
+	/**
+	 * Sets the CPUs the given thread may run on. If it is on a CPU that is not allowed anymore, it
+	 * is moved to one of the allowed CPUs as soon as that CPU schedules next.
+	 *
+	 * @param t the thread
+	 * @param mask the CPU-mask (bit n = CPU n)
+	 * @return 0 on success
+	 */
+	static int setAffinity(Thread *t,ulong mask);
+
 	/**
 	 * Prints the status of the scheduler
 	 *
@@ -121,6 +134,23 @@ public:
 	static const char *getEventName(uint event);
 
 private:
+	/**
+	 * The ready-queues of one CPU. Each thread belongs to the run-queue of the CPU it ran on last
+	 * (Thread::getCPU()) and the lock of that run-queue protects the state of the thread.
+	 */
+	struct RunQueue {
+		/* protects the queues and the state of all threads of this CPU */
+		SpinLock lock;
+		/* held while this CPU is switching threads, i.e. while the old thread is not saved yet */
+		SpinLock switchLock;
+		ulong readyMask;
+		size_t count;
+		/* the number of threads in the queues that are not allowed to run on this CPU */
+		size_t misplaced;
+		Thread *idle;
+		DList<Thread> queues[MAX_PRIO + 1];
+	};
+
 	/**
 	 * Adds the given thread as an idle-thread to the scheduler
 	 *
@@ -145,26 +175,104 @@ private:
 	 */
 	static void adjustPrio(Thread *t,uint64_t total);
 
+	/**
+	 * @param cpu the CPU
+	 * @return the lock that has to be held while switching threads on the given CPU
+	 */
+	static SpinLock *getSwitchLock(cpuid_t cpu) {
+		return &rqs[cpu].switchLock;
+	}
+
+	/**
+	 * Locks the run-queue the given thread belongs to. Since the thread might be migrated to a
+	 * different CPU in the meantime, this is repeated until the locked run-queue is still the
+	 * one of the thread.
+	 *
+	 * @param t the thread
+	 * @return the locked run-queue
+	 */
+	static RunQueue *lockThread(const Thread *t);
+
+	/**
+	 * Locks the given run-queue of another CPU, if that is possible without waiting for long.
+	 * This includes the switch-lock to ensure that all threads in the queue have been saved.
+	 *
+	 * @param rq the run-queue
+	 * @return true if both locks have been acquired
+	 */
+	static bool lockRemote(RunQueue *rq);
+
+	/**
+	 * Picks the next thread to run from the given run-queue, using the ready-mask to find the
+	 * highest priority. <old> is only taken if there is nothing else.
+	 *
+	 * @param rq the locked run-queue of <cpu>
+	 * @param cpu the CPU
+	 * @param old the old thread (may be NULL)
+	 * @return the thread or NULL
+	 */
+	static Thread *pick(RunQueue *rq,cpuid_t cpu,Thread *old);
+
+	/**
+	 * Steals the thread with the highest priority from another CPU. Expects that the run-queue of
+	 * <cpu> is locked.
+	 *
+	 * @param cpu the current CPU
+	 * @return the thread or NULL if there is nothing to steal
+	 */
+	static Thread *steal(cpuid_t cpu);
+
+	/**
+	 * Moves all threads that are on the run-queues of CPUs they are not allowed to run on, but may
+	 * run on <cpu> to the run-queue of <cpu>. Expects that the run-queue of <cpu> is locked.
+	 *
+	 * @param cpu the current CPU
+	 */
+	static void pullMisplaced(cpuid_t cpu);
+
+	/**
+	 * @param t the thread
+	 * @param cpu the CPU
+	 * @return true if <t> may run on <cpu>
+	 */
+	static bool isAllowed(const Thread *t,cpuid_t cpu);
+
+	/**
+	 * @param t the thread
+	 * @return the CPU that should run <t>
+	 */
+	static cpuid_t targetCPU(const Thread *t);
+
+	/**
+	 * Makes sure that somebody runs a thread that has just been put on the run-queue of <cpu>.
+	 *
+	 * @param cpu the CPU
+	 */
+	static void kickCPU(cpuid_t cpu);
+
 	/**
 	 * Appends the given thread on the ready-queue and sets the state to Thread::READY
 	 *
+	 * @param rq the run-queue of the thread
 	 * @param t the thread
 	 */
-	static void setReady(Thread *t);
+	static void setReady(RunQueue *rq,Thread *t);
 
 	/**
 	 * Puts the given thread to the beginning of the ready-queue
 	 *
+	 * @param rq the run-queue of the thread
 	 * @param t the thread
 	 */
-	static void setReadyQuick(Thread *t);
+	static void setReadyQuick(RunQueue *rq,Thread *t);
 
 	/**
 	 * Sets the thread in the blocked-state
 	 *
+	 * @param rq the run-queue of the thread
 	 * @param t the thread
 	 */
-	static void setBlocked(Thread *t);
+	static void setBlocked(RunQueue *rq,Thread *t);
 
 	/**
 	 * Removes the given thread from the scheduler (depending on the state)
@@ -173,35 +281,40 @@ private:
 	 */
 	static void removeThread(Thread *t);
 
-	static void enqueue(Thread *t);
-	static void enqueueQuick(Thread *t);
-	static void dequeue(Thread *t);
+	static void enqueue(RunQueue *rq,Thread *t);
+	static void enqueueQuick(RunQueue *rq,Thread *t);
+	static void dequeue(RunQueue *rq,Thread *t);
 	static void removeFromEventlist(Thread *t);
 	static bool setReadyState(Thread *t);
 	static void print(OStream &os,DList<Thread> *q);
 
+	/* protects the event-lists. has to be acquired before the lock of a run-queue */
 	static SpinLock lock;
-	static ulong readyMask;
-	static DList<Thread> rdyQueues[];
+	static RunQueue *rqs;
+	/* the total number of misplaced threads */
+	static size_t misplaced;
 	static DList<Thread> evlists[EV_COUNT];
-	static size_t rdyCount;
-	static Thread **idleThreads;
 };
 
 inline void Sched::block(Thread *t) {
 	assert(t != NULL);
-	LockGuard<SpinLock> g(&lock);
-	setBlocked(t);
+	RunQueue *rq = lockThread(t);
+	setBlocked(rq,t);
+	rq->lock.up();
 }
 
 inline void Sched::unblock(Thread *t) {
 	assert(t != NULL);
 	LockGuard<SpinLock> g(&lock);
-	setReady(t);
+	RunQueue *rq = lockThread(t);
+	setReady(rq,t);
+	rq->lock.up();
 }
 
 inline void Sched::unblockQuick(Thread *t) {
 	assert(t != NULL);
 	LockGuard<SpinLock> g(&lock);
-	setReadyQuick(t);
+	RunQueue *rq = lockThread(t);
+	setReadyQuick(rq,t);
+	rq->lock.up();
 }
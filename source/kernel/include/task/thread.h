@@ -34,7 +34,6 @@
 #define MAX_STACK_PAGES			128
 #define INITIAL_STACK_PAGES		1
 
-#define MAX_PRIO				4
 /* if a thread was blocked less than BAD_BLOCKED_TIME(t), the priority is lowered */
 #define BAD_BLOCK_TIME(total)	((total) / 6)
 /* if a thread was blocked more than GOOD_BLOCKED_TIME(t), the priority is raised again */
@@ -282,6 +281,12 @@ public:
 	void setCPU(cpuid_t cpu) {
 		this->cpu = cpu;
 	}
+	/**
+	 * @return the CPUs this thread may run on (bit n = CPU n)
+	 */
+	ulong getAffinity() const {
+		return affinity;
+	}
 
 	/**
 	 * @return the stack region with given number
@@ -311,7 +316,7 @@ public:
 	 * @return true if so
 	 */
 	bool haveHigherPrio() {
-		ulong mask = Sched::getReadyMask();
+		ulong mask = Sched::getReadyMask(cpu);
 		return mask & ~((1UL << (priority + 1)) - 1);
 	}
 
@@ -453,6 +458,15 @@ public:
 	 */
 	bool reserveFrames(size_t count,bool swap = true);
 
+	/**
+	 * Reserves up to <count> additional frames for this thread, if they are available without
+	 * swapping. In contrast to reserveFrames(), the already reserved frames are kept on failure.
+	 *
+	 * @param count the number of frames to reserve
+	 * @return the number of frames that have been reserved
+	 */
+	size_t tryReserveFrames(size_t count);
+
 	/**
 	 * Removes one frame from the collection of frames of this thread. This will always succeed,
 	 * because the function assumes that you have called reserveFrames() previously.
@@ -588,6 +602,8 @@ protected:
 	/* the next state it will receive on context-switch */
 	uint8_t newState;
 	cpuid_t cpu;
+	/* the CPUs we may run on */
+	ulong affinity;
 	/* the stack-region(s) for this thread */
 	VMRegion *stackRegions[STACK_REG_COUNT];
 	/* thread-directory in VFS */
@@ -28,31 +28,34 @@ class OStream;
 class TimerBase {
 	TimerBase() = delete;
 
-	/* an entry in the listener-list */
+	/* an entry in the listener-heap */
 	struct Listener {
 		tid_t tid;
-		/* difference to the previous listener */
-		time_t time;
 		/* if true, the thread is blocked during that time. otherwise it can run and will not be waked
 		 * up, but gets a signal (SIGALRM) */
 		bool block;
-		Listener *next;
+		/* the absolute time in microseconds at which the listener fires */
+		uint64_t deadline;
 	};
 
 	struct PerCPU {
-		/* total elapsed milliseconds */
-		time_t elapsedMsecs;
-		time_t lastResched;
+		/* the time in microseconds of the last reschedule */
+		uint64_t lastResched;
 		size_t timerIntrpts;
+		/* whether the CPU runs its idle-thread */
+		bool idle;
 	};
 
-	static const size_t LISTENER_COUNT		= 1024;
+	/* the initial number of heap-slots; the heap grows on demand */
+	static const size_t INITIAL_LISTENERS	= 64;
 
 public:
-	/* timer period = 5ms */
+	/* timer period = 5ms (if the timer is periodic) */
 	static const unsigned FREQUENCY_DIV		= 200;
 	/* time-slice for a thread (60ms) */
 	static const unsigned TIMESLICE			= ((1000 / FREQUENCY_DIV) * 4);
+	/* the deadline for "no deadline" */
+	static const uint64_t NO_DEADLINE		= ~0ULL;
 
 	/**
 	 * Initializes the timer
@@ -67,10 +70,15 @@ public:
 	}
 
 	/**
-	 * @return the kernel-internal timestamp; starts from zero, in milliseconds, increased by timer-irq
+	 * @return the kernel-internal timestamp; starts from zero, in microseconds
+	 */
+	static uint64_t getMicros();
+
+	/**
+	 * @return the kernel-internal timestamp; starts from zero, in milliseconds
 	 */
 	static time_t getRuntime() {
-		return perCPU[0].elapsedMsecs;
+		return getMicros() / 1000;
 	}
 
 	/**
@@ -100,23 +108,41 @@ public:
 	static uint64_t timeToCycles(uint us);
 
 	/**
-	 * Puts the given thread to sleep for the given number of milliseconds
+	 * Puts the given thread to sleep for the given number of microseconds. A thread can have at most
+	 * one blocking and one non-blocking listener; an existing one of the same kind is replaced.
 	 *
 	 * @param tid the thread-id
-	 * @param msecs the number of milliseconds to wait
+	 * @param usecs the number of microseconds to wait
 	 * @param block whether to block the thread or not (if so, it will be waked up, otherwise it gets
 	 *  SIGALRM)
 	 * @return 0 on success
 	 */
-	static int sleepFor(tid_t tid,time_t msecs,bool block);
+	static int sleepFor(tid_t tid,uint64_t usecs,bool block);
 
 	/**
-	 * Removes the given thread from the timer
+	 * Removes all listeners of the given thread from the timer
 	 *
 	 * @param tid the thread-id
 	 */
 	static void removeThread(tid_t tid);
 
+	/**
+	 * Removes the blocking or non-blocking listener of the given thread from the timer
+	 *
+	 * @param tid the thread-id
+	 * @param block whether to remove the blocking listener
+	 */
+	static void removeThread(tid_t tid,bool block);
+
+	/**
+	 * Notifies the timer that the current CPU starts to run a new thread. This starts a new
+	 * time-slice and programs the timer of this CPU accordingly.
+	 *
+	 * @param cpu the current CPU
+	 * @param idle whether the new thread is the idle-thread
+	 */
+	static void schedule(cpuid_t cpu,bool idle);
+
 	/**
 	 * Handles a timer-interrupt
 	 *
@@ -136,14 +162,28 @@ private:
 	 * Inits the architecture-dependent part of the timer
 	 */
 	static void archInit();
+	/**
+	 * Programs the timer of the current CPU to fire at <deadline>. Does nothing, if the timer is
+	 * periodic.
+	 *
+	 * @param now the current time in microseconds
+	 * @param deadline the absolute time in microseconds (NO_DEADLINE = stop the timer)
+	 */
+	static void program(uint64_t now,uint64_t deadline);
+
+	static void rearm(cpuid_t cpu,uint64_t now);
+	static void remove(size_t pos);
+	static void siftUp(size_t pos);
+	static void siftDown(size_t pos);
+	static void place(size_t pos,const Listener &l);
 
 	static SpinLock lock;
 	static PerCPU *perCPU;
 	static time_t lastRuntimeUpdate;
-	static Listener listenObjs[LISTENER_COUNT];
-	static Listener *freeList;
-	/* processes that should be waked up to a specified time */
-	static Listener *listener;
+	/* min-heap of the threads that should be waked up (or notified) at a specified time */
+	static Listener *heap;
+	static size_t heapSize;
+	static size_t heapCapacity;
 };
 
 #if defined(__x86__)
@@ -23,12 +23,27 @@
 #include <vfs/node.h>
 #include <col/slist.h>
 
+class VMRegion;
+
 class VFSChannel : public VFSNode {
 	struct Message : public SListItem {
 		msgid_t id;
 		size_t length;
 	};
 
+	/* the pages of a client that are lent to the driver during a read or write */
+	struct Loan {
+		explicit Loan() : drv(), vm(), addr() {
+		}
+
+		Proc *drv;
+		VMRegion *vm;
+		uintptr_t addr;
+	};
+
+	/* the minimum number of bytes to lend the pages instead of copying them */
+	static const size_t LEND_MIN_SIZE	= PAGE_SIZE * 4;
+
 public:
 	/**
 	 * Creates a new channel for given process
@@ -159,6 +174,8 @@ protected:
 
 private:
 	static Message *getMsg(SList<Message> *list,msgid_t mid,ushort flags);
+	ssize_t lend(pid_t pid,const void *buffer,size_t count,bool write,Loan *loan);
+	static void unlend(pid_t pid,Loan *loan);
 	uint getReceiveFlags() const;
 	int isSupported(int op) const;
 	int openForDriver();
@@ -0,0 +1,145 @@
+/**
+ * $Id$
+ * Copyright (C) 2008 - 2014 Nils Asmussen
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#pragma once
+
+#include <common.h>
+#include <vfs/openfile.h>
+#include <vfs/node.h>
+#include <spinlock.h>
+#include <ostream.h>
+#include <sys/stat.h>
+
+/**
+ * Caches the results of path lookups on mounted filesystems, so that repeated stats and failing
+ * opens can be answered without a round-trip to the fs driver. The entries are keyed by the fs
+ * device, the path relative to the mount point and the user, group and supplementary groups of
+ * the requester (the driver performs the permission checks). Besides the attributes, non-existing
+ * paths are cached as well.
+ *
+ * The kernel invalidates the entries on all changes it forwards to the driver. Changes it can't
+ * see are announced by the driver via MSG_FS_INVALIDATE. Additionally, all entries expire after
+ * a short time.
+ */
+class VFSFSCache {
+	VFSFSCache() = delete;
+
+	/* the number of entries and the associativity */
+	static const size_t ENTRY_COUNT		= 256;
+	static const size_t WAYS			= 2;
+	/* longer paths are not cached */
+	static const size_t PATH_LEN		= 96;
+	/* the time in milliseconds after which entries expire */
+	static const time_t TTL				= 1000;
+	/* the number of buckets to count the cached inodes in */
+	static const size_t INO_BUCKETS		= 64;
+	/* the lookups of processes with more supplementary groups are not cached */
+	static const size_t MAX_GROUPS		= 8;
+
+	struct Creds {
+		uid_t uid;
+		gid_t gid;
+		size_t groupCount;
+		gid_t groups[MAX_GROUPS];
+	};
+
+	struct Entry {
+		/* the node-number of the fs device; 0 means unused */
+		ino_t dev;
+		Creds creds;
+		time_t expires;
+		/* 0 or -ENOENT */
+		int err;
+		struct stat info;
+		char path[PATH_LEN];
+	};
+
+public:
+	/**
+	 * Searches for the given path.
+	 *
+	 * @param pid the process-id
+	 * @param fsFile the channel to the fs instance
+	 * @param path the path in the real filesystem
+	 * @param info will be filled on success (may be NULL)
+	 * @param err will be set to 0 or -ENOENT if found
+	 * @return true if found
+	 */
+	static bool lookup(pid_t pid,OpenFile *fsFile,const char *path,struct stat *info,int *err);
+
+	/**
+	 * Stores the result of a lookup of <path>
+	 *
+	 * @param pid the process-id
+	 * @param fsFile the channel to the fs instance
+	 * @param path the path in the real filesystem
+	 * @param info the attributes, if <err> is 0
+	 * @param err the result (only 0 and -ENOENT are cached)
+	 */
+	static void insert(pid_t pid,OpenFile *fsFile,const char *path,const struct stat *info,int err);
+
+	/**
+	 * Removes the entries for <path>, the paths below it, its parent directory and the other
+	 * paths that refer to the same inode.
+	 *
+	 * @param fsFile the channel to the fs instance
+	 * @param path the path in the real filesystem
+	 */
+	static void invalidate(OpenFile *fsFile,const char *path);
+
+	/**
+	 * Removes all entries that refer to the given inode.
+	 *
+	 * @param dev the node-number of the fs device
+	 * @param ino the inode-number (-1 = all entries of that device)
+	 */
+	static void invalidate(ino_t dev,ino_t ino);
+
+	/**
+	 * Prints the statistics
+	 *
+	 * @param os the output-stream
+	 */
+	static void print(OStream &os);
+
+	/**
+	 * @param fsFile the channel to the fs instance (or a file on it)
+	 * @return the node-number of the fs device
+	 */
+	static ino_t devOf(OpenFile *fsFile) {
+		return fsFile->getNode()->getParent()->getNo();
+	}
+
+private:
+	static bool getCreds(pid_t pid,Creds *creds);
+	static bool sameCreds(const Creds *c1,const Creds *c2);
+	static Entry *find(ino_t dev,const Creds *creds,const char *path,size_t len);
+	static void release(Entry *e);
+	static void remove(Entry *e);
+	static size_t set(ino_t dev,const char *path,size_t len);
+
+	static Entry entries[ENTRY_COUNT];
+	static SpinLock lock;
+	static ulong hits;
+	static ulong negHits;
+	static ulong misses;
+	static ulong invalidations;
+	/* the number of positive entries per inode-bucket */
+	static uint inoRefs[INO_BUCKETS];
+};
@@ -53,6 +53,10 @@ class VFSInfo {
 	static void statsReadCallback(VFSNode *node,size_t *dataSize,void **buffer);
 	static void memUsageReadCallback(VFSNode *node,size_t *dataSize,void **buffer);
 	static void irqsReadCallback(VFSNode *node,size_t *dataSize,void **buffer);
+	static void fsCacheReadCallback(VFSNode *node,size_t *dataSize,void **buffer);
+#if LOCK_STATS
+	static void lockStatsReadCallback(VFSNode *node,size_t *dataSize,void **buffer);
+#endif
 
 public:
 	/**
@@ -70,6 +74,10 @@ public:
 	GEN_INFO_FILECLASS(StatsFile,"stats",statsReadCallback);
 	GEN_INFO_FILECLASS(MemUsageFile,"memusage",memUsageReadCallback);
 	GEN_INFO_FILECLASS(IRQsFile,"irqs",irqsReadCallback);
+	GEN_INFO_FILECLASS(FSCacheFile,"fscache",fsCacheReadCallback);
+#if LOCK_STATS
+	GEN_INFO_FILECLASS(LockStatsFile,"lockstats",lockStatsReadCallback);
+#endif
 
 	static ssize_t readHelper(pid_t pid,VFSNode *node,void *buffer,off_t offset,
 			size_t count,size_t dataSize,read_func callback);
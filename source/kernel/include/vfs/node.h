@@ -511,7 +511,13 @@ protected:
 private:
 	static int createFile(pid_t pid,const char *path,VFSNode *dir,VFSNode **child,bool *created,mode_t mode);
 	static void doPrintTree(OStream &os,size_t level,const VFSNode *parent);
+	static size_t hashName(const char *name,size_t len);
 	ushort doUnref(bool remove);
+	const VFSNode *resolveDir() const;
+	const VFSNode *lookup(const char *name,size_t nameLen) const;
+	void hashInsert(VFSNode *child);
+	void hashRemove(VFSNode *child);
+	void hashBuild(VFSNode **table,size_t size);
 
 protected:
 	mutable SpinLock lock;
@@ -533,10 +539,18 @@ protected:
 	VFSNode *parent;
 	VFSNode *prev;
 	VFSNode *firstChild;
+	/* directories with many childs get a hash-index for them (protected by the tree-lock) */
+	VFSNode **childHash;
+	size_t childHashSize;
+	size_t childCount;
+	VFSNode *hashNext;
 public:
 	VFSNode *next;
 
 private:
+	/* the number of childs from which on we use a hash-index */
+	static const size_t HASH_MIN_CHILDS	= 32;
+
 	/* all nodes (expand dynamically) */
 	static DynArray nodeArray;
 	/* a pointer to the first free node (which points to the next and so on) */
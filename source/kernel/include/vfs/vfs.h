@@ -56,6 +56,17 @@
 /* getwork-flags */
 #define GW_NOBLOCK					1
 
+/* the max. number of messages for getworkv() and sendv() */
+#define MSGVEC_MAX					32
+
+/* one message for getworkv() and sendv() (has to match include/sys/driver.h) */
+typedef struct {
+	int fd;
+	msgid_t mid;
+	USER void *data;
+	size_t size;
+} sMsgVec;
+
 /* all flags that the user can use */
 #define VFS_USER_FLAGS				(VFS_WRITE | VFS_READ | VFS_MSGS | VFS_CREATE | VFS_TRUNCATE | \
 									 VFS_APPEND | VFS_NOBLOCK | VFS_LONELY | VFS_EXCL)
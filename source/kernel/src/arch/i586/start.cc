@@ -29,6 +29,7 @@
 #include <task/terminator.h>
 #include <mem/virtmem.h>
 #include <mem/pagedir.h>
+#include <mem/cache.h>
 #include <cpu.h>
 #include <spinlock.h>
 #include <video.h>
@@ -61,6 +62,8 @@ uintptr_t smpstart(uintptr_t *usp) {
 
 	/* start all APs */
 	SMP::start();
+	/* now all CPUs know their id, so that we can use the per-CPU caches */
+	Cache::initMagazines();
 	Timer::start(true);
 
 	// remove first page-directory entry. now that all CPUs are started, we don't need that anymore
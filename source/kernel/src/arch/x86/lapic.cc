@@ -45,8 +45,7 @@ void LAPIC::init() {
 }
 
 void LAPIC::enableTimer() {
-	setTimer((CPU::getBusSpeed() / TIMER_DIVIDER) / Timer::FREQUENCY_DIV);
-	setLVT(REG_LVT_TIMER,Interrupts::IRQ_LAPIC,ICR_DELMODE_FIXED,UNMASKED,MODE_PERIODIC);
+	setLVT(REG_LVT_TIMER,Interrupts::IRQ_LAPIC,ICR_DELMODE_FIXED,UNMASKED,MODE_ONESHOT);
 }
 
 void LAPIC::writeIPI(uint32_t high,uint32_t low) {
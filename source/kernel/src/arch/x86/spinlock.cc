@@ -19,8 +19,12 @@
 
 #include <spinlock.h>
 #include <task/thread.h>
+#include <ksymbols.h>
+#include <atomic.h>
+#include <ostream.h>
 #include <cpu.h>
 #include <util.h>
+#include <string.h>
 #include <stdarg.h>
 
 #if DEBUG_LOCKS
@@ -36,28 +40,117 @@ static void panic(const char *msg,...) {
 	Util::vpanic(msg,ap);
 	va_end(ap);
 }
+#endif
+
+#if LOCK_STATS
+#define LOCK_SITES			512
+
+/* the statistics of one call-site of SpinLock::down() */
+struct LockSite {
+	uintptr_t caller;
+	ulong acquisitions;
+	ulong contended;
+	uint64_t spinCycles;
+};
+
+static LockSite sites[LOCK_SITES];
+
+static LockSite *getSite(uintptr_t caller) {
+	/* open addressing; slots are claimed atomically and never freed */
+	size_t start = (caller >> 2) % LOCK_SITES;
+	for(size_t i = 0; i < LOCK_SITES; ++i) {
+		LockSite *s = sites + (start + i) % LOCK_SITES;
+		if(s->caller == caller)
+			return s;
+		if(s->caller == 0 && Atomic::cmpnswap(&s->caller,(uintptr_t)0,caller))
+			return s;
+		/* somebody else might have claimed it for the same caller in the meantime */
+		if(s->caller == caller)
+			return s;
+	}
+	return NULL;
+}
+
+void SpinLock::printStats(OStream &os) {
+	os.writef("%-40s %10s %10s %16s\n","Call-site","Acquired","Contended","Spin-cycles");
+	for(size_t i = 0; i < LOCK_SITES; ++i) {
+		LockSite *s = sites + i;
+		if(s->caller == 0)
+			continue;
+		KSymbols::Symbol *sym = KSymbols::getSymbolAt(s->caller);
+		if(sym)
+			os.writef("%-32.32s+%#-7zx",sym->funcName,s->caller - sym->address);
+		else
+			os.writef("%-40p",s->caller);
+		os.writef(" %10lu %10lu %16Lu\n",s->acquisitions,s->contended,s->spinCycles);
+	}
+}
+
+void SpinLock::resetStats() {
+	memclear(sites,sizeof(sites));
+}
+#endif
 
+#if DEBUG_LOCKS || LOCK_STATS
 void SpinLock::down() {
+#if DEBUG_LOCKS
 	if(Util::IsPanicStarted())
 		return;
+#endif
 
-	Thread *t = Thread::getRunning();
-	unsigned id = t->getTid() + 1;
-	if(lock == id) {
-		panic("Self-deadlock");
+	uint16_t ticket = Atomic::fetch_and_add(&next,1);
+	if(EXPECT_TRUE(owner == ticket)) {
+#if LOCK_STATS
+		LockSite *s = getSite((uintptr_t)__builtin_return_address(0));
+		if(s)
+			Atomic::fetch_and_add(&s->acquisitions,1);
+#endif
 		return;
 	}
-	uint64_t max = CPU::rdtsc() + (MAX_WAIT_SECS * CPU::getSpeed());
-	while(!Atomic::cmpnswap(&lock, 0U, id)) {
+
+	uint64_t start = CPU::rdtsc();
+#if DEBUG_LOCKS
+	uint64_t max = start + (MAX_WAIT_SECS * CPU::getSpeed());
+#endif
+	while(owner != ticket) {
+#if DEBUG_LOCKS
+		/* this includes self-deadlocks */
 		if(CPU::rdtsc() > max) {
 			panic("Acquiring spinlock %p took too long",this);
 			return;
 		}
+#endif
 		CPU::pause();
 	}
+
+#if LOCK_STATS
+	uint64_t cycles = CPU::rdtsc() - start;
+	LockSite *s = getSite((uintptr_t)__builtin_return_address(0));
+	if(s) {
+		Atomic::fetch_and_add(&s->acquisitions,1);
+		Atomic::fetch_and_add(&s->contended,1);
+		Atomic::fetch_and_add(&s->spinCycles,cycles);
+	}
+#else
+	(void)start;
+#endif
 }
 
 bool SpinLock::tryDown() {
-	return Util::IsPanicStarted() || Atomic::cmpnswap(&lock, 0, 1);
+#if DEBUG_LOCKS
+	if(Util::IsPanicStarted())
+		return true;
+#endif
+	uint16_t cur = owner;
+	return Atomic::cmpnswap(&next,cur,(uint16_t)(cur + 1));
+}
+#endif
+
+#if DEBUG_LOCKS
+void SpinLock::up() {
+	/* down() and tryDown() don't draw a ticket while locking is disabled. thus, don't pass the
+	 * lock on if nobody holds it, because <owner> would get ahead of <next> otherwise */
+	if(owner != next)
+		asm volatile ("incw	%0" : "+m"(owner) : : "memory");
 }
 #endif
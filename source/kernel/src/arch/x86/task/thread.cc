@@ -24,8 +24,6 @@
 #include <task/smp.h>
 #include <mem/pagedir.h>
 
-static SpinLock switchLock;
-
 int ThreadBase::initArch(Thread *t) {
 	t->kernelStack = t->getProc()->getPageDir()->createKernelStack();
 	t->fpuState = NULL;
@@ -124,31 +122,34 @@ void ThreadBase::finishThreadStart(A_UNUSED Thread *t,Thread *nt,const void *arg
 }
 
 void Thread::initialSwitch() {
-	switchLock.down();
 	cpuid_t cpu = GDT::getCPUId();
+	SpinLock *switchLock = Sched::getSwitchLock(cpu);
+	switchLock->down();
 	Thread *cur = Sched::perform(NULL,cpu);
 	cur->stats.schedCount++;
 	if(PhysMem::shouldSetRegTimestamp())
 		VirtMem::setTimestamp(cur,Timer::getRuntime());
 	GDT::prepareRun(cpu,true,cur);
 	cur->setCPU(cpu);
+	Timer::schedule(cpu,cur->getFlags() & T_IDLE);
 	FPU::lockFPU();
 	cur->stats.cycleStart = CPU::rdtsc();
-	Thread::resume(cur->getProc()->getPageDir()->getPhysAddr(),&cur->saveArea,&switchLock,true);
+	Thread::resume(cur->getProc()->getPageDir()->getPhysAddr(),&cur->saveArea,switchLock,true);
 }
 
 void ThreadBase::doSwitch() {
 	Thread *old = Thread::getRunning();
+	cpuid_t cpu = old->getCPU();
 	/* lock this, because Sched::perform() may make us ready and we can't be chosen by another CPU
 	 * until we've really switched the thread (kernelstack, ...) */
-	switchLock.down();
+	SpinLock *switchLock = Sched::getSwitchLock(cpu);
+	switchLock->down();
 
 	/* update runtime-stats */
 	uint64_t cycles = CPU::rdtsc();
 	uint64_t runtime = cycles - old->stats.cycleStart;
 	old->stats.runtime += runtime;
 	old->stats.curCycleCount += runtime;
-	cpuid_t cpu = old->getCPU();
 
 	/* choose a new thread to run */
 	Thread *n = Sched::perform(old,cpu);
@@ -159,12 +160,13 @@ void ThreadBase::doSwitch() {
 		if(EXPECT_FALSE(PhysMem::shouldSetRegTimestamp()))
 			VirtMem::setTimestamp(n,cycles);
 		GDT::prepareRun(cpu,n->getProc() != old->getProc(),n);
-		if(cpu != n->getCPU())
-			n->getStats().migrations++;
+		/* note that migrations are counted by Sched::perform() */
 		n->setCPU(cpu);
 
 		/* some stats for SMP */
 		SMP::schedule(cpu,n,cycles);
+		/* start a new time-slice */
+		Timer::schedule(cpu,n->getFlags() & T_IDLE);
 
 		/* lock the FPU so that we can save the FPU-state for the previous process as soon
 		 * as this one wants to use the FPU */
@@ -174,12 +176,12 @@ void ThreadBase::doSwitch() {
 			n->stats.cycleStart = CPU::rdtsc();
 			uintptr_t pdir = n->getProc()->getPageDir()->getPhysAddr();
 			bool chgpdir = n->getProc() != old->getProc();
-			Thread::resume(pdir,&n->saveArea,&switchLock,chgpdir);
+			Thread::resume(pdir,&n->saveArea,switchLock,chgpdir);
 		}
 	}
 	else {
 		SMP::schedule(cpu,n,cycles);
 		n->stats.cycleStart = CPU::rdtsc();
-		switchLock.up();
+		switchLock->up();
 	}
 }
@@ -33,15 +33,33 @@
 uint64_t Timer::bootTSC = 0;
 time_t Timer::bootTime = 0;
 uint64_t Timer::cpuMhz;
+bool Timer::oneshot = false;
 
 void TimerBase::archInit() {
 	Timer::bootTSC = CPU::rdtsc();
 	Timer::bootTime = RTC::getTime();
+	/* the APs start their timer before the BSP, so that we decide that here */
+	Timer::oneshot = !Config::get(Config::FORCE_PIT) && LAPIC::isAvailable();
+}
+
+void TimerBase::program(uint64_t now,uint64_t deadline) {
+	if(!Timer::oneshot)
+		return;
+
+	/* a count of zero stops the timer */
+	if(deadline == NO_DEADLINE) {
+		LAPIC::setTimer(0);
+		return;
+	}
+
+	uint64_t delay = deadline > now ? MIN(deadline - now,Timer::MAX_DELAY) : 0;
+	uint64_t count = (delay * (CPU::getBusSpeed() / LAPIC::TIMER_DIVIDER)) / 1000000;
+	LAPIC::setTimer(MAX(count,1));
 }
 
 void Timer::start(bool isBSP) {
-	if(!Config::get(Config::FORCE_PIT) && LAPIC::isAvailable()) {
-		Log::get().writef("CPU %d uses LAPIC as timer device\n",SMP::getCurId());
+	if(oneshot) {
+		Log::get().writef("CPU %d uses LAPIC as one-shot timer device\n",SMP::getCurId());
 		if(isBSP) {
 			/* mask it as well */
 			if(IOAPIC::enabled())
@@ -49,7 +67,9 @@ void Timer::start(bool isBSP) {
 			else
 				PIC::mask(Interrupts::IRQ_PIT - Interrupts::IRQ_MASTER_BASE);
 		}
+		/* fire at the end of the first time-slice; afterwards, we program it on demand */
 		LAPIC::enableTimer();
+		LAPIC::setTimer(((CPU::getBusSpeed() / LAPIC::TIMER_DIVIDER) * TIMESLICE) / 1000);
 	}
 	else if(isBSP) {
 		Log::get().writef("CPU %d uses PIT as timer device\n",SMP::getCurId());
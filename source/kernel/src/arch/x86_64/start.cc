@@ -26,6 +26,7 @@
 #include <task/uenv.h>
 #include <task/terminator.h>
 #include <mem/pagedir.h>
+#include <mem/cache.h>
 #include <boot.h>
 #include <util.h>
 
@@ -53,6 +54,8 @@ uintptr_t smpstart(uintptr_t *usp) {
 
 	/* start all APs */
 	SMP::start();
+	/* now all CPUs know their id, so that we can use the per-CPU caches */
+	Cache::initMagazines();
 	Timer::start(true);
 
 	// remove first page-directory entry. now that all CPUs are started, we don't need that anymore
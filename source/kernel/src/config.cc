@@ -33,6 +33,7 @@ bool Config::doLog = true;
 bool Config::smp = true;
 bool Config::forcePIT = false;
 bool Config::forcePIC = false;
+bool Config::lendPages = true;
 char Config::rootDev[MAX_BPVAL_LEN + 1] = "";
 char Config::swapDev[MAX_BPVAL_LEN + 1] = "";
 
@@ -110,6 +111,9 @@ long Config::get(int id) {
 		case FORCE_PIC:
 			res = forcePIC;
 			break;
+		case LEND_PAGES:
+			res = lendPages;
+			break;
 		default:
 			res = -EINVAL;
 			break;
@@ -134,4 +138,6 @@ void Config::set(const char *name,const char *value) {
 		forcePIT = true;
 	else if(strcmp(name,"forcepic") == 0)
 		forcePIC = true;
+	else if(strcmp(name,"nolend") == 0)
+		lendPages = false;
 }
@@ -20,15 +20,30 @@
 #include <common.h>
 #include <dbg/console.h>
 #include <dbg/cmd/locks.h>
+#include <spinlock.h>
 #include <util.h>
 #include <string.h>
 
 int cons_cmd_locks(OStream &os,size_t argc,char **argv) {
 	if(Console::isHelp(argc,argv) || argc != 2) {
+#if LOCK_STATS
+		os.writef("Usage: %s on|off|stats|reset\n",argv[0]);
+#else
 		os.writef("Usage: %s on|off\n",argv[0]);
+#endif
 		return 0;
 	}
 
+#if LOCK_STATS
+	if(strcmp(argv[1],"stats") == 0) {
+		SpinLock::printStats(os);
+		return 0;
+	}
+	if(strcmp(argv[1],"reset") == 0) {
+		SpinLock::resetStats();
+		return 0;
+	}
+#endif
 	Util::setPanicStarted(strcmp(argv[1],"off") == 0);
 	return 0;
 }
@@ -21,6 +21,7 @@
 #include <mem/cache.h>
 #include <mem/pagedir.h>
 #include <mem/kheap.h>
+#include <task/smp.h>
 #include <spinlock.h>
 #include <log.h>
 #include <video.h>
@@ -37,8 +38,17 @@
 #define SIZE_THRESHOLD		128
 #define HEAP_THRESHOLD		512
 
+/**
+ * The objects are kept in freelists per size, protected by a global lock. To avoid taking that
+ * lock for every alloc and free, each CPU has a magazine per size in front of it, i.e. a small
+ * stack of free objects. Since the kernel is not preemptive and runs with interrupts disabled,
+ * we can access the magazine of the current CPU without lock. If it runs empty or full, we move
+ * half of its capacity from or to the freelist at once.
+ */
+
 SpinLock Cache::lock;
-Cache::Entry Cache::caches[] = {
+Cache::CPUCache *Cache::cpuCaches = NULL;
+Cache::Entry Cache::caches[CACHE_COUNT] = {
 	{16,0,0,NULL},
 	{32,0,0,NULL},
 	{64,0,0,NULL},
@@ -55,11 +65,32 @@ Cache::Entry Cache::caches[] = {
 bool Cache::aafEnabled = false;
 #endif
 
+void Cache::initMagazines() {
+	CPUCache *ccs = (CPUCache*)calloc(SMP::getCPUCount(),sizeof(CPUCache));
+	if(!ccs)
+		Util::panic("Unable to allocate per-CPU caches");
+	cpuCaches = ccs;
+}
+
 size_t Cache::totalObjSize(size_t sz) {
 	/* ensure that all objects are 16 bytes aligned, thus, use 16 bytes before and behind. */
 	return sz + sizeof(uint64_t) * 4;
 }
 
+size_t Cache::magCapacity(size_t i) {
+	/* don't keep too much memory in the magazines for large objects */
+	return MIN(MAG_SIZE,MAG_BYTES / caches[i].objSize);
+}
+
+size_t Cache::magObjs(size_t i) {
+	size_t count = 0;
+	if(cpuCaches) {
+		for(size_t cpu = 0; cpu < SMP::getCPUCount(); ++cpu)
+			count += cpuCaches[cpu].mags[i].count;
+	}
+	return count;
+}
+
 void *Cache::alloc(size_t size) {
 	void *res;
 	if(size == 0)
@@ -140,12 +171,30 @@ void Cache::free(void *p) {
 	/* check guard */
 	assert(area[(objSize / sizeof(ulong)) + (16 / sizeof(ulong))] == GUARD_MAGIC);
 
-	/* put on freelist */
 	Entry *c = caches + area[0];
+	size_t cap = magCapacity(area[0]);
+	if(EXPECT_TRUE(cpuCaches && cap > 1)) {
+		Magazine *m = cpuCaches[SMP::getCurId()].mags + area[0];
+		m->frees++;
+		/* if it's full, move the older half back to the freelist */
+		if(EXPECT_FALSE(m->count == cap)) {
+			size_t batch = cap / 2;
+			LockGuard<SpinLock> g(&lock);
+			for(size_t j = 0; j < batch; ++j)
+				put(c,(ulong*)m->objs[j]);
+			memmove(m->objs,m->objs + batch,(cap - batch) * sizeof(void*));
+			m->count -= batch;
+		}
+		else
+			m->freeHits++;
+		/* keep size and guards; they are still valid */
+		m->objs[m->count++] = area;
+		return;
+	}
+
+	/* put on freelist */
 	LockGuard<SpinLock> g(&lock);
-	area[0] = (ulong)c->freeList;
-	c->freeList = area;
-	c->freeObjs++;
+	put(c,area);
 }
 
 size_t Cache::getOccMem() {
@@ -158,7 +207,7 @@ size_t Cache::getOccMem() {
 size_t Cache::getUsedMem() {
 	size_t count = 0;
 	for(size_t i = 0; i < ARRAY_SIZE(caches); i++)
-		count += (caches[i].totalObjs - caches[i].freeObjs) * totalObjSize(caches[i].objSize);
+		count += (caches[i].totalObjs - caches[i].freeObjs - magObjs(i)) * totalObjSize(caches[i].objSize);
 	return count;
 }
 
@@ -173,9 +222,19 @@ void Cache::print(OStream &os) {
 	os.writef("Total: %zu bytes\n",total);
 	for(size_t i = 0; i < ARRAY_SIZE(caches); i++) {
 		size_t mem = caches[i].totalObjs * totalObjSize(caches[i].objSize);
+		size_t free = caches[i].freeObjs + magObjs(i);
 		os.writef("Cache %zu [size=%zu, total=%zu, free=%zu, pages=%zu]:\n",i,caches[i].objSize,
-				caches[i].totalObjs,caches[i].freeObjs,BYTES_2_PAGES(mem));
-		printBar(os,mem,maxMem,caches[i].totalObjs,caches[i].freeObjs);
+				caches[i].totalObjs,free,BYTES_2_PAGES(mem));
+		if(cpuCaches) {
+			for(size_t cpu = 0; cpu < SMP::getCPUCount(); ++cpu) {
+				Magazine *m = cpuCaches[cpu].mags + i;
+				os.writef("  CPU%zu: mag=%zu/%zu, alloc hits=%zu/%zu (%zu%%), free hits=%zu/%zu (%zu%%)\n",
+					cpu,m->count,magCapacity(i),m->allocHits,m->allocs,
+					m->allocs ? (m->allocHits * 100) / m->allocs : 0,
+					m->freeHits,m->frees,m->frees ? (m->freeHits * 100) / m->frees : 0);
+			}
+		}
+		printBar(os,mem,maxMem,caches[i].totalObjs,free);
 	}
 }
 
@@ -192,7 +251,39 @@ void Cache::printBar(OStream &os,size_t mem,size_t maxMem,size_t total,size_t fr
 }
 
 void *Cache::get(Entry *c,size_t i) {
+	size_t cap = magCapacity(i);
+	if(EXPECT_TRUE(cpuCaches && cap > 1)) {
+		Magazine *m = cpuCaches[SMP::getCurId()].mags + i;
+		m->allocs++;
+		/* if it's empty, fill the half of it */
+		if(EXPECT_FALSE(m->count == 0)) {
+			LockGuard<SpinLock> g(&lock);
+			for(size_t j = 0; j < cap / 2; ++j) {
+				ulong *area = take(c,i);
+				if(area == NULL)
+					break;
+				m->objs[m->count++] = area;
+			}
+			if(m->count == 0)
+				return NULL;
+		}
+		else
+			m->allocHits++;
+		return (void*)((uintptr_t)m->objs[--m->count] + 16);
+	}
+
 	LockGuard<SpinLock> g(&lock);
+	ulong *area = take(c,i);
+	return area ? (void*)((uintptr_t)area + 16) : NULL;
+}
+
+void Cache::put(Entry *c,ulong *area) {
+	area[0] = (ulong)c->freeList;
+	c->freeList = area;
+	c->freeObjs++;
+}
+
+ulong *Cache::take(Entry *c,size_t i) {
 	if(!c->freeList) {
 		size_t pageCount = BYTES_2_PAGES(MIN_OBJ_COUNT * c->objSize);
 		size_t bytes = pageCount * PAGE_SIZE;
@@ -226,5 +317,5 @@ void *Cache::get(Entry *c,size_t i) {
 	area[1] = GUARD_MAGIC;
 	area[(c->objSize / sizeof(ulong)) + (16 / sizeof(ulong))] = GUARD_MAGIC;
 	c->freeObjs--;
-	return (void*)((uintptr_t)area + 16);
+	return area;
 }
@@ -287,6 +287,16 @@ bool PhysMem::reserve(size_t frameCount,bool swap) {
 	return true;
 }
 
+bool PhysMem::tryReserve(size_t frameCount) {
+	LockGuard<SpinLock> g(&defLock);
+	size_t free = getFreeDef();
+	if(free >= frameCount && free - frameCount >= kframes + cframes) {
+		uframes += frameCount;
+		return true;
+	}
+	return false;
+}
+
 frameno_t PhysMem::allocFrame(bool forceLower) {
 	/* prefer lower pages */
 	if(!forceLower && (size_t)(lower.frames - lower.begin) <= kframes) {
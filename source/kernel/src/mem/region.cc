@@ -64,6 +64,7 @@ Region::Region(const Region &reg,VirtMem *vm,bool &success)
 	init(-1,success);
 	if(!success)
 		return;
+	advice = reg.advice;
 
 	/* increment references to swap-blocks */
 	size_t count = BYTES_2_PAGES(reg.byteCount);
@@ -87,6 +88,9 @@ void Region::init(ulong pgFlags,bool &success) {
 		offset = 0;
 		loadCount = 0;
 	}
+	advice = MADV_NORMAL;
+	raNext = 0;
+	raPages = 0;
 
 	size_t pages = BYTES_2_PAGES(byteCount);
 	/* if we have no pages, create the page-array with 1; using 0 will fail and this may actually
@@ -341,6 +341,44 @@ int VirtMem::lockall() {
 	return res;
 }
 
+int VirtMem::advise(uintptr_t addr,int advice) {
+	Thread *t = Thread::getRunning();
+	int res = 0;
+	acquire();
+	VMRegion *vm = regtree.getByAddr(addr);
+	if(vm == NULL) {
+		release();
+		return -ENXIO;
+	}
+
+	vm->reg->acquire();
+	if(advice != MADV_WILLNEED)
+		vm->reg->setAdvice(advice);
+	else if(vm->reg->getFile()) {
+		/* load all pages with content in the file in large chunks, as long as we don't need to swap */
+		size_t loadPages = BYTES_2_PAGES(vm->reg->getLoadCount());
+		for(size_t page = 0; res == 0 && page < loadPages; ) {
+			if(~vm->reg->getPageFlags(page) & PF_DEMANDLOAD) {
+				page++;
+				continue;
+			}
+
+			size_t count = 1;
+			while(count < READ_AHEAD_MAX && page + count < loadPages &&
+					(vm->reg->getPageFlags(page + count) & PF_DEMANDLOAD))
+				count++;
+			if((count = t->tryReserveFrames(count)) == 0)
+				break;
+			res = loadFromFile(vm,page,count);
+			page += count;
+		}
+		t->discardFrames();
+	}
+	vm->reg->release();
+	release();
+	return res;
+}
+
 int VirtMem::lockRegion(VMRegion *vm,int flags) {
 	Thread *t = Thread::getRunning();
 	int res = 0;
@@ -538,6 +576,36 @@ int VirtMem::getRegRange(uintptr_t virt,uintptr_t *start,uintptr_t *end) {
 	return res;
 }
 
+int VirtMem::getFrames(uintptr_t addr,frameno_t *frames,size_t count) {
+	int res = 0;
+	acquire();
+	VMRegion *vm = regtree.getByAddr(addr);
+	if(!vm) {
+		release();
+		return -ENXIO;
+	}
+
+	/* only locked regions keep their frames */
+	vm->reg->acquire();
+	size_t page = (addr - vm->virt()) / PAGE_SIZE;
+	if((addr & (PAGE_SIZE - 1)) || (~vm->reg->getFlags() & RF_LOCKED) ||
+			page + count > BYTES_2_PAGES(vm->reg->getByteCount()))
+		res = -EINVAL;
+	else {
+		for(size_t i = 0; i < count; ++i) {
+			/* all pages of a locked region are present, but not necessarily copied yet */
+			if(vm->reg->getPageFlags(page + i) != 0) {
+				res = -EFAULT;
+				break;
+			}
+			frames[i] = getPageDir()->getFrameNo(addr + i * PAGE_SIZE);
+		}
+	}
+	vm->reg->release();
+	release();
+	return res;
+}
+
 ssize_t VirtMem::getShareInfo(uintptr_t addr,char *path,size_t size) {
 	ssize_t res = -ENXIO;
 	acquire();
@@ -854,6 +922,85 @@ errProc:
 	return res;
 }
 
+uintptr_t VirtMem::lend(uintptr_t srcAddr,size_t bytes,VirtMem *dst,bool write,VMRegion **nvm) {
+	Thread *t = Thread::getRunning();
+	uintptr_t start = ROUND_DN(srcAddr,PAGE_SIZE);
+	size_t pages = BYTES_2_PAGES(srcAddr + bytes - start);
+	uintptr_t dstAddr = 0;
+	VMRegion *vm;
+	ulong pts = 0;
+
+	/* the swapper might take the frames away */
+	if(PhysMem::canSwap() || dst == this)
+		return 0;
+
+	/* create the region first, because map() needs the lock of dst */
+	if(dst->map(&dstAddr,pages * PAGE_SIZE,0,PROT_READ | (write ? PROT_WRITE : 0),
+			MAP_NOMAP | MAP_NOFREE | MAP_LOCKED,NULL,0,nvm) < 0)
+		return 0;
+
+	/* we might need one frame per page for demand-loading and copy-on-write */
+	if(!t->reserveFrames(pages))
+		goto errUnmap;
+
+	acquire();
+	vm = regtree.getByAddr(start);
+	if(vm == NULL || (vm->reg->getFlags() & (RF_SHAREABLE | RF_NOFREE)) ||
+			(write && !(vm->reg->getFlags() & RF_WRITABLE)) ||
+			start + pages * PAGE_SIZE > vm->virt() + ROUND_PAGE_UP(vm->reg->getByteCount()))
+		goto errRel;
+
+	vm->reg->acquire();
+	for(size_t i = 0; i < pages; ++i) {
+		uintptr_t addr = start + i * PAGE_SIZE;
+		ulong pflags = vm->reg->getPageFlags((addr - vm->virt()) / PAGE_SIZE);
+		if((pflags & (PF_DEMANDLOAD | PF_SWAPPED)) || (write && (pflags & PF_COPYONWRITE))) {
+			if(doPagefault(addr,vm,write) < 0)
+				goto errRegRel;
+		}
+	}
+
+	// see join()
+	if(!dst->tryAquire())
+		goto errRegRel;
+	for(size_t i = 0; i < pages; ++i) {
+		PageTables::RangeAllocator alloc(getPageDir()->getFrameNo(start + i * PAGE_SIZE));
+		if(dst->getPageDir()->map((*nvm)->virt() + i * PAGE_SIZE,1,alloc,
+				PG_PRESENT | (write ? PG_WRITABLE : 0)) < 0) {
+			dst->addOwn(pts);
+			dst->addShared(i);
+			dst->release();
+			goto errRegRel;
+		}
+		pts += alloc.pageTables();
+	}
+	dst->addOwn(pts);
+	dst->addShared(pages);
+	dst->release();
+
+	vm->reg->release();
+	release();
+	t->discardFrames();
+	return (*nvm)->virt() + (srcAddr - start);
+
+errRegRel:
+	vm->reg->release();
+errRel:
+	release();
+	t->discardFrames();
+errUnmap:
+	dst->unlend((*nvm)->virt(),*nvm);
+	return 0;
+}
+
+void VirtMem::unlend(uintptr_t virt,VMRegion *vm) {
+	acquire();
+	/* the owner might have unmapped it in the meantime */
+	if(regtree.getByAddr(virt) == vm)
+		doUnmap(vm);
+	release();
+}
+
 int VirtMem::cloneAll(VirtMem *dst) {
 	Thread *t = Thread::getRunning();
 	VMTree::iterator vm;
@@ -1216,112 +1363,156 @@ void VirtMem::print(OStream &os) const {
 }
 
 int VirtMem::demandLoad(VMRegion *vm,uintptr_t addr) {
-	int res;
+	/* pages with content in the file are loaded together with their neighbours */
+	if(addr - vm->virt() < vm->reg->getLoadCount()) {
+		size_t page = (addr - vm->virt()) / PAGE_SIZE;
+		size_t first,count;
+		getLoadWindow(vm,page,&first,&count);
+
+		/* we have a frame for the faulting page. the others are only loaded if there is enough
+		 * memory available without swapping */
+		if(count > 1) {
+			size_t got = Thread::getRunning()->tryReserveFrames(count - 1);
+			if(got < count - 1) {
+				count = MIN(first + count - page,got + 1);
+				first = page;
+			}
+		}
+		return loadFromFile(vm,first,count);
+	}
 
-	/* calculate the number of bytes to load and zero */
-	size_t loadCount = 0, zeroCount;
-	if(addr - vm->virt() < vm->reg->getLoadCount())
-		loadCount = MIN(PAGE_SIZE,vm->reg->getLoadCount() - (addr - vm->virt()));
-	zeroCount = MIN(PAGE_SIZE,vm->reg->getByteCount() - (addr - vm->virt())) - loadCount;
+	/* the others are simply zero'd */
+	/* do the memclear before the mapping to ensure that it's ready when the first CPU sees it */
+	size_t zeroCount = MIN(PAGE_SIZE,vm->reg->getByteCount() - (addr - vm->virt()));
+	frameno_t frame = Thread::getRunning()->getFrame();
+	uintptr_t frameAddr = PageDir::getAccess(frame);
+	memclear((void*)frameAddr,zeroCount);
+	PageDir::removeAccess(frame);
+	mapLoaded(vm,addr,frame);
+	return 0;
+}
 
-	/* load from file */
-	if(loadCount)
-		res = loadFromFile(vm,addr,loadCount);
-	else
-		res = 0;
+void VirtMem::getLoadWindow(VMRegion *vm,size_t page,size_t *first,size_t *count) {
+	Region *reg = vm->reg;
+	size_t start,end;
+	switch(reg->getAdvice()) {
+		case MADV_RANDOM:
+			*first = page;
+			*count = 1;
+			return;
+
+		case MADV_SEQUENTIAL:
+			start = page;
+			end = page + READ_AHEAD_MAX;
+			break;
 
-	/* zero the rest, if necessary */
-	if(res == 0 && zeroCount) {
-		/* do the memclear before the mapping to ensure that it's ready when the first CPU sees it */
-		frameno_t frame = loadCount ? Proc::getCurPageDir()->getFrameNo(addr)
-									: Thread::getRunning()->getFrame();
-		uintptr_t frameAddr = PageDir::getAccess(frame);
-		memclear((void*)(frameAddr + loadCount),zeroCount);
-		PageDir::removeAccess(frame);
-		/* if the pages weren't present so far, map them into every process that has this region */
-		if(!loadCount) {
-			uint mapFlags = PG_PRESENT;
-			if(vm->reg->getFlags() & RF_WRITABLE)
-				mapFlags |= PG_WRITABLE;
-			/* this doesn't seem to make a lot of sense but is necessary for initloader */
-			if(vm->reg->getFlags() & RF_EXECUTABLE)
-				mapFlags |= PG_EXECUTABLE;
-			for(auto mp = vm->reg->vmbegin(); mp != vm->reg->vmend(); ++mp) {
-				/* the region may be mapped to a different virtual address */
-				PageTables::RangeAllocator alloc(frame);
-				VMRegion *mpreg = (*mp)->regtree.getByReg(vm->reg);
-				/* can't fail */
-				sassert((*mp)->getPageDir()->map(mpreg->virt() + (addr - vm->virt()),1,alloc,mapFlags) == 0);
-				if(vm->reg->getFlags() & RF_SHAREABLE)
-					(*mp)->addShared(1);
-				else
-					(*mp)->addOwn(1);
+		default:
+			/* if the last window has been consumed sequentially, read ahead and double the window */
+			if(reg->getReadAheadPages() > 0 && page == reg->getReadAheadNext()) {
+				start = page;
+				end = page + MIN(reg->getReadAheadPages() * 2,READ_AHEAD_MAX);
 			}
-		}
+			/* otherwise, load the aligned window around the page */
+			else {
+				start = ROUND_DN(page,FAULT_AROUND_PAGES);
+				end = start + FAULT_AROUND_PAGES;
+			}
+			break;
 	}
-	return res;
+
+	/* stop at the first page that is present already or has no content in the file */
+	end = MIN(end,BYTES_2_PAGES(reg->getLoadCount()));
+	size_t s = page;
+	while(s > start && (reg->getPageFlags(s - 1) & PF_DEMANDLOAD))
+		s--;
+	size_t e = page + 1;
+	while(e < end && (reg->getPageFlags(e) & PF_DEMANDLOAD))
+		e++;
+
+	reg->setReadAhead(e,e - page);
+	*first = s;
+	*count = e - s;
 }
 
-int VirtMem::loadFromFile(VMRegion *vm,uintptr_t addr,size_t loadCount) {
-	uint mapFlags;
-	frameno_t frame;
+int VirtMem::loadFromFile(VMRegion *vm,size_t first,size_t count) {
+	Region *reg = vm->reg;
 	void *tempBuf;
 	/* note that we currently ignore that the file might have changed in the meantime */
 	ssize_t err;
-	off_t pos = vm->reg->getOffset() + (addr - vm->virt());
-	if((err = vm->reg->getFile()->seek(proc->getPid(),pos,SEEK_SET)) < 0)
+	size_t offset = first * PAGE_SIZE;
+	size_t loadCount = MIN(count * PAGE_SIZE,reg->getLoadCount() - offset);
+	off_t pos = reg->getOffset() + offset;
+	if((err = reg->getFile()->seek(proc->getPid(),pos,SEEK_SET)) < 0)
 		goto error;
 
-	/* first read into a temp-buffer because we can't mark the page as present until
-	 * its read from disk. and we can't use a temporary mapping when switching
-	 * threads. */
-	tempBuf = Cache::alloc(PAGE_SIZE);
+	/* first read into a temp-buffer because we can't mark the pages as present until
+	 * they're read from disk. and we can't use a temporary mapping when switching
+	 * threads. all pages are read with one request to save round-trips to the driver. */
+	tempBuf = Cache::alloc(count * PAGE_SIZE);
 	if(tempBuf == NULL) {
 		err = -ENOMEM;
 		goto error;
 	}
-	err = vm->reg->getFile()->read(proc->getPid(),tempBuf,loadCount);
+	err = reg->getFile()->read(proc->getPid(),tempBuf,loadCount);
 	if(err != (ssize_t)loadCount) {
 		if(err >= 0)
 			err = -ENOMEM;
 		goto errorFree;
 	}
 
-	/* copy into frame */
-	frame = PageDir::demandLoad(tempBuf,loadCount,vm->reg->getFlags());
+	for(size_t i = 0; i < count; ++i) {
+		size_t pgoff = offset + i * PAGE_SIZE;
+		size_t amount = MIN(PAGE_SIZE,loadCount - i * PAGE_SIZE);
+		size_t zeroCount = MIN(PAGE_SIZE,reg->getByteCount() - pgoff) - amount;
 
-	/* free resources not needed anymore */
-	Cache::free(tempBuf);
+		/* copy into frame */
+		frameno_t frame = PageDir::demandLoad((char*)tempBuf + i * PAGE_SIZE,amount,reg->getFlags());
 
-	/* map into all pagedirs */
-	{
-		mapFlags = PG_PRESENT;
-		if(vm->reg->getFlags() & RF_WRITABLE)
-			mapFlags |= PG_WRITABLE;
-		if(vm->reg->getFlags() & RF_EXECUTABLE)
-			mapFlags |= PG_EXECUTABLE;
-		for(auto mp = vm->reg->vmbegin(); mp != vm->reg->vmend(); ++mp) {
-			PageTables::RangeAllocator alloc(frame);
-			/* the region may be mapped to a different virtual address */
-			VMRegion *mpreg = (*mp)->regtree.getByReg(vm->reg);
-			/* can't fail */
-			sassert((*mp)->getPageDir()->map(mpreg->virt() + (addr - vm->virt()),1,alloc,mapFlags) == 0);
-			if(vm->reg->getFlags() & RF_SHAREABLE)
-				(*mp)->addShared(1);
-			else
-				(*mp)->addOwn(1);
+		/* zero the rest, if necessary (before the mapping; see above) */
+		if(zeroCount) {
+			uintptr_t frameAddr = PageDir::getAccess(frame);
+			memclear((void*)(frameAddr + amount),zeroCount);
+			PageDir::removeAccess(frame);
 		}
+
+		mapLoaded(vm,vm->virt() + pgoff,frame);
+		reg->setPageFlags(first + i,reg->getPageFlags(first + i) & ~PF_DEMANDLOAD);
 	}
+
+	/* free resources not needed anymore */
+	Cache::free(tempBuf);
 	return 0;
 
 errorFree:
 	Cache::free(tempBuf);
 error:
-	Log::get().writef("Demandload page @ %p for proc %s: %s (%d)\n",addr,
-		proc->getProgram(),strerror(err),err);
+	Log::get().writef("Demandload %zu pages @ %p for proc %s: %s (%d)\n",count,
+		vm->virt() + offset,proc->getProgram(),strerror(err),err);
 	return err;
 }
 
+void VirtMem::mapLoaded(VMRegion *vm,uintptr_t addr,frameno_t frame) {
+	uint mapFlags = PG_PRESENT;
+	if(vm->reg->getFlags() & RF_WRITABLE)
+		mapFlags |= PG_WRITABLE;
+	/* for zero'd pages, this doesn't seem to make a lot of sense but is necessary for initloader */
+	if(vm->reg->getFlags() & RF_EXECUTABLE)
+		mapFlags |= PG_EXECUTABLE;
+
+	/* map into all pagedirs */
+	for(auto mp = vm->reg->vmbegin(); mp != vm->reg->vmend(); ++mp) {
+		PageTables::RangeAllocator alloc(frame);
+		/* the region may be mapped to a different virtual address */
+		VMRegion *mpreg = (*mp)->regtree.getByReg(vm->reg);
+		/* can't fail */
+		sassert((*mp)->getPageDir()->map(mpreg->virt() + (addr - vm->virt()),1,alloc,mapFlags) == 0);
+		if(vm->reg->getFlags() & RF_SHAREABLE)
+			(*mp)->addShared(1);
+		else
+			(*mp)->addOwn(1);
+	}
+}
+
 Region *VirtMem::getLRURegion() {
 	Region *lru = NULL;
 	uint64_t ts = (uint64_t)-1;
@@ -58,7 +58,7 @@ const Syscalls::Syscall Syscalls::syscalls[] = {
 
 	/* 20 */
 	{init,				"init",	    		0},
-	{sleep,				"sleep",    		1},
+	{sleep,				"sleep",    		2},
 	{seek,				"seek",    			2},
 	{stat,				"stat",    			2},
 	{startthread,		"startthread",		2},
@@ -124,6 +124,13 @@ const Syscalls::Syscall Syscalls::syscalls[] = {
 	{rename,			"rename",			2},
 	{gettimeofday,		"gettimeofday",		1},
 	{utime,				"utime",			2},
+	{setaffinity,		"setaffinity",		2},
+	{getworkv,			"getworkv",			3},
+	{sendv,				"sendv",			2},
+
+	/* 80 */
+	{madvise,			"madvise",			2},
+	{virt2phys,			"virt2phys",		3},
 #if defined(__x86__)
 	{reqports,			"reqports",   		2},
 	{relports,			"relports",    		2},
@@ -29,6 +29,7 @@
 #include <vfs/node.h>
 #include <vfs/channel.h>
 #include <syscalls.h>
+#include <sys/messages.h>
 #include <errno.h>
 #include <string.h>
 
@@ -129,3 +130,121 @@ int Syscalls::getwork(Thread *t,IntrptStackFrame *stack) {
 	*id = mid;
 	SYSC_RET1(stack,clifd);
 }
+
+static bool isInBatch(const sMsgVec *vec,size_t count,int fd) {
+	for(size_t i = 0; i < count; ++i) {
+		if(vec[i].fd == fd)
+			return true;
+	}
+	return false;
+}
+
+int Syscalls::getworkv(Thread *t,IntrptStackFrame *stack) {
+	int fd = SYSC_ARG1(stack) >> 2;
+	sMsgVec *vec = (sMsgVec*)SYSC_ARG2(stack);
+	size_t count = SYSC_ARG3(stack);
+	uint flags = SYSC_ARG1(stack) & 0x3;
+	Proc *p = t->getProc();
+	ssize_t res = 0;
+	size_t i;
+
+	if(EXPECT_FALSE(count == 0 || count > MSGVEC_MAX))
+		SYSC_ERROR(stack,-EINVAL);
+	if(EXPECT_FALSE(!PageDir::isInUserSpace((uintptr_t)vec,count * sizeof(sMsgVec))))
+		SYSC_ERROR(stack,-EFAULT);
+
+	for(i = 0; i < count; ++i) {
+		void *data = vec[i].data;
+		size_t size = vec[i].size;
+		msgid_t mid = vec[i].mid;
+		if(EXPECT_FALSE(!PageDir::isInUserSpace((uintptr_t)data,size))) {
+			res = -EFAULT;
+			break;
+		}
+
+		OpenFile *file = FileDesc::request(p,fd);
+		if(EXPECT_FALSE(file == NULL)) {
+			res = -EBADF;
+			break;
+		}
+
+		/* only wait for the first message. afterwards, take just what is already there */
+		int clifd;
+		res = OpenFile::getWork(file,&clifd,i == 0 ? flags : flags | GW_NOBLOCK);
+		FileDesc::release(file);
+		if(res < 0)
+			break;
+
+		/* take at most one message per channel. a request might be followed by further messages
+		 * (e.g. the data of a write), which the handler of the request receives itself. if we put
+		 * them into the batch as well, the handler would wait forever */
+		if(i > 0 && isInBatch(vec,i,clifd)) {
+			res = 0;
+			break;
+		}
+
+		OpenFile *client = FileDesc::request(p,clifd);
+		if(EXPECT_FALSE(client == NULL)) {
+			res = -EBADF;
+			break;
+		}
+
+		res = client->receiveMsg(p->getPid(),&mid,data,size,VFS_SIGNALS);
+		FileDesc::release(client);
+		if(EXPECT_FALSE(res < 0))
+			break;
+
+		vec[i].fd = clifd;
+		vec[i].mid = mid;
+		vec[i].size = res;
+	}
+
+	/* errors are only reported if we haven't received anything */
+	if(EXPECT_FALSE(i == 0))
+		SYSC_ERROR(stack,res);
+	SYSC_RET1(stack,i);
+}
+
+int Syscalls::sendv(Thread *t,IntrptStackFrame *stack) {
+	const sMsgVec *vec = (const sMsgVec*)SYSC_ARG1(stack);
+	size_t count = SYSC_ARG2(stack);
+	Proc *p = t->getProc();
+	ssize_t res = 0;
+	size_t sent = 0;
+
+	if(EXPECT_FALSE(count == 0 || count > MSGVEC_MAX))
+		SYSC_ERROR(stack,-EINVAL);
+	if(EXPECT_FALSE(!PageDir::isInUserSpace((uintptr_t)vec,count * sizeof(sMsgVec))))
+		SYSC_ERROR(stack,-EFAULT);
+
+	/* the messages are independent of each other. thus, if one fails (e.g. because the client is
+	 * gone), we continue with the next one */
+	for(size_t i = 0; i < count; ++i) {
+		const void *data = vec[i].data;
+		size_t size = vec[i].size;
+		msgid_t mid = vec[i].mid;
+		if(EXPECT_FALSE(!PageDir::isInUserSpace((uintptr_t)data,size))) {
+			res = -EFAULT;
+			continue;
+		}
+
+		OpenFile *file = FileDesc::request(p,vec[i].fd);
+		if(EXPECT_FALSE(file == NULL)) {
+			res = -EBADF;
+			continue;
+		}
+
+		/* can only be sent by drivers */
+		if(EXPECT_FALSE(!file->isDevice() && IS_DEVICE_MSG(mid & 0xFFFF)))
+			res = -EPERM;
+		else
+			res = file->sendMsg(p->getPid(),mid,data,size,NULL,0);
+		FileDesc::release(file);
+		if(EXPECT_TRUE(res >= 0))
+			sent++;
+	}
+
+	if(EXPECT_FALSE(sent == 0))
+		SYSC_ERROR(stack,res);
+	SYSC_RET1(stack,sent);
+}
@@ -156,6 +156,41 @@ int Syscalls::mlockall(Thread *t,IntrptStackFrame *stack) {
 	SYSC_RET1(stack,res);
 }
 
+int Syscalls::madvise(Thread *t,IntrptStackFrame *stack) {
+	void *virt = (void*)SYSC_ARG1(stack);
+	int advice = (int)SYSC_ARG2(stack);
+	if(EXPECT_FALSE(advice < MADV_NORMAL || advice > MADV_WILLNEED))
+		SYSC_ERROR(stack,-EINVAL);
+
+	int res = t->getProc()->getVM()->advise((uintptr_t)virt,advice);
+	if(EXPECT_FALSE(res < 0))
+		SYSC_ERROR(stack,res);
+	SYSC_RET1(stack,0);
+}
+
+int Syscalls::virt2phys(Thread *t,IntrptStackFrame *stack) {
+	uintptr_t addr = SYSC_ARG1(stack);
+	uintptr_t *phys = (uintptr_t*)SYSC_ARG2(stack);
+	size_t count = SYSC_ARG3(stack);
+	/* the size of <phys> must not overflow */
+	if(EXPECT_FALSE(count > (size_t)-1 / sizeof(uintptr_t)))
+		SYSC_ERROR(stack,-EINVAL);
+	if(EXPECT_FALSE(!PageDir::isInUserSpace((uintptr_t)phys,count * sizeof(uintptr_t))))
+		SYSC_ERROR(stack,-EFAULT);
+
+	/* don't write to user memory while holding the locks */
+	frameno_t frames[16];
+	for(size_t i = 0; i < count; i += ARRAY_SIZE(frames)) {
+		size_t amount = MIN(ARRAY_SIZE(frames),count - i);
+		int res = t->getProc()->getVM()->getFrames(addr + i * PAGE_SIZE,frames,amount);
+		if(EXPECT_FALSE(res < 0))
+			SYSC_ERROR(stack,res);
+		for(size_t j = 0; j < amount; ++j)
+			phys[i + j] = frames[j] * PAGE_SIZE;
+	}
+	SYSC_RET1(stack,0);
+}
+
 int Syscalls::mmapphys(Thread *t,IntrptStackFrame *stack) {
 	uintptr_t *phys = (uintptr_t*)SYSC_ARG1(stack);
 	size_t bytes = SYSC_ARG2(stack);
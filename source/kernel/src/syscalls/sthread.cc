@@ -66,22 +66,24 @@ int Syscalls::getcycles(Thread *t,IntrptStackFrame *stack) {
 int Syscalls::alarm(Thread *t,IntrptStackFrame *stack) {
 	time_t msecs = SYSC_ARG1(stack);
 	int res;
-	/* ensure that we're not already in the list */
-	Timer::removeThread(t->getTid());
-	if(EXPECT_FALSE((res = Timer::sleepFor(t->getTid(),msecs,false)) < 0))
+	/* this replaces a previous alarm, if there is any */
+	if(EXPECT_FALSE((res = Timer::sleepFor(t->getTid(),(uint64_t)msecs * 1000,false)) < 0))
 		SYSC_ERROR(stack,res);
 	SYSC_RET1(stack,0);
 }
 
 int Syscalls::sleep(Thread *t,IntrptStackFrame *stack) {
 	time_t msecs = SYSC_ARG1(stack);
+	ulong usecs = SYSC_ARG2(stack);
 	int res;
-	if(EXPECT_FALSE((res = Timer::sleepFor(t->getTid(),msecs,true)) < 0))
+	if(EXPECT_FALSE(usecs >= 1000))
+		SYSC_ERROR(stack,-EINVAL);
+	if(EXPECT_FALSE((res = Timer::sleepFor(t->getTid(),(uint64_t)msecs * 1000 + usecs,true)) < 0))
 		SYSC_ERROR(stack,res);
 	Thread::switchAway();
 	/* ensure that we're no longer in the timer-list. this may for example happen if we get a signal
 	 * and the sleep-time was not over yet. */
-	Timer::removeThread(t->getTid());
+	Timer::removeThread(t->getTid(),true);
 	if(EXPECT_FALSE(t->hasSignal()))
 		SYSC_ERROR(stack,-EINTR);
 	SYSC_RET1(stack,0);
@@ -108,6 +110,29 @@ int Syscalls::join(Thread *t,IntrptStackFrame *stack) {
 	SYSC_RET1(stack,0);
 }
 
+int Syscalls::setaffinity(Thread *t,IntrptStackFrame *stack) {
+	tid_t tid = (tid_t)SYSC_ARG1(stack);
+	ulong mask = SYSC_ARG2(stack);
+	Thread *tt = Thread::getRef(tid);
+	/* just threads from the own process */
+	if(EXPECT_FALSE(tt == NULL))
+		SYSC_ERROR(stack,-EINVAL);
+	if(EXPECT_FALSE(tt->getProc()->getPid() != t->getProc()->getPid())) {
+		Thread::relRef(tt);
+		SYSC_ERROR(stack,-EINVAL);
+	}
+
+	int res = Sched::setAffinity(tt,mask);
+	Thread::relRef(tt);
+	if(EXPECT_FALSE(res < 0))
+		SYSC_ERROR(stack,res);
+
+	/* if we're not allowed to run here anymore, move to an allowed CPU immediately */
+	if(tt == t && !(t->getAffinity() & (1UL << t->getCPU())))
+		Thread::switchAway();
+	SYSC_RET1(stack,0);
+}
+
 int Syscalls::semcrtirq(Thread *t,IntrptStackFrame *stack) {
 	char kname[32];
 	int irq = (int)SYSC_ARG1(stack);
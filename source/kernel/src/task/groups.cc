@@ -85,6 +85,25 @@ size_t Groups::get(pid_t pid,USER gid_t *list,size_t count) {
 	return res;
 }
 
+ssize_t Groups::copy(pid_t pid,gid_t *list,size_t count) {
+	ssize_t res = 0;
+	Proc *p = Proc::getRef(pid);
+	if(p) {
+		LockGuard<SpinLock> guard(&lock);
+		Entries *g = p->groups;
+		if(g) {
+			if(g->count > count)
+				res = -1;
+			else {
+				memcpy(list,g->groups,g->count * sizeof(gid_t));
+				res = g->count;
+			}
+		}
+		Proc::relRef(p);
+	}
+	return res;
+}
+
 bool Groups::contains(pid_t pid,gid_t gid) {
 	bool res = false;
 	Proc *p = Proc::getRef(pid);
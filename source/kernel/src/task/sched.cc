@@ -27,10 +27,15 @@
 #include <util.h>
 #include <cpu.h>
 #include <spinlock.h>
+#include <atomic.h>
 #include <video.h>
 #include <log.h>
 #include <assert.h>
 #include <string.h>
+#include <errno.h>
+
+/* the number of attempts to lock the run-queue of another CPU */
+#define REMOTE_LOCK_TRIES	64
 
 /**
  * We're using round-robin here atm. That means a thread-switch puts the current thread at the end
@@ -41,56 +46,147 @@
  * the beginning and end. Therefore we can dequeue the first, prepend, append and remove a thread
  * in O(1). Additionally the number of threads is limited by the kernel-heap (i.e. we don't need
  * a static storage of nodes for the linked list; we use the threads itself)
+ *
+ * Every CPU has its own ready-queues with its own lock, so that thread-switches on different CPUs
+ * don't contend. A thread is always put on the queues of the CPU it ran on last. If a CPU has
+ * nothing to do, it steals a thread from another CPU. Only the event-lists are global and thus
+ * protected by a global lock, which has to be acquired before the lock of a run-queue.
+ *
+ * To find the thread to run, we take the highest bit in the ready-mask, which gives us the
+ * highest priority that has a ready thread. Threads can be restricted to a set of CPUs. If a
+ * thread is on the run-queue of a CPU it is not allowed to run on anymore, it is "misplaced" and
+ * will be pulled by an allowed CPU on its next schedule.
  */
 
+static inline uint highestBit(ulong mask) {
+	return sizeof(ulong) * 8 - 1 - __builtin_clzl(mask);
+}
+
 SpinLock Sched::lock;
-ulong Sched::readyMask = 0;
-DList<Thread> Sched::rdyQueues[MAX_PRIO + 1];
+Sched::RunQueue *Sched::rqs;
+size_t Sched::misplaced = 0;
 DList<Thread> Sched::evlists[EV_COUNT];
-size_t Sched::rdyCount;
-Thread **Sched::idleThreads;
 
 void Sched::init() {
-	idleThreads = (Thread**)Cache::calloc(SMP::getCPUCount(),sizeof(Thread*));
-	if(!idleThreads)
-		Util::panic("Unable to allocate idle-threads array");
-	rdyCount = 0;
+	rqs = (RunQueue*)Cache::calloc(SMP::getCPUCount(),sizeof(RunQueue));
+	if(!rqs)
+		Util::panic("Unable to allocate run-queues");
 }
 
 void Sched::addIdleThread(Thread *t) {
 	LockGuard<SpinLock> g(&lock);
 	for(size_t i = 0; i < SMP::getCPUCount(); ++i) {
-		if(idleThreads[i] == NULL) {
-			idleThreads[i] = t;
+		if(rqs[i].idle == NULL) {
+			rqs[i].idle = t;
 			break;
 		}
 	}
 }
 
-void Sched::enqueue(Thread *t) {
+Sched::RunQueue *Sched::lockThread(const Thread *t) {
+	while(1) {
+		RunQueue *rq = rqs + t->getCPU();
+		rq->lock.down();
+		/* if it has not been migrated in the meantime, we're done */
+		if(EXPECT_TRUE(rqs + t->getCPU() == rq))
+			return rq;
+		rq->lock.up();
+	}
+}
+
+inline bool Sched::isAllowed(const Thread *t,cpuid_t cpu) {
+	return t->getAffinity() & (1UL << cpu);
+}
+
+cpuid_t Sched::targetCPU(const Thread *t) {
+	if(EXPECT_TRUE(isAllowed(t,t->getCPU())))
+		return t->getCPU();
+	/* setAffinity() ensures that there is at least one existing CPU in the mask */
+	return __builtin_ctzl(t->getAffinity());
+}
+
+void Sched::enqueue(RunQueue *rq,Thread *t) {
 	uint8_t prio = t->getPriority();
-	rdyQueues[prio].append(t);
-	readyMask |= 1UL << prio;
-	rdyCount++;
+	rq->queues[prio].append(t);
+	rq->readyMask |= 1UL << prio;
+	rq->count++;
+	if(EXPECT_FALSE(!isAllowed(t,rq - rqs))) {
+		rq->misplaced++;
+		Atomic::fetch_and_add(&misplaced,+1);
+	}
 }
 
-void Sched::enqueueQuick(Thread *t) {
+void Sched::enqueueQuick(RunQueue *rq,Thread *t) {
 	uint8_t prio = t->getPriority();
-	rdyQueues[prio].prepend(t);
-	readyMask |= 1UL << prio;
-	rdyCount++;
+	rq->queues[prio].prepend(t);
+	rq->readyMask |= 1UL << prio;
+	rq->count++;
+	if(EXPECT_FALSE(!isAllowed(t,rq - rqs))) {
+		rq->misplaced++;
+		Atomic::fetch_and_add(&misplaced,+1);
+	}
 }
 
-void Sched::dequeue(Thread *t) {
+void Sched::dequeue(RunQueue *rq,Thread *t) {
 	uint8_t prio = t->getPriority();
-	rdyQueues[prio].remove(t);
-	if(rdyQueues[prio].length() == 0)
-		readyMask &= ~(1UL << prio);
-	rdyCount--;
+	rq->queues[prio].remove(t);
+	if(rq->queues[prio].length() == 0)
+		rq->readyMask &= ~(1UL << prio);
+	rq->count--;
+	if(EXPECT_FALSE(!isAllowed(t,rq - rqs))) {
+		rq->misplaced--;
+		Atomic::fetch_and_add(&misplaced,-1);
+	}
+}
+
+int Sched::setAffinity(Thread *t,ulong mask) {
+	size_t total = SMP::getCPUCount();
+	if(total < sizeof(ulong) * 8)
+		mask &= (1UL << total) - 1;
+	if(mask == 0)
+		return -EINVAL;
+
+	RunQueue *rq = lockThread(t);
+	/* requeue it, if necessary, to keep the misplaced-counters up to date */
+	bool ready = t->getState() == Thread::READY;
+	if(ready)
+		dequeue(rq,t);
+	t->affinity = mask;
+	if(ready)
+		enqueue(rq,t);
+	bool move = ready && !isAllowed(t,t->getCPU());
+	cpuid_t target = targetCPU(t);
+	rq->lock.up();
+
+	/* a running thread is moved as soon as it is switched out (see perform) */
+	if(move)
+		kickCPU(target);
+	return 0;
 }
 
 Thread *Sched::perform(Thread *old,cpuid_t cpu) {
-	LockGuard<SpinLock> g(&lock);
+	RunQueue *rq = rqs + cpu;
+
+	/* we have to check for a signal here, because otherwise we might miss it */
+	/* (scenario: cpu0 unblocks t1 for signal, cpu1 runs t1 and blocks itself) */
+	/* since the signal is set before the thread is unblocked, it is sufficient to check that
+	 * without lock. if we miss it, the unblock will find the thread blocked */
+	if(old && !(old->getFlags() & T_IDLE) && old->getNewState() != Thread::ZOMBIE &&
+			old->hasSignal()) {
+		/* we need the global lock to remove it from the event-list */
+		LockGuard<SpinLock> g(&lock);
+		LockGuard<SpinLock> rg(&rq->lock);
+		if(old->getNewState() != Thread::ZOMBIE) {
+			/* we have to reset the newstate in this case and remove us from event */
+			old->setNewState(Thread::READY);
+			old->waitstart = 0;
+			removeFromEventlist(old);
+			return old;
+		}
+	}
+
+	rq->lock.down();
+
 	/* give the old thread a new state */
 	if(old) {
 		if(old->getFlags() & T_IDLE)
@@ -98,21 +194,11 @@ Thread *Sched::perform(Thread *old,cpuid_t cpu) {
 		else {
 			vassert(old->getState() == Thread::RUNNING,"State %d",old->getState());
 
-			/* we have to check for a signal here, because otherwise we might miss it */
-			/* (scenario: cpu0 unblocks t1 for signal, cpu1 runs t1 and blocks itself) */
-			if(old->getNewState() != Thread::ZOMBIE && old->hasSignal()) {
-				/* we have to reset the newstate in this case and remove us from event */
-				old->setNewState(Thread::READY);
-				old->waitstart = 0;
-				removeFromEventlist(old);
-				return old;
-			}
-
 			switch(old->getNewState()) {
 				case Thread::READY:
 					assert(old->event == 0);
 					old->setState(Thread::READY);
-					enqueue(old);
+					enqueue(rq,old);
 					break;
 				case Thread::BLOCKED:
 				case Thread::ZOMBIE:
@@ -125,27 +211,20 @@ Thread *Sched::perform(Thread *old,cpuid_t cpu) {
 		}
 	}
 
+	/* first take the threads that want to run here, but are on the queues of other CPUs */
+	if(EXPECT_FALSE(misplaced > 0) && SMP::getCPUCount() > 1)
+		pullMisplaced(cpu);
+
 	/* get new thread */
-	Thread *t;
-	for(ssize_t i = MAX_PRIO; i >= 0; i--) {
-		t = rdyQueues[i].removeFirst();
-		if(t) {
-			/* if its the old thread again and we have more ready threads, don't take this one again.
-			 * because we assume that Thread::switchAway() has been called for a reason. therefore, it
-			 * should be better to take a thread with a lower priority than taking the same again */
-			if(rdyCount > 1 && t == old) {
-				rdyQueues[i].append(t);
-				continue;
-			}
-			if(rdyQueues[i].length() == 0)
-				readyMask &= ~(1UL << i);
-			rdyCount--;
-			break;
-		}
-	}
+	Thread *t = pick(rq,cpu,old);
+
+	/* if we have nothing to do, try to take work from the other CPUs */
+	if(t == NULL && SMP::getCPUCount() > 1)
+		t = steal(cpu);
+
 	if(t == NULL) {
 		/* choose an idle-thread */
-		t = idleThreads[cpu];
+		t = rq->idle;
 		t->setState(Thread::RUNNING);
 	}
 	else {
@@ -153,14 +232,139 @@ Thread *Sched::perform(Thread *old,cpuid_t cpu) {
 		t->setNewState(Thread::READY);
 	}
 
+	bool more = rq->count > rq->misplaced;
+	bool oldMisplaced = old && old->getState() == Thread::READY && !isAllowed(old,cpu);
+	rq->lock.up();
+
 	/* if there is another thread ready, check if we have another cpu that we can start for it */
-	if(rdyCount > 0)
+	if(more)
 		SMP::wakeupCPU();
+	/* if we have just put a thread on our queue that should run somewhere else, tell them */
+	if(EXPECT_FALSE(oldMisplaced))
+		kickCPU(targetCPU(old));
 	return t;
 }
 
+Thread *Sched::pick(RunQueue *rq,cpuid_t cpu,Thread *old) {
+	/* if its the old thread again and we have more ready threads, don't take this one again.
+	 * because we assume that Thread::switchAway() has been called for a reason. therefore, it
+	 * should be better to take a thread with a lower priority than taking the same again */
+	Thread *fallback = NULL;
+	ulong mask = rq->readyMask;
+	while(mask) {
+		uint prio = highestBit(mask);
+		/* in almost all cases, we take the first one */
+		for(auto it = rq->queues[prio].begin(); it != rq->queues[prio].end(); ++it) {
+			Thread *t = &*it;
+			if(EXPECT_FALSE(!isAllowed(t,cpu)))
+				continue;
+			if(EXPECT_FALSE(t == old)) {
+				fallback = t;
+				continue;
+			}
+			dequeue(rq,t);
+			return t;
+		}
+		mask &= ~(1UL << prio);
+	}
+
+	if(fallback)
+		dequeue(rq,fallback);
+	return fallback;
+}
+
+bool Sched::lockRemote(RunQueue *rq) {
+	/* never wait for the locks of other CPUs here to prevent deadlocks, because the other CPU
+	 * might try to lock our queue at the same time. but switches are short, so try it a few times */
+	for(int i = 0; i < REMOTE_LOCK_TRIES; ++i) {
+		if(rq->switchLock.tryDown()) {
+			if(rq->lock.tryDown())
+				return true;
+			rq->switchLock.up();
+		}
+		CPU::pause();
+	}
+	return false;
+}
+
+Thread *Sched::steal(cpuid_t cpu) {
+	size_t total = SMP::getCPUCount();
+	for(size_t i = 1; i < total; ++i) {
+		RunQueue *vrq = rqs + (cpu + i) % total;
+		if(vrq->count == 0)
+			continue;
+
+		/* we can't take threads from a CPU that is currently switching, because it might be the
+		 * thread that has not been saved yet */
+		if(!lockRemote(vrq))
+			continue;
+
+		Thread *t = NULL;
+		ulong mask = vrq->readyMask;
+		while(t == NULL && mask) {
+			uint prio = highestBit(mask);
+			for(auto it = vrq->queues[prio].begin(); it != vrq->queues[prio].end(); ++it) {
+				if(isAllowed(&*it,cpu)) {
+					t = &*it;
+					dequeue(vrq,t);
+					/* from now on, the thread belongs to us */
+					t->setCPU(cpu);
+					t->getStats().migrations++;
+					break;
+				}
+			}
+			mask &= ~(1UL << prio);
+		}
+
+		vrq->lock.up();
+		vrq->switchLock.up();
+		if(t)
+			return t;
+	}
+	return NULL;
+}
+
+void Sched::pullMisplaced(cpuid_t cpu) {
+	RunQueue *rq = rqs + cpu;
+	size_t total = SMP::getCPUCount();
+	for(size_t i = 1; i < total; ++i) {
+		RunQueue *vrq = rqs + (cpu + i) % total;
+		if(vrq->misplaced == 0 || !lockRemote(vrq))
+			continue;
+
+		for(size_t p = 0; vrq->misplaced > 0 && p <= MAX_PRIO; ++p) {
+			for(auto it = vrq->queues[p].begin(); it != vrq->queues[p].end(); ) {
+				Thread *t = &*it++;
+				if(!isAllowed(t,(cpuid_t)(vrq - rqs)) && isAllowed(t,cpu)) {
+					dequeue(vrq,t);
+					t->setCPU(cpu);
+					t->getStats().migrations++;
+					enqueue(rq,t);
+				}
+			}
+		}
+
+		vrq->lock.up();
+		vrq->switchLock.up();
+	}
+}
+
+void Sched::kickCPU(cpuid_t cpu) {
+	if(SMP::getCPUCount() == 1)
+		return;
+
+	/* if the CPU idles, let it run the thread. otherwise let somebody steal it */
+	SMP::CPU *c = SMP::cpus[cpu];
+	if(c->thread && (c->thread->getFlags() & T_IDLE)) {
+		if(c->ready && cpu != SMP::getCurId())
+			SMP::sendIPI(cpu,IPI_WORK);
+	}
+	else
+		SMP::wakeupCPU();
+}
+
 void Sched::adjustPrio(Thread *t,uint64_t total) {
-	LockGuard<SpinLock> g(&lock);
+	RunQueue *rq = lockThread(t);
 	/* if it is still blocked, add the time to the blocked time */
 	if(t->waitstart > 0) {
 		uint64_t now = CPU::rdtsc();
@@ -191,10 +395,10 @@ void Sched::adjustPrio(Thread *t,uint64_t total) {
 	if(t->stats.blocked < BAD_BLOCK_TIME(total)) {
 		if(t->getPriority() > 0) {
 			if(t->getState() == Thread::READY)
-				dequeue(t);
+				dequeue(rq,t);
 			t->setPriority(t->getPriority() - 1);
 			if(t->getState() == Thread::READY)
-				enqueue(t);
+				enqueue(rq,t);
 		}
 		t->prioGoodCnt = 0;
 	}
@@ -204,10 +408,10 @@ void Sched::adjustPrio(Thread *t,uint64_t total) {
 			/* but don't do that immediately, but only if it happened multiple times */
 			if(++t->prioGoodCnt == PRIO_FORGIVE_CNT) {
 				if(t->getState() == Thread::READY)
-					dequeue(t);
+					dequeue(rq,t);
 				t->setPriority(t->getPriority() + 1);
 				if(t->getState() == Thread::READY)
-					enqueue(t);
+					enqueue(rq,t);
 				t->prioGoodCnt = 0;
 			}
 		}
@@ -215,17 +419,20 @@ void Sched::adjustPrio(Thread *t,uint64_t total) {
 
 	/* reset blocked time */
 	t->stats.blocked = 0;
+	rq->lock.up();
 }
 
 void Sched::wait(Thread *t,uint event,evobj_t object) {
 	LockGuard<SpinLock> g(&lock);
+	RunQueue *rq = lockThread(t);
 	assert(t->event == 0);
 	assert(Thread::getRunning() == t);
 	t->event = event;
 	t->evobject = object;
-	setBlocked(t);
+	setBlocked(rq,t);
 	if(event)
 		evlists[event - 1].append(t);
+	rq->lock.up();
 }
 
 void Sched::wakeup(uint event,evobj_t object,bool all) {
@@ -236,8 +443,10 @@ void Sched::wakeup(uint event,evobj_t object,bool all) {
 		auto old = it++;
 		assert(old->event == event);
 		if(old->evobject == 0 || old->evobject == object) {
+			RunQueue *rq = lockThread(&*old);
 			removeFromEventlist(&*old);
-			setReady(&*old);
+			setReady(rq,&*old);
+			rq->lock.up();
 			if(!all)
 				break;
 		}
@@ -252,7 +461,7 @@ void Sched::removeFromEventlist(Thread *t) {
 	}
 }
 
-void Sched::setReady(Thread *t) {
+void Sched::setReady(RunQueue *rq,Thread *t) {
 	if(t->getFlags() & T_IDLE)
 		return;
 
@@ -267,11 +476,12 @@ void Sched::setReady(Thread *t) {
 	}
 	else if(setReadyState(t)) {
 		assert(t->event == 0);
-		enqueue(t);
+		enqueue(rq,t);
+		kickCPU(targetCPU(t));
 	}
 }
 
-void Sched::setReadyQuick(Thread *t) {
+void Sched::setReadyQuick(RunQueue *rq,Thread *t) {
 	if(t->getFlags() & T_IDLE)
 		return;
 
@@ -286,16 +496,17 @@ void Sched::setReadyQuick(Thread *t) {
 	}
 	else if(t->getState() == Thread::READY) {
 		assert(t->event == 0);
-		dequeue(t);
-		enqueueQuick(t);
+		dequeue(rq,t);
+		enqueueQuick(rq,t);
 	}
 	else if(setReadyState(t)) {
 		assert(t->event == 0);
-		enqueueQuick(t);
+		enqueueQuick(rq,t);
+		kickCPU(targetCPU(t));
 	}
 }
 
-void Sched::setBlocked(Thread *t) {
+void Sched::setBlocked(RunQueue *rq,Thread *t) {
 	switch(t->getState()) {
 		case Thread::ZOMBIE:
 		case Thread::BLOCKED:
@@ -305,7 +516,7 @@ void Sched::setBlocked(Thread *t) {
 			break;
 		case Thread::READY:
 			t->setState(Thread::BLOCKED);
-			dequeue(t);
+			dequeue(rq,t);
 			break;
 		default:
 			vassert(false,"Invalid state for setBlocked (%d)",t->getState());
@@ -316,6 +527,7 @@ void Sched::setBlocked(Thread *t) {
 
 void Sched::removeThread(Thread *t) {
 	LockGuard<SpinLock> g(&lock);
+	RunQueue *rq = lockThread(t);
 	switch(t->getState()) {
 		case Thread::RUNNING:
 			break;
@@ -323,7 +535,7 @@ void Sched::removeThread(Thread *t) {
 			removeFromEventlist(t);
 			break;
 		case Thread::READY:
-			dequeue(t);
+			dequeue(rq,t);
 			break;
 		default:
 			/* TODO threads can die during swap, right? */
@@ -331,6 +543,7 @@ void Sched::removeThread(Thread *t) {
 			break;
 	}
 	t->setNewState(Thread::ZOMBIE);
+	rq->lock.up();
 }
 
 bool Sched::setReadyState(Thread *t) {
@@ -350,11 +563,15 @@ bool Sched::setReadyState(Thread *t) {
 }
 
 void Sched::print(OStream &os) {
-	os.writef("Ready queues:\n");
-	for(size_t i = 0; i < ARRAY_SIZE(rdyQueues); i++) {
-		os.writef("\t[%d]:\n",i);
-		print(os,rdyQueues + i);
-		os.writef("\n");
+	for(size_t cpu = 0; cpu < SMP::getCPUCount(); cpu++) {
+		RunQueue *rq = rqs + cpu;
+		os.writef("CPU %zu: %zu ready threads (%zu misplaced), mask=%#lx\n",
+			cpu,rq->count,rq->misplaced,rq->readyMask);
+		for(size_t i = 0; i < ARRAY_SIZE(rq->queues); i++) {
+			os.writef("\t[%d]:\n",i);
+			print(os,rq->queues + i);
+			os.writef("\n");
+		}
 	}
 }
 
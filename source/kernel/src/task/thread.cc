@@ -113,6 +113,7 @@ void ThreadBase::initProps() {
 	intrptLevel = 0;
 	threadDir = 0;
 	cpu = 0;
+	affinity = ~0UL;
 	stats.runtime = 0;
 	stats.curCycleCount = 0;
 	stats.lastCycleCount = 0;
@@ -206,6 +207,19 @@ bool ThreadBase::reserveFrames(size_t count,bool swap) {
 	return true;
 }
 
+size_t ThreadBase::tryReserveFrames(size_t count) {
+	if(!PhysMem::tryReserve(count))
+		return 0;
+	size_t i;
+	for(i = 0; i < count; i++) {
+		frameno_t frm = PhysMem::allocate(PhysMem::USR);
+		if(frm == INVALID_FRAME)
+			break;
+		reqFrames.append(frm);
+	}
+	return i;
+}
+
 int ThreadBase::create(Thread *src,Thread **dst,Proc *p,uint8_t tflags,bool cloneProc) {
 	int err = -ENOMEM;
 	Thread *t = (Thread*)Cache::alloc(sizeof(Thread));
@@ -215,6 +229,9 @@ int ThreadBase::create(Thread *src,Thread **dst,Proc *p,uint8_t tflags,bool clon
 	t->proc = p;
 	t->flags = tflags;
 	t->initProps();
+	/* start on the run-queue of our creator and inherit its affinity */
+	t->cpu = src->cpu;
+	t->affinity = src->affinity;
 
 	/* determine tid (ensure that nobody else gets the same) and insert into thread-list */
 	{
@@ -342,6 +359,7 @@ void ThreadBase::print(OStream &os) const {
 	os.writef("\n");
 	Signals::print(static_cast<const Thread*>(this),os);
 	os.writef("LastCPU = %d\n",cpu);
+	os.writef("Affinity = %#lx\n",affinity);
 	for(size_t i = 0; i < STACK_REG_COUNT; i++) {
 		os.writef("stackRegion%zu = %p",i,stackRegions[i] ? stackRegions[i]->virt() : 0);
 		if(i + 1 < STACK_REG_COUNT)
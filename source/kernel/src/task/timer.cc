@@ -27,14 +27,15 @@
 #include <spinlock.h>
 #include <errno.h>
 
-/* total elapsed milliseconds */
 TimerBase::PerCPU *TimerBase::perCPU = NULL;
 time_t TimerBase::lastRuntimeUpdate = 0;
 
 SpinLock TimerBase::lock;
-TimerBase::Listener TimerBase::listenObjs[LISTENER_COUNT];
-TimerBase::Listener *TimerBase::freeList;
-TimerBase::Listener *TimerBase::listener = NULL;
+TimerBase::Listener *TimerBase::heap = NULL;
+size_t TimerBase::heapSize = 0;
+size_t TimerBase::heapCapacity = 0;
+/* the position + 1 of each thread's non-blocking and blocking listener in the heap (0 = none) */
+static uint16_t heapPos[2][MAX_THREAD_COUNT];
 
 void TimerBase::init() {
 	archInit();
@@ -43,46 +44,43 @@ void TimerBase::init() {
 	if(!perCPU)
 		Util::panic("Unable to create per-cpu-array");
 
-	/* init objects */
-	listenObjs->next = NULL;
-	freeList = listenObjs;
-	for(size_t i = 1; i < LISTENER_COUNT; i++) {
-		listenObjs[i].next = freeList;
-		freeList = listenObjs + i;
-	}
+	heap = (Listener*)Cache::alloc(INITIAL_LISTENERS * sizeof(Listener));
+	if(!heap)
+		Util::panic("Unable to create timer-heap");
+	heapCapacity = INITIAL_LISTENERS;
 }
 
-int TimerBase::sleepFor(tid_t tid,time_t msecs,bool block) {
+int TimerBase::sleepFor(tid_t tid,uint64_t usecs,bool block) {
+	uint64_t now = getMicros();
 	LockGuard<SpinLock> g(&lock);
-	Listener *l = freeList;
-	if(l == NULL)
-		return -ENOMEM;
-
-	/* remove from freelist */
-	freeList = freeList->next;
-	/* find place and calculate time */
-	l->tid = tid;
-	time_t msecDiff = 0;
-	Listener *p = NULL;
-	Listener *nl;
-	for(nl = listener; nl != NULL; p = nl, nl = nl->next) {
-		if(msecDiff + nl->time > msecs)
-			break;
-		msecDiff += nl->time;
+	Listener l;
+	l.tid = tid;
+	l.block = block;
+	l.deadline = now + usecs;
+
+	size_t pos = heapPos[block][tid];
+	if(pos > 0) {
+		/* replace the existing one; it moves either up or down */
+		place(pos - 1,l);
+		siftUp(pos - 1);
+		siftDown(heapPos[block][tid] - 1);
+	}
+	else {
+		if(heapSize == heapCapacity) {
+			Listener *nheap = (Listener*)Cache::realloc(heap,heapCapacity * 2 * sizeof(Listener));
+			if(nheap == NULL)
+				return -ENOMEM;
+			heap = nheap;
+			heapCapacity *= 2;
+		}
+		place(heapSize,l);
+		siftUp(heapSize++);
 	}
 
-	l->time = msecs - msecDiff;
-	l->block = block;
-	/* insert entry */
-	l->next = nl;
-	if(p)
-		p->next = l;
-	else
-		listener = l;
-
-	/* now change time of next one */
-	if(nl)
-		nl->time -= l->time;
+	/* if the listener is the next one, make sure that we get an interrupt in time. other CPUs can
+	 * only wake up later, so that this is sufficient. */
+	if(heap[0].tid == tid && heap[0].block == block)
+		rearm(Thread::getRunning()->getCPU(),now);
 
 	/* put process to sleep */
 	if(block)
@@ -92,86 +90,132 @@ int TimerBase::sleepFor(tid_t tid,time_t msecs,bool block) {
 
 void TimerBase::removeThread(tid_t tid) {
 	LockGuard<SpinLock> g(&lock);
-	Listener *p = NULL;
-	for(Listener *l = listener; l != NULL; p = l, l = l->next) {
-		if(l->tid == tid) {
-			/* increase time of next */
-			if(l->next)
-				l->next->time += l->time;
-			/* remove from list */
-			if(p)
-				p->next = l->next;
-			else
-				listener = l->next;
-			/* put on freelist */
-			l->next = freeList;
-			freeList = l;
-			/* it's not possible to be in the list twice */
-			break;
-		}
+	for(int block = 0; block < 2; ++block) {
+		if(heapPos[block][tid] > 0)
+			remove(heapPos[block][tid] - 1);
 	}
 }
 
+void TimerBase::removeThread(tid_t tid,bool block) {
+	LockGuard<SpinLock> g(&lock);
+	if(heapPos[block][tid] > 0)
+		remove(heapPos[block][tid] - 1);
+}
+
+void TimerBase::schedule(cpuid_t cpu,bool idle) {
+	uint64_t now = getMicros();
+	LockGuard<SpinLock> g(&lock);
+	perCPU[cpu].lastResched = now;
+	perCPU[cpu].idle = idle;
+	rearm(cpu,now);
+}
+
 bool TimerBase::intrpt() {
 	bool res,foundThread = false;
-	time_t timeInc = 1000 / FREQUENCY_DIV;
 	cpuid_t cpu = Thread::getRunning()->getCPU();
 
 	perCPU[cpu].timerIntrpts++;
-	perCPU[cpu].elapsedMsecs += timeInc;
-
-	if(cpu == 0) {
-		LockGuard<SpinLock> g(&lock);
-		if((perCPU[cpu].elapsedMsecs - lastRuntimeUpdate) >= RUNTIME_UPDATE_INTVAL) {
-			Thread::updateRuntimes();
-			SMP::updateRuntimes();
-			lastRuntimeUpdate = perCPU[cpu].elapsedMsecs;
-		}
+	uint64_t now = getMicros();
+
+	LockGuard<SpinLock> g(&lock);
+	if(cpu == 0 && (time_t)(now / 1000) - lastRuntimeUpdate >= RUNTIME_UPDATE_INTVAL) {
+		Thread::updateRuntimes();
+		SMP::updateRuntimes();
+		lastRuntimeUpdate = now / 1000;
+	}
 
-		/* look if there are threads to wakeup */
-		for(Listener *l = listener; l != NULL; ) {
-			/* stop if we have to continue waiting for this one */
-			/* note that multiple listeners may have l->time = 0 */
-			if(l->time > timeInc) {
-				l->time -= timeInc;
-				break;
-			}
-
-			timeInc -= l->time;
-			/* wake up thread */
-			Thread *t = Thread::getById(l->tid);
-			if(l->block) {
-				t->unblock();
-				foundThread = true;
-			}
-			else
-				Signals::addSignalFor(t,SIGALRM);
-			/* remove from list */
-			listener = l->next;
-			Listener *tl = l->next;
-			/* put on freelist */
-			l->next = freeList;
-			freeList = l;
-			/* to next */
-			l = tl;
+	/* look if there are threads to wakeup. every CPU does that, because in one-shot mode, the
+	 * CPU that has been programmed for the next deadline is the one that handles it */
+	while(heapSize > 0 && heap[0].deadline <= now) {
+		Listener l = heap[0];
+		remove(0);
+
+		/* wake up thread */
+		Thread *t = Thread::getById(l.tid);
+		if(l.block) {
+			t->unblock();
+			foundThread = true;
 		}
+		else
+			Signals::addSignalFor(t,SIGALRM);
 	}
 
 	/* if a process has been waked up or the time-slice is over, reschedule */
 	res = false;
-	if(foundThread || (perCPU[cpu].elapsedMsecs - perCPU[cpu].lastResched) >= TIMESLICE) {
-		perCPU[cpu].lastResched = perCPU[cpu].elapsedMsecs;
+	if(foundThread || (now - perCPU[cpu].lastResched) >= TIMESLICE * 1000) {
+		perCPU[cpu].lastResched = now;
 		res = true;
 	}
+	rearm(cpu,now);
 	return res;
 }
 
+void TimerBase::rearm(cpuid_t cpu,uint64_t now) {
+	uint64_t deadline = heapSize > 0 ? heap[0].deadline : NO_DEADLINE;
+	/* a running thread has to be preempted at the end of its time-slice. idle CPUs need a tick as
+	 * well, because a thread that is enqueued while the CPU is switching to its idle-thread does
+	 * not get an IPI. without a tick, it would stay in the run queue until the next interrupt */
+	deadline = MIN(deadline,perCPU[cpu].lastResched + TIMESLICE * 1000);
+	/* the first CPU updates the runtimes regularly */
+	if(cpu == 0)
+		deadline = MIN(deadline,(uint64_t)(lastRuntimeUpdate + RUNTIME_UPDATE_INTVAL) * 1000);
+	program(now,deadline);
+}
+
+void TimerBase::place(size_t pos,const Listener &l) {
+	heap[pos] = l;
+	heapPos[l.block][l.tid] = pos + 1;
+}
+
+void TimerBase::remove(size_t pos) {
+	heapPos[heap[pos].block][heap[pos].tid] = 0;
+	if(pos != --heapSize) {
+		/* move the last one into the gap; it moves either up or down */
+		Listener last = heap[heapSize];
+		place(pos,last);
+		siftUp(pos);
+		siftDown(heapPos[last.block][last.tid] - 1);
+	}
+}
+
+void TimerBase::siftUp(size_t pos) {
+	Listener l = heap[pos];
+	while(pos > 0) {
+		size_t parent = (pos - 1) / 2;
+		if(heap[parent].deadline <= l.deadline)
+			break;
+		place(pos,heap[parent]);
+		pos = parent;
+	}
+	place(pos,l);
+}
+
+void TimerBase::siftDown(size_t pos) {
+	Listener l = heap[pos];
+	while(true) {
+		size_t child = pos * 2 + 1;
+		if(child >= heapSize)
+			break;
+		if(child + 1 < heapSize && heap[child + 1].deadline < heap[child].deadline)
+			child++;
+		if(l.deadline <= heap[child].deadline)
+			break;
+		place(pos,heap[child]);
+		pos = child;
+	}
+	place(pos,l);
+}
+
 void TimerBase::print(OStream &os) {
-	os.writef("Timer-Listener:\n");
-	time_t time = 0;
-	for(Listener *l = listener; l != NULL; l = l->next) {
-		time += l->time;
-		os.writef("	diff=%u ms, rem=%u ms, thread=%d(%s), block=%d\n",l->time,time,l->tid,
+	uint64_t now = getMicros();
+	os.writef("Timer-Listener (%zu of %zu slots):\n",heapSize,heapCapacity);
+	for(size_t i = 0; i < heapSize; ++i) {
+		const Listener *l = heap + i;
+		uint64_t rem = l->deadline > now ? l->deadline - now : 0;
+		os.writef("	rem=%Lu us, thread=%d(%s), block=%d\n",rem,l->tid,
 				Thread::getById(l->tid)->getProc()->getProgram(),l->block);
 	}
+	os.writef("Interrupts per CPU:\n");
+	for(size_t i = 0; i < SMP::getCPUCount(); ++i)
+		os.writef("	CPU %zu: %zu%s\n",i,perCPU[i].timerIntrpts,perCPU[i].idle ? " (idle)" : "");
 }
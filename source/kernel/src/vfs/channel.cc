@@ -29,6 +29,7 @@
 #include <vfs/channel.h>
 #include <vfs/device.h>
 #include <vfs/openfile.h>
+#include <config.h>
 #include <video.h>
 #include <spinlock.h>
 #include <log.h>
@@ -263,6 +264,44 @@ static bool useSharedMem(const void *shmem,size_t shmsize,const void *buffer,siz
 		(uintptr_t)buffer + bufsize <= (uintptr_t)shmem + shmsize;
 }
 
+ssize_t VFSChannel::lend(pid_t pid,USER const void *buffer,size_t count,bool write,Loan *loan) {
+	/* the driver uses shm() + shmemoff. so, if no file has been shared, we can pass the address of
+	 * the lent pages in the driver's address space as the offset. we do that only for drivers that
+	 * know about shared memory. */
+	if(!Config::get(Config::LEND_PAGES) || count < LEND_MIN_SIZE || shmem != NULL ||
+			isSupported(DEV_SHFILE) < 0)
+		return -1;
+	/* if we get interrupted, we need to know when the driver is done with the pages. the cancel
+	 * message tells us that, but the cancel signal doesn't. thus, don't lend pages if only the
+	 * latter is supported */
+	if(isSupported(DEV_CANCEL) < 0 && isSupported(DEV_CANCELSIG) == 0)
+		return -1;
+
+	/* if there are other threads, they could unmap the pages while the driver is using them */
+	Proc *p = Proc::getByPid(pid);
+	if(p->getThreadCount() > 1)
+		return -1;
+
+	loan->drv = Proc::getRef(getParent()->getOwner());
+	if(!loan->drv)
+		return -1;
+	loan->addr = p->getVM()->lend((uintptr_t)buffer,count,loan->drv->getVM(),write,&loan->vm);
+	if(loan->addr == 0) {
+		Proc::relRef(loan->drv);
+		loan->drv = NULL;
+		return -1;
+	}
+	return loan->addr;
+}
+
+void VFSChannel::unlend(A_UNUSED pid_t pid,Loan *loan) {
+	if(loan->drv) {
+		loan->drv->getVM()->unlend(ROUND_DN(loan->addr,PAGE_SIZE),loan->vm);
+		Proc::relRef(loan->drv);
+		loan->drv = NULL;
+	}
+}
+
 uint VFSChannel::getReceiveFlags() const {
 	uint flags = 0;
 	/* allow signals if either the cancel message or cancel signal is supported */
@@ -283,12 +322,20 @@ ssize_t VFSChannel::read(pid_t pid,OpenFile *file,USER void *buffer,off_t offset
 	if((res = isSupported(DEV_READ)) < 0)
 		return res;
 
-	/* send msg to driver */
+	/* send msg to driver; if there is no shared memory, try to lend the pages to it */
+	Loan loan;
+	ssize_t shmemoff = -1;
 	bool useshm = useSharedMem(shmem,shmemSize,buffer,count);
-	ib << esc::FileRead::Request(offset,count,useshm ? ((uintptr_t)buffer - (uintptr_t)shmem) : -1);
+	if(useshm)
+		shmemoff = (uintptr_t)buffer - (uintptr_t)shmem;
+	else
+		useshm = (shmemoff = lend(pid,buffer,count,true,&loan)) != -1;
+	ib << esc::FileRead::Request(offset,count,shmemoff);
 	res = file->sendMsg(pid,MSG_FILE_READ,ib.buffer(),ib.pos(),NULL,0);
-	if(res < 0)
+	if(res < 0) {
+		unlend(pid,&loan);
 		return res;
+	}
 
 	msgid_t mid = res;
 	uint flags = getReceiveFlags();
@@ -307,12 +354,14 @@ ssize_t VFSChannel::read(pid_t pid,OpenFile *file,USER void *buffer,off_t offset
 					continue;
 				}
 			}
+			unlend(pid,&loan);
 			return res;
 		}
 
 		/* handle response */
 		esc::FileRead::Response r;
 		ib >> r;
+		unlend(pid,&loan);
 		if(r.res < 0)
 			return r.res;
 
@@ -328,16 +377,24 @@ ssize_t VFSChannel::write(pid_t pid,OpenFile *file,USER const void *buffer,off_t
 	ulong ibuffer[IPC_DEF_SIZE / sizeof(ulong)];
 	esc::IPCBuf ib(ibuffer,sizeof(ibuffer));
 	ssize_t res;
+	ssize_t shmemoff = -1;
 	bool useshm = useSharedMem(shmem,shmemSize,buffer,count);
+	Loan loan;
 
 	if((res = isSupported(DEV_WRITE)) < 0)
 		return res;
 
-	/* send msg and data to driver */
-	ib << esc::FileWrite::Request(offset,count,useshm ? ((uintptr_t)buffer - (uintptr_t)shmem) : -1);
+	/* send msg and data to driver; if there is no shared memory, try to lend the pages to it */
+	if(useshm)
+		shmemoff = (uintptr_t)buffer - (uintptr_t)shmem;
+	else
+		useshm = (shmemoff = lend(pid,buffer,count,false,&loan)) != -1;
+	ib << esc::FileWrite::Request(offset,count,shmemoff);
 	res = file->sendMsg(pid,MSG_FILE_WRITE,ib.buffer(),ib.pos(),useshm ? NULL : buffer,count);
-	if(res < 0)
+	if(res < 0) {
+		unlend(pid,&loan);
 		return res;
+	}
 
 	msgid_t mid = res;
 	uint flags = getReceiveFlags();
@@ -355,11 +412,13 @@ ssize_t VFSChannel::write(pid_t pid,OpenFile *file,USER const void *buffer,off_t
 					continue;
 				}
 			}
+			unlend(pid,&loan);
 			return res;
 		}
 
 		esc::FileWrite::Response r;
 		ib >> r;
+		unlend(pid,&loan);
 		return r.res;
 	}
 	A_UNREACHED;
@@ -24,6 +24,7 @@
 #include <vfs/node.h>
 #include <vfs/channel.h>
 #include <vfs/device.h>
+#include <vfs/fscache.h>
 #include <video.h>
 #include <spinlock.h>
 #include <sys/messages.h>
@@ -71,6 +72,9 @@ void VFSDevice::close(A_UNUSED pid_t pid,A_UNUSED OpenFile *file,A_UNUSED int ms
 	 * action */
 	/* do that first because otherwise the client-nodes are already gone :) */
 	wakeupClients(true);
+	/* the node-number might be reused by another fs */
+	if(IS_FS(getMode()))
+		VFSFSCache::invalidate(getNo(),-1);
 	destroy();
 }
 
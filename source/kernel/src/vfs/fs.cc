@@ -25,6 +25,7 @@
 #include <vfs/vfs.h>
 #include <vfs/node.h>
 #include <vfs/fs.h>
+#include <vfs/fscache.h>
 #include <vfs/channel.h>
 #include <vfs/openfile.h>
 #include <util.h>
@@ -63,14 +64,22 @@ int VFSFS::stat(pid_t pid,OpenFile *fsFile,const char *path,struct stat *info) {
 	ulong buffer[IPC_DEF_SIZE / sizeof(ulong)];
 	esc::IPCBuf ib(buffer,sizeof(buffer));
 
+	int err;
+	if(VFSFSCache::lookup(pid,fsFile,path,info,&err))
+		return err;
+
 	const Proc *p = Proc::getByPid(pid);
 	ib << p->getEUid() << p->getEGid() << p->getPid() << esc::CString(path);
 
 	ssize_t res = communicate(pid,fsFile,MSG_FS_STAT,ib);
-	if(res < 0)
+	if(res < 0) {
+		VFSFSCache::insert(pid,fsFile,path,NULL,res);
 		return res;
+	}
 
 	ib >> *info;
+	if(!ib.error())
+		VFSFSCache::insert(pid,fsFile,path,info,0);
 	return 0;
 }
 
@@ -80,7 +89,10 @@ int VFSFS::chmod(pid_t pid,OpenFile *fsFile,const char *path,mode_t mode) {
 
 	const Proc *p = Proc::getByPid(pid);
 	ib << p->getEUid() << p->getEGid() << p->getPid() << esc::CString(path) << mode;
-	return communicate(pid,fsFile,MSG_FS_CHMOD,ib);
+	int res = communicate(pid,fsFile,MSG_FS_CHMOD,ib);
+	if(res == 0)
+		VFSFSCache::invalidate(fsFile,path);
+	return res;
 }
 
 int VFSFS::chown(pid_t pid,OpenFile *fsFile,const char *path,uid_t uid,gid_t gid) {
@@ -89,7 +101,10 @@ int VFSFS::chown(pid_t pid,OpenFile *fsFile,const char *path,uid_t uid,gid_t gid
 
 	const Proc *p = Proc::getByPid(pid);
 	ib << p->getEUid() << p->getEGid() << p->getPid() << esc::CString(path) << uid << gid;
-	return communicate(pid,fsFile,MSG_FS_CHOWN,ib);
+	int res = communicate(pid,fsFile,MSG_FS_CHOWN,ib);
+	if(res == 0)
+		VFSFSCache::invalidate(fsFile,path);
+	return res;
 }
 
 int VFSFS::utime(pid_t pid,OpenFile *fsFile,const char *path,const struct utimbuf *utimes) {
@@ -98,7 +113,10 @@ int VFSFS::utime(pid_t pid,OpenFile *fsFile,const char *path,const struct utimbu
 
 	const Proc *p = Proc::getByPid(pid);
 	ib << p->getEUid() << p->getEGid() << p->getPid() << esc::CString(path) << *utimes;
-	return communicate(pid,fsFile,MSG_FS_UTIME,ib);
+	int res = communicate(pid,fsFile,MSG_FS_UTIME,ib);
+	if(res == 0)
+		VFSFSCache::invalidate(fsFile,path);
+	return res;
 }
 
 int VFSFS::link(pid_t pid,OpenFile *fsFile,const char *oldPath,const char *newPath) {
@@ -107,7 +125,12 @@ int VFSFS::link(pid_t pid,OpenFile *fsFile,const char *oldPath,const char *newPa
 
 	const Proc *p = Proc::getByPid(pid);
 	ib << p->getEUid() << p->getEGid() << p->getPid() << esc::CString(oldPath) << esc::CString(newPath);
-	return communicate(pid,fsFile,MSG_FS_LINK,ib);
+	int res = communicate(pid,fsFile,MSG_FS_LINK,ib);
+	if(res == 0) {
+		VFSFSCache::invalidate(fsFile,oldPath);
+		VFSFSCache::invalidate(fsFile,newPath);
+	}
+	return res;
 }
 
 int VFSFS::unlink(pid_t pid,OpenFile *fsFile,const char *path) {
@@ -116,7 +139,10 @@ int VFSFS::unlink(pid_t pid,OpenFile *fsFile,const char *path) {
 
 	const Proc *p = Proc::getByPid(pid);
 	ib << p->getEUid() << p->getEGid() << p->getPid() << esc::CString(path);
-	return communicate(pid,fsFile,MSG_FS_UNLINK,ib);
+	int res = communicate(pid,fsFile,MSG_FS_UNLINK,ib);
+	if(res == 0)
+		VFSFSCache::invalidate(fsFile,path);
+	return res;
 }
 
 int VFSFS::rename(pid_t pid,OpenFile *fsFile,const char *oldPath,const char *newPath) {
@@ -125,7 +151,12 @@ int VFSFS::rename(pid_t pid,OpenFile *fsFile,const char *oldPath,const char *new
 
 	const Proc *p = Proc::getByPid(pid);
 	ib << p->getEUid() << p->getEGid() << p->getPid() << esc::CString(oldPath) << esc::CString(newPath);
-	return communicate(pid,fsFile,MSG_FS_RENAME,ib);
+	int res = communicate(pid,fsFile,MSG_FS_RENAME,ib);
+	if(res == 0) {
+		VFSFSCache::invalidate(fsFile,oldPath);
+		VFSFSCache::invalidate(fsFile,newPath);
+	}
+	return res;
 }
 
 int VFSFS::mkdir(pid_t pid,OpenFile *fsFile,const char *path,mode_t mode) {
@@ -134,7 +165,10 @@ int VFSFS::mkdir(pid_t pid,OpenFile *fsFile,const char *path,mode_t mode) {
 
 	const Proc *p = Proc::getByPid(pid);
 	ib << p->getEUid() << p->getEGid() << p->getPid() << esc::CString(path) << mode;
-	return communicate(pid,fsFile,MSG_FS_MKDIR,ib);
+	int res = communicate(pid,fsFile,MSG_FS_MKDIR,ib);
+	if(res == 0)
+		VFSFSCache::invalidate(fsFile,path);
+	return res;
 }
 
 int VFSFS::rmdir(pid_t pid,OpenFile *fsFile,const char *path) {
@@ -143,5 +177,8 @@ int VFSFS::rmdir(pid_t pid,OpenFile *fsFile,const char *path) {
 
 	const Proc *p = Proc::getByPid(pid);
 	ib << p->getEUid() << p->getEGid() << p->getPid() << esc::CString(path);
-	return communicate(pid,fsFile,MSG_FS_RMDIR,ib);
+	int res = communicate(pid,fsFile,MSG_FS_RMDIR,ib);
+	if(res == 0)
+		VFSFSCache::invalidate(fsFile,path);
+	return res;
 }
@@ -0,0 +1,229 @@
+/**
+ * $Id$
+ * Copyright (C) 2008 - 2014 Nils Asmussen
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <common.h>
+#include <task/proc.h>
+#include <task/groups.h>
+#include <task/timer.h>
+#include <vfs/fscache.h>
+#include <vfs/node.h>
+#include <spinlock.h>
+#include <lockguard.h>
+#include <ostream.h>
+#include <string.h>
+#include <errno.h>
+
+VFSFSCache::Entry VFSFSCache::entries[ENTRY_COUNT];
+SpinLock VFSFSCache::lock;
+ulong VFSFSCache::hits = 0;
+ulong VFSFSCache::negHits = 0;
+ulong VFSFSCache::misses = 0;
+ulong VFSFSCache::invalidations = 0;
+uint VFSFSCache::inoRefs[INO_BUCKETS];
+
+/* ignore trailing slashes, so that "/a/b/" and "/a/b" and "/" and "" are the same */
+static size_t normalizedLen(const char *path) {
+	size_t len = strlen(path);
+	while(len > 0 && path[len - 1] == '/')
+		len--;
+	return len;
+}
+
+size_t VFSFSCache::set(ino_t dev,const char *path,size_t len) {
+	/* FNV-1a */
+	uint32_t hash = 2166136261U ^ (uint32_t)dev;
+	for(size_t i = 0; i < len; ++i)
+		hash = (hash ^ (uchar)path[i]) * 16777619U;
+	return (hash % (ENTRY_COUNT / WAYS)) * WAYS;
+}
+
+bool VFSFSCache::getCreds(pid_t pid,Creds *creds) {
+	const Proc *p = Proc::getByPid(pid);
+	creds->uid = p->getEUid();
+	creds->gid = p->getEGid();
+	ssize_t count = Groups::copy(pid,creds->groups,MAX_GROUPS);
+	if(count < 0)
+		return false;
+	creds->groupCount = count;
+	return true;
+}
+
+bool VFSFSCache::sameCreds(const Creds *c1,const Creds *c2) {
+	return c1->uid == c2->uid && c1->gid == c2->gid && c1->groupCount == c2->groupCount &&
+		memcmp(c1->groups,c2->groups,c1->groupCount * sizeof(gid_t)) == 0;
+}
+
+VFSFSCache::Entry *VFSFSCache::find(ino_t dev,const Creds *creds,const char *path,size_t len) {
+	Entry *e = entries + set(dev,path,len);
+	for(size_t i = 0; i < WAYS; ++i, ++e) {
+		if(e->dev == dev && sameCreds(&e->creds,creds) &&
+				strncmp(e->path,path,len) == 0 && e->path[len] == '\0')
+			return e;
+	}
+	return NULL;
+}
+
+void VFSFSCache::release(Entry *e) {
+	if(e->dev != 0 && e->err == 0)
+		inoRefs[e->info.st_ino % INO_BUCKETS]--;
+	e->dev = 0;
+}
+
+void VFSFSCache::remove(Entry *e) {
+	release(e);
+	invalidations++;
+}
+
+bool VFSFSCache::lookup(pid_t pid,OpenFile *fsFile,const char *path,struct stat *info,int *err) {
+	size_t len = normalizedLen(path);
+	if(len >= PATH_LEN)
+		return false;
+
+	Creds creds;
+	if(!getCreds(pid,&creds))
+		return false;
+
+	ino_t dev = devOf(fsFile);
+	LockGuard<SpinLock> g(&lock);
+	Entry *e = find(dev,&creds,path,len);
+	if(!e || e->expires <= Timer::getRuntime()) {
+		if(e)
+			release(e);
+		misses++;
+		return false;
+	}
+
+	*err = e->err;
+	if(e->err == 0) {
+		if(info)
+			memcpy(info,&e->info,sizeof(*info));
+		hits++;
+	}
+	else
+		negHits++;
+	return true;
+}
+
+void VFSFSCache::insert(pid_t pid,OpenFile *fsFile,const char *path,const struct stat *info,int err) {
+	size_t len = normalizedLen(path);
+	if(len >= PATH_LEN || (err != 0 && err != -ENOENT))
+		return;
+
+	Creds creds;
+	if(!getCreds(pid,&creds))
+		return;
+
+	ino_t dev = devOf(fsFile);
+	time_t now = Timer::getRuntime();
+	LockGuard<SpinLock> g(&lock);
+	Entry *e = find(dev,&creds,path,len);
+	if(!e) {
+		/* take a free or expired way or, if there is none, the one that expires first */
+		Entry *first = entries + set(dev,path,len);
+		e = first;
+		for(size_t i = 0; i < WAYS; ++i) {
+			if(first[i].dev == 0 || first[i].expires <= now) {
+				e = first + i;
+				break;
+			}
+			if(first[i].expires < e->expires)
+				e = first + i;
+		}
+	}
+
+	release(e);
+	e->dev = dev;
+	memcpy(&e->creds,&creds,sizeof(creds));
+	e->expires = now + TTL;
+	e->err = err;
+	if(err == 0) {
+		memcpy(&e->info,info,sizeof(e->info));
+		inoRefs[info->st_ino % INO_BUCKETS]++;
+	}
+	memcpy(e->path,path,len);
+	e->path[len] = '\0';
+}
+
+void VFSFSCache::invalidate(OpenFile *fsFile,const char *path) {
+	size_t len = normalizedLen(path);
+	size_t parentLen = len;
+	while(parentLen > 0 && path[parentLen - 1] != '/')
+		parentLen--;
+	parentLen = parentLen > 0 ? parentLen - 1 : 0;
+
+	ino_t dev = devOf(fsFile);
+	ino_t ino = -1;
+	LockGuard<SpinLock> g(&lock);
+	for(size_t i = 0; i < ENTRY_COUNT; ++i) {
+		Entry *e = entries + i;
+		if(e->dev != dev)
+			continue;
+
+		/* the path itself or something below it */
+		if(strncmp(e->path,path,len) == 0 && (e->path[len] == '\0' || e->path[len] == '/')) {
+			if(e->path[len] == '\0' && e->err == 0)
+				ino = e->info.st_ino;
+			remove(e);
+		}
+		/* the parent directory (its size, link count and times might change) */
+		else if(len > 0 && strncmp(e->path,path,parentLen) == 0 && e->path[parentLen] == '\0')
+			remove(e);
+	}
+
+	/* other links to the same file */
+	if(ino != (ino_t)-1) {
+		for(size_t i = 0; i < ENTRY_COUNT; ++i) {
+			Entry *e = entries + i;
+			if(e->dev == dev && e->err == 0 && e->info.st_ino == ino)
+				remove(e);
+		}
+	}
+}
+
+void VFSFSCache::invalidate(ino_t dev,ino_t ino) {
+	/* writes call us for every chunk; don't walk the table if nothing of this inode is cached */
+	if(ino != (ino_t)-1 && inoRefs[ino % INO_BUCKETS] == 0)
+		return;
+
+	LockGuard<SpinLock> g(&lock);
+	for(size_t i = 0; i < ENTRY_COUNT; ++i) {
+		Entry *e = entries + i;
+		if(e->dev == dev && (ino == (ino_t)-1 || (e->err == 0 && e->info.st_ino == ino)))
+			remove(e);
+	}
+}
+
+void VFSFSCache::print(OStream &os) {
+	LockGuard<SpinLock> g(&lock);
+	size_t used = 0,negative = 0;
+	time_t now = Timer::getRuntime();
+	for(size_t i = 0; i < ENTRY_COUNT; ++i) {
+		if(entries[i].dev != 0 && entries[i].expires > now) {
+			used++;
+			if(entries[i].err != 0)
+				negative++;
+		}
+	}
+
+	os.writef("%-16s%zu of %zu (%zu negative)\n","Entries:",used,ENTRY_COUNT,negative);
+	os.writef("%-16s%lu\n","Hits:",hits);
+	os.writef("%-16s%lu\n","Negative hits:",negHits);
+	os.writef("%-16s%lu\n","Misses:",misses);
+	os.writef("%-16s%lu\n","Invalidations:",invalidations);
+}
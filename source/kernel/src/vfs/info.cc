@@ -33,6 +33,7 @@
 #include <vfs/info.h>
 #include <vfs/file.h>
 #include <vfs/fs.h>
+#include <vfs/fscache.h>
 #include <vfs/openfile.h>
 #include <cpu.h>
 #include <spinlock.h>
@@ -49,6 +50,10 @@ void VFSInfo::init(VFSNode *sysNode) {
 	VFSNode::release(createObj<CPUFile>(KERNEL_PID,sysNode));
 	VFSNode::release(createObj<StatsFile>(KERNEL_PID,sysNode));
 	VFSNode::release(createObj<IRQsFile>(KERNEL_PID,sysNode));
+	VFSNode::release(createObj<FSCacheFile>(KERNEL_PID,sysNode));
+#if LOCK_STATS
+	VFSNode::release(createObj<LockStatsFile>(KERNEL_PID,sysNode));
+#endif
 }
 
 void VFSInfo::traceReadCallback(VFSNode *node,size_t *dataSize,void **buffer) {
@@ -199,7 +204,7 @@ void VFSInfo::statsReadCallback(A_UNUSED VFSNode *node,size_t *dataSize,void **b
 		"Threads:",Thread::getCount(),
 		"Interrupts:",Interrupts::getCount(),
 		"CPUCycles:",cycles.val64,
-		"UpTime:",Timer::getIntrptCount() / Timer::FREQUENCY_DIV
+		"UpTime:",(size_t)(Timer::getRuntime() / 1000)
 	);
 	*buffer = os.keepString();
 	*dataSize = os.getLength();
@@ -298,6 +303,22 @@ void VFSInfo::irqsReadCallback(A_UNUSED VFSNode *node,size_t *dataSize,void **bu
 	*dataSize = os.getLength();
 }
 
+void VFSInfo::fsCacheReadCallback(A_UNUSED VFSNode *node,size_t *dataSize,void **buffer) {
+	OStringStream os;
+	VFSFSCache::print(os);
+	*buffer = os.keepString();
+	*dataSize = os.getLength();
+}
+
+#if LOCK_STATS
+void VFSInfo::lockStatsReadCallback(A_UNUSED VFSNode *node,size_t *dataSize,void **buffer) {
+	OStringStream os;
+	SpinLock::printStats(os);
+	*buffer = os.keepString();
+	*dataSize = os.getLength();
+}
+#endif
+
 Proc *VFSInfo::getProc(VFSNode *node,size_t *dataSize,void **buffer) {
 	Proc *p = NULL;
 	VFSNode::acquireTree();
@@ -66,7 +66,8 @@ size_t VFSNode::allocated;
  * working with it */
 VFSNode::VFSNode(pid_t pid,char *n,uint m,bool &success)
 		: lock(), name(n), nameLen(), refCount(2), owner(pid), uid(), gid(), mode(m),
-		  parent(), prev(), firstChild(), next() {
+		  parent(), prev(), firstChild(), childHash(), childHashSize(), childCount(), hashNext(),
+		  next() {
 	if(this == nullptr || name == NULL || nameLen > NAME_MAX) {
 		success = false;
 		return;
@@ -91,12 +92,14 @@ bool VFSNode::isDeletable() const {
 	return getOwner() != KERNEL_PID;
 }
 
-const VFSNode *VFSNode::openDir(bool locked,bool *valid) const {
-	const VFSNode *p;
+const VFSNode *VFSNode::resolveDir() const {
 	if(!S_ISLNK(mode))
-		p = this;
-	else
-		p = static_cast<const VFSLink*>(this)->resolve();
+		return this;
+	return static_cast<const VFSLink*>(this)->resolve();
+}
+
+const VFSNode *VFSNode::openDir(bool locked,bool *valid) const {
+	const VFSNode *p = resolveDir();
 	if(locked)
 		treeLock.down();
 	*valid = p->name != NULL;
@@ -226,16 +229,16 @@ int VFSNode::utime(pid_t pid,const struct utimbuf *utimes) {
 
 int VFSNode::request(const char *path,const char **end,VFSNode **node,bool *created,
 		uint flags,mode_t mode) {
-	const VFSNode *dir,*n = *node;
+	const VFSNode *dir,*n,*start = *node;
 	const Thread *t = Thread::getRunning();
 	/* at the beginning, t might be NULL */
 	pid_t pid = t ? t->getProc()->getPid() : KERNEL_PID;
-	int pos = 0,err,depth,lastdepth;
+	int pos,err;
 	bool valid;
 	if(created)
 		*created = false;
-	if(n == NULL)
-		n = get(0);
+	if(start == NULL)
+		start = get(0);
 	*node = NULL;
 
 	/* skip slashes */
@@ -244,62 +247,57 @@ int VFSNode::request(const char *path,const char **end,VFSNode **node,bool *crea
 
 	/* root/current node requested? */
 	if(!*path) {
-		*node = const_cast<VFSNode*>(n->increaseRefs());
+		*node = const_cast<VFSNode*>(start->increaseRefs());
 		err = *node == NULL ? -ENOENT : 0;
 		return err;
 	}
 
-	depth = 0;
-	lastdepth = -1;
-	dir = n;
-	n = dir->openDir(true,&valid);
+	n = NULL;
+	dir = start;
+	dir->openDir(true,&valid);
 	if(valid) {
-		while(n != NULL) {
+		while(true) {
+			char c;
+			/* check if we can access this directory */
+			if((err = VFS::hasAccess(pid,dir,VFS_EXEC)) < 0)
+				goto done;
+
 			/* go to next '/' and check for invalid chars */
-			if(depth != lastdepth) {
-				char c;
-				/* check if we can access this directory */
-				if((err = VFS::hasAccess(pid,dir,VFS_EXEC)) < 0)
+			pos = 0;
+			while((c = path[pos]) && c != '/') {
+				if((c != ' ' && isspace(c)) || !isprint(c)) {
+					err = -EINVAL;
 					goto done;
-
-				pos = 0;
-				while((c = path[pos]) && c != '/') {
-					if((c != ' ' && isspace(c)) || !isprint(c)) {
-						err = -EINVAL;
-						goto done;
-					}
-					pos++;
 				}
-				lastdepth = depth;
+				pos++;
 			}
 
-			if((int)n->nameLen == pos && strncmp(n->name,path,pos) == 0) {
-				path += pos;
-				/* finished? */
-				if(!*path)
-					break;
-
-				/* skip slashes */
-				while(*path == '/')
-					path++;
-				/* "/" at the end is optional */
-				if(!*path)
-					break;
-
-				if(IS_DEVICE(n->mode))
-					break;
-
-				/* move to childs of this node */
-				dir = n;
-				n = dir->openDir(false,&valid);
-				if(!valid) {
-					err = -EDESTROYED;
-					goto done;
-				}
-				depth++;
-				continue;
+			n = dir->resolveDir()->lookup(path,pos);
+			if(n == NULL)
+				break;
+
+			path += pos;
+			/* finished? */
+			if(!*path)
+				break;
+
+			/* skip slashes */
+			while(*path == '/')
+				path++;
+			/* "/" at the end is optional */
+			if(!*path)
+				break;
+
+			if(IS_DEVICE(n->mode))
+				break;
+
+			/* move to childs of this node */
+			dir = n;
+			dir->openDir(false,&valid);
+			if(!valid) {
+				err = -EDESTROYED;
+				goto done;
 			}
-			n = n->next;
 		}
 	}
 
@@ -374,22 +372,71 @@ void VFSNode::dirname(char *path,size_t len) {
 const VFSNode *VFSNode::findInDir(const char *ename,size_t enameLen) const {
 	bool valid = false;
 	const VFSNode *res = NULL;
-	const VFSNode *n = openDir(true,&valid);
-	if(valid) {
-		while(n != NULL) {
-			if(n->nameLen == enameLen && strncmp(n->name,ename,enameLen) == 0) {
-				res = n;
-				break;
-			}
-			n = n->next;
-		}
-	}
+	openDir(true,&valid);
+	if(valid)
+		res = resolveDir()->lookup(ename,enameLen);
 	closeDir(true);
 	return res;
 }
 
+size_t VFSNode::hashName(const char *name,size_t len) {
+	/* FNV-1a */
+	uint32_t hash = 2166136261U;
+	for(size_t i = 0; i < len; ++i)
+		hash = (hash ^ (uchar)name[i]) * 16777619U;
+	return hash;
+}
+
+const VFSNode *VFSNode::lookup(const char *ename,size_t enameLen) const {
+	const VFSNode *n;
+	if(childHash) {
+		n = childHash[hashName(ename,enameLen) & (childHashSize - 1)];
+		for(; n != NULL; n = n->hashNext) {
+			if(n->nameLen == enameLen && strncmp(n->name,ename,enameLen) == 0)
+				return n;
+		}
+		return NULL;
+	}
+
+	for(n = firstChild; n != NULL; n = n->next) {
+		if(n->nameLen == enameLen && strncmp(n->name,ename,enameLen) == 0)
+			return n;
+	}
+	return NULL;
+}
+
+void VFSNode::hashInsert(VFSNode *child) {
+	size_t idx = hashName(child->name,child->nameLen) & (childHashSize - 1);
+	child->hashNext = childHash[idx];
+	childHash[idx] = child;
+}
+
+void VFSNode::hashRemove(VFSNode *child) {
+	VFSNode **n = childHash + (hashName(child->name,child->nameLen) & (childHashSize - 1));
+	for(; *n != NULL; n = &(*n)->hashNext) {
+		if(*n == child) {
+			*n = child->hashNext;
+			break;
+		}
+	}
+	child->hashNext = NULL;
+}
+
+void VFSNode::hashBuild(VFSNode **table,size_t size) {
+	childHash = table;
+	childHashSize = size;
+	for(VFSNode *n = firstChild; n != NULL; n = n->next)
+		hashInsert(n);
+}
+
 void VFSNode::append(VFSNode *p) {
 	if(p != NULL) {
+		/* if the directory gets big, allocate a (larger) hash-index before grabbing the lock */
+		VFSNode **table = NULL;
+		size_t size = p->childHashSize ? p->childHashSize * 2 : HASH_MIN_CHILDS * 2;
+		if(p->childCount + 1 >= HASH_MIN_CHILDS && p->childCount + 1 > p->childHashSize)
+			table = (VFSNode**)Cache::calloc(size,sizeof(VFSNode*));
+
 		{
 			LockGuard<SpinLock> g(&treeLock);
 			prev = NULL;
@@ -397,7 +444,19 @@ void VFSNode::append(VFSNode *p) {
 			if(next)
 				next->prev = this;
 			p->firstChild = this;
+			p->childCount++;
+
+			/* somebody else might have been faster */
+			if(table && size > p->childHashSize) {
+				VFSNode **old = p->childHash;
+				p->hashBuild(table,size);
+				table = old;
+			}
+			else if(p->childHash)
+				p->hashInsert(this);
 		}
+		/* free the old or unused one */
+		Cache::free(table);
 
 		LockGuard<SpinLock> g(&p->lock);
 		p->refCount++;
@@ -407,6 +466,7 @@ void VFSNode::append(VFSNode *p) {
 
 ushort VFSNode::doUnref(bool remove) {
 	const char *nameptr = NULL;
+	VFSNode **hashptr = NULL;
 	/* first check whether we have the last ref */
 	ushort remRefs = refCount;
 	bool norefs = remRefs == 1;
@@ -444,10 +504,19 @@ ushort VFSNode::doUnref(bool remove) {
 				parent->firstChild = next;
 			if(next)
 				next->prev = prev;
+			if(parent) {
+				parent->childCount--;
+				if(parent->childHash)
+					parent->hashRemove(this);
+			}
 
 			prev = NULL;
 			next = NULL;
 			firstChild = NULL;
+			hashptr = childHash;
+			childHash = NULL;
+			childHashSize = 0;
+			childCount = 0;
 
 			/* free name (do that afterwards, unlocked) */
 			if(IS_ON_HEAP(name))
@@ -458,6 +527,7 @@ ushort VFSNode::doUnref(bool remove) {
 
 	if(nameptr)
 		Cache::free(const_cast<char*>(nameptr));
+	Cache::free(hashptr);
 	/* if there are no references anymore, we can put the node on the freelist */
 	if(norefs) {
 		parent->unref();
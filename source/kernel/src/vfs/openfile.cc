@@ -22,9 +22,11 @@
 #include <mem/cache.h>
 #include <vfs/openfile.h>
 #include <vfs/fs.h>
+#include <vfs/fscache.h>
 #include <vfs/channel.h>
 #include <vfs/device.h>
 #include <vfs/vfs.h>
+#include <mem/useraccess.h>
 #include <ostream.h>
 #include <esc/ipc/ipcbuf.h>
 #include <sys/messages.h>
@@ -207,6 +209,9 @@ ssize_t OpenFile::write(pid_t pid,USER const void *buffer,size_t count) {
 		LockGuard<SpinLock> g(&lock);
 		position += writtenBytes;
 	}
+	/* the size and modification time have changed */
+	if(EXPECT_TRUE(writtenBytes > 0 && devNo != VFS_DEV_NO))
+		VFSFSCache::invalidate(node->getParent()->getNo(),nodeNo);
 
 	if(EXPECT_TRUE(writtenBytes > 0 && pid != KERNEL_PID)) {
 		Proc *p = Proc::getByPid(pid);
@@ -223,6 +228,21 @@ ssize_t OpenFile::sendMsg(pid_t pid,msgid_t id,USER const void *data1,size_t siz
 	if(EXPECT_FALSE(!IS_DEVICE_MSG(id & 0xFFFF) && !(flags & (VFS_MSGS | VFS_DEVICE))))
 		return -EACCES;
 
+	/* filesystems tell us via their device about changes we haven't seen */
+	if(EXPECT_FALSE((id & 0xFFFF) == MSG_FS_INVALIDATE && (flags & VFS_DEVICE) &&
+			IS_FS(node->getMode()))) {
+		ino_t ino = -1;
+		if(size1 > 0) {
+			if(EXPECT_FALSE(size1 != sizeof(ino)))
+				return -EINVAL;
+			int res = UserAccess::read(&ino,data1,sizeof(ino));
+			if(EXPECT_FALSE(res < 0))
+				return res;
+		}
+		VFSFSCache::invalidate(node->getNo(),ino);
+		return 0;
+	}
+
 	if(EXPECT_FALSE(!IS_CHANNEL(node->getMode())))
 		return -ENOTSUP;
 
@@ -21,6 +21,7 @@
 #include <vfs/vfs.h>
 #include <vfs/node.h>
 #include <vfs/fs.h>
+#include <vfs/fscache.h>
 #include <vfs/info.h>
 #include <vfs/file.h>
 #include <vfs/dir.h>
@@ -177,6 +178,12 @@ int VFS::openPath(pid_t pid,ushort flags,mode_t mode,const char *path,OpenFile *
 	}
 	/* otherwise use the device-node of the fs */
 	else {
+		/* we might know already that it doesn't exist */
+		int cached;
+		if(!(flags & VFS_CREATE) && VFSFSCache::lookup(pid,fsFile,begin,NULL,&cached) && cached < 0) {
+			VFSMS::release(fsFile);
+			return cached;
+		}
 		node = fsFile->getNode();
 		node = VFSNode::request(node->getParent()->getNo());
 		openmsg = MSG_FS_OPEN;
@@ -200,6 +207,12 @@ int VFS::openPath(pid_t pid,ushort flags,mode_t mode,const char *path,OpenFile *
 
 	/* give the node a chance to react on it */
 	err = node->open(pid,begin,flags,openmsg,mode);
+	if(!IS_NODE(fsFile)) {
+		if(err == -ENOENT && !(flags & VFS_CREATE))
+			VFSFSCache::insert(pid,fsFile,begin,NULL,err);
+		else if(err >= 0 && (flags & (VFS_CREATE | VFS_TRUNCATE)))
+			VFSFSCache::invalidate(fsFile,begin);
+	}
 	if(err < 0)
 		goto error;
 
@@ -19,10 +19,21 @@
 
 #include <common.h>
 #include <task/sched.h>
+#include <task/thread.h>
+#include <task/proc.h>
+#include <task/smp.h>
+#include <atomic.h>
+#include <cpu.h>
 #include <sys/test.h>
 
+#define MAX_THREADS			32
+#define SWITCH_COUNT		20000
+
 /* forward declarations */
 static void test_sched();
+#ifndef __mmix__
+static void test_throughput();
+#endif
 
 /* our test-module */
 sTestModule tModSched = {
@@ -31,71 +42,53 @@ sTestModule tModSched = {
 };
 
 static void test_sched() {
-	/* TODO implement for threads */
-#if 0
-	Proc *x = (Proc*)Proc::getByPid(Proc::getFreePid());
-	Proc *rand[5] = {x + 1,x,x + 4,x + 2,x + 3};
-	size_t i;
-	bool res = true;
-	/* not relevant here */
-	Proc *p = (Proc*)x, *pp;
+	/* doesn't work on mmix since we can't start kernel-threads there (see tproc.cc) */
+#ifndef __mmix__
+	test_throughput();
+#endif
+}
 
-	test_caseStart("Enqueuing - dequeuing");
-	/* enqueue */
-	for(i = 0; i < PROC_COUNT - 1; i++) {
-		sched_setReady(p++);
-	}
-	/* dequeue */
-	pp = (Proc*)x;
-	while((p = sched_dequeueReady()) != NULL) {
-		p->state = Thread::UNUSED;
-		if(p != pp) {
-			res = false;
-			break;
+#ifndef __mmix__
+static volatile ulong slot;
+static uint64_t starts[MAX_THREADS];
+static uint64_t ends[MAX_THREADS];
+
+static void switch_thread() {
+	size_t i = Atomic::fetch_and_add(&slot,1);
+	starts[i] = CPU::rdtsc();
+	for(size_t j = 0; j < SWITCH_COUNT; ++j)
+		Thread::switchAway();
+	ends[i] = CPU::rdtsc();
+
+	Proc::terminateThread(0);
+}
+
+static void test_throughput() {
+	size_t max = MIN(SMP::getCPUCount(),(size_t)MAX_THREADS);
+	for(size_t n = 1; n <= max; ++n) {
+		int tids[MAX_THREADS];
+		test_caseStart("Thread-switch throughput with %zu threads on %zu CPUs",
+			n,SMP::getCPUCount());
+
+		slot = 0;
+		for(size_t i = 0; i < n; ++i) {
+			tids[i] = Proc::startThread((uintptr_t)&switch_thread,0,NULL);
+			test_assertTrue(tids[i] >= 0);
 		}
-		pp++;
-	}
-	if(res)
-		test_caseSucceeded();
-	else
-		test_caseFailed("Got process 0x%x, expected 0x%x",p,pp);
+		for(size_t i = 0; i < n; ++i)
+			Proc::join(tids[i]);
+		test_assertULInt(slot,n);
 
-	/* second test */
-	res = true;
-	test_caseStart("Dequeue specific processes (opposite order)");
-	/* enqueue some processes */
-	p = (Proc*)x;
-	for(i = 0; i < 5; i++)
-		sched_setReady(p++);
-	/* dequeue */
-	p--;
-	for(i = 4; i >= 0; i--) {
-		res = res && sched_dequeueReadyProc(p);
-		res = res && !sched_dequeueReadyProc(p);
-		p->state = Thread::UNUSED;
-		p--;
-	}
-	if(res)
-		test_caseSucceeded();
-	else
-		test_caseFailed("");
+		uint64_t start = starts[0], end = ends[0];
+		for(size_t i = 1; i < n; ++i) {
+			start = MIN(start,starts[i]);
+			end = MAX(end,ends[i]);
+		}
+		uint64_t total = (uint64_t)n * SWITCH_COUNT;
+		tprintf("%Lu switches in %Lu cycles: %Lu cycles/switch, %Lu switches/s\n",
+			total,end - start,(end - start) / total,(total * CPU::getSpeed()) / (end - start));
 
-	/* third test */
-	res = true;
-	test_caseStart("Dequeue specific processes (random order)");
-	/* enqueue some processes */
-	p = (Proc*)x;
-	for(i = 0; i < 5; i++)
-		sched_setReady(p++);
-	/* dequeue */
-	for(i = 0; i < 5; i++) {
-		res = res && sched_dequeueReadyProc(rand[i]);
-		res = res && !sched_dequeueReadyProc(rand[i]);
-		rand[i]->state = Thread::UNUSED;
-	}
-	if(res)
 		test_caseSucceeded();
-	else
-		test_caseFailed("");
-#endif
+	}
 }
+#endif
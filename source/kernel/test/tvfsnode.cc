@@ -36,6 +36,7 @@ static void test_vfs_node_getPath();
 static void test_vfs_node_file_refs();
 static void test_vfs_node_dir_refs();
 static void test_vfs_node_dev_refs();
+static void test_vfs_node_big_dir();
 
 /* our test-module */
 sTestModule tModVFSn = {
@@ -49,6 +50,7 @@ static void test_vfsn() {
 	test_vfs_node_file_refs();
 	test_vfs_node_dir_refs();
 	test_vfs_node_dev_refs();
+	test_vfs_node_big_dir();
 }
 
 static void test_vfs_node_resolvePath() {
@@ -233,3 +235,64 @@ static void test_vfs_node_dev_refs() {
 	checkMemoryAfter(false);
 	test_caseSucceeded();
 }
+
+static void test_vfs_node_genName(char *path,size_t size,size_t i) {
+	const char *prefix = "/sys/foobar/file";
+	size_t len = strlen(prefix);
+	strnzcpy(path,prefix,size);
+	itoa(path + len,size - len,i);
+}
+
+static void test_vfs_node_big_dir() {
+	char path[MAX_PATH_LEN];
+	Thread *t = Thread::getRunning();
+	pid_t pid = t->getProc()->getPid();
+	OpenFile *f;
+	VFSNode *n;
+	const size_t count = 200;
+
+	test_caseStart("Testing lookups in big directories");
+	checkMemoryBefore(false);
+	size_t nodesBefore = VFSNode::getNodeCount();
+
+	test_assertInt(VFS::mkdir(pid,"/sys/foobar",DIR_DEF_MODE),0);
+	for(size_t i = 0; i < count; ++i) {
+		test_vfs_node_genName(path,sizeof(path),i);
+		test_assertInt(VFS::openPath(pid,VFS_WRITE | VFS_CREATE,0,path,&f),0);
+		f->close(pid);
+	}
+
+	for(size_t i = 0; i < count; ++i) {
+		test_vfs_node_genName(path,sizeof(path),i);
+		n = NULL;
+		test_assertInt(VFSNode::request(path,NULL,&n,NULL,VFS_READ,0),0);
+		test_assertStr(n->getPath(),path);
+		VFSNode::release(n);
+	}
+
+	/* remove every second one */
+	for(size_t i = 0; i < count; i += 2) {
+		test_vfs_node_genName(path,sizeof(path),i);
+		test_assertInt(VFS::unlink(pid,path),0);
+	}
+	for(size_t i = 0; i < count; ++i) {
+		test_vfs_node_genName(path,sizeof(path),i);
+		n = NULL;
+		test_assertInt(VFSNode::request(path,NULL,&n,NULL,VFS_READ,0),(i % 2) == 0 ? -ENOENT : 0);
+		VFSNode::release(n);
+	}
+	n = NULL;
+	test_assertInt(VFSNode::request("/sys/foobar/./file1",NULL,&n,NULL,VFS_READ,0),0);
+	test_assertStr(n->getName(),"file1");
+	VFSNode::release(n);
+
+	for(size_t i = 1; i < count; i += 2) {
+		test_vfs_node_genName(path,sizeof(path),i);
+		test_assertInt(VFS::unlink(pid,path),0);
+	}
+	test_assertInt(VFS::rmdir(pid,"/sys/foobar"),0);
+
+	test_assertSize(nodesBefore,VFSNode::getNodeCount());
+	checkMemoryAfter(false);
+	test_caseSucceeded();
+}
@@ -25,7 +25,7 @@
 #define DIRE_SIZE	(sizeof(struct dirent) - (NAME_MAX + 1))
 
 bool readdir(DIR *dir,struct dirent *e) {
-	if(fread(e,1,DIRE_SIZE,dir) > 0) {
+	while(fread(e,1,DIRE_SIZE,dir) > 0) {
 		/* convert endianess */
 		e->d_namelen = le16tocpu(e->d_namelen);
 		e->d_reclen = le16tocpu(e->d_reclen);
@@ -35,6 +35,14 @@ bool readdir(DIR *dir,struct dirent *e) {
 		if(len >= NAME_MAX)
 			return false;
 
+		/* records without name or inode are unused (e.g. the index-blocks of ext2 directories or
+		 * a removed entry at the beginning of an ext2 block, which keeps its name) */
+		if(len == 0 || e->d_ino == 0) {
+			if(e->d_reclen < DIRE_SIZE || fseek(dir,e->d_reclen - DIRE_SIZE,SEEK_CUR) < 0)
+				return false;
+			continue;
+		}
+
 		/* now read the name */
 		if(fread(e->d_name,1,len,dir) > 0) {
 			/* if the record is longer, we have to skip the stuff until the next record */
@@ -48,6 +56,7 @@ bool readdir(DIR *dir,struct dirent *e) {
 			e->d_name[e->d_namelen] = '\0';
 			return true;
 		}
+		break;
 	}
 
 	return false;
@@ -23,6 +23,7 @@
 #include <sys/debug.h>
 #include <sys/sync.h>
 #include <sys/conf.h>
+#include <sys/tls.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -33,38 +34,89 @@
 #define DEBUG_ALLOC_N_FREE_PID	27	/* -1 = all */
 #endif
 
+/* whether we put a guard behind each area and detect duplicate frees */
+#ifndef HEAP_GUARDS
+#	define HEAP_GUARDS			DEBUGGING
+#endif
+
 #define GUARD_MAGIC				0xDEADBEEF
 #define FREE_MAGIC				0xFEEEFEEE
 
-/* an area in memory */
-typedef struct sMemArea sMemArea;
-struct sMemArea {
-	size_t size;
-	void *address;
-	sMemArea *next;
+/**
+ * The heap uses segregated size-classes: 16 classes with a distance of 16 bytes up to 256 bytes,
+ * followed by 4 classes per power of two up to MAX_SMALL. Each class has a freelist, protected
+ * by heapSem. Additionally, each thread has a cache with a small list of free areas per class,
+ * so that most allocations and frees don't need to take the lock. Areas larger than MAX_SMALL
+ * are mapped separately via mmap.
+ *
+ * Every area starts with a header of two words: the first one is the class or, for mapped areas,
+ * the size of the mapping. The second one is the requested size if guards are enabled.
+ */
+#define HEADER_SIZE				(sizeof(ulong) * 2)
+#if HEAP_GUARDS
+#	define GUARD_SIZE			sizeof(ulong)
+#else
+#	define GUARD_SIZE			0
+#endif
+
+#define SMALL_BINS				16
+#define BIN_COUNT				48
+#define MAX_SMALL				(64 * 1024)
+
+/* the max. number of areas and bytes per class in the thread caches */
+#define CACHE_MAX				32
+#define CACHE_BYTES				(16 * 1024)
+/* the minimum number of pages we request via chgsize */
+#define GROW_PAGES				4
+
+/* the TLS slot that holds the thread cache (reserved in tls.c) */
+#define TLS_HEAP_CACHE			0
+
+typedef struct sBin {
+	void *freeList;
+	size_t count;
+} sBin;
+
+typedef struct sThreadCache sThreadCache;
+struct sThreadCache {
+	sThreadCache *next;
+	void *lists[BIN_COUNT];
+	size_t counts[BIN_COUNT];
 };
 
 void initHeap(void);
+void exitHeapThread(void);
 
 /**
- * Allocates a new page for areas
+ * Takes an area from the freelist of class <bin> or, if it's empty, from the top of the heap.
+ * Assumes that heapSem is held.
  *
- * @return true on success
+ * @param bin the class
+ * @return the area or NULL if there is no memory left
+ */
+static ulong *binPop(size_t bin);
+
+/**
+ * Puts the given area back on the freelist of its class. Assumes that heapSem is held.
+ *
+ * @param area the area
  */
-static bool loadNewAreas(void);
+static void binPush(ulong *area);
 
 /**
- * Allocates new space for alloation
+ * Makes sure that there are at least <size> bytes at the top of the heap.
  *
- * @param size the minimum size
+ * @param size the number of bytes
  * @return true on success
  */
 static bool loadNewSpace(size_t size);
 
-/* a linked list of free and usable areas. That means the areas have an address and size */
-static sMemArea *usableList = NULL;
-/* a linked list of free but not usable areas. That means the areas have no address and size */
-static sMemArea *freeList = NULL;
+static sBin bins[BIN_COUNT];
+/* the space at the top of the heap, that hasn't been handed out yet */
+static uintptr_t topStart = 0;
+static uintptr_t topEnd = 0;
+/* all thread caches */
+static sThreadCache *caches = NULL;
 /* total number of pages we're using */
 static uintptr_t heapstart = 0;
 static size_t pageCount = 0;
@@ -73,6 +125,53 @@ static size_t pageCount = 0;
 static tUserSem heapSem;
 static bool initialized = false;
 
+static inline size_t binOf(size_t size) {
+	size_t log;
+	if(size <= SMALL_BINS * 16)
+		return (size + 15) / 16 - 1;
+	log = sizeof(ulong) * 8 - 1 - __builtin_clzl(size - 1);
+	return SMALL_BINS + (log - 8) * 4 + (((size - 1) >> (log - 2)) & 3);
+}
+
+static inline size_t binSize(size_t bin) {
+	if(bin < SMALL_BINS)
+		return (bin + 1) * 16;
+	bin -= SMALL_BINS;
+	return (5 + (bin & 3)) << (8 + bin / 4 - 2);
+}
+
+static inline size_t cacheCap(size_t bin) {
+	return MIN(CACHE_MAX,CACHE_BYTES / binSize(bin));
+}
+
+static inline size_t areaCap(ulong *area) {
+	size_t total = area[0] < BIN_COUNT ? binSize(area[0]) : area[0];
+	return total - HEADER_SIZE - GUARD_SIZE;
+}
+
+static sThreadCache *getCache(void) {
+	/* the TLS is not available during the initialization of a thread */
+	ulong *tls = *(ulong**)stack_top(2);
+	if(EXPECT_FALSE(tls == NULL))
+		return NULL;
+
+	sThreadCache *tc = (sThreadCache*)tls[TLS_HEAP_CACHE];
+	if(EXPECT_FALSE(tc == NULL)) {
+		size_t bin = binOf(sizeof(sThreadCache) + HEADER_SIZE);
+		usemdown(&heapSem);
+		ulong *area = binPop(bin);
+		if(area) {
+			tc = (sThreadCache*)(area + 2);
+			memclear(tc,sizeof(sThreadCache));
+			tc->next = caches;
+			caches = tc;
+		}
+		usemup(&heapSem);
+		tls[TLS_HEAP_CACHE] = (ulong)tc;
+	}
+	return tc;
+}
+
 void initHeap(void) {
 	if(initialized)
 		return;
@@ -82,73 +181,98 @@ void initHeap(void) {
 	initialized = true;
 }
 
-void *malloc(size_t size) {
-	ulong *begin;
-	sMemArea *area,*prev,*narea;
+void exitHeapThread(void) {
+	ulong *tls = *(ulong**)stack_top(2);
+	if(tls == NULL || tls[TLS_HEAP_CACHE] == 0)
+		return;
 
-	if(size == 0)
-		return NULL;
+	sThreadCache *tc = (sThreadCache*)tls[TLS_HEAP_CACHE];
+	tls[TLS_HEAP_CACHE] = 0;
 
 	usemdown(&heapSem);
-
-	/* align and we need 3 ulongs for the guards */
-	size = ROUND_UP(size,sizeof(ulong)) + sizeof(ulong) * 4;
-
-	/* find a suitable area */
-	prev = NULL;
-	area = usableList;
-	while(area != NULL) {
-		if(area->size >= size)
-			break;
-		prev = area;
-		area = area->next;
+	/* give all areas back */
+	for(size_t i = 0; i < BIN_COUNT; ++i) {
+		while(tc->lists[i]) {
+			ulong *area = (ulong*)tc->lists[i] - 2;
+			tc->lists[i] = *(void**)tc->lists[i];
+			binPush(area);
+		}
 	}
 
-	/* no area found? */
-	if(area == NULL) {
-		if(!loadNewSpace(size)) {
-			usemup(&heapSem);
+	/* remove us from the list */
+	sThreadCache **p = &caches;
+	while(*p != tc)
+		p = &(*p)->next;
+	*p = tc->next;
+	binPush((ulong*)tc - 2);
+	usemup(&heapSem);
+}
+
+static void *allocLarge(size_t total) {
+	total = ROUND_UP(total,PAGE_SIZE);
+	ulong *area = (ulong*)mmap(NULL,total,0,PROT_READ | PROT_WRITE,MAP_PRIVATE,-1,0);
+	if(area == NULL)
+		return NULL;
+	area[0] = total;
+	return area;
+}
+
+void *malloc(size_t size) {
+	ulong *area;
+	size_t total,bin;
+	sThreadCache *tc;
+
+	if(size == 0 || size > ~(size_t)0 / 2)
+		return NULL;
+
+	/* align and add space for header and guard */
+	size = ROUND_UP(size,sizeof(ulong));
+	total = size + HEADER_SIZE + GUARD_SIZE;
+
+	if(EXPECT_FALSE(total > MAX_SMALL)) {
+		area = allocLarge(total);
+		if(area == NULL)
 			return NULL;
-		}
-		/* we can assume that it fits */
-		area = usableList;
-		/* remove from usable-list */
-		usableList = area->next;
 	}
 	else {
-		/* remove from usable-list */
-		if(prev == NULL)
-			usableList = area->next;
-		else
-			prev->next = area->next;
-	}
-
-	/* is there space left? */
-	if(size < area->size) {
-		if(freeList == NULL) {
-			if(!loadNewAreas()) {
-				/* TODO we may have changed something... */
+		bin = binOf(total);
+		tc = getCache();
+		if(EXPECT_TRUE(tc && cacheCap(bin) > 1)) {
+			/* if the cache is empty, fetch half of its capacity at once */
+			if(EXPECT_FALSE(tc->counts[bin] == 0)) {
+				usemdown(&heapSem);
+				for(size_t i = cacheCap(bin) / 2; i > 0; --i) {
+					ulong *a = binPop(bin);
+					if(a == NULL)
+						break;
+					*(void**)(a + 2) = tc->lists[bin];
+					tc->lists[bin] = a + 2;
+					tc->counts[bin]++;
+				}
 				usemup(&heapSem);
-				return NULL;
+				if(tc->counts[bin] == 0)
+					return NULL;
 			}
-		}
 
-		/* split the area */
-		narea = freeList;
-		freeList = freeList->next;
-		narea->address = (void*)((uintptr_t)area->address + size);
-		narea->size = area->size - size;
-		area->size = size;
-		/* insert in usable-list */
-		narea->next = usableList;
-		usableList = narea;
+			area = (ulong*)tc->lists[bin] - 2;
+			tc->lists[bin] = *(void**)tc->lists[bin];
+			tc->counts[bin]--;
+		}
+		else {
+			usemdown(&heapSem);
+			area = binPop(bin);
+			usemup(&heapSem);
+			if(area == NULL)
+				return NULL;
+		}
+		area[0] = bin;
 	}
 
 #if DEBUG_ALLOC_N_FREE
 	if(DEBUG_ALLOC_N_FREE_PID == -1 || getpid() == DEBUG_ALLOC_N_FREE_PID) {
 		size_t i = 0;
 		uintptr_t *trace = getStackTrace();
-		debugf("[A] %x %d ",(char*)area->address + 3,area->size);
+		debugf("[A] %x %d ",area + 2,size);
 		while(*trace && i++ < 10) {
 			debugf("%x",*trace);
 			if(trace[1])
@@ -159,73 +283,48 @@ void *malloc(size_t size) {
 	}
 #endif
 
-	/* add guards */
-	begin = (ulong*)area->address;
-	begin[0] = (ulong)area;
-	begin[1] = size - sizeof(ulong) * 4;
-	begin[2] = GUARD_MAGIC;
-	begin[size / sizeof(ulong) - 1] = GUARD_MAGIC;
-	usemup(&heapSem);
-	return begin + 3;
+#if HEAP_GUARDS
+	area[1] = size;
+	area[size / sizeof(ulong) + 2] = GUARD_MAGIC;
+#endif
+	return area + 2;
 }
 
 void *calloc(size_t num,size_t size) {
-	void *a = malloc(num * size);
+	if(size && num > ~(size_t)0 / size)
+		return NULL;
+
+	ulong *a = (ulong*)malloc(num * size);
 	if(a == NULL)
 		return NULL;
 
-	memclear(a,num * size);
+	/* mapped areas are already zeroed */
+	if(a[-2] < BIN_COUNT)
+		memclear(a,num * size);
 	return a;
 }
 
 void free(void *addr) {
-	ulong *begin;
-	sMemArea *area,*a,*prev,*next,*nprev,*pprev,*tprev;
+	ulong *area;
+	sThreadCache *tc;
 
 	/* addr may be null */
 	if(addr == NULL)
 		return;
 
+	area = (ulong*)addr - 2;
 	/* check guards */
-	begin = (ulong*)addr - 3;
-	area = (sMemArea*)begin[0];
-	vassert(begin[0] != FREE_MAGIC,"Duplicate free of %p?",addr);
-	assert(begin[2] == GUARD_MAGIC);
-	assert(begin[begin[1] / sizeof(ulong) + 3] == GUARD_MAGIC);
-
-	usemdown(&heapSem);
-
-	/* mark as free */
-	begin[0] = FREE_MAGIC;
-
-	/* find the previous and next free areas */
-	prev = NULL;
-	next = NULL;
-	tprev = NULL;
-	pprev = NULL;
-	nprev = NULL;
-	a = usableList;
-	while(a != NULL) {
-		if((uintptr_t)a->address + a->size == (uintptr_t)begin) {
-			prev = a;
-			pprev = tprev;
-		}
-		if((uintptr_t)a->address == (uintptr_t)begin + area->size) {
-			next = a;
-			nprev = tprev;
-		}
-		/* do we have both? */
-		if(prev && next)
-			break;
-		tprev = a;
-		a = a->next;
-	}
+#if HEAP_GUARDS
+	vassert(area[1] != FREE_MAGIC,"Duplicate free of %p?",addr);
+	assert(area[area[1] / sizeof(ulong) + 2] == GUARD_MAGIC);
+	area[1] = FREE_MAGIC;
+#endif
 
 #if DEBUG_ALLOC_N_FREE
 	if(DEBUG_ALLOC_N_FREE_PID == -1 || getpid() == DEBUG_ALLOC_N_FREE_PID) {
 		size_t i = 0;
 		uintptr_t *trace = getStackTrace();
-		debugf("[F] %x %d ",addr,area->size);
+		debugf("[F] %x %d ",addr,areaCap(area));
 		while(*trace && i++ < 10) {
 			debugf("%x",*trace);
 			if(trace[1])
@@ -236,203 +335,124 @@ void free(void *addr) {
 	}
 #endif
 
-	/* see what we have to merge */
-	if(prev && next) {
-		/* merge prev & area & next */
-		area->size += prev->size + next->size;
-		area->address = prev->address;
-		/* remove prev and next from the list */
-		if(nprev)
-			nprev->next = next->next;
-		else
-			usableList = next->next;
-		/* special-case if next is the previous of prev */
-		if(pprev == next) {
-			if(nprev)
-				nprev->next = prev->next;
-			else
-				usableList = prev->next;
-		}
-		else {
-			if(pprev)
-				pprev->next = prev->next;
-			else
-				usableList = prev->next;
-		}
-		/* put area on the usable-list */
-		area->next = usableList;
-		usableList = area;
-		/* put prev and next on the freelist */
-		prev->next = next;
-		next->next = freeList;
-		freeList = prev;
-	}
-	else if(prev) {
-		/* merge preg & area */
-		prev->size += area->size;
-		/* put area on the freelist */
-		area->next = freeList;
-		freeList = area;
+	if(EXPECT_FALSE(area[0] >= BIN_COUNT)) {
+		assert((area[0] & (PAGE_SIZE - 1)) == 0);
+		munmap(area);
+		return;
 	}
-	else if(next) {
-		/* merge area & next */
-		next->address = area->address;
-		next->size += area->size;
-		/* put area on the freelist */
-		area->next = freeList;
-		freeList = area;
+
+	size_t bin = area[0];
+	tc = getCache();
+	if(EXPECT_TRUE(tc && cacheCap(bin) > 1)) {
+		/* if the cache is full, give half of it back */
+		if(EXPECT_FALSE(tc->counts[bin] == cacheCap(bin))) {
+			usemdown(&heapSem);
+			for(size_t i = cacheCap(bin) / 2; i > 0; --i) {
+				ulong *a = (ulong*)tc->lists[bin] - 2;
+				tc->lists[bin] = *(void**)tc->lists[bin];
+				binPush(a);
+			}
+			usemup(&heapSem);
+			tc->counts[bin] -= cacheCap(bin) / 2;
+		}
+
+		*(void**)addr = tc->lists[bin];
+		tc->lists[bin] = addr;
+		tc->counts[bin]++;
 	}
 	else {
-		/* insert area in usableList */
-		area->next = usableList;
-		usableList = area;
+		usemdown(&heapSem);
+		binPush(area);
+		usemup(&heapSem);
 	}
-
-	usemup(&heapSem);
 }
 
 void *realloc(void *addr,size_t size) {
-	ulong *begin;
-	sMemArea *area,*a,*prev;
+	ulong *area;
+	void *a;
 	if(addr == NULL)
 		return malloc(size);
 
-	begin = (ulong*)addr - 3;
-	area = (sMemArea*)begin[0];
+	area = (ulong*)addr - 2;
 	/* check guards */
-	vassert(begin[0] != FREE_MAGIC,"Duplicate free?");
-	assert(begin[2] == GUARD_MAGIC);
-	assert(begin[begin[1] / sizeof(ulong) + 3] == GUARD_MAGIC);
-
-	usemdown(&heapSem);
-
-	/* align and we need 3 ulongs for the guards */
-	size = ROUND_UP(size,sizeof(ulong)) + sizeof(ulong) * 4;
-
-	/* ignore shrinks */
-	if(size < area->size) {
-		usemup(&heapSem);
-		return addr;
-	}
-
-	a = usableList;
-	prev = NULL;
-	while(a != NULL) {
-		/* found the area behind? */
-		if((uintptr_t)a->address == (uintptr_t)area->address + area->size) {
-			/* if the size of both is big enough we can use them */
-			if(area->size + a->size >= size) {
-				/* space left? */
-				if(size < area->size + a->size) {
-					/* so move the area forward */
-					a->address = (void*)((uintptr_t)area->address + size);
-					a->size = (area->size + a->size) - size;
-				}
-				/* otherwise we don't need a anymore */
-				else {
-					/* remove a from usable-list */
-					if(prev == NULL)
-						usableList = a->next;
-					else
-						prev->next = a->next;
-					/* free a */
-					a->next = freeList;
-					freeList = a;
-				}
-
-				area->size = size;
-				/* reset guards */
-				begin[0] = (ulong)area;
-				begin[1] = size - sizeof(ulong) * 4;
-				begin[2] = GUARD_MAGIC;
-				begin[size / sizeof(ulong) - 1] = GUARD_MAGIC;
-				usemup(&heapSem);
-				return begin + 3;
-			}
+#if HEAP_GUARDS
+	vassert(area[1] != FREE_MAGIC,"Duplicate free?");
+	assert(area[area[1] / sizeof(ulong) + 2] == GUARD_MAGIC);
+#endif
 
-			/* makes no sense to continue since we've found the area behind */
-			break;
+	/* if it still fits into the area, we're done (this includes shrinks) */
+	size_t cap = areaCap(area);
+	size = ROUND_UP(size,sizeof(ulong));
+	if(size <= cap) {
+#if HEAP_GUARDS
+		if(size > area[1]) {
+			area[1] = size;
+			area[size / sizeof(ulong) + 2] = GUARD_MAGIC;
 		}
-		prev = a;
-		a = a->next;
+#endif
+		return addr;
 	}
 
-	usemup(&heapSem);
-
-	/* the areas are not big enough, so allocate a new one */
+	/* otherwise allocate a new one */
 	a = malloc(size);
 	if(a == NULL)
 		return NULL;
 
 	/* copy the old data and free it */
-	memcpy(a,addr,area->size - sizeof(ulong) * 4);
+#if HEAP_GUARDS
+	memcpy(a,addr,area[1]);
+#else
+	memcpy(a,addr,cap);
+#endif
 	free(addr);
 	return a;
 }
 
+static ulong *binPop(size_t bin) {
+	sBin *b = bins + bin;
+	ulong *area;
+	if(b->freeList) {
+		area = (ulong*)b->freeList - 2;
+		b->freeList = *(void**)b->freeList;
+		b->count--;
+	}
+	else {
+		size_t size = binSize(bin);
+		if(topEnd - topStart < size && !loadNewSpace(size))
+			return NULL;
+		area = (ulong*)topStart;
+		topStart += size;
+	}
+	area[0] = bin;
+	return area;
+}
+
+static void binPush(ulong *area) {
+	sBin *b = bins + area[0];
+	assert(area[0] < BIN_COUNT);
+	*(void**)(area + 2) = b->freeList;
+	b->freeList = area + 2;
+	b->count++;
+}
+
 static bool loadNewSpace(size_t size) {
 	void *oldEnd;
 	size_t count;
-	sMemArea *area;
-
-	/* no free areas? */
-	if(freeList == NULL) {
-		if(!loadNewAreas())
-			return false;
-	}
-
-	/* check for overflow */
-	if(size + PAGE_SIZE < PAGE_SIZE)
-		return false;
 
 	/* allocate the required pages */
-	count = (size + PAGE_SIZE - 1) / PAGE_SIZE;
+	count = MAX(GROW_PAGES,(size + PAGE_SIZE - 1) / PAGE_SIZE);
 	oldEnd = chgsize(count);
 	if(oldEnd == NULL)
 		return false;
 
 	if(pageCount == 0)
 		heapstart = (uintptr_t)oldEnd;
-
 	pageCount += count;
-	/* take one area from the freelist and put the memory in it */
-	area = freeList;
-	freeList = freeList->next;
-	area->address = oldEnd;
-	area->size = PAGE_SIZE * count;
-	/* put area in the usable-list */
-	area->next = usableList;
-	usableList = area;
-	return true;
-}
-
-static bool loadNewAreas(void) {
-	sMemArea *area,*end;
-	void *oldEnd;
-
-	/* allocate one page for area-structs */
-	oldEnd = chgsize(1);
-	if(oldEnd == NULL)
-		return false;
-
-	if(pageCount == 0)
-		heapstart = (uintptr_t)oldEnd;
-
-	/* determine start- and end-address */
-	pageCount++;
-	area = (sMemArea*)oldEnd;
-	end = area + (PAGE_SIZE / sizeof(sMemArea));
-
-	/* put all areas in the freelist */
-	freeList = area;
-	area->next = NULL;
-	area++;
-	while(area < end) {
-		area->next = freeList;
-		freeList = area;
-		area++;
-	}
 
+	/* if somebody else has changed the data-region in the meantime, we can't use the rest */
+	if((uintptr_t)oldEnd != topEnd)
+		topStart = (uintptr_t)oldEnd;
+	topEnd = (uintptr_t)oldEnd + count * PAGE_SIZE;
 	return true;
 }
 
@@ -441,13 +461,15 @@ bool isOnHeap(const void *ptr) {
 }
 
 size_t heapspace(void) {
-	sMemArea *area;
-	size_t c = 0;
-	area = usableList;
-	while(area != NULL) {
-		c += area->size;
-		area = area->next;
+	size_t c;
+	usemdown(&heapSem);
+	c = topEnd - topStart;
+	for(size_t i = 0; i < BIN_COUNT; ++i) {
+		c += bins[i].count * binSize(i);
+		for(sThreadCache *tc = caches; tc != NULL; tc = tc->next)
+			c += tc->counts[i] * binSize(i);
 	}
+	usemup(&heapSem);
 	return c;
 }
 
@@ -455,22 +477,15 @@ size_t heapspace(void) {
 #if DEBUGGING
 
 void printheap(void) {
-	sMemArea *area;
-
-	printf("PageCount=%d\n",pageCount);
-	printf("UsableList:\n");
-	area = usableList;
-	while(area != NULL) {
-		printf("\t%p: addr=%p, size=0x%x, next=%p\n",area,area->address,area->size,area->next);
-		area = area->next;
+	printf("PageCount=%zu, Top=%p..%p\n",pageCount,(void*)topStart,(void*)topEnd);
+	printf("Bins:\n");
+	for(size_t i = 0; i < BIN_COUNT; ++i) {
+		size_t cached = 0;
+		for(sThreadCache *tc = caches; tc != NULL; tc = tc->next)
+			cached += tc->counts[i];
+		if(bins[i].count || cached)
+			printf("\t%5zu: free=%zu, cached=%zu\n",binSize(i),bins[i].count,cached);
 	}
-
-	/*printf("FreeList:\n");
-	area = freeList;
-	while(area != NULL) {
-		printf("\t0x%x: addr=0x%x, size=0x%x, next=0x%x\n",area,area->address,area->size,area->next);
-		area = area->next;
-	}*/
 }
 
 #endif
@@ -22,50 +22,169 @@
 #include <stdlib.h>
 
 /**
- * Quicksort-implementation
- * source: http://de.wikipedia.org/wiki/Quicksort
+ * Introsort-implementation: a quicksort with median-of-three pivots, that leaves small ranges to
+ * insertion sort and falls back to heapsort if the recursion gets too deep. Thus, it takes
+ * O(n log n) in the worst case and O(log n) stack space.
+ * source: Musser, "Introspective Sorting and Selection Algorithms"
  */
-static void _qsort(void *base,size_t size,fCompare cmp,int left,int right);
-static int divide(void *base,size_t size,fCompare cmp,int left,int right);
+
+/* ranges up to this number of elements are sorted by insertion sort */
+#define THRESHOLD		16
+
+typedef void (*fSwap)(char *a,char *b,size_t size);
+
+typedef struct {
+	size_t size;
+	fCompare cmp;
+	fSwap swap;
+} sSortInfo;
+
+static void introsort(const sSortInfo *info,char *first,char *last,size_t depth);
+static char *divide(const sSortInfo *info,char *first,char *last);
+static void medianToFirst(const sSortInfo *info,char *res,char *a,char *b,char *c);
+static void heapsort(const sSortInfo *info,char *first,size_t n);
+static void siftDown(const sSortInfo *info,char *first,size_t root,size_t n);
+static void insertionSort(const sSortInfo *info,char *first,char *last);
+static void swapWords(char *a,char *b,size_t size);
+static void swapBytes(char *a,char *b,size_t size);
 
 void qsort(void *base,size_t nmemb,size_t size,fCompare cmp) {
-	_qsort(base,size,cmp,0,nmemb - 1);
+	sSortInfo info;
+	info.size = size;
+	info.cmp = cmp;
+	/* swap word-wise if the elements are properly aligned */
+	if((((uintptr_t)base | size) & (sizeof(ulong) - 1)) == 0)
+		info.swap = swapWords;
+	else
+		info.swap = swapBytes;
+
+	size_t depth = 0;
+	for(size_t n = nmemb; n > 1; n >>= 1)
+		depth += 2;
+
+	char *first = (char*)base;
+	char *last = first + nmemb * size;
+	introsort(&info,first,last,depth);
+	/* the ranges left by introsort are unsorted, but already in the right place */
+	insertionSort(&info,first,last);
+}
+
+static void introsort(const sSortInfo *info,char *first,char *last,size_t depth) {
+	size_t size = info->size;
+	while((size_t)(last - first) > THRESHOLD * size) {
+		/* too many bad pivots; fall back to heapsort */
+		if(depth == 0) {
+			heapsort(info,first,(last - first) / size);
+			return;
+		}
+		depth--;
+
+		/* recurse into the smaller part to bound the stack depth */
+		char *cut = divide(info,first,last);
+		if(cut - first < last - cut) {
+			introsort(info,first,cut,depth);
+			first = cut;
+		}
+		else {
+			introsort(info,cut,last,depth);
+			last = cut;
+		}
+	}
+}
+
+static char *divide(const sSortInfo *info,char *first,char *last) {
+	size_t size = info->size;
+	size_t n = (last - first) / size;
+	/* the median of first, middle and last element is the pivot and is put at first. it also
+	 * serves as sentinel for the loops below */
+	char *piv = first;
+	medianToFirst(info,piv,first + size,first + (n / 2) * size,last - size);
+	first += size;
+	while(1) {
+		/* right until the element is >= piv */
+		while(info->cmp(first,piv) < 0)
+			first += size;
+		/* left until the element is <= piv */
+		last -= size;
+		while(info->cmp(piv,last) < 0)
+			last -= size;
+
+		if(first >= last)
+			return first;
+		info->swap(first,last,size);
+		first += size;
+	}
 }
 
-static void _qsort(void *base,size_t size,fCompare cmp,int left,int right) {
-	/* TODO someday we should provide a better implementation which uses another sort-algo
-	 * for small arrays, don't uses recursion and so on */
-	if(left < right) {
-		int i = divide(base,size,cmp,left,right);
-		_qsort(base,size,cmp,left,i - 1);
-		_qsort(base,size,cmp,i + 1,right);
+static void medianToFirst(const sSortInfo *info,char *res,char *a,char *b,char *c) {
+	char *median;
+	if(info->cmp(a,b) < 0) {
+		if(info->cmp(b,c) < 0)
+			median = b;
+		else if(info->cmp(a,c) < 0)
+			median = c;
+		else
+			median = a;
 	}
+	else if(info->cmp(a,c) < 0)
+		median = a;
+	else if(info->cmp(b,c) < 0)
+		median = c;
+	else
+		median = b;
+	info->swap(res,median,info->size);
 }
 
-static int divide(void *base,size_t size,fCompare cmp,int left,int right) {
-	char *pleft = (char*)base + left * size;
-	char *piv = (char*)base + right * size;
-	char *i = pleft;
-	char *j = piv - size;
-	do {
-		/* right until the element is > piv */
-		while(cmp(i,piv) <= 0 && i < piv)
-			i += size;
-		/* left until the element is < piv */
-		while(cmp(j,piv) >= 0 && j > pleft)
-			j -= size;
-
-		/* swap */
-		if(i < j) {
-			memswp(i,j,size);
-			i += size;
-			j -= size;
+static void heapsort(const sSortInfo *info,char *first,size_t n) {
+	size_t size = info->size;
+	for(size_t i = n / 2; i-- > 0; )
+		siftDown(info,first,i,n);
+	while(n > 1) {
+		n--;
+		info->swap(first,first + n * size,size);
+		siftDown(info,first,0,n);
+	}
+}
+
+static void siftDown(const sSortInfo *info,char *first,size_t root,size_t n) {
+	size_t size = info->size;
+	size_t child;
+	while((child = 2 * root + 1) < n) {
+		char *c = first + child * size;
+		if(child + 1 < n && info->cmp(c,c + size) < 0) {
+			child++;
+			c += size;
 		}
+		char *r = first + root * size;
+		if(info->cmp(r,c) >= 0)
+			break;
+		info->swap(r,c,size);
+		root = child;
+	}
+}
+
+static void insertionSort(const sSortInfo *info,char *first,char *last) {
+	size_t size = info->size;
+	for(char *i = first + size; i < last; i += size) {
+		for(char *j = i; j > first && info->cmp(j - size,j) > 0; j -= size)
+			info->swap(j - size,j,size);
 	}
-	while(i < j);
+}
 
-	/* swap piv with element i */
-	if(cmp(i,piv) > 0)
-		memswp(i,piv,size);
-	return (uint)(i - (char*)base) / size;
+static void swapWords(char *a,char *b,size_t size) {
+	ulong *wa = (ulong*)a;
+	ulong *wb = (ulong*)b;
+	for(size /= sizeof(ulong); size > 0; size--) {
+		ulong tmp = *wa;
+		*wa++ = *wb;
+		*wb++ = tmp;
+	}
+}
+
+static void swapBytes(char *a,char *b,size_t size) {
+	for(; size > 0; size--) {
+		char tmp = *a;
+		*a++ = *b;
+		*b++ = tmp;
+	}
 }
@@ -26,16 +26,19 @@
 #include <stdlib.h>
 #include <stdio.h>
 
-long __tls_num = 0;
+/* slot 0 is reserved for the thread cache of the heap */
+long __tls_num = 1;
 
 void initTLS(void);
 
 void initTLS(void) {
+	/* calloc uses the TLS if it's present, so mark it as not present until we're done */
+	ulong **ptr = (ulong**)stack_top(2);
+	*ptr = NULL;
+
 	ulong *tls = calloc(MAX_TLS_ENTRIES,sizeof(ulong));
 	if(!tls)
 		error("Not enough memory for TLS struct");
-
-	ulong **ptr = (ulong**)stack_top(2);
 	*ptr = tls;
 }
 
@@ -54,19 +54,57 @@ void Device::unset(msgid_t op) {
 }
 
 void Device::loop() {
-	ulong buf[IPC_DEF_SIZE / sizeof(ulong)];
 	while(_run) {
-		msgid_t mid;
-		int fd = getwork(_id,&mid,buf,sizeof(buf),0);
-		if(EXPECT_FALSE(fd < 0)) {
-			/* just log that it failed. maybe a client has sent a message that was too big */
-			if(fd != -EINTR)
-				printe("getwork failed");
-			continue;
+		ssize_t res = handleWork(0);
+		/* just log that it failed. maybe a client has sent a message that was too big */
+		if(EXPECT_FALSE(res < 0 && res != -EINTR))
+			printe("getwork failed");
+	}
+}
+
+ssize_t Device::handleWork(uint flags) {
+	ulong bufs[BATCH_SIZE][IPC_DEF_SIZE / sizeof(ulong)];
+	sMsgVec msgs[BATCH_SIZE];
+	sMsgVec replies[BATCH_SIZE];
+	for(size_t i = 0; i < BATCH_SIZE; ++i) {
+		msgs[i].mid = 0;
+		msgs[i].data = bufs[i];
+		msgs[i].size = sizeof(bufs[i]);
+	}
+
+	ssize_t count = getworkv(_id,msgs,BATCH_SIZE,flags);
+	if(EXPECT_FALSE(count < 0))
+		return count;
+
+	size_t nreplies = 0;
+	for(ssize_t i = 0; i < count; ++i) {
+		/* the close handler releases the fd, which might be reused by a new client afterwards */
+		if(EXPECT_FALSE((msgs[i].mid & 0xFFFF) == MSG_FILE_CLOSE)) {
+			sendReplies(replies,nreplies);
+			nreplies = 0;
 		}
 
-		IPCStream is(fd,buf,sizeof(buf),mid);
-		handleMsg(mid,is);
+		/* the reply stays in bufs[i] until we send it below */
+		IPCStream is(msgs[i].fd,bufs[i],sizeof(bufs[i]),msgs[i].mid);
+		is.deferReply();
+		handleMsg(msgs[i].mid,is);
+
+		sMsgVec *r = replies + nreplies;
+		if(is.takeReply(&r->data,&r->size)) {
+			r->fd = is.fd();
+			r->mid = is.msgid();
+			nreplies++;
+		}
+	}
+	sendReplies(replies,nreplies);
+	return count;
+}
+
+void Device::sendReplies(const sMsgVec *replies,size_t count) {
+	if(count > 0) {
+		ssize_t res = sendv(replies,count);
+		if(EXPECT_FALSE(res != (ssize_t)count))
+			printe("Sending replies failed: %zd of %zu sent",res < 0 ? 0 : res,count);
 	}
 }
 
@@ -24,27 +24,33 @@
 #include <fs/fsdev.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <assert.h>
 
 #define ALLOC_LOCK	0xF7180000
+#define STAGE_LOCK	0xF7180001
 
 BlockCache::BlockCache(int fd,size_t blocks,size_t bsize)
-		: _blockCacheSize(blocks), _blockSize(bsize), _hashmap(new CBlock*[HASH_SIZE]()),
-		  _oldestBlock(NULL), _newestBlock(NULL), _freeBlocks(NULL),
-		  _blockCache(new CBlock[blocks]), _blockmem(), _blockshm(), _hits(), _misses() {
+		: _blockCacheSize(blocks), _blockSize(bsize), _hashSize(HASH_INIT), _hashUsed(),
+		  _hashmap(new CBlock*[HASH_INIT]()), _oldestBlock(NULL), _newestBlock(NULL),
+		  _freeBlocks(NULL), _blockCache(new CBlock[blocks]), _blockmem(), _blockshm(), _stage(),
+		  _raNext(), _raWindow(), _raMax(MAX(1,MIN(MAX_BATCH,blocks / 8))), _hits(), _misses(),
+		  _raBlocks(), _raHits(), _diskReads(), _diskWrites(), _writtenBlocks() {
 	size_t i;
 	CBlock *bentry;
-	if(sharebuf(fd,_blockCacheSize * _blockSize,&_blockmem,&_blockshm,0) < 0) {
+	if(sharebuf(fd,(_blockCacheSize + MAX_BATCH) * _blockSize,&_blockmem,&_blockshm,0) < 0) {
 		if(_blockmem == NULL)
 			VTHROW("Unable to create block cache");
 		printe("Unable to share buffer with disk driver");
 	}
+	_stage = (char*)_blockmem + _blockCacheSize * _blockSize;
 	bentry = _blockCache;
 	for(i = 0; i < _blockCacheSize; i++) {
 		bentry->blockNo = 0;
 		bentry->buffer = (char*)_blockmem + i * _blockSize;
 		bentry->dirty = false;
 		bentry->refs = 0;
+		bentry->prefetched = false;
 		bentry->prev = (i < _blockCacheSize - 1) ? bentry + 1 : NULL;
 		bentry->next = _freeBlocks;
 		bentry->hnext = NULL;
@@ -63,17 +69,43 @@ void BlockCache::flush() {
 	CBlock *bentry = _newestBlock;
 	while(bentry != NULL) {
 		sassert(tpool_lock(ALLOC_LOCK,LOCK_EXCLUSIVE | LOCK_KEEP) == 0);
-		if(bentry->dirty) {
-			acquire(bentry,READ);
-			writeBlocks(bentry->buffer,bentry->blockNo,1);
-			bentry->dirty = false;
-			doRelease(bentry,false);
-		}
+		/* writeBack() only changes the dirty flags, so that we can simply walk on */
+		if(bentry->dirty)
+			writeBack(bentry);
 		sassert(tpool_unlock(ALLOC_LOCK) == 0);
 		bentry = bentry->next;
 	}
 }
 
+void BlockCache::sync(block_t start,size_t count) {
+	for(size_t i = 0; i < count; ++i) {
+		sassert(tpool_lock(ALLOC_LOCK,LOCK_EXCLUSIVE | LOCK_KEEP) == 0);
+		CBlock *b = lookup(start + i);
+		if(b && b->dirty)
+			writeBack(b);
+		sassert(tpool_unlock(ALLOC_LOCK) == 0);
+	}
+}
+
+void BlockCache::update(const void *buffer,block_t start,size_t count) {
+	for(size_t i = 0; i < count; ++i) {
+		sassert(tpool_lock(ALLOC_LOCK,LOCK_EXCLUSIVE | LOCK_KEEP) == 0);
+		CBlock *b = lookup(start + i);
+		if(b == NULL) {
+			sassert(tpool_unlock(ALLOC_LOCK) == 0);
+			continue;
+		}
+
+		b->refs++;
+		sassert(tpool_unlock(ALLOC_LOCK) == 0);
+		sassert(tpool_lock((uint)b,LOCK_EXCLUSIVE) == 0);
+		memcpy(b->buffer,(const char*)buffer + i * _blockSize,_blockSize);
+		/* the disk has the same content now */
+		b->dirty = false;
+		doRelease(b,true);
+	}
+}
+
 void BlockCache::acquire(CBlock *b,A_UNUSED uint mode) {
 	assert(!(mode & WRITE) || b->refs == 0);
 	b->refs++;
@@ -97,48 +129,44 @@ CBlock *BlockCache::doRequest(block_t blockNo,bool doRead,uint mode) {
 	sassert(tpool_lock(ALLOC_LOCK,LOCK_EXCLUSIVE | LOCK_KEEP) == 0);
 
 	/* search for the block. perhaps it's already in cache */
-	bentry = _hashmap[blockNo % HASH_SIZE];
-	while(bentry != NULL) {
-		if(bentry->blockNo == blockNo) {
-			/* remove from list and put at the beginning of the usedlist because it was
-			 * used most recently */
-			if(bentry->prev != NULL) {
-				/* update oldest */
-				if(_oldestBlock == bentry)
-					_oldestBlock = bentry->prev;
-				/* remove */
-				bentry->prev->next = bentry->next;
-				if(bentry->next)
-					bentry->next->prev = bentry->prev;
-				/* put at the beginning */
-				bentry->prev = NULL;
-				bentry->next = _newestBlock;
-				bentry->next->prev = bentry;
-				_newestBlock = bentry;
-			}
-			acquire(bentry,mode);
-			_hits++;
-			return bentry;
+	bentry = lookup(blockNo);
+	if(bentry != NULL) {
+		/* remove from list and put at the beginning of the usedlist because it was
+		 * used most recently */
+		if(bentry->prev != NULL) {
+			/* update oldest */
+			if(_oldestBlock == bentry)
+				_oldestBlock = bentry->prev;
+			/* remove */
+			bentry->prev->next = bentry->next;
+			if(bentry->next)
+				bentry->next->prev = bentry->prev;
+			/* put at the beginning */
+			bentry->prev = NULL;
+			bentry->next = _newestBlock;
+			bentry->next->prev = bentry;
+			_newestBlock = bentry;
 		}
-		bentry = bentry->hnext;
+		if(bentry->prefetched) {
+			bentry->prefetched = false;
+			_raHits++;
+		}
+		acquire(bentry,mode);
+		_hits++;
+		return bentry;
 	}
 
 	/* init cached block */
 	block = getBlock(blockNo);
-	block->blockNo = blockNo;
 	block->dirty = false;
 	block->refs = 0;
+	block->prefetched = false;
 
 	/* now read from disk */
-	if(doRead) {
-		/* we need always a write-tpool_lock because we have to read the content into it */
-		acquire(block,WRITE);
-		if(readBlocks(block->buffer,blockNo,1) != 0) {
-			block->blockNo = 0;
-			doRelease(block,true);
-			return NULL;
-		}
-		doRelease(block,false);
+	if(doRead && !fetch(block)) {
+		invalidate(block);
+		sassert(tpool_unlock(ALLOC_LOCK) == 0);
+		return NULL;
 	}
 
 	acquire(block,mode);
@@ -146,6 +174,132 @@ CBlock *BlockCache::doRequest(block_t blockNo,bool doRead,uint mode) {
 	return block;
 }
 
+bool BlockCache::fetch(CBlock *block) {
+	CBlock *blocks[MAX_BATCH];
+	block_t blockNo = block->blockNo;
+	size_t count = 1;
+
+	/* if the accesses are sequential, read ahead and double the window each time */
+	if(blockNo == _raNext && blockNo != 0)
+		_raWindow = _raWindow ? MIN(_raWindow * 2,_raMax) : MIN(RA_MIN,_raMax);
+	else
+		_raWindow = 0;
+
+	/* stop at the first block that we have already, because it might be dirty */
+	blocks[0] = block;
+	for(; count < _raWindow; ++count) {
+		if(lookup(blockNo + count))
+			break;
+		CBlock *b = getBlock(blockNo + count);
+		b->dirty = false;
+		b->refs = 0;
+		b->prefetched = true;
+		blocks[count] = b;
+	}
+	_raNext = blockNo + count;
+
+	/* we need always a write-lock because we have to read the content into it */
+	for(size_t i = 0; i < count; ++i) {
+		blocks[i]->refs++;
+		sassert(tpool_lock((uint)blocks[i],LOCK_EXCLUSIVE) == 0);
+	}
+	sassert(tpool_unlock(ALLOC_LOCK) == 0);
+
+	bool rares = false;
+	if(count > 1) {
+		sassert(tpool_lock(STAGE_LOCK,LOCK_EXCLUSIVE) == 0);
+		rares = readBlocks(_stage,blockNo,count) == 0;
+		if(rares) {
+			for(size_t i = 0; i < count; ++i)
+				memcpy(blocks[i]->buffer,(char*)_stage + i * _blockSize,_blockSize);
+		}
+		sassert(tpool_unlock(STAGE_LOCK) == 0);
+		_diskReads++;
+	}
+
+	/* no read-ahead or perhaps we went beyond the end of the device; read just the block */
+	bool res = rares;
+	if(!res) {
+		res = readBlocks(block->buffer,blockNo,1) == 0;
+		_diskReads++;
+	}
+
+	for(size_t i = 0; i < count; ++i)
+		doRelease(blocks[i],false);
+	/* throw the read-ahead blocks away if we couldn't read them */
+	for(size_t i = 1; i < count; ++i) {
+		if(rares)
+			_raBlocks++;
+		else
+			invalidate(blocks[i]);
+	}
+	return res;
+}
+
+void BlockCache::writeBack(CBlock *block) {
+	CBlock *blocks[MAX_BATCH];
+	CBlock *b;
+	block_t start = block->blockNo;
+	size_t count = 0;
+
+	/* collect the dirty blocks around <block>, that are not in use at the moment */
+	while(count < MAX_BATCH / 2 && start > 0 && (b = lookup(start - 1)) && b->dirty && b->refs == 0) {
+		start--;
+		count++;
+	}
+	for(count = 0; count < MAX_BATCH; ++count) {
+		b = lookup(start + count);
+		if(b != block && (!b || !b->dirty || b->refs > 0))
+			break;
+		blocks[count] = b;
+	}
+	assert(count > 0);
+
+	for(size_t i = 0; i < count; ++i) {
+		blocks[i]->refs++;
+		sassert(tpool_lock((uint)blocks[i],0) == 0);
+	}
+	sassert(tpool_unlock(ALLOC_LOCK) == 0);
+
+	if(count == 1)
+		writeBlocks(block->buffer,block->blockNo,1);
+	else {
+		/* copy them into a contiguous buffer to write them at once */
+		sassert(tpool_lock(STAGE_LOCK,LOCK_EXCLUSIVE) == 0);
+		for(size_t i = 0; i < count; ++i)
+			memcpy((char*)_stage + i * _blockSize,blocks[i]->buffer,_blockSize);
+		writeBlocks(_stage,start,count);
+		sassert(tpool_unlock(STAGE_LOCK) == 0);
+	}
+	_diskWrites++;
+	_writtenBlocks += count;
+
+	for(size_t i = 0; i < count; ++i) {
+		blocks[i]->dirty = false;
+		doRelease(blocks[i],false);
+	}
+}
+
+void BlockCache::invalidate(CBlock *block) {
+	assert(block->refs == 0);
+	hashRemove(block);
+	/* remove from usedlist */
+	if(block->prev)
+		block->prev->next = block->next;
+	else
+		_newestBlock = block->next;
+	if(block->next)
+		block->next->prev = block->prev;
+	else
+		_oldestBlock = block->prev;
+	/* put in freelist */
+	block->prev = NULL;
+	block->next = _freeBlocks;
+	block->dirty = false;
+	block->prefetched = false;
+	_freeBlocks = block;
+}
+
 CBlock *BlockCache::getBlock(block_t blockNo) {
 	CBlock *block = _freeBlocks;
 	if(block != NULL) {
@@ -153,7 +307,7 @@ CBlock *BlockCache::getBlock(block_t blockNo) {
 		_freeBlocks = block->next;
 		if(_freeBlocks)
 			_freeBlocks->prev = NULL;
-		/* block->prev is already NULL */
+		block->prev = NULL;
 		block->next = _newestBlock;
 		if(block->next)
 			block->next->prev = block;
@@ -162,34 +316,19 @@ CBlock *BlockCache::getBlock(block_t blockNo) {
 		if(_oldestBlock == NULL)
 			_oldestBlock = block;
 		/* insert into hashmap */
-		CBlock **list = &_hashmap[blockNo % HASH_SIZE];
-		block->hnext = *list;
-		*list = block;
+		block->blockNo = blockNo;
+		hashInsert(block);
 		return block;
 	}
 
-	/* take the oldest one */
+	/* take the oldest one. if it is dirty we have to write it first to disk */
 	block = _oldestBlock;
 	assert(block->refs == 0);
+	if(block->dirty)
+		writeBack(block);
 	_oldestBlock = block->prev;
 	_oldestBlock->next = NULL;
-	/* remove from hashmap */
-	bool diffhash = block->blockNo % HASH_SIZE != blockNo % HASH_SIZE;
-	if(diffhash) {
-		CBlock **list = &_hashmap[block->blockNo % HASH_SIZE];
-		CBlock *b = *list, *p = NULL;
-		while(b != NULL) {
-			if(b == block) {
-				if(p)
-					p->hnext = b->hnext;
-				else
-					*list = b->hnext;
-				break;
-			}
-			p = b;
-			b = b->hnext;
-		}
-	}
+	hashRemove(block);
 	/* put at beginning of usedlist */
 	block->prev = NULL;
 	block->next = _newestBlock;
@@ -197,20 +336,49 @@ CBlock *BlockCache::getBlock(block_t blockNo) {
 		block->next->prev = block;
 	_newestBlock = block;
 	/* insert into hashmap */
-	if(diffhash) {
-		CBlock **list = &_hashmap[blockNo % HASH_SIZE];
-		block->hnext = *list;
-		*list = block;
-	}
-	/* if it is dirty we have to write it first to disk */
-	if(block->dirty) {
-		acquire(block,READ);
-		writeBlocks(block->buffer,block->blockNo,1);
-		doRelease(block,false);
-	}
+	block->blockNo = blockNo;
+	block->prefetched = false;
+	hashInsert(block);
 	return block;
 }
 
+void BlockCache::hashInsert(CBlock *block) {
+	if(++_hashUsed > _hashSize * HASH_LOAD)
+		hashResize(_hashSize * 2);
+	CBlock **list = &_hashmap[block->blockNo & (_hashSize - 1)];
+	block->hnext = *list;
+	*list = block;
+}
+
+void BlockCache::hashRemove(CBlock *block) {
+	CBlock **list = &_hashmap[block->blockNo & (_hashSize - 1)];
+	while(*list != NULL) {
+		if(*list == block) {
+			*list = block->hnext;
+			_hashUsed--;
+			break;
+		}
+		list = &(*list)->hnext;
+	}
+}
+
+void BlockCache::hashResize(size_t size) {
+	CBlock **map = new CBlock*[size]();
+	for(size_t i = 0; i < _hashSize; ++i) {
+		CBlock *b = _hashmap[i];
+		while(b != NULL) {
+			CBlock *next = b->hnext;
+			CBlock **list = &map[b->blockNo & (size - 1)];
+			b->hnext = *list;
+			*list = b;
+			b = next;
+		}
+	}
+	delete[] _hashmap;
+	_hashmap = map;
+	_hashSize = size;
+}
+
 void BlockCache::printStats(FILE *f) {
 	float hitrate;
 	size_t used = 0,dirty = 0;
@@ -224,8 +392,13 @@ void BlockCache::printStats(FILE *f) {
 	fprintf(f,"\t\tTotal blocks: %zu\n",_blockCacheSize);
 	fprintf(f,"\t\tUsed blocks: %zu\n",used);
 	fprintf(f,"\t\tDirty blocks: %zu\n",dirty);
+	fprintf(f,"\t\tHash buckets: %zu\n",_hashSize);
 	fprintf(f,"\t\tHits: %lu\n",_hits);
 	fprintf(f,"\t\tMisses: %lu\n",_misses);
+	fprintf(f,"\t\tRead ahead: %lu blocks\n",_raBlocks);
+	fprintf(f,"\t\tRead-ahead hits: %lu\n",_raHits);
+	fprintf(f,"\t\tDisk reads: %lu\n",_diskReads);
+	fprintf(f,"\t\tDisk writes: %lu (%lu blocks)\n",_diskWrites,_writtenBlocks);
 	if(_hits == 0)
 		hitrate = 0;
 	else
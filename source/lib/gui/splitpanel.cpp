@@ -30,10 +30,10 @@ namespace gui {
 
 		// determine position by preferred sizes, if not already done
 		if(_position == -1) {
-			const std::shared_ptr<Control> &first = _controls[1];
-			const std::shared_ptr<Control> &second = _controls[2];
-			Size fsize = first.get() ? first.get()->getPreferredSize() : Size();
-			if(!second.get())
+			Control *first = getChild(1);
+			Control *second = getChild(2);
+			Size fsize = first ? first->getPreferredSize() : Size();
+			if(!second)
 				_position = 100;
 			else if(_orientation == VERTICAL)
 				_position = 100.0 * ((double)fsize.width / total.width);
@@ -48,9 +48,10 @@ namespace gui {
 			first = Size(total.width,total.height * (_position / 100.0));
 
 		Pos pos(pad,pad);
-		if(_controls[1]) {
-			res |= _controls[1]->resizeTo(first);
-			res |= _controls[1]->moveTo(pos);
+		Control *fctrl = getChild(1);
+		if(fctrl) {
+			res |= fctrl->resizeTo(first);
+			res |= fctrl->moveTo(pos);
 			if(_orientation == VERTICAL)
 				pos.x += first.width;
 			else
@@ -68,9 +69,10 @@ namespace gui {
 			pos.y += sepSize.height;
 		}
 
-		if(_controls[2]) {
-			res |= _controls[2]->moveTo(pos);
-			res |= _controls[2]->resizeTo(total - Size(pos));
+		Control *sctrl = getChild(2);
+		if(sctrl) {
+			res |= sctrl->moveTo(pos);
+			res |= sctrl->resizeTo(total - Size(pos));
 		}
 
 		_doingLayout = false;
@@ -142,10 +144,10 @@ namespace gui {
 	}
 
 	Size SplitPanel::getPrefSize() const {
-		const std::shared_ptr<Control> &first = _controls[1];
-		const std::shared_ptr<Control> &second = _controls[2];
-		Size fsize = first.get() ? first.get()->getPreferredSize() : Size();
-		Size ssize = second.get() ? second.get()->getPreferredSize() : Size();
+		Control *first = getChild(1);
+		Control *second = getChild(2);
+		Size fsize = first ? first->getPreferredSize() : Size();
+		Size ssize = second ? second->getPreferredSize() : Size();
 		return combine(fsize,ssize,_controls[0]->getPreferredSize());
 	}
 
@@ -91,7 +91,7 @@ namespace gui {
 		if(_colors == nullptr)
 			_colors = new vector<Color>();
 		if(id >= _colors->size())
-			_colors->reserve(id + 1);
+			_colors->resize(id + 1);
 		(*_colors)[id] = c;
 		_present |= 1 << id;
 		_dirty = true;
@@ -18,32 +18,179 @@
  */
 
 #include <z/crc32.h>
+#include <string.h>
+
+#include "crc32tab.h"
+
+#if defined(__x86_64__)
+#	include <smmintrin.h>
+#	include <wmmintrin.h>
+#endif
 
 namespace z {
 
 /* source: http://tools.ietf.org/html/rfc1952 */
 
-CRC32::CRC32() {
-	/* Make the table for a fast CRC. */
-	for(size_t n = 0; n < 256; n++) {
-		ulong c = n;
-		for(int k = 0; k < 8; k++) {
-			if(c & 1)
-				c = 0xedb88320L ^ (c >> 1);
-			else
-				c = c >> 1;
-		}
-		_table[n] = c;
-	}
+static inline uint32_t load32(const uint8_t *b) {
+#if defined(__x86__)
+	uint32_t val;
+	memcpy(&val,b,sizeof(val));
+	return val;
+#else
+	return b[0] | (b[1] << 8) | (b[2] << 16) | ((uint32_t)b[3] << 24);
+#endif
 }
 
-CRC32::type CRC32::update(type crc,const void *buf,size_t len) {
+CRC32::type CRC32::update_bytewise(type crc,const void *buf,size_t len) {
 	type c = crc ^ 0xffffffffL;
-	const char *b = reinterpret_cast<const char*>(buf);
+	const uint8_t *b = reinterpret_cast<const uint8_t*>(buf);
 
 	for(size_t n = 0; n < len; n++)
-		c = _table[(c ^ b[n]) & 0xff] ^ (c >> 8);
+		c = crc32_tables[0][(c ^ b[n]) & 0xff] ^ (c >> 8);
 	return c ^ 0xffffffffL;
 }
 
+CRC32::type CRC32::update_sliced(type crc,const void *buf,size_t len) {
+	type c = crc ^ 0xffffffffL;
+	const uint8_t *b = reinterpret_cast<const uint8_t*>(buf);
+
+	/* process 8 bytes at once. the first word is combined with the current CRC and each byte is
+	 * looked up in the table that corresponds to the number of bytes that follow it */
+	for(; len >= 8; len -= 8, b += 8) {
+		uint32_t one = load32(b) ^ c;
+		uint32_t two = load32(b + 4);
+		c = crc32_tables[7][one & 0xff] ^
+			crc32_tables[6][(one >> 8) & 0xff] ^
+			crc32_tables[5][(one >> 16) & 0xff] ^
+			crc32_tables[4][one >> 24] ^
+			crc32_tables[3][two & 0xff] ^
+			crc32_tables[2][(two >> 8) & 0xff] ^
+			crc32_tables[1][(two >> 16) & 0xff] ^
+			crc32_tables[0][two >> 24];
+	}
+
+	for(; len > 0; --len)
+		c = crc32_tables[0][(c ^ *b++) & 0xff] ^ (c >> 8);
+	return c ^ 0xffffffffL;
+}
+
+#if defined(__x86_64__)
+/* the PCLMULQDQ variant needs at least 64 bytes and works on 16 byte chunks */
+static const size_t CLMUL_MIN_LEN	= 64;
+
+/* based on "Fast CRC Computation for Generic Polynomials Using PCLMULQDQ Instruction" by Intel.
+ * expects the CRC without the final inversion and <len> >= 64 and a multiple of 16. */
+__attribute__((target("sse4.1,pclmul")))
+static uint32_t update_clmul(uint32_t crc,const uint8_t *buf,size_t len) {
+	/* the bit-reflected constants k1 .. k5 and the polynomial for the Barrett reduction */
+	static const uint64_t k1k2[] A_ALIGNED(16) = {0x0154442bd4,0x01c6e41596};
+	static const uint64_t k3k4[] A_ALIGNED(16) = {0x01751997d0,0x00ccaa009e};
+	static const uint64_t k5k0[] A_ALIGNED(16) = {0x0163cd6124,0x0000000000};
+	static const uint64_t poly[] A_ALIGNED(16) = {0x01db710641,0x01f7011641};
+	__m128i x0,x1,x2,x3,x4,x5,x6,x7,x8;
+
+	x1 = _mm_loadu_si128((const __m128i*)(buf + 0x00));
+	x2 = _mm_loadu_si128((const __m128i*)(buf + 0x10));
+	x3 = _mm_loadu_si128((const __m128i*)(buf + 0x20));
+	x4 = _mm_loadu_si128((const __m128i*)(buf + 0x30));
+	x1 = _mm_xor_si128(x1,_mm_cvtsi32_si128(crc));
+	x0 = _mm_load_si128((const __m128i*)k1k2);
+	buf += 64;
+	len -= 64;
+
+	/* fold 4 x 128 bits in parallel */
+	while(len >= 64) {
+		x5 = _mm_clmulepi64_si128(x1,x0,0x00);
+		x6 = _mm_clmulepi64_si128(x2,x0,0x00);
+		x7 = _mm_clmulepi64_si128(x3,x0,0x00);
+		x8 = _mm_clmulepi64_si128(x4,x0,0x00);
+		x1 = _mm_clmulepi64_si128(x1,x0,0x11);
+		x2 = _mm_clmulepi64_si128(x2,x0,0x11);
+		x3 = _mm_clmulepi64_si128(x3,x0,0x11);
+		x4 = _mm_clmulepi64_si128(x4,x0,0x11);
+		x1 = _mm_xor_si128(_mm_xor_si128(x1,x5),_mm_loadu_si128((const __m128i*)(buf + 0x00)));
+		x2 = _mm_xor_si128(_mm_xor_si128(x2,x6),_mm_loadu_si128((const __m128i*)(buf + 0x10)));
+		x3 = _mm_xor_si128(_mm_xor_si128(x3,x7),_mm_loadu_si128((const __m128i*)(buf + 0x20)));
+		x4 = _mm_xor_si128(_mm_xor_si128(x4,x8),_mm_loadu_si128((const __m128i*)(buf + 0x30)));
+		buf += 64;
+		len -= 64;
+	}
+
+	/* fold them into 128 bits */
+	x0 = _mm_load_si128((const __m128i*)k3k4);
+	x5 = _mm_clmulepi64_si128(x1,x0,0x00);
+	x1 = _mm_clmulepi64_si128(x1,x0,0x11);
+	x1 = _mm_xor_si128(_mm_xor_si128(x1,x2),x5);
+	x5 = _mm_clmulepi64_si128(x1,x0,0x00);
+	x1 = _mm_clmulepi64_si128(x1,x0,0x11);
+	x1 = _mm_xor_si128(_mm_xor_si128(x1,x3),x5);
+	x5 = _mm_clmulepi64_si128(x1,x0,0x00);
+	x1 = _mm_clmulepi64_si128(x1,x0,0x11);
+	x1 = _mm_xor_si128(_mm_xor_si128(x1,x4),x5);
+
+	/* fold the remaining 16 byte chunks */
+	while(len >= 16) {
+		x5 = _mm_clmulepi64_si128(x1,x0,0x00);
+		x1 = _mm_clmulepi64_si128(x1,x0,0x11);
+		x1 = _mm_xor_si128(_mm_xor_si128(x1,_mm_loadu_si128((const __m128i*)buf)),x5);
+		buf += 16;
+		len -= 16;
+	}
+
+	/* fold 128 bits to 64 bits */
+	x2 = _mm_clmulepi64_si128(x1,x0,0x10);
+	x3 = _mm_setr_epi32(~0,0,~0,0);
+	x1 = _mm_srli_si128(x1,8);
+	x1 = _mm_xor_si128(x1,x2);
+	x0 = _mm_loadl_epi64((const __m128i*)k5k0);
+	x2 = _mm_srli_si128(x1,4);
+	x1 = _mm_and_si128(x1,x3);
+	x1 = _mm_clmulepi64_si128(x1,x0,0x00);
+	x1 = _mm_xor_si128(x1,x2);
+
+	/* Barrett reduction to 32 bits */
+	x0 = _mm_load_si128((const __m128i*)poly);
+	x2 = _mm_and_si128(x1,x3);
+	x2 = _mm_clmulepi64_si128(x2,x0,0x10);
+	x2 = _mm_and_si128(x2,x3);
+	x2 = _mm_clmulepi64_si128(x2,x0,0x00);
+	x1 = _mm_xor_si128(x1,x2);
+	return _mm_extract_epi32(x1,1);
+}
+
+static bool has_clmul() {
+	uint32_t eax = 1,ebx,ecx,edx;
+	__asm__ ("cpuid" : "+a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx));
+	/* we need PCLMULQDQ and SSE4.1 */
+	return (ecx & (1 << 1)) && (ecx & (1 << 19));
+}
+
+bool CRC32::accelerated() {
+	/* a race doesn't hurt here; all threads will come to the same conclusion */
+	static int clmul = -1;
+	if(EXPECT_FALSE(clmul == -1))
+		clmul = has_clmul();
+	return clmul;
+}
+
+CRC32::type CRC32::update(type crc,const void *buf,size_t len) {
+	const uint8_t *b = reinterpret_cast<const uint8_t*>(buf);
+	if(len >= CLMUL_MIN_LEN && accelerated()) {
+		size_t chunk = len & ~(size_t)15;
+		crc = ~update_clmul(~crc,b,chunk);
+		b += chunk;
+		len -= chunk;
+	}
+	return update_sliced(crc,b,len);
+}
+#else
+bool CRC32::accelerated() {
+	return false;
+}
+
+CRC32::type CRC32::update(type crc,const void *buf,size_t len) {
+	return update_sliced(crc,buf,len);
+}
+#endif
+
 }
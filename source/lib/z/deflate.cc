@@ -22,228 +22,705 @@
 
 namespace z {
 
-/* based on http://tools.ietf.org/html/rfc1951 */
+/* based on http://tools.ietf.org/html/rfc1951. the matcher follows the approach of zlib, i.e. hash
+ * chains over a 32 KiB sliding window with optional lazy evaluation. */
+
+/* the parameters per compression level (the same as zlib uses) */
+const Deflate::Config Deflate::configs[] = {
+	/*      good lazy nice chain lazy */
+	/* 0 */ {0,    0,   0,    0, false},	/* store only */
+	/* 1 */ {4,    4,   8,    4, false},
+	/* 2 */ {4,    5,  16,    8, false},
+	/* 3 */ {4,    6,  32,   32, false},
+	/* 4 */ {4,    4,  16,   16, true},
+	/* 5 */ {8,   16,  32,   32, true},
+	/* 6 */ {8,   16, 128,  128, true},
+	/* 7 */ {8,   32, 128,  256, true},
+	/* 8 */ {32, 128, 258, 1024, true},
+	/* 9 */ {32, 258, 258, 4096, true},
+};
 
 /* ---------------------- *
  * -- encode functions -- *
  * ---------------------- */
 
+void Deflate::flush_output(Data *d) {
+	if(d->outpos > 0) {
+		d->drain->write(d->out,d->outpos);
+		d->outpos = 0;
+	}
+}
+
 void Deflate::flush(Data *d) {
 	if(d->bitcount > 0) {
-		d->drain->put(d->tag);
+		put(d,d->tag);
 		d->tag = 0;
 		d->bitcount = 0;
 	}
 }
 
-void Deflate::writebit(Data *d,int bit) {
-	assert((bit & ~0x1) == 0);
-	d->tag |= bit << d->bitcount;
+void Deflate::write_bits(Data *d,unsigned int bits,int num) {
+	d->tag |= bits << d->bitcount;
+	d->bitcount += num;
+	while(d->bitcount >= 8) {
+		put(d,d->tag & 0xFF);
+		d->tag >>= 8;
+		d->bitcount -= 8;
+	}
+}
+
+/* ---------------------- *
+ * -- Huffman encoding -- *
+ * ---------------------- */
 
-	if(++d->bitcount == 8)
-		flush(d);
+struct SymFreq {
+	uint32_t key;
+	unsigned short sym;
+};
+
+static bool symfreq_less(const SymFreq &a,const SymFreq &b) {
+	return a.key < b.key;
 }
 
-void Deflate::write_bits(Data *d,unsigned int bits,int num) {
-	while(num-- > 0) {
-		writebit(d,bits & 0x1);
-		bits >>= 1;
+void Deflate::build_lengths(const unsigned short *freq,unsigned short *lens,size_t num,size_t maxbits) {
+	SymFreq syms[L_CODES + 2];
+	size_t n = 0;
+
+	for(size_t i = 0; i < num; ++i) {
+		lens[i] = 0;
+		if(freq[i]) {
+			syms[n].key = freq[i];
+			syms[n++].sym = i;
+		}
+	}
+	/* a tree with less than two codes can't be complete; add dummy codes */
+	for(size_t i = 0; n < 2 && i < num; ++i) {
+		if(freq[i] == 0) {
+			syms[n].key = 1;
+			syms[n++].sym = i;
+		}
+	}
+	std::sort(syms,syms + n,symfreq_less);
+
+	/* compute the code lengths in place (A. Moffat, J. Katajainen: In-Place Calculation of
+	 * Minimum-Redundancy Codes). afterwards, syms[i].key is the code length of syms[i].sym */
+	size_t root = 0,leaf = 2,next;
+	syms[0].key += syms[1].key;
+	for(next = 1; next < n - 1; ++next) {
+		if(leaf >= n || syms[root].key < syms[leaf].key) {
+			syms[next].key = syms[root].key;
+			syms[root++].key = next;
+		}
+		else
+			syms[next].key = syms[leaf++].key;
+		if(leaf >= n || (root < next && syms[root].key < syms[leaf].key)) {
+			syms[next].key += syms[root].key;
+			syms[root++].key = next;
+		}
+		else
+			syms[next].key += syms[leaf++].key;
+	}
+	syms[n - 2].key = 0;
+	for(ssize_t i = n - 3; i >= 0; --i)
+		syms[i].key = syms[syms[i].key].key + 1;
+	ssize_t avail = 1,used = 0,depth = 0,r = n - 2,nx = n - 1;
+	while(avail > 0) {
+		while(r >= 0 && (ssize_t)syms[r].key == depth) {
+			used++;
+			r--;
+		}
+		while(avail > used) {
+			syms[nx--].key = depth;
+			avail--;
+		}
+		avail = 2 * used;
+		depth++;
+		used = 0;
+	}
+
+	/* limit the code lengths to <maxbits> and make the tree complete again */
+	size_t count[MAX_BITS + 1] = {0};
+	for(size_t i = 0; i < n; ++i)
+		count[std::min<size_t>(syms[i].key,maxbits)]++;
+	uint32_t total = 0;
+	for(size_t i = maxbits; i > 0; --i)
+		total += count[i] << (maxbits - i);
+	while(total != (1U << maxbits)) {
+		count[maxbits]--;
+		for(size_t i = maxbits - 1; i > 0; --i) {
+			if(count[i]) {
+				count[i]--;
+				count[i + 1] += 2;
+				break;
+			}
+		}
+		total--;
+	}
+
+	/* the most frequent symbols get the shortest codes */
+	for(size_t i = 1, j = n; i <= maxbits; ++i) {
+		for(size_t c = count[i]; c > 0; --c)
+			lens[syms[--j].sym] = i;
 	}
 }
 
-void Deflate::write_bits_reverse(Data *d,unsigned int bits,unsigned int num) {
-	while(num-- > 0)
-		writebit(d,(bits >> num) & 0x1);
+void Deflate::build_codes(Code *codes,const unsigned short *lens,size_t num) {
+	unsigned short bl_count[MAX_BITS + 1] = {0};
+	unsigned short next_code[MAX_BITS + 1];
+
+	for(size_t i = 0; i < num; ++i)
+		bl_count[lens[i]]++;
+	bl_count[0] = 0;
+
+	unsigned int code = 0;
+	for(size_t bits = 1; bits <= MAX_BITS; ++bits) {
+		code = (code + bl_count[bits - 1]) << 1;
+		next_code[bits] = code;
+	}
+
+	for(size_t i = 0; i < num; ++i) {
+		codes[i].len = lens[i];
+		codes[i].code = 0;
+		if(lens[i]) {
+			/* the codes are written starting with the MSB, but write_bits starts with the LSB */
+			unsigned int c = next_code[lens[i]]++;
+			for(size_t b = 0; b < lens[i]; ++b) {
+				codes[i].code = (codes[i].code << 1) | (c & 1);
+				c >>= 1;
+			}
+		}
+	}
 }
 
-void Deflate::write_symbol(Data *d,Tree *t,unsigned int sym) {
-	size_t i;
-	for(i = 0; i < 4; ++i) {
-		if(t->litbase[i] > sym)
+size_t Deflate::build_bl_tree(const Code *ltree,size_t lcodes,const Code *dtree,size_t dcodes) {
+	/* the code lengths of both trees form a single sequence, which is run-length encoded */
+	uint8_t lens[L_CODES + D_CODES];
+	size_t num = lcodes + dcodes;
+	for(size_t i = 0; i < lcodes; ++i)
+		lens[i] = ltree[i].len;
+	for(size_t i = 0; i < dcodes; ++i)
+		lens[lcodes + i] = dtree[i].len;
+
+	unsigned short freq[BL_CODES] = {0};
+	bl_count = 0;
+	for(size_t i = 0; i < num; ) {
+		uint8_t len = lens[i];
+		size_t run = 1;
+		while(i + run < num && lens[i + run] == len)
+			run++;
+		i += run;
+
+		if(len == 0) {
+			while(run >= 11) {
+				size_t r = std::min<size_t>(run,138);
+				bl_syms[bl_count] = 18;
+				bl_extra[bl_count++] = r - 11;
+				run -= r;
+			}
+			if(run >= 3) {
+				bl_syms[bl_count] = 17;
+				bl_extra[bl_count++] = run - 3;
+				run = 0;
+			}
+		}
+		else {
+			bl_syms[bl_count] = len;
+			bl_extra[bl_count++] = 0;
+			run--;
+			while(run >= 3) {
+				size_t r = std::min<size_t>(run,6);
+				bl_syms[bl_count] = 16;
+				bl_extra[bl_count++] = r - 3;
+				run -= r;
+			}
+		}
+		while(run-- > 0) {
+			bl_syms[bl_count] = len;
+			bl_extra[bl_count++] = 0;
+		}
+	}
+
+	for(size_t i = 0; i < bl_count; ++i)
+		freq[bl_syms[i]]++;
+	unsigned short bllens[BL_CODES];
+	build_lengths(freq,bllens,BL_CODES,MAX_BL_BITS);
+	build_codes(bltree,bllens,BL_CODES);
+
+	/* determine the number of code length codes to send */
+	for(bl_codes = BL_CODES; bl_codes > 4; --bl_codes) {
+		if(bltree[clcidx[bl_codes - 1]].len != 0)
 			break;
 	}
-	assert(i > 0);
-	i--;
 
-	unsigned int num = t->length[i];
-	unsigned int bits = t->codebase[i] + (sym - t->litbase[i]);
-	write_bits_reverse(d,bits,num);
+	/* 5 bits HLIT, 5 bits HDIST, 4 bits HCLEN and 3 bits per code length code */
+	size_t bits = 5 + 5 + 4 + 3 * bl_codes;
+	for(size_t i = 0; i < bl_count; ++i) {
+		static const uint8_t extra[] = {2,3,7};
+		bits += bltree[bl_syms[i]].len;
+		if(bl_syms[i] >= 16)
+			bits += extra[bl_syms[i] - 16];
+	}
+	return bits;
 }
 
-void Deflate::write_int(Data *d,Tree *t,unsigned short *base,unsigned char *bits,unsigned int value,int add) {
-	/* determine code */
-	size_t i;
-	for(i = 0; i < 30; ++i) {
-		if(base[i] > value)
+/* ------------------- *
+ * -- LZ77 matching -- *
+ * ------------------- */
+
+void Deflate::fill_window(Data *d) {
+	do {
+		size_t more = 2 * WSIZE - d->lookahead - d->strstart;
+
+		/* if the window is almost full, move the upper half to the lower half */
+		if(d->strstart >= WSIZE + MAX_DIST) {
+			memcpy(window,window + WSIZE,WSIZE);
+			d->match_start -= WSIZE;
+			d->strstart -= WSIZE;
+			d->block_start -= WSIZE;
+			for(size_t i = 0; i < HASH_SIZE; ++i)
+				head[i] = head[i] >= WSIZE ? head[i] - WSIZE : 0;
+			for(size_t i = 0; i < WSIZE; ++i)
+				prev[i] = prev[i] >= WSIZE ? prev[i] - WSIZE : 0;
+			more += WSIZE;
+		}
+		if(d->eof)
 			break;
+
+		size_t n = d->source->read(window + d->strstart + d->lookahead,more);
+		if(n < more)
+			d->eof = true;
+		d->lookahead += n;
+
+		/* initialize the hash with the first two bytes of the string at strstart */
+		if(d->lookahead >= MIN_MATCH) {
+			d->ins_h = window[d->strstart];
+			d->ins_h = ((d->ins_h << HASH_SHIFT) ^ window[d->strstart + 1]) & HASH_MASK;
+		}
 	}
-	assert(i > 0);
-	i--;
+	while(d->lookahead < MIN_LOOKAHEAD && !d->eof);
+}
 
-	/* write code */
-	write_symbol(d,t,add + i);
-	write_bits(d,value - base[i],bits[i]);
+unsigned int Deflate::insert_string(Data *d,size_t pos) {
+	d->ins_h = ((d->ins_h << HASH_SHIFT) ^ window[pos + MIN_MATCH - 1]) & HASH_MASK;
+	unsigned int match_head = prev[pos & WMASK] = head[d->ins_h];
+	head[d->ins_h] = pos;
+	return match_head;
 }
 
-void Deflate::write_symbol_chain(Data *d,Tree *lt,Tree *dt,unsigned int len,unsigned int dist) {
-	write_int(d,lt,length_base,length_bits,len,257);
-	write_int(d,dt,dist_base,dist_bits,dist,0);
+size_t Deflate::longest_match(Data *d,size_t cur_match) {
+	size_t chain_length = d->cfg->max_chain;
+	size_t best_len = d->prev_length;
+	size_t nice_match = std::min<size_t>(d->cfg->nice_length,d->lookahead);
+	size_t limit = d->strstart > MAX_DIST ? d->strstart - MAX_DIST : 0;
+	const uint8_t *scan = window + d->strstart;
+	const uint8_t *strend = scan + MAX_MATCH;
+	uint8_t scan_end1 = scan[best_len - 1];
+	uint8_t scan_end = scan[best_len];
+
+	/* do not waste too much time if we already have a good match */
+	if(d->prev_length >= d->cfg->good_length)
+		chain_length >>= 2;
+
+	do {
+		const uint8_t *match = window + cur_match;
+		/* skip this one if the end or the first two bytes don't match */
+		if(match[best_len] != scan_end || match[best_len - 1] != scan_end1 ||
+				match[0] != scan[0] || match[1] != scan[1])
+			continue;
+
+		/* the window has MAX_MATCH bytes slack at the end, so that we can compare 8 bytes at once
+		 * and check for the end afterwards */
+		const uint8_t *s = scan + 2;
+		match += 2;
+		while(*++s == *++match && *++s == *++match && *++s == *++match && *++s == *++match &&
+			  *++s == *++match && *++s == *++match && *++s == *++match && *++s == *++match &&
+			  s < strend)
+			;
+
+		size_t len = MAX_MATCH - (size_t)(strend - std::min(s,strend));
+		if(len > best_len) {
+			d->match_start = cur_match;
+			best_len = len;
+			if(len >= nice_match)
+				break;
+			scan_end1 = scan[best_len - 1];
+			scan_end = scan[best_len];
+		}
+	}
+	while((cur_match = prev[cur_match & WMASK]) > limit && --chain_length != 0);
+
+	return std::min(best_len,d->lookahead);
+}
+
+bool Deflate::tally(Data *d,size_t dist,size_t lc) {
+	sym_dist[d->sym_count] = dist;
+	sym_lc[d->sym_count] = lc;
+	d->sym_count++;
+	if(dist == 0)
+		d->lit_freq[lc]++;
+	else {
+		d->lit_freq[LITERALS + 1 + length_code[lc]]++;
+		d->dist_freq[dist_code(dist - 1)]++;
+	}
+	return d->sym_count == SYM_COUNT - 1;
 }
 
 /* ----------------------------- *
  * -- block deflate functions -- *
  * ----------------------------- */
 
-void Deflate::deflate_fixed_block(Data *d) {
-	size_t len = d->source->cached();
-	size_t orglen = len;
-	while(len > 0) {
-		unsigned char sym = d->source->peek(0);
-
-		// first, check if we already had the now following byte-sequence
-		int x,maxlen = 0,max = 0;
-		// ensure that we don't look more than 29 bytes back and not past the block-start and our
-		// current position
-		int end = MIN(29,len);
-		int begin = -MIN(29,orglen - len);
-		for(x = begin; x < 0; ++x) {
-			// check how many bytes match
-			int y;
-			for(y = 0; x + y < 0 && y < end; ++y) {
-				if(d->source->peek(x + y) != d->source->peek(y))
-					break;
-			}
-			// if we reached the end, the last one didn't match
-			if(x + y >= 0 || y >= end)
-				y--;
-
-			// the longest so far?
-			if(y > maxlen) {
-				maxlen = y;
-				max = x;
-			}
-		}
-
-		// the smallest length we can encode is 3
-		if(maxlen >= 3) {
-			write_symbol_chain(d,&sltree,&sdtree,maxlen,-max);
-			x = maxlen;
-		}
+void Deflate::compress_block(Data *d,const Code *ltree,const Code *dtree) {
+	for(size_t i = 0; i < d->sym_count; ++i) {
+		size_t dist = sym_dist[i];
+		size_t lc = sym_lc[i];
+		if(dist == 0)
+			write_code(d,ltree + lc);
 		else {
-			// first write the symbol
-			write_symbol(d,&sltree,sym);
-
-			// now check if the symbol is following again at least 3 times
-			for(x = 1; x < end; ++x) {
-				if(d->source->peek(x) != sym)
-					break;
-			}
-			x--;
-			if(x == end)
-				x--;
-
-			if(x >= 3) {
-				write_symbol_chain(d,&sltree,&sdtree,x,1);
-				x++;
-			}
-			// adjust x to fetch one byte from source
-			else
-				x = 1;
+			size_t code = length_code[lc];
+			write_code(d,ltree + LITERALS + 1 + code);
+			if(length_bits[code])
+				write_bits(d,lc + MIN_MATCH - length_base[code],length_bits[code]);
+
+			code = dist_code(dist - 1);
+			write_code(d,dtree + code);
+			if(dist_bits[code])
+				write_bits(d,dist - dist_base[code],dist_bits[code]);
 		}
+	}
+	write_code(d,ltree + END_BLOCK);
+}
 
-		// fetch the bytes from source
-		len -= x;
-		while(x-- > 0)
-			d->source->get();
+void Deflate::deflate_fixed_block(Data *d) {
+	compress_block(d,sltree,sdtree);
+}
+
+void Deflate::deflate_dynamic_block(Data *d) {
+	write_bits(d,dyn_lcodes - 257,5);
+	write_bits(d,dyn_dcodes - 1,5);
+	write_bits(d,bl_codes - 4,4);
+	for(size_t i = 0; i < bl_codes; ++i)
+		write_bits(d,bltree[clcidx[i]].len,3);
+
+	for(size_t i = 0; i < bl_count; ++i) {
+		static const uint8_t extra[] = {2,3,7};
+		write_code(d,bltree + bl_syms[i]);
+		if(bl_syms[i] >= 16)
+			write_bits(d,bl_extra[i],extra[bl_syms[i] - 16]);
 	}
 
-	/* end of block */
-	write_symbol(d,&sltree,256);
+	compress_block(d,dltree,ddtree);
 }
 
-void Deflate::deflate_uncompressed_block(Data *d) {
+void Deflate::deflate_uncompressed_block(Data *d,const uint8_t *buf,size_t len,bool last) {
 	unsigned int length,invlength;
-	unsigned int i;
+
+	write_bits(d,last ? 1 : 0,1);
+	write_bits(d,STORED,2);
 
 	/* make sure we start next block on a byte boundary */
 	flush(d);
 
 	/* get length */
-	length = d->source->cached();
+	length = len;
 	invlength = ~length & 0x0000ffff;
 	assert(length <= 0xffff);
 
 	length = cputole16(length);
 	invlength = cputole16(invlength);
-	d->drain->put(length & 0xff);
-	d->drain->put(length >> 8);
-	d->drain->put(invlength & 0xff);
-	d->drain->put(invlength >> 8);
+	put(d,length & 0xff);
+	put(d,length >> 8);
+	put(d,invlength & 0xff);
+	put(d,invlength >> 8);
 
 	/* copy block */
-	for(i = le16tocpu(length); i; --i)
-		d->drain->put(d->source->get());
+	flush_output(d);
+	d->drain->write(buf,len);
+}
+
+void Deflate::flush_block(Data *d,bool last) {
+	d->lit_freq[END_BLOCK] = 1;
+
+	/* build the dynamic trees */
+	unsigned short lens[L_CODES];
+	build_lengths(d->lit_freq,lens,L_CODES,MAX_BITS);
+	build_codes(dltree,lens,L_CODES);
+	build_lengths(d->dist_freq,lens,D_CODES,MAX_BITS);
+	build_codes(ddtree,lens,D_CODES);
+	for(dyn_lcodes = L_CODES; dyn_lcodes > 257 && dltree[dyn_lcodes - 1].len == 0; --dyn_lcodes)
+		;
+	for(dyn_dcodes = D_CODES; dyn_dcodes > 1 && ddtree[dyn_dcodes - 1].len == 0; --dyn_dcodes)
+		;
+
+	/* determine the size of the block in bits for each block type */
+	size_t dynbits = 3 + build_bl_tree(dltree,dyn_lcodes,ddtree,dyn_dcodes);
+	size_t fixbits = 3;
+	for(size_t i = 0; i < L_CODES; ++i) {
+		size_t extra = i > LITERALS ? length_bits[i - LITERALS - 1] : 0;
+		dynbits += d->lit_freq[i] * (dltree[i].len + extra);
+		fixbits += d->lit_freq[i] * (sltree[i].len + extra);
+	}
+	for(size_t i = 0; i < D_CODES; ++i) {
+		dynbits += d->dist_freq[i] * (ddtree[i].len + dist_bits[i]);
+		fixbits += d->dist_freq[i] * (sdtree[i].len + dist_bits[i]);
+	}
+
+	/* storing is only possible if the data of the block is still in the window */
+	size_t stored_len = 0;
+	size_t storedbits = ~(size_t)0;
+	if(d->block_start >= 0) {
+		stored_len = d->strstart - d->block_start;
+		size_t chunks = std::max<size_t>(1,(stored_len + MAX_STORED - 1) / MAX_STORED);
+		storedbits = stored_len * 8 + chunks * (3 + 7 + 32);
+	}
+
+	if(storedbits <= fixbits && storedbits <= dynbits) {
+		const uint8_t *buf = window + d->block_start;
+		do {
+			size_t amount = MIN(stored_len,MAX_STORED);
+			stored_len -= amount;
+			deflate_uncompressed_block(d,buf,amount,last && stored_len == 0);
+			buf += amount;
+		}
+		while(stored_len > 0);
+	}
+	else {
+		write_bits(d,last ? 1 : 0,1);
+		if(fixbits <= dynbits) {
+			write_bits(d,FIXED,2);
+			deflate_fixed_block(d);
+		}
+		else {
+			write_bits(d,DYN,2);
+			deflate_dynamic_block(d);
+		}
+	}
+
+	/* start a new block */
+	d->block_start = d->strstart;
+	d->sym_count = 0;
+	memset(d->lit_freq,0,sizeof(d->lit_freq));
+	memset(d->dist_freq,0,sizeof(d->dist_freq));
+}
+
+void Deflate::deflate_stored(Data *d) {
+	/* no need for the window here; just use it as a buffer */
+	size_t len;
+	do {
+		len = d->source->read(window,MAX_STORED);
+		deflate_uncompressed_block(d,window,len,len < MAX_STORED);
+	}
+	while(len == MAX_STORED);
+}
+
+void Deflate::deflate_greedy(Data *d) {
+	while(true) {
+		/* make sure that we have enough lookahead */
+		if(d->lookahead < MIN_LOOKAHEAD) {
+			fill_window(d);
+			if(d->lookahead == 0)
+				break;
+		}
+
+		/* insert the string at strstart into the dictionary and search for the longest match */
+		size_t hash_head = 0;
+		if(d->lookahead >= MIN_MATCH)
+			hash_head = insert_string(d,d->strstart);
+		d->match_length = MIN_MATCH - 1;
+		if(hash_head != 0 && d->strstart - hash_head <= MAX_DIST)
+			d->match_length = longest_match(d,hash_head);
+
+		bool full;
+		if(d->match_length >= MIN_MATCH) {
+			full = tally(d,d->strstart - d->match_start,d->match_length - MIN_MATCH);
+			d->lookahead -= d->match_length;
+
+			/* insert the strings of short matches into the dictionary as well */
+			if(d->match_length <= d->cfg->max_lazy && d->lookahead >= MIN_MATCH) {
+				d->match_length--;
+				do {
+					d->strstart++;
+					insert_string(d,d->strstart);
+				}
+				while(--d->match_length != 0);
+				d->strstart++;
+			}
+			else {
+				d->strstart += d->match_length;
+				d->match_length = 0;
+				d->ins_h = window[d->strstart];
+				d->ins_h = ((d->ins_h << HASH_SHIFT) ^ window[d->strstart + 1]) & HASH_MASK;
+			}
+		}
+		else {
+			full = tally(d,0,window[d->strstart]);
+			d->lookahead--;
+			d->strstart++;
+		}
+
+		if(full)
+			flush_block(d,false);
+	}
+	flush_block(d,true);
+}
+
+void Deflate::deflate_lazy(Data *d) {
+	while(true) {
+		/* make sure that we have enough lookahead */
+		if(d->lookahead < MIN_LOOKAHEAD) {
+			fill_window(d);
+			if(d->lookahead == 0)
+				break;
+		}
+
+		/* insert the string at strstart into the dictionary and search for the longest match */
+		size_t hash_head = 0;
+		if(d->lookahead >= MIN_MATCH)
+			hash_head = insert_string(d,d->strstart);
+
+		d->prev_length = d->match_length;
+		d->prev_match = d->match_start;
+		d->match_length = MIN_MATCH - 1;
+		if(hash_head != 0 && d->prev_length < d->cfg->max_lazy &&
+				d->strstart - hash_head <= MAX_DIST) {
+			d->match_length = longest_match(d,hash_head);
+			/* a match of length 3 that is too far away is not worth it */
+			if(d->match_length == MIN_MATCH && d->strstart - d->match_start > TOO_FAR)
+				d->match_length = MIN_MATCH - 1;
+		}
+
+		/* if there was a match at the previous position and the current one isn't better,
+		 * output the previous one */
+		if(d->prev_length >= MIN_MATCH && d->match_length <= d->prev_length) {
+			size_t max_insert = d->strstart + d->lookahead - MIN_MATCH;
+			bool full = tally(d,d->strstart - 1 - d->prev_match,d->prev_length - MIN_MATCH);
+
+			/* insert the strings of the match into the dictionary. strstart - 1 and strstart
+			 * are already inserted */
+			d->lookahead -= d->prev_length - 1;
+			d->prev_length -= 2;
+			do {
+				if(++d->strstart <= max_insert)
+					insert_string(d,d->strstart);
+			}
+			while(--d->prev_length != 0);
+			d->match_available = false;
+			d->match_length = MIN_MATCH - 1;
+			d->strstart++;
+
+			if(full)
+				flush_block(d,false);
+		}
+		/* otherwise, output the previous byte as a literal and wait for the next match */
+		else if(d->match_available) {
+			if(tally(d,0,window[d->strstart - 1]))
+				flush_block(d,false);
+			d->strstart++;
+			d->lookahead--;
+		}
+		else {
+			d->match_available = true;
+			d->strstart++;
+			d->lookahead--;
+		}
+	}
+
+	if(d->match_available)
+		tally(d,0,window[d->strstart - 1]);
+	flush_block(d,true);
 }
 
 /* ---------------------- *
  * -- public functions -- *
  * ---------------------- */
 
-Deflate::Deflate() : DeflateBase() {
-	/* init static length tree */
-	sltree.litbase[0] = 0;
-	sltree.length[0] = 8;
-	sltree.codebase[0] = 0x30;
-
-	sltree.litbase[1] = 144;
-	sltree.length[1] = 9;
-	sltree.codebase[1] = 0x190;
+Deflate::Deflate()
+	: DeflateBase(), window(new uint8_t[2 * WSIZE + MAX_MATCH]), head(new unsigned short[HASH_SIZE]),
+	  prev(new unsigned short[WSIZE]), sym_lc(new uint8_t[SYM_COUNT]),
+	  sym_dist(new unsigned short[SYM_COUNT]) {
+	/* the matcher might compare a few bytes beyond the valid data; make them defined */
+	memset(window,0,2 * WSIZE + MAX_MATCH);
 
-	sltree.litbase[2] = 256;
-	sltree.length[2] = 7;
-	sltree.codebase[2] = 0;
-
-	sltree.litbase[3] = 280;
-	sltree.length[3] = 8;
-	sltree.codebase[3] = 0xC0;
+	/* init fixed trees */
+	unsigned short lens[L_CODES + 2];
+	size_t i;
+	for(i = 0; i < 144; ++i)
+		lens[i] = 8;
+	for(; i < 256; ++i)
+		lens[i] = 9;
+	for(; i < 280; ++i)
+		lens[i] = 7;
+	for(; i < L_CODES + 2; ++i)
+		lens[i] = 8;
+	build_codes(sltree,lens,L_CODES + 2);
+	for(i = 0; i < D_CODES; ++i)
+		lens[i] = 5;
+	build_codes(sdtree,lens,D_CODES);
+
+	/* build the tables to map lengths and distances to codes */
+	for(size_t code = 0; code < 28; ++code) {
+		for(size_t n = 0; n < (1U << length_bits[code]); ++n)
+			length_code[length_base[code] - MIN_MATCH + n] = code;
+	}
+	/* length 258 has its own code */
+	length_code[MAX_MATCH - MIN_MATCH] = 28;
+	for(size_t code = 0; code < D_CODES; ++code) {
+		for(size_t n = 0; n < (1U << dist_bits[code]); ++n) {
+			size_t dist = dist_base[code] - 1 + n;
+			if(dist < 256)
+				dist_codes[dist] = code;
+			else
+				dist_codes[256 + (dist >> 7)] = code;
+		}
+	}
+}
 
-	/* init static distance tree */
-	sdtree.litbase[0] = 0;
-	sdtree.length[0] = 5;
-	sdtree.codebase[0] = 0;
-	// termination
-	sdtree.litbase[1] = 32;
+Deflate::~Deflate() {
+	delete[] window;
+	delete[] head;
+	delete[] prev;
+	delete[] sym_lc;
+	delete[] sym_dist;
 }
 
-int Deflate::compress(DeflateDrain *drain,DeflateSource *source,int compr) {
+int Deflate::compress(DeflateDrain *drain,DeflateSource *source,int level) {
+	if(level < NONE || level > BEST)
+		return FAILED;
+
 	Data d;
 	d.source = source;
 	d.bitcount = 0;
 	d.tag = 0;
 	d.drain = drain;
-
-	while(source->more() || source->cached() > 0) {
-		/* final block? */
-		writebit(&d,source->more() ? 0 : 1);
-		/* compression type */
-		write_bits(&d,compr,2);
-
-		/* write data */
-		switch(compr) {
-			case NONE:
-				deflate_uncompressed_block(&d);
-				break;
-			case FIXED:
-				deflate_fixed_block(&d);
-				break;
-			case DYN:
-				// TODO deflate_dynamic_block(&d);
-				break;
-		}
+	d.outpos = 0;
+
+	if(level == NONE)
+		deflate_stored(&d);
+	else {
+		d.cfg = configs + level;
+		d.ins_h = 0;
+		d.block_start = 0;
+		d.strstart = 0;
+		d.lookahead = 0;
+		d.match_start = 0;
+		d.match_length = MIN_MATCH - 1;
+		d.prev_length = MIN_MATCH - 1;
+		d.prev_match = 0;
+		d.match_available = false;
+		d.eof = false;
+		d.sym_count = 0;
+		memset(d.lit_freq,0,sizeof(d.lit_freq));
+		memset(d.dist_freq,0,sizeof(d.dist_freq));
+		memset(head,0,HASH_SIZE * sizeof(*head));
+
+		if(d.cfg->lazy)
+			deflate_lazy(&d);
+		else
+			deflate_greedy(&d);
 	}
 
 	flush(&d);
-	return 0;
+	flush_output(&d);
+	return OK;
 }
 
 }
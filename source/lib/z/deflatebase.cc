@@ -21,6 +21,13 @@
 
 namespace z {
 
+/* special ordering of code length codes */
+const unsigned char DeflateBase::clcidx[] = {
+	16,17,18,0,8,7,9,6,
+	10,5,11,4,12,3,13,2,
+	14,1,15
+};
+
 DeflateBase::DeflateBase() {
 	/* build extra bits and base tables */
 	build_bits_base(length_bits,length_base,4,3);
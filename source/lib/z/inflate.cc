@@ -17,7 +17,7 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
  */
 
-/* This is a slightly modified version of: */
+/* This was originally based on the following, but uses table-driven decoding now: */
 
 /*
  * tinflate  -  tiny inflate
@@ -57,138 +57,222 @@
 
 namespace z {
 
-/* special ordering of code length codes */
-const unsigned char Inflate::clcidx[] = {
-	16,17,18,0,8,7,9,6,
-	10,5,11,4,12,3,13,2,
-	14,1,15
-};
+static inline uint64_t load64(const uint8_t *b) {
+#if defined(__x86__)
+	uint64_t val;
+	memcpy(&val,b,sizeof(val));
+	return val;
+#else
+	uint64_t val = 0;
+	for(size_t i = 0; i < sizeof(val); ++i)
+		val |= (uint64_t)b[i] << (i * 8);
+	return val;
+#endif
+}
+
+static inline uint64_t mask(uint bits) {
+	return ((uint64_t)1 << bits) - 1;
+}
+
+/* copies <len> bytes from <dist> bytes behind <out> to <out>. might write up to 7 bytes more */
+static inline uint8_t *copy_match(uint8_t *out,size_t dist,size_t len) {
+	const uint8_t *src = out - dist;
+	uint8_t *end = out + len;
+	if(EXPECT_TRUE(dist >= sizeof(uint64_t))) {
+		/* the source is at least one word behind, so that we always read already written data */
+		do {
+			uint64_t word;
+			memcpy(&word,src,sizeof(word));
+			memcpy(out,&word,sizeof(word));
+			src += sizeof(word);
+			out += sizeof(word);
+		}
+		while(out < end);
+	}
+	else if(dist == 1)
+		memset(out,*src,len);
+	else {
+		while(out < end)
+			*out++ = *src++;
+	}
+	return end;
+}
 
 /* ----------------------- *
  * -- utility functions -- *
  * ----------------------- */
 
-/* build the fixed huffman trees */
-void Inflate::build_fixed_trees(Tree *lt,Tree *dt) {
-	int i;
-
-	/* build fixed length tree */
-	for(i = 0; i < 7; ++i)
-		lt->table[i] = 0;
-
-	lt->table[7] = 24;
-	lt->table[8] = 152;
-	lt->table[9] = 112;
+/* given an array of code lengths, build a decode table. returns false if the code is invalid */
+bool Inflate::build_table(uint32_t *table,size_t size,uint bits,const uint32_t *syms,
+		const uint8_t *lengths,uint num) {
+	uint16_t count[16];
+	uint16_t offs[16];
+	uint16_t sorted[288];
+	uint16_t codes[288];
+	uint8_t submax[1 << LITLEN_BITS];
+	uint i,len;
+
+	/* count the code lengths */
+	for(i = 0; i < 16; ++i)
+		count[i] = 0;
+	for(i = 0; i < num; ++i)
+		count[lengths[i]]++;
+	count[0] = 0;
+
+	/* reject over-subscribed codes. incomplete ones are fine, their unused entries stay invalid */
+	int left = 1;
+	for(len = 1; len < 16; ++len) {
+		left = (left << 1) - count[len];
+		if(left < 0)
+			return false;
+	}
 
-	for(i = 0; i < 24; ++i)
-		lt->trans[i] = 256 + i;
-	for(i = 0; i < 144; ++i)
-		lt->trans[24 + i] = i;
-	for(i = 0; i < 8; ++i)
-		lt->trans[24 + 144 + i] = 280 + i;
-	for(i = 0; i < 112; ++i)
-		lt->trans[24 + 144 + 8 + i] = 144 + i;
+	/* sort the symbols by code length */
+	for(offs[1] = 0, len = 1; len < 15; ++len)
+		offs[len + 1] = offs[len] + count[len];
+	for(i = 0; i < num; ++i) {
+		if(lengths[i])
+			sorted[offs[lengths[i]]++] = i;
+	}
 
-	/* build fixed distance tree */
-	for(i = 0; i < 5; ++i)
-		dt->table[i] = 0;
+	/* determine the (bit-reversed) canonical codes and the longest code behind each primary
+	 * entry, which determines the size of the sub table */
+	memset(submax,0,1 << bits);
+	uint code = 0,n = 0;
+	for(len = 1; len < 16; ++len) {
+		for(uint j = 0; j < count[len]; ++j, ++n) {
+			uint rev = 0;
+			for(uint b = 0; b < len; ++b)
+				rev |= ((code >> b) & 1) << (len - 1 - b);
+			codes[n] = rev;
+			if(len > bits)
+				submax[rev & mask(bits)] = len;
+			code++;
+		}
+		code <<= 1;
+	}
 
-	dt->table[5] = 32;
+	/* fill the tables. an entry of 0 is invalid */
+	memset(table,0,sizeof(uint32_t) << bits);
+	size_t next = 1 << bits;
+	n = 0;
+	for(len = 1; len < 16; ++len) {
+		for(uint j = 0; j < count[len]; ++j, ++n) {
+			uint32_t entry = syms[sorted[n]];
+			if(entry == 0)
+				continue;
+
+			uint rev = codes[n];
+			if(len <= bits) {
+				for(i = rev; i < (1U << bits); i += 1 << len)
+					table[i] = entry | len;
+			}
+			else {
+				uint prefix = rev & mask(bits);
+				if(table[prefix] == 0) {
+					uint subbits = submax[prefix] - bits;
+					if(next + (1 << subbits) > size)
+						return false;
+					table[prefix] = (next << E_VALUE_SHIFT) | (subbits << E_EXTRA_SHIFT) | E_SUBTABLE;
+					memset(table + next,0,sizeof(uint32_t) << subbits);
+					next += 1 << subbits;
+				}
 
-	for(i = 0; i < 32; ++i)
-		dt->trans[i] = i;
+				uint32_t *sub = table + (table[prefix] >> E_VALUE_SHIFT);
+				uint subbits = (table[prefix] >> E_EXTRA_SHIFT) & E_EXTRA_MASK;
+				for(i = rev >> bits; i < (1U << subbits); i += 1 << (len - bits))
+					sub[i] = entry | (len - bits);
+			}
+		}
+	}
+	return true;
 }
 
-/* given an array of code lengths, build a tree */
-void Inflate::build_tree(Tree *t,const unsigned char *lengths,unsigned int num) {
-	unsigned short offs[16];
-	unsigned int i,sum;
+/* build the tables for the fixed huffman codes */
+bool Inflate::build_fixed_tables(Data *d) {
+	uint8_t lengths[288];
+	uint i;
 
-	/* clear code length count table */
-	for(i = 0; i < 16; ++i)
-		t->table[i] = 0;
-
-	/* scan symbol lengths,and sum code length counts */
-	for(i = 0; i < num; ++i)
-		t->table[lengths[i]]++;
+	if(d->fixed)
+		return true;
 
-	t->table[0] = 0;
-
-	/* compute offset table for distribution sort */
-	for(sum = 0,i = 0; i < 16; ++i) {
-		offs[i] = sum;
-		sum += t->table[i];
-	}
+	for(i = 0; i < 144; ++i)
+		lengths[i] = 8;
+	for(; i < 256; ++i)
+		lengths[i] = 9;
+	for(; i < 280; ++i)
+		lengths[i] = 7;
+	for(; i < 288; ++i)
+		lengths[i] = 8;
+	if(!build_table(d->littable,LITLEN_ENOUGH,LITLEN_BITS,litsyms,lengths,288))
+		return false;
 
-	/* create code->symbol translation table (symbols sorted by code) */
-	for(i = 0; i < num; ++i) {
-		if(lengths[i])
-			t->trans[offs[lengths[i]]++] = i;
-	}
+	for(i = 0; i < 32; ++i)
+		lengths[i] = 5;
+	if(!build_table(d->disttable,DIST_ENOUGH,DIST_BITS,distsyms,lengths,32))
+		return false;
+	d->fixed = true;
+	return true;
 }
 
 /* ---------------------- *
  * -- decode functions -- *
  * ---------------------- */
 
-/* get one bit from source stream */
-int Inflate::getbit(Data *d) {
-	unsigned int bit;
+/* refill the input buffer from the source, keeping the bytes the bit buffer might contain */
+void Inflate::refill_input(Data *d) {
+	size_t keep = std::min<size_t>(d->in - d->inbuf,sizeof(d->bitbuf));
+	memmove(d->inbuf,d->in - keep,keep);
+	d->in = d->inbuf + keep;
+	d->in_end = d->in + d->source->read(d->inbuf + keep,IN_SIZE);
+}
 
-	/* check if tag is empty */
-	if(!d->bitcount--) {
-		/* load next tag */
-		d->tag = d->source->get();
-		d->bitcount = 7;
+/* make sure that at least <num> bits are in the bit buffer. at the end of the input, zeros are
+ * added, which is detected later if they are actually consumed */
+void Inflate::need(Data *d,uint num) {
+	while(d->bitcnt < num) {
+		uint8_t byte = 0;
+		if(d->in == d->in_end)
+			refill_input(d);
+		if(d->in < d->in_end)
+			byte = *d->in++;
+		else
+			d->overrun++;
+		d->bitbuf |= (uint64_t)byte << d->bitcnt;
+		d->bitcnt += 8;
 	}
-
-	/* shift bit out of tag */
-	bit = d->tag & 0x01;
-	d->tag >>= 1;
-
-	return bit;
 }
 
 /* read a num bit value from a stream and add base */
-unsigned int Inflate::read_bits(Data *d,int num,int base) {
-	unsigned int val = 0;
-
-	/* read num bits */
-	if(num) {
-		unsigned int limit = 1 << (num);
-		unsigned int mask;
-
-		for(mask = 1; mask < limit; mask *= 2)
-			if(getbit(d)) val += mask;
-	}
-
+uint Inflate::read_bits(Data *d,uint num,uint base) {
+	need(d,num);
+	uint val = d->bitbuf & mask(num);
+	d->bitbuf >>= num;
+	d->bitcnt -= num;
 	return val + base;
 }
 
-/* given a data stream and a tree, decode a symbol */
-int Inflate::decode_symbol(Data *d,Tree *t) {
-	int sum = 0,cur = 0,len = 0;
-
-	/* get more bits while code value is above sum */
-	do {
-		cur = 2 * cur + getbit(d);
-
-		++len;
-
-		sum += t->table[len];
-		cur -= t->table[len];
+/* decode the next symbol with given table and return its entry, with the code consumed */
+uint32_t Inflate::decode_symbol(Data *d,const uint32_t *table,uint bits) {
+	need(d,15);
+	uint32_t entry = table[d->bitbuf & mask(bits)];
+	if(entry & E_SUBTABLE) {
+		d->bitbuf >>= bits;
+		d->bitcnt -= bits;
+		entry = table[(entry >> E_VALUE_SHIFT) +
+			(d->bitbuf & mask((entry >> E_EXTRA_SHIFT) & E_EXTRA_MASK))];
 	}
-	while(cur >= 0);
-
-	return t->trans[sum + cur];
+	d->bitbuf >>= entry & E_LEN_MASK;
+	d->bitcnt -= entry & E_LEN_MASK;
+	return entry;
 }
 
 /* given a data stream, decode dynamic trees from it */
-void Inflate::decode_trees(Data *d,Tree *lt,Tree *dt) {
-	Tree code_tree;
-	unsigned char lengths[288 + 32];
-	unsigned int hlit,hdist,hclen;
-	unsigned int i,num,length;
+bool Inflate::decode_trees(Data *d) {
+	uint32_t codetable[1 << PRECODE_BITS];
+	uint8_t lengths[288 + 32];
+	uint hlit,hdist,hclen;
+	uint i,num,length;
 
 	/* get 5 bits HLIT (257-286) */
 	hlit = read_bits(d,5,257);
@@ -205,183 +289,316 @@ void Inflate::decode_trees(Data *d,Tree *lt,Tree *dt) {
 	/* read code lengths for code length alphabet */
 	for(i = 0; i < hclen; ++i) {
 		/* get 3 bits code length (0-7) */
-		unsigned int clen = read_bits(d,3,0);
-
-		lengths[clcidx[i]] = clen;
+		lengths[clcidx[i]] = read_bits(d,3,0);
 	}
 
-	/* build code length tree */
-	build_tree(&code_tree,lengths,19);
+	/* build code length table */
+	if(!build_table(codetable,ARRAY_SIZE(codetable),PRECODE_BITS,precodesyms,lengths,19))
+		return false;
 
 	/* decode code lengths for the dynamic trees */
 	for(num = 0; num < hlit + hdist;) {
-		int sym = decode_symbol(d,&code_tree);
+		uint32_t entry = decode_symbol(d,codetable,PRECODE_BITS);
+		if(EXPECT_FALSE(!(entry & E_LEN_MASK)))
+			return false;
 
+		uint sym = entry >> E_VALUE_SHIFT;
+		unsigned char val = 0;
 		switch(sym) {
 			case 16:
 				/* copy previous code length 3-6 times (read 2 bits) */
-				{
-					unsigned char prev = lengths[num - 1];
-					for(length = read_bits(d,2,3); length; --length)
-						lengths[num++] = prev;
-				}
+				if(num == 0)
+					return false;
+				val = lengths[num - 1];
+				length = read_bits(d,2,3);
 				break;
 			case 17:
 				/* repeat code length 0 for 3-10 times (read 3 bits) */
-				for(length = read_bits(d,3,3); length; --length)
-					lengths[num++] = 0;
+				length = read_bits(d,3,3);
 				break;
 			case 18:
 				/* repeat code length 0 for 11-138 times (read 7 bits) */
-				for(length = read_bits(d,7,11); length; --length)
-					lengths[num++] = 0;
+				length = read_bits(d,7,11);
 				break;
 			default:
 				/* values 0-15 represent the actual code lengths */
-				lengths[num++] = sym;
+				val = sym;
+				length = 1;
 				break;
 		}
+
+		if(num + length > hlit + hdist)
+			return false;
+		for(; length; --length)
+			lengths[num++] = val;
+	}
+
+	/* build dynamic tables */
+	d->fixed = false;
+	return build_table(d->littable,LITLEN_ENOUGH,LITLEN_BITS,litsyms,lengths,hlit) &&
+		build_table(d->disttable,DIST_ENOUGH,DIST_BITS,distsyms,lengths + hlit,hdist);
+}
+
+/* pass the output to the drain and keep the last WSIZE bytes as the window */
+void Inflate::flush_window(Data *d) {
+	d->drain->write(d->flushed,d->out - d->flushed);
+	if(d->out - d->window > (ssize_t)WSIZE) {
+		memmove(d->window,d->out - WSIZE,WSIZE);
+		d->out = d->window + WSIZE;
 	}
+	d->flushed = d->out;
+}
 
-	/* build dynamic trees */
-	build_tree(lt,lengths,hlit);
-	build_tree(dt,lengths + hlit,hdist);
+/* go to the next byte boundary and give the complete bytes in the bit buffer back to the input */
+void Inflate::align(Data *d) {
+	d->bitcnt -= d->bitcnt & 7;
+	d->in -= (d->bitcnt >> 3) - d->overrun;
+	d->bitbuf = 0;
+	d->bitcnt = 0;
+	d->overrun = 0;
 }
 
 /* ----------------------------- *
  * -- block inflate functions -- *
  * ----------------------------- */
 
-/* given a stream and two trees, inflate a block of data */
-int Inflate::inflate_block_data(Data *d,Tree *lt,Tree *dt) {
-	while(1) {
-		int sym = decode_symbol(d,lt);
+/* decodes symbols as long as there is enough input for a whole symbol and enough space for the
+ * longest match. returns AGAIN if that is no longer the case */
+int Inflate::inflate_fast(Data *d) {
+	const uint32_t *lt = d->littable;
+	const uint32_t *dt = d->disttable;
+	const uint8_t *in = d->in;
+	const uint8_t *in_last = d->in_end - sizeof(uint64_t);
+	uint8_t *out = d->out;
+	uint8_t *out_last = d->wend - MAX_MATCH;
+	uint64_t bitbuf = d->bitbuf;
+	uint bitcnt = d->bitcnt;
+	int res = AGAIN;
+
+	/* one symbol with extra bits and a distance with extra bits need at most 48 bits, so that a
+	 * single refill per iteration suffices */
+	while(in <= in_last && out <= out_last) {
+		/* fill the bit buffer to at least 56 bits. the bits above <bitcnt> belong to the next
+		 * byte and are simply or'd in again with the next refill */
+		bitbuf |= load64(in) << bitcnt;
+		in += (63 - bitcnt) >> 3;
+		bitcnt |= 56;
+
+		uint32_t entry = lt[bitbuf & mask(LITLEN_BITS)];
+		if(EXPECT_FALSE(entry & E_SUBTABLE)) {
+			bitbuf >>= LITLEN_BITS;
+			bitcnt -= LITLEN_BITS;
+			entry = lt[(entry >> E_VALUE_SHIFT) +
+				(bitbuf & mask((entry >> E_EXTRA_SHIFT) & E_EXTRA_MASK))];
+		}
+		bitbuf >>= entry & E_LEN_MASK;
+		bitcnt -= entry & E_LEN_MASK;
 
-		/* check for end of block */
-		if(sym == 256)
-			return OK;
+		if(EXPECT_TRUE(entry & E_LITERAL)) {
+			*out++ = entry >> E_VALUE_SHIFT;
+			continue;
+		}
+		if(entry & E_EOB) {
+			res = OK;
+			break;
+		}
+		if(EXPECT_FALSE(!(entry & E_LEN_MASK))) {
+			res = FAILED;
+			break;
+		}
 
-		if(sym < 256)
-			d->drain->put(sym);
-		else {
-			int length,dist,offs;
-			int i;
+		/* length with extra bits */
+		uint extra = (entry >> E_EXTRA_SHIFT) & E_EXTRA_MASK;
+		size_t length = (entry >> E_VALUE_SHIFT) + (bitbuf & mask(extra));
+		bitbuf >>= extra;
+		bitcnt -= extra;
+
+		/* distance with extra bits */
+		entry = dt[bitbuf & mask(DIST_BITS)];
+		if(EXPECT_FALSE(entry & E_SUBTABLE)) {
+			bitbuf >>= DIST_BITS;
+			bitcnt -= DIST_BITS;
+			entry = dt[(entry >> E_VALUE_SHIFT) +
+				(bitbuf & mask((entry >> E_EXTRA_SHIFT) & E_EXTRA_MASK))];
+		}
+		bitbuf >>= entry & E_LEN_MASK;
+		bitcnt -= entry & E_LEN_MASK;
+		extra = (entry >> E_EXTRA_SHIFT) & E_EXTRA_MASK;
+		size_t dist = (entry >> E_VALUE_SHIFT) + (bitbuf & mask(extra));
+		bitbuf >>= extra;
+		bitcnt -= extra;
+
+		if(EXPECT_FALSE(!(entry & E_LEN_MASK) || dist > (size_t)(out - d->window))) {
+			res = FAILED;
+			break;
+		}
+		out = copy_match(out,dist,length);
+	}
 
-			sym -= 257;
+	d->in = in;
+	d->out = out;
+	d->bitbuf = bitbuf;
+	d->bitcnt = bitcnt;
+	return res;
+}
 
-			/* possibly get more bits from length code */
-			length = read_bits(d,length_bits[sym],length_base[sym]);
+/* inflate a block of data with the current tables */
+int Inflate::inflate_block_data(Data *d) {
+	while(1) {
+		if((size_t)(d->wend - d->out) < MAX_MATCH)
+			flush_window(d);
 
-			dist = decode_symbol(d,dt);
+		int res = inflate_fast(d);
+		if(res != AGAIN)
+			return res;
+		if((size_t)(d->wend - d->out) < MAX_MATCH)
+			continue;
 
-			/* possibly get more bits from distance code */
-			offs = read_bits(d,dist_bits[dist],dist_base[dist]);
+		/* close to the end of the input buffer: decode one symbol carefully */
+		if(d->overrun > sizeof(d->bitbuf))
+			return FAILED;
 
-			/* copy match */
-			for(i = 0; i < length; ++i)
-				d->drain->put(d->drain->get(offs));
+		uint32_t entry = decode_symbol(d,d->littable,LITLEN_BITS);
+		if(entry & E_LITERAL) {
+			*d->out++ = entry >> E_VALUE_SHIFT;
+			continue;
 		}
+		if(entry & E_EOB)
+			return OK;
+		if(!(entry & E_LEN_MASK))
+			return FAILED;
+
+		size_t length = read_bits(d,(entry >> E_EXTRA_SHIFT) & E_EXTRA_MASK,entry >> E_VALUE_SHIFT);
+		entry = decode_symbol(d,d->disttable,DIST_BITS);
+		if(!(entry & E_LEN_MASK))
+			return FAILED;
+		size_t dist = read_bits(d,(entry >> E_EXTRA_SHIFT) & E_EXTRA_MASK,entry >> E_VALUE_SHIFT);
+		if(dist > (size_t)(d->out - d->window))
+			return FAILED;
+		d->out = copy_match(d->out,dist,length);
 	}
 }
 
 /* inflate an uncompressed block of data */
 int Inflate::inflate_uncompressed_block(Data *d) {
-	unsigned int length,invlength;
-	unsigned int i;
+	uint length,invlength;
 
-	/* get length */
-	length = d->source->get();
-	length = length + 256 * d->source->get();
+	/* continue at the next byte boundary */
+	if(d->overrun > (d->bitcnt >> 3))
+		return FAILED;
+	align(d);
 
-	/* get one's complement of length */
-	invlength = d->source->get();
-	invlength = invlength + 256 * d->source->get();
+	/* get length and one's complement of length */
+	length = read_bits(d,16,0);
+	invlength = read_bits(d,16,0);
 
 	/* check length */
 	if(length != (~invlength & 0x0000ffff))
 		return FAILED;
+	if(d->overrun > (d->bitcnt >> 3))
+		return FAILED;
+	align(d);
 
 	/* copy block */
-	for(i = length; i; --i)
-		d->drain->put(d->source->get());
-
-	/* make sure we start next block on a byte boundary */
-	d->bitcount = 0;
-
+	while(length > 0) {
+		if(d->in == d->in_end) {
+			refill_input(d);
+			if(d->in == d->in_end)
+				return FAILED;
+		}
+		if(d->out == d->wend)
+			flush_window(d);
+
+		size_t amount = std::min<size_t>(length,d->in_end - d->in);
+		amount = std::min<size_t>(amount,d->wend - d->out);
+		memcpy(d->out,d->in,amount);
+		d->out += amount;
+		d->in += amount;
+		length -= amount;
+	}
 	return OK;
 }
 
-/* inflate a block of data compressed with fixed huffman trees */
-int Inflate::inflate_fixed_block(Data *d) {
-	/* decode block using fixed trees */
-	return inflate_block_data(d,&sltree,&sdtree);
-}
-
-/* inflate a block of data compressed with dynamic huffman trees */
-int Inflate::inflate_dynamic_block(Data *d) {
-	/* decode trees from stream */
-	decode_trees(d,&d->ltree,&d->dtree);
-
-	/* decode block using decoded trees */
-	return inflate_block_data(d,&d->ltree,&d->dtree);
-}
-
 /* ---------------------- *
  * -- public functions -- *
  * ---------------------- */
 
-/* initialize global (static) data */
+/* initialize the table entries of all symbols */
 Inflate::Inflate() : DeflateBase() {
-	/* build fixed huffman trees */
-	build_fixed_trees(&sltree,&sdtree);
+	uint i;
+	for(i = 0; i < 256; ++i)
+		litsyms[i] = (i << E_VALUE_SHIFT) | E_LITERAL;
+	litsyms[256] = E_EOB;
+	for(i = 0; i < 29; ++i)
+		litsyms[257 + i] = (length_base[i] << E_VALUE_SHIFT) | (length_bits[i] << E_EXTRA_SHIFT);
+	/* 286 and 287 do not occur in valid streams */
+	litsyms[286] = litsyms[287] = 0;
+
+	for(i = 0; i < 30; ++i)
+		distsyms[i] = (dist_base[i] << E_VALUE_SHIFT) | (dist_bits[i] << E_EXTRA_SHIFT);
+	distsyms[30] = distsyms[31] = 0;
+
+	for(i = 0; i < 19; ++i)
+		precodesyms[i] = (i << E_VALUE_SHIFT) | E_LITERAL;
 }
 
 /* inflate stream from source to dest */
 int Inflate::uncompress(InflateDrain *drain,InflateSource *source) {
-	Data d;
-	int bfinal;
+	Data *d = new Data;
+	int bfinal,res = OK;
 
 	/* initialise data */
-	d.source = source;
-	d.bitcount = 0;
-
-	d.drain = drain;
+	d->source = source;
+	d->drain = drain;
+	d->bitbuf = 0;
+	d->bitcnt = 0;
+	d->overrun = 0;
+	d->in = d->in_end = d->inbuf;
+	d->out = d->flushed = d->window;
+	d->wend = d->window + WSIZE + OUT_SIZE;
+	d->fixed = false;
 
 	do {
-		unsigned int btype;
-		int res;
-
 		/* read final block flag */
-		bfinal = getbit(&d);
+		bfinal = read_bits(d,1,0);
 
 		/* read block type (2 bits) */
-		btype = read_bits(&d,2,0);
+		uint btype = read_bits(d,2,0);
 
 		/* decompress block */
 		switch(btype) {
 			case 0:
 				/* decompress uncompressed block */
-				res = inflate_uncompressed_block(&d);
+				res = inflate_uncompressed_block(d);
 				break;
 			case 1:
 				/* decompress block with fixed huffman trees */
-				res = inflate_fixed_block(&d);
+				res = build_fixed_tables(d) ? inflate_block_data(d) : FAILED;
 				break;
 			case 2:
 				/* decompress block with dynamic huffman trees */
-				res = inflate_dynamic_block(&d);
+				res = decode_trees(d) ? inflate_block_data(d) : FAILED;
 				break;
 			default:
-				return FAILED;
+				res = FAILED;
+				break;
 		}
 
-		if(res != OK)
-			return FAILED;
-
+		/* we may have used zeros beyond the end of the input */
+		if(d->overrun > (d->bitcnt >> 3))
+			res = FAILED;
 	}
-	while(!bfinal);
-
-	return 0;
+	while(res == OK && !bfinal);
+
+	if(res == OK) {
+		flush_window(d);
+		/* the input might continue after the stream (e.g. with a gzip trailer) */
+		align(d);
+		if(d->in < d->in_end)
+			source->unread(d->in,d->in_end - d->in);
+	}
+	delete d;
+	return res == OK ? 0 : FAILED;
 }
 
 }
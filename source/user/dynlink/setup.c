@@ -18,6 +18,7 @@
  */
 
 #include <sys/common.h>
+#include <sys/mman.h>
 #include <sys/proc.h>
 #include <stdlib.h>
 #include <stdio.h>
@@ -70,8 +71,9 @@ void load_initHeap(void) {
 	initHeap();
 #ifndef NDEBUG
 	/* allocate a lot of memory at the beginning to make the beginning of shared libraries more
-	 * predictable */
-	free(malloc(MAX_MEM));
+	 * predictable. note that malloc would use mmap for such a large area */
+	if(chgsize(MAX_MEM / PAGE_SIZE) == NULL)
+		load_error("Not enough mem!");
 #endif
 }
 
@@ -26,7 +26,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 
-static int compr = z::Deflate::FIXED;
+static int level = z::Deflate::DEFAULT;
 static int tostdout = false;
 static int keep = false;
 
@@ -47,7 +47,7 @@ static void compress(FILE *f,const std::string &filename) {
 	z::FileDeflateSource src(f);
 	z::FileDeflateDrain drain(out);
 	z::Deflate deflate;
-	if(deflate.compress(&drain,&src,compr) != 0)
+	if(deflate.compress(&drain,&src,level) != 0)
 		printe("%s: compressing failed",filename.c_str());
 	else {
 		uint32_t crc32 = src.crc32();
@@ -68,18 +68,19 @@ static void compress(FILE *f,const std::string &filename) {
 }
 
 static void usage(const char *name) {
-	fprintf(stderr,"Usage: %s [-c] [-k] <file>...\n",name);
+	fprintf(stderr,"Usage: %s [-c] [-k] [-l <level>] <file>...\n",name);
 	fprintf(stderr,"  -c: write to stdout\n");
 	fprintf(stderr,"  -k: keep the original files, don't delete them\n");
+	fprintf(stderr,"  -l: the compression level: 0 = store only, ..., 9 = best (default: %d)\n",
+		z::Deflate::DEFAULT);
 	exit(EXIT_FAILURE);
 }
 
 int main(int argc,char **argv) {
 	esc::cmdargs args(argc,argv,0);
 	try {
-		args.parse("c l=d k",&tostdout,&compr,&keep);
-		if(args.is_help() ||
-			(compr != z::Deflate::NONE && compr != z::Deflate::FIXED && compr != z::Deflate::DYN))
+		args.parse("c l=d k",&tostdout,&level,&keep);
+		if(args.is_help() || level < z::Deflate::NONE || level > z::Deflate::BEST)
 			usage(argv[0]);
 	}
 	catch(const esc::cmdargs_error& e) {
@@ -31,6 +31,9 @@ extern sTestModule tModBintree;
 extern sTestModule tModMap;
 extern sTestModule tModSmartPtr;
 extern sTestModule tModTuple;
+extern sTestModule tModUnordered;
+extern sTestModule tModMapPerf;
+extern sTestModule tModSortPerf;
 
 int main(void) {
 	test_register(&tModString);
@@ -43,6 +46,9 @@ int main(void) {
 	test_register(&tModMap);
 	test_register(&tModSmartPtr);
 	test_register(&tModTuple);
+	test_register(&tModUnordered);
+	test_register(&tModMapPerf);
+	test_register(&tModSortPerf);
 	test_start();
 	/* flush stdout because cout will be closed before stdout is flushed by exit(). thus, that flush
 	 * will fail because the file has already been closed. */
@@ -23,6 +23,7 @@
 #include <algorithm>
 #include <list>
 #include <vector>
+#include <string>
 
 using namespace std;
 
@@ -36,6 +37,8 @@ static void test_fill(void);
 static void test_generate(void);
 static void test_remove(void);
 static void test_reverse(void);
+static void test_sort(void);
+static void test_heap(void);
 static void test_binsearch(void);
 static void test_merge(void);
 static void test_includes(void);
@@ -66,6 +69,8 @@ static void test_algo(void) {
 	test_generate();
 	test_remove();
 	test_reverse();
+	test_sort();
+	test_heap();
 	test_binsearch();
 	test_merge();
 	test_includes();
@@ -262,6 +267,96 @@ static void test_reverse(void) {
 	test_caseSucceeded();
 }
 
+struct SortEntry {
+	int key;
+	int pos;
+	bool operator<(const SortEntry &e) const {
+		return key < e.key;
+	}
+};
+
+static int compare_ints(const void *a,const void *b) {
+	return *(const int*)a - *(const int*)b;
+}
+
+static void check_sorted(const vector<int> &v,size_t count) {
+	test_assertSize(v.size(),count);
+	for(size_t i = 1; i < v.size(); ++i)
+		test_assertTrue(v[i - 1] <= v[i]);
+}
+
+static void test_sort(void) {
+	test_caseStart("Testing sort");
+
+	for(int n = 0; n < 300; n += 7) {
+		vector<int> sorted,reversed,random,few;
+		for(int i = 0; i < n; ++i) {
+			sorted.push_back(i);
+			reversed.push_back(n - i);
+			random.push_back(rand());
+			few.push_back(rand() % 3);
+		}
+		sort(sorted.begin(),sorted.end());
+		check_sorted(sorted,n);
+		sort(reversed.begin(),reversed.end());
+		check_sorted(reversed,n);
+		sort(random.begin(),random.end());
+		check_sorted(random,n);
+		sort(few.begin(),few.end());
+		check_sorted(few,n);
+	}
+
+	const char *strs[] = {"foo","bar","test","a","abc","foo","z","ab"};
+	vector<string> s(strs,strs + ARRAY_SIZE(strs));
+	sort(s.begin(),s.end());
+	for(size_t i = 1; i < s.size(); ++i)
+		test_assertTrue(s[i - 1] <= s[i]);
+
+	vector<SortEntry> e;
+	for(int i = 0; i < 200; ++i) {
+		SortEntry entry = {rand() % 10,i};
+		e.push_back(entry);
+	}
+	stable_sort(e.begin(),e.end());
+	for(size_t i = 1; i < e.size(); ++i) {
+		test_assertTrue(e[i - 1].key <= e[i].key);
+		if(e[i - 1].key == e[i].key)
+			test_assertTrue(e[i - 1].pos < e[i].pos);
+	}
+
+	int ints[] = {5,1,4,2,3};
+	qsort(ints,ARRAY_SIZE(ints),sizeof(int),compare_ints);
+	for(int i = 0; i < 5; ++i)
+		test_assertInt(ints[i],i + 1);
+
+	test_caseSucceeded();
+}
+
+static void test_heap(void) {
+	test_caseStart("Testing heap");
+
+	int ints[] = {10,20,30,5,15,1};
+	vector<int> v(ints,ints + ARRAY_SIZE(ints));
+	make_heap(v.begin(),v.end());
+	test_assertInt(v.front(),30);
+
+	pop_heap(v.begin(),v.end());
+	test_assertInt(v.back(),30);
+	v.pop_back();
+	test_assertInt(v.front(),20);
+
+	v.push_back(99);
+	push_heap(v.begin(),v.end());
+	test_assertInt(v.front(),99);
+
+	sort_heap(v.begin(),v.end());
+	check_sorted(v,6);
+	test_assertInt(v.front(),1);
+	test_assertInt(v.back(),99);
+
+	test_caseSucceeded();
+}
+
 static void test_binsearch(void) {
 	test_caseStart("Testing binsearch");
 
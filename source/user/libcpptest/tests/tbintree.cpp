@@ -32,6 +32,8 @@ static void test_order(void);
 static void test_copy(void);
 static void test_erase(void);
 static void test_iterators(void);
+static void test_sorted(void);
+static void test_bounds(void);
 
 /* our test-module */
 sTestModule tModBintree = {
@@ -45,6 +47,8 @@ static void test_bintree(void) {
 	test_copy();
 	test_erase();
 	test_iterators();
+	test_sorted();
+	test_bounds();
 }
 
 static void test_insert(void) {
@@ -387,6 +391,99 @@ static void test_erase(void) {
 	after = heapspace();
 	test_assertSize(after,before);
 
+	before = heapspace();
+	{
+		bintree<int,int> t;
+		for(int i = 0; i < 10; ++i)
+			t.insert(i,i);
+
+		// erasing a node with two children must not invalidate iterators to other nodes
+		bintree<int,int>::iterator five = t.find(5);
+		bintree<int,int>::iterator six = t.find(6);
+		t.erase(t.find(3));
+		t.erase(five);
+		test_assertTrue(*six == make_pair(6,6));
+		test_assertTrue(t.find(6) == six);
+		test_assertSize(t.size(),8);
+	}
+	after = heapspace();
+	test_assertSize(after,before);
+
+	test_caseSucceeded();
+}
+
+static void test_sorted(void) {
+	size_t before,after;
+	test_caseStart("Testing sorted inserts");
+
+	before = heapspace();
+	{
+		bintree<int,int> t;
+		for(int i = 0; i < 1000; ++i)
+			t.insert(i,i);
+		for(int i = 999; i >= 1000 - 200; --i)
+			t.erase(i);
+		for(int i = 0; i < 1000; ++i)
+			t.insert(t.end(),i,i * 2);
+		test_assertSize(t.size(),1000);
+
+		int i = 0;
+		for(auto it = t.begin(); it != t.end(); ++it, ++i) {
+			test_assertInt(it->first,i);
+			test_assertInt(it->second,i * 2);
+		}
+		test_assertInt(i,1000);
+
+		for(int i = 0; i < 1000; i += 2)
+			t.erase(i);
+		i = 1;
+		for(auto it = t.begin(); it != t.end(); ++it, i += 2)
+			test_assertInt(it->first,i);
+	}
+	after = heapspace();
+	test_assertSize(after,before);
+
+	before = heapspace();
+	{
+		// wrong hints have to be ignored
+		bintree<int,int> t;
+		for(int i = 0; i < 20; i += 2)
+			t.insert(i,i);
+		t.insert(t.find(4),9,9);
+		t.insert(t.begin(),15,15);
+		t.insert(t.end(),-1,-1);
+		t.insert(t.find(8),7,7);
+
+		int ints[] = {-1,0,2,4,6,7,8,9,10,12,14,15,16,18};
+		int i = 0;
+		for(auto it = t.begin(); it != t.end(); ++it)
+			test_assertInt(it->first,ints[i++]);
+		test_assertSize(t.size(),ARRAY_SIZE(ints));
+	}
+	after = heapspace();
+	test_assertSize(after,before);
+
+	test_caseSucceeded();
+}
+
+static void test_bounds(void) {
+	test_caseStart("Testing bounds");
+
+	bintree<int,int> t;
+	for(int i = 0; i < 100; i += 10)
+		t.insert(i,i);
+
+	test_assertInt(t.lower_bound(-5)->first,0);
+	test_assertInt(t.lower_bound(0)->first,0);
+	test_assertInt(t.lower_bound(41)->first,50);
+	test_assertInt(t.lower_bound(50)->first,50);
+	test_assertTrue(t.lower_bound(91) == t.end());
+	test_assertInt(t.upper_bound(-5)->first,0);
+	test_assertInt(t.upper_bound(0)->first,10);
+	test_assertInt(t.upper_bound(49)->first,50);
+	test_assertInt(t.upper_bound(50)->first,60);
+	test_assertTrue(t.upper_bound(90) == t.end());
+
 	test_caseSucceeded();
 }
 
@@ -0,0 +1,132 @@
+/**
+ * $Id$
+ * Copyright (C) 2008 - 2014 Nils Asmussen
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#include <sys/common.h>
+#include <sys/test.h>
+#include <sys/time.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <map>
+#include <unordered_map>
+
+using namespace std;
+
+#define ELEMENT_COUNT		20000
+
+/* forward declarations */
+static void test_mapperf(void);
+static void test_sorted(void);
+static void test_random(void);
+
+/* our test-module */
+sTestModule tModMapPerf = {
+	"Map performance",
+	&test_mapperf
+};
+
+static uint keys[ELEMENT_COUNT];
+
+static void test_mapperf(void) {
+	test_sorted();
+	test_random();
+}
+
+static void print_result(const char *name,uint64_t insert,uint64_t lookup) {
+	printf("%-24s: insert=%6Lu lookup=%6Lu cycles/element\n",name,
+		insert / ELEMENT_COUNT,lookup / ELEMENT_COUNT);
+}
+
+template<class M>
+static void run(const char *name,M &m) {
+	uint64_t start = rdtsc();
+	for(size_t i = 0; i < ELEMENT_COUNT; ++i)
+		m[keys[i]] = i;
+	uint64_t insert = rdtsc() - start;
+
+	size_t found = 0;
+	start = rdtsc();
+	for(size_t i = 0; i < ELEMENT_COUNT; ++i)
+		found += m.count(keys[i]);
+	uint64_t lookup = rdtsc() - start;
+
+	test_assertSize(m.size(),ELEMENT_COUNT);
+	test_assertSize(found,ELEMENT_COUNT);
+	print_result(name,insert,lookup);
+}
+
+static void run_hinted(const char *name) {
+	map<uint,uint> m;
+	uint64_t start = rdtsc();
+	for(size_t i = 0; i < ELEMENT_COUNT; ++i)
+		m.insert(m.end(),make_pair(keys[i],i));
+	uint64_t insert = rdtsc() - start;
+
+	size_t found = 0;
+	start = rdtsc();
+	for(size_t i = 0; i < ELEMENT_COUNT; ++i)
+		found += m.count(keys[i]);
+	uint64_t lookup = rdtsc() - start;
+
+	test_assertSize(m.size(),ELEMENT_COUNT);
+	test_assertSize(found,ELEMENT_COUNT);
+	print_result(name,insert,lookup);
+}
+
+static void test_sorted(void) {
+	test_caseStart("Inserting %d sorted keys",ELEMENT_COUNT);
+
+	/* consecutive IPv4 addresses, as e.g. in the ARP cache */
+	for(size_t i = 0; i < ELEMENT_COUNT; ++i)
+		keys[i] = 0x0A000001 + i;
+
+	{
+		map<uint,uint> m;
+		run("map",m);
+	}
+	run_hinted("map (hint end())");
+	{
+		unordered_map<uint,uint> m;
+		run("unordered_map",m);
+	}
+
+	test_caseSucceeded();
+}
+
+static void test_random(void) {
+	test_caseStart("Inserting %d random keys",ELEMENT_COUNT);
+
+	srand(0x1234);
+	for(size_t i = 0; i < ELEMENT_COUNT; ++i) {
+		keys[i] = 0x0A000001 + i;
+		size_t j = rand() % (i + 1);
+		std::swap(keys[i],keys[j]);
+	}
+
+	{
+		map<uint,uint> m;
+		run("map",m);
+	}
+	{
+		unordered_map<uint,uint> m;
+		run("unordered_map",m);
+	}
+
+	test_caseSucceeded();
+}
@@ -0,0 +1,150 @@
+/**
+ * $Id$
+ * Copyright (C) 2008 - 2014 Nils Asmussen
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#include <sys/common.h>
+#include <sys/test.h>
+#include <sys/time.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+#define ELEMENT_COUNT		50000
+
+/* forward declarations */
+static void test_sortperf(void);
+static void test_ints(void);
+static void test_strings(void);
+
+/* our test-module */
+sTestModule tModSortPerf = {
+	"Sort performance",
+	&test_sortperf
+};
+
+enum Input {
+	IN_SORTED,
+	IN_REVERSED,
+	IN_RANDOM,
+};
+
+static const char *inputNames[] = {"sorted","reversed","random"};
+static int values[ELEMENT_COUNT];
+
+static void test_sortperf(void) {
+	test_ints();
+	test_strings();
+}
+
+static void gen_input(Input in) {
+	srand(0x1234);
+	for(size_t i = 0; i < ELEMENT_COUNT; ++i) {
+		switch(in) {
+			case IN_SORTED:
+				values[i] = i;
+				break;
+			case IN_REVERSED:
+				values[i] = ELEMENT_COUNT - i;
+				break;
+			case IN_RANDOM:
+				values[i] = rand();
+				break;
+		}
+	}
+}
+
+static int compare_ints(const void *a,const void *b) {
+	int ia = *(const int*)a;
+	int ib = *(const int*)b;
+	return ia < ib ? -1 : (ia > ib ? 1 : 0);
+}
+
+template<class T>
+static void check_sorted(const T *begin,const T *end) {
+	for(const T *it = begin + 1; it < end; ++it)
+		test_assertTrue(!(*it < *(it - 1)));
+}
+
+static void print_result(const char *algo,Input in,uint64_t time) {
+	printf("%-12s %-9s: %8Lu cycles (%Lu per element)\n",algo,inputNames[in],
+		time,time / ELEMENT_COUNT);
+}
+
+static void test_ints(void) {
+	test_caseStart("Sorting %d ints",ELEMENT_COUNT);
+
+	static int copy[ELEMENT_COUNT];
+	for(int in = IN_SORTED; in <= IN_RANDOM; ++in) {
+		gen_input((Input)in);
+
+		memcpy(copy,values,sizeof(values));
+		uint64_t start = rdtsc();
+		sort(copy,copy + ELEMENT_COUNT);
+		print_result("sort",(Input)in,rdtsc() - start);
+		check_sorted(copy,copy + ELEMENT_COUNT);
+
+		memcpy(copy,values,sizeof(values));
+		start = rdtsc();
+		stable_sort(copy,copy + ELEMENT_COUNT);
+		print_result("stable_sort",(Input)in,rdtsc() - start);
+		check_sorted(copy,copy + ELEMENT_COUNT);
+
+		memcpy(copy,values,sizeof(values));
+		start = rdtsc();
+		qsort(copy,ELEMENT_COUNT,sizeof(int),compare_ints);
+		print_result("qsort",(Input)in,rdtsc() - start);
+		check_sorted(copy,copy + ELEMENT_COUNT);
+	}
+
+	test_caseSucceeded();
+}
+
+static void test_strings(void) {
+	test_caseStart("Sorting %d strings",ELEMENT_COUNT / 10);
+
+	for(int in = IN_SORTED; in <= IN_RANDOM; ++in) {
+		gen_input((Input)in);
+
+		vector<string> strs;
+		for(size_t i = 0; i < ELEMENT_COUNT / 10; ++i) {
+			char buf[16];
+			snprintf(buf,sizeof(buf),"%010d",values[i]);
+			strs.push_back(buf);
+		}
+
+		vector<string> copy(strs);
+		uint64_t start = rdtsc();
+		sort(copy.begin(),copy.end());
+		print_result("sort",(Input)in,rdtsc() - start);
+		check_sorted(&copy[0],&copy[0] + copy.size());
+
+		copy = strs;
+		start = rdtsc();
+		stable_sort(copy.begin(),copy.end());
+		print_result("stable_sort",(Input)in,rdtsc() - start);
+		check_sorted(&copy[0],&copy[0] + copy.size());
+	}
+
+	test_caseSucceeded();
+}
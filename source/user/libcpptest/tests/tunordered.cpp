@@ -0,0 +1,229 @@
+/**
+ * $Id$
+ * Copyright (C) 2008 - 2014 Nils Asmussen
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#include <sys/common.h>
+#include <sys/test.h>
+#include <stdlib.h>
+#include <unordered_map>
+#include <unordered_set>
+#include <string>
+
+using namespace std;
+
+/* forward declarations */
+static void test_unordered(void);
+static void test_insert(void);
+static void test_erase(void);
+static void test_rehash(void);
+static void test_copy(void);
+static void test_set(void);
+
+/* our test-module */
+sTestModule tModUnordered = {
+	"Unordered map and set",
+	&test_unordered
+};
+
+static void test_unordered(void) {
+	test_insert();
+	test_erase();
+	test_rehash();
+	test_copy();
+	test_set();
+}
+
+static void test_insert(void) {
+	size_t before,after;
+	test_caseStart("Testing insert");
+
+	before = heapspace();
+	{
+		unordered_map<int,int> m;
+		test_assertTrue(m.empty());
+		test_assertTrue(m.begin() == m.end());
+		m[4] = 2;
+		m[1] = -12;
+		m[4] = 3;
+		test_assertSize(m.size(),2);
+		test_assertInt(m[4],3);
+		test_assertInt(m.at(1),-12);
+		test_assertTrue(m.find(2) == m.end());
+		test_assertSize(m.count(1),1);
+		test_assertSize(m.count(2),0);
+
+		pair<unordered_map<int,int>::iterator,bool> res = m.insert(make_pair(1,5));
+		test_assertFalse(res.second);
+		test_assertInt(res.first->second,-12);
+		res = m.insert(make_pair(2,5));
+		test_assertTrue(res.second);
+		test_assertInt(res.first->second,5);
+	}
+	after = heapspace();
+	test_assertSize(after,before);
+
+	before = heapspace();
+	{
+		unordered_map<string,int> m;
+		m["foo"] = 1;
+		m["bar"] = 4;
+		m["a"] = 12;
+		test_assertInt(m["foo"],1);
+		test_assertInt(m["bar"],4);
+		test_assertInt(m["a"],12);
+		test_assertTrue(m.find("b") == m.end());
+
+		int sum = 0;
+		for(auto it = m.begin(); it != m.end(); ++it)
+			sum += it->second;
+		test_assertInt(sum,17);
+	}
+	after = heapspace();
+	test_assertSize(after,before);
+
+	test_caseSucceeded();
+}
+
+static void test_erase(void) {
+	size_t before,after;
+	test_caseStart("Testing erase");
+
+	before = heapspace();
+	{
+		unordered_map<int,int> m;
+		for(int i = 0; i < 100; ++i)
+			m[i] = i;
+		for(int i = 0; i < 100; i += 2)
+			test_assertSize(m.erase(i),1);
+		test_assertSize(m.erase(2),0);
+		test_assertSize(m.size(),50);
+		for(int i = 0; i < 100; ++i)
+			test_assertSize(m.count(i),i % 2);
+
+		// erase while iterating
+		for(auto it = m.begin(); it != m.end(); ) {
+			if(it->first % 3 == 0)
+				it = m.erase(it);
+			else
+				++it;
+		}
+		for(int i = 0; i < 100; ++i)
+			test_assertSize(m.count(i),(i % 2) && (i % 3) ? 1 : 0);
+
+		m.erase(m.begin(),m.end());
+		test_assertTrue(m.empty());
+	}
+	after = heapspace();
+	test_assertSize(after,before);
+
+	test_caseSucceeded();
+}
+
+static void test_rehash(void) {
+	size_t before,after;
+	test_caseStart("Testing rehash");
+
+	before = heapspace();
+	{
+		unordered_map<int,int> m;
+		for(int i = 0; i < 1000; ++i)
+			m[i * 4096] = i;
+		test_assertSize(m.size(),1000);
+		test_assertTrue(m.load_factor() <= m.max_load_factor());
+		for(int i = 0; i < 1000; ++i)
+			test_assertInt(m[i * 4096],i);
+
+		size_t count = 0;
+		for(size_t b = 0; b < m.bucket_count(); ++b)
+			count += m.bucket_size(b);
+		test_assertSize(count,1000);
+
+		m.reserve(5000);
+		test_assertTrue(m.bucket_count() >= 5000);
+		test_assertSize(m.size(),1000);
+		for(int i = 0; i < 1000; ++i)
+			test_assertInt(m[i * 4096],i);
+	}
+	after = heapspace();
+	test_assertSize(after,before);
+
+	test_caseSucceeded();
+}
+
+static void test_copy(void) {
+	size_t before,after;
+	test_caseStart("Testing copy");
+
+	before = heapspace();
+	{
+		unordered_map<int,int> m1;
+		for(int i = 0; i < 50; ++i)
+			m1[i] = i + 1;
+		unordered_map<int,int> m2(m1);
+		test_assertTrue(m1 == m2);
+		m2[50] = 51;
+		test_assertTrue(m1 != m2);
+
+		unordered_map<int,int> m3;
+		m3[4] = 4;
+		m3 = m1;
+		test_assertTrue(m3 == m1);
+		test_assertTrue(m3.find(4)->second == 5);
+
+		m3.swap(m2);
+		test_assertSize(m3.size(),51);
+		test_assertSize(m2.size(),50);
+	}
+	after = heapspace();
+	test_assertSize(after,before);
+
+	test_caseSucceeded();
+}
+
+static void test_set(void) {
+	size_t before,after;
+	test_caseStart("Testing set");
+
+	before = heapspace();
+	{
+		unordered_set<int> s;
+		for(int i = 0; i < 20; ++i)
+			test_assertTrue(s.insert(i).second);
+		test_assertFalse(s.insert(4).second);
+		test_assertSize(s.size(),20);
+		test_assertSize(s.count(19),1);
+		test_assertSize(s.count(20),0);
+		test_assertSize(s.erase(19),1);
+		test_assertTrue(s.find(19) == s.end());
+
+		unordered_set<int> s2(s.begin(),s.end());
+		test_assertTrue(s == s2);
+
+		unordered_set<string> strs;
+		strs.insert("foo");
+		strs.insert("bar");
+		strs.insert("foo");
+		test_assertSize(strs.size(),2);
+		test_assertStr(strs.find("bar")->c_str(),"bar");
+	}
+	after = heapspace();
+	test_assertSize(after,before);
+
+	test_caseSucceeded();
+}
@@ -21,6 +21,7 @@
 #include <sys/test.h>
 #include <stdlib.h>
 #include <vector>
+#include <string>
 
 using namespace std;
 
@@ -33,6 +34,7 @@ static void test_insert(void);
 static void test_at(void);
 static void test_erase(void);
 static void test_nonpod(void);
+static void test_growth(void);
 
 /* our test-module */
 sTestModule tModVector = {
@@ -48,6 +50,7 @@ static void test_vector(void) {
 	test_at();
 	test_erase();
 	test_nonpod();
+	test_growth();
 }
 
 static void test_constr(void) {
@@ -267,6 +270,7 @@ static void test_erase(void) {
 }
 
 static unsigned counter = 0;
+static unsigned moves = 0;
 
 struct NonPOD {
 	NonPOD() : x(0) {
@@ -277,6 +281,10 @@ struct NonPOD {
 	NonPOD(const NonPOD &a) : x(a.x) {
 		attach();
 	}
+	NonPOD(NonPOD &&a) : x(a.x) {
+		a.x = 0;
+		moves++;
+	}
 	NonPOD &operator=(const NonPOD &a) {
 		if(&a != this) {
 			detach();
@@ -338,3 +346,58 @@ static void test_nonpod(void) {
 
 	test_caseSucceeded();
 }
+
+static void test_growth(void) {
+	test_caseStart("Testing growth");
+
+	size_t before = heapspace();
+
+	{
+		vector<NonPOD> v;
+		for(int i = 1; i <= 100; ++i)
+			v.emplace_back(i);
+		test_assertUInt(counter,100);
+		test_assertSize(v.size(),100);
+
+		// growing moves the elements instead of copying them
+		moves = 0;
+		size_t cap = v.capacity();
+		v.reserve(cap * 2);
+		test_assertSize(v.capacity(),cap * 2);
+		test_assertUInt(moves,100);
+		test_assertUInt(counter,100);
+
+		v.shrink_to_fit();
+		test_assertSize(v.capacity(),100);
+		test_assertUInt(counter,100);
+
+		// pushing an element of the vector itself has to work while growing
+		v.push_back(v[0]);
+		test_assertUInt(counter,101);
+
+		v.resize(10);
+		test_assertUInt(counter,10);
+		v.pop_back();
+		test_assertUInt(counter,9);
+
+		v.clear();
+		test_assertUInt(counter,0);
+		test_assertSize(v.size(),0);
+	}
+
+	{
+		vector<string> v;
+		v.emplace_back("foo");
+		v.emplace_back(3,'a');
+		v.insert(v.begin(),"bar");
+		test_assertSize(v.size(),3);
+		test_assertStr(v[0].c_str(),"bar");
+		test_assertStr(v[1].c_str(),"foo");
+		test_assertStr(v[2].c_str(),"aaa");
+	}
+
+	size_t after = heapspace();
+	test_assertSize(after,before);
+
+	test_caseSucceeded();
+}
@@ -22,6 +22,8 @@
 #include <sys/test.h>
 #include <sys/proc.h>
 #include <sys/stat.h>
+#include <sys/wait.h>
+#include <dirent.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
@@ -31,6 +33,8 @@ static void test_basics(void);
 static void test_perms(void);
 static void test_rename(void);
 static void test_largeFile(void);
+static void test_concurrentWrites(void);
+static void test_bigDir(void);
 static void test_assertCan(const char *path,uint mode);
 static void test_assertCanNot(const char *path,uint mode,int err);
 static void fs_createFile(const char *name,const char *content);
@@ -51,6 +55,8 @@ static void test_fs(void) {
 		test_perms();
 		test_rename();
 		test_largeFile();
+		test_concurrentWrites();
+		test_bigDir();
 	}
 	else
 		printf("WARNING: Detected readonly filesystem; skipping the test\n\n");
@@ -270,6 +276,131 @@ static void test_largeFile(void) {
 	test_caseSucceeded();
 }
 
+static int concurrent_writer(const char *path,const uint8_t *buf,size_t bufsize,size_t size) {
+	int fd = create(path,O_WRONLY | O_TRUNC,FILE_DEF_MODE);
+	if(fd < 0)
+		return EXIT_FAILURE;
+	for(size_t rem = size; rem > 0; ) {
+		size_t amount = MIN(rem,bufsize);
+		if(write(fd,buf,amount) != (ssize_t)amount) {
+			close(fd);
+			return EXIT_FAILURE;
+		}
+		rem -= amount;
+	}
+	close(fd);
+	return EXIT_SUCCESS;
+}
+
+static void test_concurrentWrites(void) {
+	/* larger than a message, so that the data is sent in a separate message after the request */
+	static uint8_t buf[4096 + 123];
+	static uint8_t rbuf[4096 + 123];
+	const size_t size = 64 * 1024;
+	const int count = 4;
+	char path[MAX_PATH_LEN];
+	test_caseStart("Writing large files concurrently without shared memory");
+
+	for(size_t i = 0; i < sizeof(buf); ++i)
+		buf[i] = i;
+
+	/* let multiple clients write at the same time to let the fs driver handle them in batches */
+	for(int i = 0; i < count; ++i) {
+		int pid = fork();
+		test_assertTrue(pid >= 0);
+		if(pid == 0) {
+			snprintf(path,sizeof(path),"/concurrent-%d",i);
+			exit(concurrent_writer(path,buf,sizeof(buf),size));
+		}
+	}
+	for(int i = 0; i < count; ++i) {
+		sExitState state;
+		test_assertTrue(waitchild(&state,-1) >= 0);
+		test_assertInt(state.exitCode,EXIT_SUCCESS);
+	}
+
+	for(int i = 0; i < count; ++i) {
+		snprintf(path,sizeof(path),"/concurrent-%d",i);
+		int fd = open(path,O_RDONLY);
+		test_assertTrue(fd >= 0);
+		if(fd >= 0) {
+			for(size_t rem = size; rem > 0; ) {
+				size_t amount = MIN(rem,sizeof(rbuf));
+				test_assertSSize(read(fd,rbuf,amount),amount);
+				test_assertTrue(memcmp(rbuf,buf,amount) == 0);
+				rem -= amount;
+			}
+			close(fd);
+		}
+		test_assertInt(unlink(path),0);
+	}
+
+	test_caseSucceeded();
+}
+
+static void test_bigDir(void) {
+	/* enough entries to let the directory span multiple blocks (and get indexed on ext2) */
+	const size_t count = 500;
+	char path[MAX_PATH_LEN];
+	struct stat info;
+	test_caseStart("Creating a large directory");
+
+	test_assertInt(mkdir("/bigdir",DIR_DEF_MODE),0);
+	for(size_t i = 0; i < count; ++i) {
+		snprintf(path,sizeof(path),"/bigdir/file-with-a-long-name-%zu",i);
+		fs_createFile(path,"foo");
+	}
+
+	/* all of them have to be listed exactly once */
+	{
+		size_t found = 0;
+		struct dirent e;
+		DIR *dir = opendir("/bigdir");
+		test_assertTrue(dir != NULL);
+		while(readdir(dir,&e)) {
+			if(strncmp(e.d_name,"file-with-a-long-name-",22) == 0)
+				found++;
+		}
+		closedir(dir);
+		test_assertSize(found,count);
+	}
+
+	/* remove every second one */
+	for(size_t i = 0; i < count; i += 2) {
+		snprintf(path,sizeof(path),"/bigdir/file-with-a-long-name-%zu",i);
+		test_assertInt(unlink(path),0);
+	}
+	for(size_t i = 0; i < count; ++i) {
+		snprintf(path,sizeof(path),"/bigdir/file-with-a-long-name-%zu",i);
+		test_assertInt(stat(path,&info),(i % 2) == 0 ? -ENOENT : 0);
+	}
+
+	/* the removed ones must not be listed anymore */
+	{
+		size_t found = 0;
+		struct dirent e;
+		DIR *dir = opendir("/bigdir");
+		test_assertTrue(dir != NULL);
+		while(readdir(dir,&e)) {
+			if(strncmp(e.d_name,"file-with-a-long-name-",22) == 0) {
+				test_assertTrue((strtoul(e.d_name + 22,NULL,10) % 2) == 1);
+				found++;
+			}
+		}
+		closedir(dir);
+		test_assertSize(found,count / 2);
+	}
+
+	test_assertInt(rmdir("/bigdir"),-ENOTEMPTY);
+	for(size_t i = 1; i < count; i += 2) {
+		snprintf(path,sizeof(path),"/bigdir/file-with-a-long-name-%zu",i);
+		test_assertInt(unlink(path),0);
+	}
+	test_assertInt(rmdir("/bigdir"),0);
+
+	test_caseSucceeded();
+}
+
 static void test_assertCan(const char *path,uint mode) {
 	int fd = open(path,mode);
 	test_assertTrue(fd >= 0);
@@ -34,13 +34,17 @@
 static bool run = true;
 
 static void usage(const char *name) {
-	fprintf(stderr,"Usage: %s [--ms <ms>] <device> <path> <fs>\n",name);
+	fprintf(stderr,"Usage: %s [--ms <ms>] [-o <opts>] <device> <path> <fs>\n",name);
 	fprintf(stderr,"    For example, %s /dev/hda1 /mnt ext2, where ext2 is a program\n",name);
 	fprintf(stderr,"    in PATH that takes the device as argument 2 and creates\n");
 	fprintf(stderr,"    /dev/ext2-hda1 (in this case).\n");
 	fprintf(stderr,"\n");
 	fprintf(stderr,"    By default, the current mountspace (/sys/proc/self/ms) will\n");
 	fprintf(stderr,"    be used. This can be overwritten by specifying --ms <ms>.\n");
+	fprintf(stderr,"\n");
+	fprintf(stderr,"    -o passes a comma-separated list of options (e.g. noatime or\n");
+	fprintf(stderr,"    relatime) as argument 3 to the fs. They are ignored if the fs\n");
+	fprintf(stderr,"    is already running.\n");
 	exit(EXIT_FAILURE);
 }
 
@@ -56,8 +60,9 @@ int main(int argc,const char *argv[]) {
 	char *path = NULL;
 	char *dev = NULL;
 	char *fs = NULL;
+	char *opts = NULL;
 
-	int res = ca_parse(argc,argv,CA_NO_FREE,"ms=s =s* =s* =s*",&mspath,&dev,&path,&fs);
+	int res = ca_parse(argc,argv,CA_NO_FREE,"ms=s o=s =s* =s* =s*",&mspath,&opts,&dev,&path,&fs);
 	if(res < 0) {
 		printe("Invalid arguments: %s",ca_error(res));
 		usage(argv[0]);
@@ -89,7 +94,7 @@ int main(int argc,const char *argv[]) {
 		if(pid < 0)
 			error("fork failed");
 		if(pid == 0) {
-			const char *args[] = {fs,fsdev,dev,NULL};
+			const char *args[] = {fs,fsdev,dev,opts,NULL};
 			execvp(fs,args);
 			error("exec failed");
 		}
@@ -19,6 +19,10 @@
 
 #include <sys/common.h>
 
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
 extern int mod_getpid(int,char**);
 extern int mod_yield(int,char**);
 extern int mod_fork(int,char**);
@@ -35,3 +39,13 @@ extern int mod_locks(int,char**);
 extern int mod_chgsize(int,char**);
 extern int mod_pagefault(int,char**);
 extern int mod_heap(int,char**);
+extern int mod_deflate(int,char**);
+extern int mod_crc32(int,char**);
+extern int mod_inflate(int,char**);
+extern int mod_fsalloc(int,char**);
+extern int mod_readers(int,char**);
+extern int mod_elfstart(int,char**);
+
+#if defined(__cplusplus)
+}
+#endif
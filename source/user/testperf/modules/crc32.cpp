@@ -0,0 +1,72 @@
+/**
+ * $Id$
+ * Copyright (C) 2008 - 2014 Nils Asmussen
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <sys/common.h>
+#include <sys/time.h>
+#include <z/crc32.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../modules.h"
+
+#define MAX_SIZE		(1024 * 1024)
+#define TOTAL_BYTES		(16 * 1024 * 1024)
+
+typedef z::CRC32::type (*crc_func)(z::CRC32::type crc,const void *buf,size_t len);
+
+static size_t sizes[] = {64,1024,64 * 1024,MAX_SIZE};
+static uint8_t buffer[MAX_SIZE];
+
+static z::CRC32::type update_default(z::CRC32::type crc,const void *buf,size_t len) {
+	z::CRC32 c;
+	return c.update(crc,buf,len);
+}
+
+static void do_test(const char *name,crc_func func,z::CRC32::type *results) {
+	for(size_t s = 0; s < ARRAY_SIZE(sizes); ++s) {
+		size_t count = TOTAL_BYTES / sizes[s];
+		z::CRC32::type crc = 0;
+		uint64_t start = rdtsc();
+		for(size_t i = 0; i < count; ++i)
+			crc = func(crc,buffer,sizes[s]);
+		uint64_t total = rdtsc() - start;
+
+		/* all implementations have to produce the same result */
+		if(results[s] == 0)
+			results[s] = crc;
+		uint64_t usecs = tsctotime(total);
+		printf("%-8s: %7zub: %5Lu cycles/call, throughput=%Lu MB/s%s\n",
+			name,sizes[s],total / count,usecs ? (uint64_t)TOTAL_BYTES / usecs : 0,
+			results[s] != crc ? " (WRONG RESULT)" : "");
+	}
+	fflush(stdout);
+}
+
+int mod_crc32(A_UNUSED int argc,A_UNUSED char **argv) {
+	z::CRC32::type results[ARRAY_SIZE(sizes)] = {0};
+	srand(rdtsc());
+	for(size_t i = 0; i < MAX_SIZE; ++i)
+		buffer[i] = rand();
+
+	do_test("bytewise",z::CRC32::update_bytewise,results);
+	do_test("sliced",z::CRC32::update_sliced,results);
+	if(z::CRC32::accelerated())
+		do_test("pclmul",update_default,results);
+	return 0;
+}
@@ -0,0 +1,78 @@
+/**
+ * $Id$
+ * Copyright (C) 2008 - 2014 Nils Asmussen
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <sys/common.h>
+#include <sys/time.h>
+#include <z/deflate.h>
+#include <z/inflate.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../modules.h"
+#include "zcorpus.h"
+
+static const int levels[] = {z::Deflate::NONE,z::Deflate::FAST,3,z::Deflate::DEFAULT,z::Deflate::BEST};
+
+static void do_compress(const char *path) {
+	size_t size;
+	uint8_t *data = zcorpus_read(path,&size);
+	if(!data) {
+		printe("Unable to read %s",path);
+		return;
+	}
+
+	/* the output might be slightly larger than the input for incompressible data */
+	size_t max = size + size / 8 + 1024;
+	uint8_t *out = (uint8_t*)malloc(max);
+	uint8_t *check = (uint8_t*)malloc(size + 1);
+	z::Deflate deflate;
+	for(size_t i = 0; i < ARRAY_SIZE(levels); ++i) {
+		z::MemDeflateSource src(data,size);
+		z::MemDeflateDrain drain(out,max);
+		uint64_t start = rdtsc();
+		if(deflate.compress(&drain,&src,levels[i]) != 0) {
+			printe("Compressing %s failed",path);
+			break;
+		}
+		uint64_t total = rdtsc() - start;
+
+		/* verify the result */
+		z::MemInflateSource isrc(out,drain.count());
+		z::MemInflateDrain idrain(check,size + 1);
+		z::Inflate inflate;
+		bool ok = drain.count() <= max && inflate.uncompress(&idrain,&isrc) == 0 &&
+			memcmp(check,data,size) == 0;
+
+		uint64_t usecs = tsctotime(total);
+		printf("%-16s: level=%d size=%zu compressed=%zu ratio=%3zu%% throughput=%Lu MB/s%s\n",
+			path,levels[i],size,drain.count(),size ? (drain.count() * 100) / size : 0,
+			usecs ? (uint64_t)size / usecs : 0,ok ? "" : " (VERIFICATION FAILED)");
+	}
+	fflush(stdout);
+
+	free(check);
+	free(out);
+	free(data);
+}
+
+int mod_deflate(int argc,char **argv) {
+	zcorpus_run(argc,argv,do_compress);
+	return 0;
+}
@@ -0,0 +1,111 @@
+/**
+ * $Id$
+ * Copyright (C) 2008 - 2014 Nils Asmussen
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <sys/common.h>
+#include <sys/arch.h>
+#include <sys/mman.h>
+#include <sys/proc.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../modules.h"
+
+#define START_COUNT		100
+#define TOUCH_COUNT		20
+
+static void startup(const char **args) {
+	uint64_t total = 0, min = ~0ULL;
+	for(int i = 0; i < START_COUNT; ++i) {
+		uint64_t start = rdtsc();
+		int pid = fork();
+		if(pid == 0) {
+			/* we're only interested in the time to get the program running */
+			int fd = open("/dev/null",O_WRONLY);
+			if(fd >= 0)
+				redirect(STDOUT_FILENO,fd);
+			execv(args[0],args);
+			exit(EXIT_FAILURE);
+		}
+		else if(pid < 0) {
+			printe("fork failed");
+			return;
+		}
+		waitchild(NULL,-1);
+		uint64_t time = rdtsc() - start;
+		total += time;
+		min = MIN(min,time);
+	}
+	printf("%-16s: avg=%Lu min=%Lu cycles/start\n",args[0],total / START_COUNT,min);
+}
+
+static void touch(const char *path,int advice,const char *name) {
+	uint64_t total = 0;
+	int fd = open(path,O_RDONLY);
+	if(fd < 0) {
+		printe("Unable to open '%s'",path);
+		return;
+	}
+	ssize_t size = filesize(fd);
+	if(size <= 0) {
+		printe("Unable to get size of '%s'",path);
+		close(fd);
+		return;
+	}
+
+	for(int i = 0; i < TOUCH_COUNT; ++i) {
+		/* use a private mapping to get a new region that has not been loaded yet */
+		uint64_t start = rdtsc();
+		volatile char *addr = mmap(NULL,size,size,PROT_READ,MAP_PRIVATE,fd,0);
+		if(!addr) {
+			printe("mmap failed");
+			break;
+		}
+		if(madvise((void*)addr,advice) < 0)
+			printe("madvise failed");
+		for(ssize_t off = 0; off < size; off += PAGE_SIZE)
+			(void)addr[off];
+		total += rdtsc() - start;
+		munmap((void*)addr);
+	}
+	close(fd);
+
+	printf("touch %-10s: %Lu cycles for %zd pages\n",name,total / TOUCH_COUNT,
+		(size + PAGE_SIZE - 1) / PAGE_SIZE);
+}
+
+int mod_elfstart(int argc,char *argv[]) {
+	const char *defargs[] = {"/bin/readelf","-a","/bin/readelf",NULL};
+	const char **args = argc > 2 ? (const char**)argv + 2 : defargs;
+
+	printf("Starting %s %d times...\n",args[0],START_COUNT);
+	fflush(stdout);
+	startup(args);
+
+	printf("Touching all pages of %s sequentially...\n",args[0]);
+	fflush(stdout);
+	touch(args[0],MADV_RANDOM,"random");
+	touch(args[0],MADV_NORMAL,"normal");
+	touch(args[0],MADV_SEQUENTIAL,"sequential");
+	touch(args[0],MADV_WILLNEED,"willneed");
+	fflush(stdout);
+	return EXIT_SUCCESS;
+}
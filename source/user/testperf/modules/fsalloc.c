@@ -0,0 +1,134 @@
+/**
+ * $Id$
+ * Copyright (C) 2008 - 2014 Nils Asmussen
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <sys/common.h>
+#include <sys/arch.h>
+#include <sys/time.h>
+#include <sys/stat.h>
+#include <sys/io.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../modules.h"
+
+#define FILE_COUNT		256
+#define FILE_SIZE		(64 * 1024)
+#define BIG_SIZE		(8 * 1024 * 1024)
+#define CHUNK_SIZE		(64 * 1024)
+
+static char buffer[CHUNK_SIZE];
+
+static bool writeFile(const char *path,size_t size) {
+	int fd = create(path,O_WRONLY | O_TRUNC,0644);
+	if(fd < 0) {
+		printe("Unable to create '%s'",path);
+		return false;
+	}
+	for(size_t off = 0; off < size; off += CHUNK_SIZE) {
+		if(write(fd,buffer,CHUNK_SIZE) != CHUNK_SIZE) {
+			printe("Writing to '%s' failed",path);
+			close(fd);
+			return false;
+		}
+	}
+	close(fd);
+	return true;
+}
+
+static uint64_t syncDir(const char *dir) {
+	uint64_t start = rdtsc();
+	int fd = open(dir,O_RDONLY);
+	if(fd >= 0) {
+		if(syncfs(fd) < 0)
+			printe("syncfs failed");
+		close(fd);
+	}
+	return rdtsc() - start;
+}
+
+static void printResult(const char *name,uint64_t time,size_t files,size_t bytes) {
+	printf("%-9s: %8Lu cycles/file, %Lu MB/s\n",name,time / files,(uint64_t)bytes / tsctotime(time));
+}
+
+int mod_fsalloc(int argc,char *argv[]) {
+	const char *dir = argc > 2 ? argv[2] : "/fsalloc";
+	char path[MAX_PATH_LEN];
+	uint64_t start,time;
+
+	memset(buffer,0x55,sizeof(buffer));
+	if(mkdir(dir,DIR_DEF_MODE) < 0) {
+		printe("Unable to create '%s'",dir);
+		return 1;
+	}
+
+	/* fill the directory with small files; this is mostly bound by the allocation of blocks */
+	start = rdtsc();
+	for(size_t i = 0; i < FILE_COUNT; ++i) {
+		snprintf(path,sizeof(path),"%s/small%zu",dir,i);
+		if(!writeFile(path,FILE_SIZE))
+			return 1;
+	}
+	time = rdtsc() - start;
+	time += syncDir(dir);
+	printResult("fill",time,FILE_COUNT,FILE_COUNT * FILE_SIZE);
+
+	/* fragment the free space by deleting every second file */
+	start = rdtsc();
+	for(size_t i = 0; i < FILE_COUNT; i += 2) {
+		snprintf(path,sizeof(path),"%s/small%zu",dir,i);
+		if(unlink(path) < 0)
+			printe("Unable to unlink '%s'",path);
+	}
+	time = rdtsc() - start;
+	time += syncDir(dir);
+	printf("%-9s: %8Lu cycles/file\n","unlink",time / (FILE_COUNT / 2));
+
+	/* now write a large file, which should get long runs of blocks nevertheless */
+	snprintf(path,sizeof(path),"%s/big",dir);
+	start = rdtsc();
+	if(!writeFile(path,BIG_SIZE))
+		return 1;
+	time = rdtsc() - start;
+	time += syncDir(dir);
+	printResult("big",time,1,BIG_SIZE);
+
+	/* refill the holes */
+	start = rdtsc();
+	for(size_t i = 0; i < FILE_COUNT; i += 2) {
+		snprintf(path,sizeof(path),"%s/small%zu",dir,i);
+		if(!writeFile(path,FILE_SIZE))
+			return 1;
+	}
+	time = rdtsc() - start;
+	time += syncDir(dir);
+	printResult("refill",time,FILE_COUNT / 2,(FILE_COUNT / 2) * FILE_SIZE);
+
+	/* clean up */
+	for(size_t i = 0; i < FILE_COUNT; ++i) {
+		snprintf(path,sizeof(path),"%s/small%zu",dir,i);
+		if(unlink(path) < 0)
+			printe("Unable to unlink '%s'",path);
+	}
+	snprintf(path,sizeof(path),"%s/big",dir);
+	if(unlink(path) < 0)
+		printe("Unable to unlink '%s'",path);
+	if(rmdir(dir) < 0)
+		printe("Unable to remove '%s'",dir);
+	return 0;
+}
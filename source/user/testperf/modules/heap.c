@@ -18,7 +18,9 @@
  */
 
 #include <sys/common.h>
+#include <sys/conf.h>
 #include <sys/proc.h>
+#include <sys/thread.h>
 #include <sys/time.h>
 #include <stdio.h>
 #include <string.h>
@@ -26,8 +28,14 @@
 
 #include "../modules.h"
 
+#define MT_COUNT		100000
+#define MT_SLOTS		64
+#define MAX_THREADS		8
+
 static const uint TEST_COUNT    = 10000;
 static size_t sizes[] = {4,8,16,32,64,128,256,512,1024};
+static size_t largeSizes[] = {4096,16384,65536,262144};
+static uint64_t mtTimes[MAX_THREADS];
 
 static void test1(void) {
 	uint64_t atimes[ARRAY_SIZE(sizes)];
@@ -86,8 +94,64 @@ static void test2(void) {
 	free(areas);
 }
 
+static void test3(void) {
+	printf("n*(malloc+free) of large areas:\n");
+	for(size_t s = 0; s < ARRAY_SIZE(largeSizes); ++s) {
+		uint64_t atotal = 0, ftotal = 0;
+		for(uint i = 0; i < TEST_COUNT / 10; ++i) {
+			uint64_t start = rdtsc();
+			void *p = malloc(largeSizes[s]);
+			atotal += rdtsc() - start;
+
+			start = rdtsc();
+			free(p);
+			ftotal += rdtsc() - start;
+		}
+		printf("malloc(%zu): %Lu cycles/call\n",largeSizes[s],atotal / (TEST_COUNT / 10));
+		printf("  free(%zu): %Lu cycles/call\n",largeSizes[s],ftotal / (TEST_COUNT / 10));
+	}
+}
+
+static int mtThread(void *arg) {
+	void *slots[MT_SLOTS];
+	uint rand = (uint)(uintptr_t)arg * 7919 + 1;
+	memclear(slots,sizeof(slots));
+
+	/* keep a few areas alive and replace a random one with an area of random size */
+	uint64_t start = rdtsc();
+	for(uint i = 0; i < MT_COUNT; ++i) {
+		rand = rand * 1103515245 + 12345;
+		size_t idx = (rand >> 16) % MT_SLOTS;
+		free(slots[idx]);
+		slots[idx] = malloc(16 + (rand >> 8) % 1024);
+	}
+	for(size_t i = 0; i < MT_SLOTS; ++i)
+		free(slots[i]);
+	mtTimes[(uintptr_t)arg] = rdtsc() - start;
+	return 0;
+}
+
+static void test4(void) {
+	size_t cpus = MIN(MAX_THREADS,(size_t)sysconf(CONF_CPU_COUNT));
+	printf("Random (malloc+free) with multiple threads:\n");
+	for(size_t n = 1; n <= cpus; n *= 2) {
+		for(size_t i = 0; i < n; ++i) {
+			if(startthread(mtThread,(void*)i) < 0)
+				printe("Unable to start thread");
+		}
+		join(0);
+
+		uint64_t total = 0;
+		for(size_t i = 0; i < n; ++i)
+			total += mtTimes[i];
+		printf("%zu threads: %Lu cycles/(malloc+free)\n",n,total / (n * MT_COUNT));
+	}
+}
+
 int mod_heap(A_UNUSED int argc,A_UNUSED char *argv[]) {
 	test1();
 	test2();
+	test3();
+	test4();
 	return 0;
 }
@@ -0,0 +1,108 @@
+/**
+ * $Id$
+ * Copyright (C) 2008 - 2014 Nils Asmussen
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <sys/common.h>
+#include <sys/proc.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <sys/stat.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../modules.h"
+
+#define FILE_SIZE		(256 * 1024)
+#define READ_SIZE		0x1000
+#define READ_COUNT		2000
+
+static char buffer[FILE_SIZE];
+
+static void reader(const char *path) {
+	int fd = open(path,O_RDONLY);
+	if(fd < 0)
+		error("Unable to open '%s'",path);
+
+	void *buf = buffer;
+	ulong name;
+	if(sharebuf(fd,READ_SIZE,&buf,&name,0) < 0) {
+		printe("Unable to share buffer");
+		buf = buffer;
+	}
+
+	/* read the file over and over again, so that all readers hit the same inode */
+	for(int i = 0; i < READ_COUNT; ++i) {
+		if((i * READ_SIZE) % FILE_SIZE == 0 && seek(fd,0,SEEK_SET) < 0)
+			error("Seeking in '%s' failed",path);
+		if(read(fd,buf,READ_SIZE) != READ_SIZE)
+			error("Reading from '%s' failed",path);
+	}
+
+	if(buf != buffer)
+		destroybuf(buf,name);
+	close(fd);
+}
+
+static void test_readers(const char *path,int count) {
+	uint64_t start = rdtsc();
+	for(int i = 0; i < count; ++i) {
+		int pid = fork();
+		if(pid < 0)
+			error("fork failed");
+		if(pid == 0) {
+			reader(path);
+			exit(EXIT_SUCCESS);
+		}
+	}
+	for(int i = 0; i < count; ++i)
+		waitchild(NULL,-1);
+	uint64_t end = rdtsc();
+
+	uint64_t total = (uint64_t)count * READ_COUNT * READ_SIZE;
+	printf("%d reader(s): %8Lu cycles/read, %Lu MB/s in total\n",
+		count,(end - start) / ((uint64_t)count * READ_COUNT),total / tsctotime(end - start));
+	fflush(stdout);
+}
+
+int mod_readers(int argc,char *argv[]) {
+	const char *path = argc > 2 ? argv[2] : "/readers.tmp";
+	int fd = create(path,O_WRONLY | O_TRUNC,0644);
+	if(fd < 0) {
+		printe("Unable to create '%s'",path);
+		return 1;
+	}
+	if(write(fd,buffer,sizeof(buffer)) != sizeof(buffer)) {
+		printe("write failed");
+		return 1;
+	}
+	close(fd);
+
+	/* with the ext2 option "noatime" or "relatime", the readers don't need to change the inode */
+	struct stat before,after;
+	if(stat(path,&before) < 0)
+		printe("stat of '%s' failed",path);
+
+	for(int n = 1; n <= 8; n *= 2)
+		test_readers(path,n);
+
+	if(stat(path,&after) == 0)
+		printf("access-time has %s\n",before.st_atime != after.st_atime ? "changed" : "not changed");
+	if(unlink(path) < 0)
+		printe("Unlink of '%s' failed",path);
+	return 0;
+}
@@ -18,6 +18,7 @@
  */
 
 #include <sys/common.h>
+#include <sys/conf.h>
 #include <sys/time.h>
 #include <sys/thread.h>
 #include <sys/proc.h>
@@ -36,7 +37,7 @@
 static size_t sizes[] = {0x1000,0x2000,0x4000,0x8000,0x10000,0x20000,0x40000,0x80000,0x100000};
 static char buffer[MAX_PACKET_SIZE];
 
-static void do_read(const char *path,bool useshm) {
+static void do_read(const char *path,bool useshm,bool device) {
 	uint64_t times[ARRAY_SIZE(sizes)] = {0};
 	int fd = open(path,O_RDONLY);
 	if(fd < 0) {
@@ -71,10 +72,13 @@ static void do_read(const char *path,bool useshm) {
 		destroybuf(buf,name);
 	close(fd);
 
+	/* without shared memory, the kernel lends our pages to the driver (unless disabled via the
+	 * boot-parameter "nolend") or copies the data twice */
+	const char *mode = useshm ? "shared" : (device && sysconf(CONF_LEND_PAGES) == 1) ? "lent" : "copied";
 	for(size_t s = 0; s < ARRAY_SIZE(sizes); ++s) {
-		printf("%-16s: per-read=%5Lu throughput=%Lu MB/s (%db packets)\n",
+		printf("%-16s: per-read=%5Lu throughput=%Lu MB/s (%zub packets, %s)\n",
 		       path,times[s] / PACKET_COUNT,
-		       ((uint64_t)sizes[s] * PACKET_COUNT) / tsctotime(times[s]),sizes[s]);
+		       ((uint64_t)sizes[s] * PACKET_COUNT) / tsctotime(times[s]),sizes[s],mode);
 	}
 	fflush(stdout);
 }
@@ -92,7 +96,7 @@ int mod_reading(int argc,char **argv) {
 	}
 	close(fd);
 
-	do_read("/dev/zero",useshm);
+	do_read("/dev/zero",useshm,true);
 
 	int pid;
 	if((pid = fork()) == 0) {
@@ -104,12 +108,12 @@ int mod_reading(int argc,char **argv) {
 		while(stat("/dev/ramdisk",&info) == -ENOENT)
 			sleep(50);
 
-		do_read("/dev/ramdisk",useshm);
+		do_read("/dev/ramdisk",useshm,true);
 		kill(pid,SIGTERM);
 		waitchild(NULL,-1);
 	}
 
-	do_read("/sys/test",false);
+	do_read("/sys/test",false,false);
 	if(unlink("/sys/test") < 0)
 		printe("Unlink of /sys/test failed");
 	return 0;
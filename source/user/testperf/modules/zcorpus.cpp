@@ -0,0 +1,57 @@
+/**
+ * $Id$
+ * Copyright (C) 2008 - 2014 Nils Asmussen
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <sys/common.h>
+#include <sys/stat.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "zcorpus.h"
+
+/* a text file, a binary and a mix of both by default */
+static const char *corpus[] = {"/etc/pci.ids","/bin/gzip","/sbin/ext2"};
+
+uint8_t *zcorpus_read(const char *path,size_t *size) {
+	struct stat info;
+	if(stat(path,&info) < 0)
+		return NULL;
+
+	uint8_t *buf = (uint8_t*)malloc(info.st_size);
+	FILE *f = fopen(path,"r");
+	if(!buf || !f) {
+		free(buf);
+		if(f)
+			fclose(f);
+		return NULL;
+	}
+	*size = fread(buf,1,info.st_size,f);
+	fclose(f);
+	return buf;
+}
+
+void zcorpus_run(int argc,char **argv,void (*func)(const char *path)) {
+	if(argc > 2) {
+		for(int i = 2; i < argc; ++i)
+			func(argv[i]);
+	}
+	else {
+		for(size_t i = 0; i < ARRAY_SIZE(corpus); ++i)
+			func(corpus[i]);
+	}
+}
@@ -0,0 +1,41 @@
+/**
+ * $Id$
+ * Copyright (C) 2008 - 2014 Nils Asmussen
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#pragma once
+
+#include <sys/common.h>
+
+/**
+ * Reads the given file into a newly allocated buffer.
+ *
+ * @param path the path to the file
+ * @param size will be set to the number of read bytes
+ * @return the buffer (to be free'd by the caller) or NULL if it failed
+ */
+uint8_t *zcorpus_read(const char *path,size_t *size);
+
+/**
+ * Calls <func> for all files given on the command line or, if there are none, for the default
+ * corpus of the z benchmarks.
+ *
+ * @param argc the number of arguments
+ * @param argv the arguments (the files start at index 2)
+ * @param func the function to call for each file
+ */
+void zcorpus_run(int argc,char **argv,void (*func)(const char *path));
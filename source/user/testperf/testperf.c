@@ -50,6 +50,12 @@ static sTestModule modules[] = {
 	{"chgsize",		mod_chgsize},
 	{"pagefault",	mod_pagefault},
 	{"heap",		mod_heap},
+	{"deflate",		mod_deflate},
+	{"crc32",		mod_crc32},
+	{"inflate",		mod_inflate},
+	{"fsalloc",		mod_fsalloc},
+	{"readers",		mod_readers},
+	{"elfstart",	mod_elfstart},
 };
 
 int main(int argc,char *argv[]) {